@@ -24,6 +24,7 @@ option (APEX_WITH_MPI "Enable MPI support" FALSE)
 option (APEX_WITH_OMPT "Enable OpenMP Tools (OMPT) support" FALSE)
 option (APEX_WITH_OTF2 "Enable Open Trace Format 2 (OTF2) support" FALSE)
 option (APEX_WITH_PAPI "Enable PAPI support" FALSE)
+option (APEX_WITH_PERF_EVENT "Enable per-timer counters with perf_event_open (Linux only, no PAPI needed)" FALSE)
 option (APEX_WITH_PERFETTO "Enable native Perfetto trace support" FALSE)
 option (APEX_WITH_PHIPROF "Enable APEX PhiProf support" FALSE)
 option (APEX_WITH_PLUGINS "Enable APEX policy plugin support" FALSE)
@@ -22,4 +22,20 @@ if(ZLIB_FOUND)
 
   list(APPEND _apex_imported_targets zlib)
 
+  # the compressed trace can use zstd instead of gzip
+  find_package(ZSTD)
+  if(ZSTD_FOUND)
+    add_library(zstd INTERFACE IMPORTED)
+    set_property(TARGET zstd PROPERTY
+      INTERFACE_INCLUDE_DIRECTORIES ${ZSTD_INCLUDE_DIR})
+    set_property(TARGET zstd PROPERTY
+      INTERFACE_LINK_LIBRARIES ${ZSTD_LIBRARIES})
+
+    set(CMAKE_INSTALL_RPATH ${CMAKE_INSTALL_RPATH} ${ZSTD_LIBRARY_DIR})
+    target_compile_definitions(apex_flags INTERFACE APEX_HAVE_ZSTD)
+    message(INFO " Using zstd: ${ZSTD_INCLUDE_DIR}")
+
+    list(APPEND _apex_imported_targets zstd)
+  endif()
+
 endif()
@@ -0,0 +1,35 @@
+# - Try to find ZSTD
+# Once done this will define
+#  ZSTD_FOUND       - True if ZSTD found.
+#  ZSTD_INCLUDE_DIR - where to find zstd.h, etc.
+#  ZSTD_LIBRARIES   - List of libraries when using ZSTD.
+
+
+if(NOT DEFINED $ZSTD_ROOT)
+    if(DEFINED ENV{ZSTD_ROOT})
+        set(ZSTD_ROOT $ENV{ZSTD_ROOT})
+    endif()
+endif()
+
+find_path(ZSTD_INCLUDE_DIR zstd.h
+    HINTS ${ZSTD_ROOT}/include
+    /opt/local/include /usr/local/include /usr/include)
+
+find_library(ZSTD_LIBRARY NAMES zstd
+    HINTS ${ZSTD_ROOT}/lib ${ZSTD_ROOT}/lib64
+    /usr/lib /usr/lib64 /usr/local/lib /opt/local/lib)
+
+include(FindPackageHandleStandardArgs)
+# handle the QUIETLY and REQUIRED arguments and set ZSTD_FOUND to TRUE
+# if all listed variables are TRUE
+find_package_handle_standard_args(ZSTD  DEFAULT_MSG
+                                  ZSTD_LIBRARY ZSTD_INCLUDE_DIR)
+
+mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
+
+if (ZSTD_FOUND)
+  set(ZSTD_LIBRARIES ${ZSTD_LIBRARY} )
+  set(ZSTD_INCLUDE_DIRS ${ZSTD_INCLUDE_DIR})
+  get_filename_component(ZSTD_LIBRARY_DIR ${ZSTD_LIBRARY} DIRECTORY)
+  message(STATUS "Found ZSTD: ${ZSTD_LIBRARY}")
+endif ()
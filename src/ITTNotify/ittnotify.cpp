@@ -25,20 +25,35 @@ using namespace std;
 #define APEX_TRACER
 #endif
 
-#include <stack>
-std::stack<apex::profiler*>& the_timer_stack() {
+#include "apex.hpp"
+#include "handle_cache.hpp"
+#include <vector>
+
+/* The timers started on this thread, innermost last.  Excluded timers
+ * are nullptr, so that their end is still matched. */
+std::vector<apex::profiler*>& the_timer_stack() {
 #if defined (__APPLE__)
-    static APEX_NATIVE_TLS std::stack<apex::profiler*> *the_stack = nullptr;
+    static APEX_NATIVE_TLS std::vector<apex::profiler*> *the_stack = nullptr;
     if (the_stack == nullptr) {
-        the_stack = new std::stack<apex::profiler*>();
+        the_stack = new std::vector<apex::profiler*>();
     }
     return *the_stack;
 #else
-    static APEX_NATIVE_TLS std::stack<apex::profiler*> the_stack;
+    static APEX_NATIVE_TLS std::vector<apex::profiler*> the_stack;
     return the_stack;
 #endif
 }
 
+/* String handles are created once per name, so each one is interned the
+ * first time a task begins with it. */
+apex::handle_cache<__itt_string_handle*>& the_string_handles() {
+    static apex::handle_cache<__itt_string_handle*> handles(
+        [](__itt_string_handle* const& handle) {
+            return std::string(handle->strA);
+        });
+    return handles;
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -132,13 +147,17 @@ void __itt_task_begin(__itt_domain const* domain, __itt_id taskid, __itt_id
   APEX_UNUSED(domain);
   APEX_UNUSED(taskid);
   APEX_UNUSED(parentid);
-  std::string tmp = string(handle->strA);
-  the_timer_stack().push(apex::start(tmp));
+  const apex::interned_timer * timer = the_string_handles().get(handle);
+  the_timer_stack().push_back(timer->excluded ? nullptr :
+      apex::start(timer->id));
 }
 void __itt_task_end(__itt_domain const*) {
   APEX_TRACER
-  apex::stop(the_timer_stack().top());
-  the_timer_stack().pop();
+  auto& the_stack = the_timer_stack();
+  if (the_stack.empty()) { return; }
+  apex::profiler * p = the_stack.back();
+  the_stack.pop_back();
+  if (p != nullptr) { apex::stop(p); }
 }
 
 void __itt_thread_set_name (const char * name) {
@@ -148,6 +148,17 @@ if(EXISTS "/proc/stat" AND NOT APEX_DISABLE_PROC)
   set(proc_sources proc_read.cpp)
 endif()
 
+# perf_event
+if(APEX_WITH_PERF_EVENT AND CMAKE_SYSTEM_NAME MATCHES "Linux")
+  include(CheckIncludeFile)
+  check_include_file(linux/perf_event.h HAVE_LINUX_PERF_EVENT_H)
+  if(HAVE_LINUX_PERF_EVENT_H)
+    hpx_info("apex" "Building APEX with perf_event_open counters")
+    target_compile_definitions(apex_flags INTERFACE APEX_HAVE_PERF_EVENT)
+    set(perf_event_sources perf_event_counters.cpp)
+  endif()
+endif()
+
 IF("$ENV{CRAY_CPU_TARGET}" STREQUAL "mic-knl")
     hpx_info("apex" "This is Cray KNL, will build with Cray Power support")
     set(APEX_HAVE_CRAY_POWER TRUE)
@@ -309,25 +320,44 @@ set(apex_headers
     apex_options.hpp
     apex_policies.hpp
     apex_types.h
+    async_activity.hpp
+    bayesian_optimization.hpp
+    block_zstream.hpp
+    columnar_table.hpp
     concurrency_handler.hpp
+    cooperative_tuning.hpp
     dependency_tree.hpp
+    drift_detector.hpp
+    epoch_reclaimer.hpp
     event_listener.hpp
     exhaustive.hpp
+    flight_recorder.hpp
+    global_view.hpp
     gzstream.hpp
+    handle_cache.hpp
     handler.hpp
+    mapped_trace_buffer.hpp
     memory_wrapper.hpp
+    nelder_mead.hpp
+    parallel_rank_order.hpp
+    perf_event_counters.hpp
     policy_handler.hpp
     profile.hpp
+    profile_index.hpp
     profiler.hpp
     profile_reducer.hpp
+    profile_snapshot_writer.hpp
     profiler_listener.hpp
     random.hpp
+    sampling_listener.hpp
     semaphore.hpp
     simulated_annealing.hpp
+    slab_allocator.hpp
     thread_instance.hpp
     task_identifier.hpp
     task_wrapper.hpp
     tau_listener.hpp
+    tuning_cache.hpp
     utils.hpp
     ${perfetto_headers}
     ${proc_headers}
@@ -344,27 +374,39 @@ set(apex_sources
     ${apex_mpi_sources}
     apex_options.cpp
     apex_policies.cpp
+    bayesian_optimization.cpp
+    block_zstream.cpp
+    columnar_table.cpp
     concurrency_handler.cpp
+    cooperative_tuning.cpp
     dependency_tree.cpp
     event_listener.cpp
     event_filter.cpp
     exhaustive.cpp
+    global_view.cpp
     gzstream.cpp
     handler.cpp
+    mapped_trace_buffer.cpp
     memory_wrapper.cpp
+    nelder_mead.cpp
+    parallel_rank_order.cpp
     policy_handler.cpp
     profile_reducer.cpp
+    profile_snapshot_writer.cpp
     profiler_listener.cpp
     random.cpp
+    sampling_listener.cpp
     simulated_annealing.cpp
     task_identifier.cpp
     tau_listener.cpp
     tau_dummy.cpp
     thread_instance.cpp
     trace_event_listener.cpp
+    tuning_cache.cpp
     utils.cpp
     ${perfetto_sources}
     ${proc_sources}
+    ${perf_event_sources}
     ${bfd_sources}
     ${sensor_sources}
     ${otf2_sources}
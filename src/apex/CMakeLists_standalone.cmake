@@ -21,6 +21,10 @@ if (APEX_HAVE_PROC)
 SET(PROC_SOURCE proc_read.cpp)
 endif(APEX_HAVE_PROC)
 
+if (APEX_HAVE_PERF_EVENT)
+SET(PERF_EVENT_SOURCE perf_event_counters.cpp)
+endif(APEX_HAVE_PERF_EVENT)
+
 if (LM_SENSORS_FOUND)
 SET(SENSOR_SOURCE sensor_data.cpp)
 endif(LM_SENSORS_FOUND)
@@ -30,7 +34,7 @@ SET(OTF2_SOURCE otf2_listener.cpp otf2_listener_mpi.cpp otf2_listener_nompi.cpp)
 endif(OTF2_FOUND)
 
 if (ZLIB_FOUND)
-SET(ZLIB_SOURCE gzstream.cpp)
+SET(ZLIB_SOURCE gzstream.cpp block_zstream.cpp)
 endif(ZLIB_FOUND)
 
 if (STARPU_FOUND)
@@ -69,25 +73,35 @@ apex_kokkos_tuning.cpp
 apex_options.cpp
 event_filter.cpp
 apex_policies.cpp
+bayesian_optimization.cpp
 ${bfd_SOURCE}
 ${OpenACC_SOURCE}
 ${RAJA_SOURCE}
 ${STARPU_SOURCE}
 ${PHIPROF_SOURCE}
+columnar_table.cpp
 concurrency_handler.cpp
+cooperative_tuning.cpp
 dependency_tree.cpp
 event_listener.cpp
 exhaustive.cpp
+global_view.cpp
 handler.cpp
+mapped_trace_buffer.cpp
 memory_wrapper.cpp
+nelder_mead.cpp
+parallel_rank_order.cpp
 ${OTF2_SOURCE}
 ${perfetto_sources}
+${PERF_EVENT_SOURCE}
 perftool_implementation.cpp
 policy_handler.cpp
 ${PROC_SOURCE}
 profile_reducer.cpp
+profile_snapshot_writer.cpp
 profiler_listener.cpp
 random.cpp
+sampling_listener.cpp
 ${SENSOR_SOURCE}
 simulated_annealing.cpp
 task_identifier.cpp
@@ -95,6 +109,7 @@ tcmalloc_hooks.cpp
 ${tau_SOURCE}
 thread_instance.cpp
 trace_event_listener.cpp
+tuning_cache.cpp
 utils.cpp
 ${ZLIB_SOURCE}
 )
@@ -254,10 +269,17 @@ SET(APEX_PUBLIC_HEADERS apex.h
     apex_types.h
     apex_policies.h
     apex_policies.hpp
+    bayesian_optimization.hpp
+    cooperative_tuning.hpp
+    drift_detector.hpp
     exhaustive.hpp
+    global_view.hpp
     dependency_tree.hpp
+    handle_cache.hpp
     handler.hpp
     memory_wrapper.hpp
+    nelder_mead.hpp
+    parallel_rank_order.hpp
     profile.hpp
     random.hpp
     apex_export.h
@@ -266,7 +288,8 @@ SET(APEX_PUBLIC_HEADERS apex.h
     profiler.hpp
     simulated_annealing.hpp
     task_wrapper.hpp
-    task_identifier.hpp)
+    task_identifier.hpp
+    tuning_cache.hpp)
 
 INSTALL(FILES ${APEX_PUBLIC_HEADERS} DESTINATION include)
 #set_target_properties(apex PROPERTIES PUBLIC_HEADER apex.h)
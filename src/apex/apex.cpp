@@ -37,12 +37,18 @@
 #include "policy_handler.hpp"
 #include "thread_instance.hpp"
 #include "utils.hpp"
+#include "slab_allocator.hpp"
 #include "apex_assert.h"
 #include "event_filter.hpp"
+#include "cooperative_tuning.hpp"
+#include "global_view.hpp"
 
 #include "tau_listener.hpp"
 #include "profiler_listener.hpp"
 #include "trace_event_listener.hpp"
+#if defined(__linux__)
+#include "sampling_listener.hpp"
+#endif
 #if defined(APEX_WITH_PERFETTO)
 #include "perfetto_listener.hpp"
 #endif
@@ -384,6 +390,11 @@ void apex::_initialize()
                 concurrency_handler(apex_options::concurrency_period(),
             apex_options::use_concurrency()));
         }
+#if defined(__linux__)
+        if (apex_options::use_sampling()) {
+            listeners.push_back(new sampling_listener());
+        }
+#endif
         startup_throttling();
 /* For the Jupyter support, always enable the policy listener. */
         if (apex_options::use_jupyter_support() ||
@@ -391,6 +402,7 @@ void apex::_initialize()
             this->m_policy_handler = new policy_handler();
             listeners.push_back(this->m_policy_handler);
         }
+        build_dispatch_table();
     }
     this->resize_state(1);
     this->set_state(0, APEX_BUSY);
@@ -435,15 +447,90 @@ policy_handler * apex::get_policy_handler(void) const
 
 policy_handler * apex::get_policy_handler(uint64_t const& period)
 {
+    std::unique_lock<std::mutex> l(dispatch_mutex);
     if(apex_options::use_policy() && period_handlers.count(period) == 0)
     {
         period_handlers[period] = new policy_handler(period);
-        //write_lock_type l(listener_mutex);
         listeners.push_back(period_handlers[period]);
+        build_dispatch_table_locked();
     }
     return period_handlers[period];
 }
 
+/* Build the list of listeners for each frequent event, leaving out the
+ * listeners that don't handle it. */
+void apex::build_dispatch_table(void) {
+    std::unique_lock<std::mutex> l(dispatch_mutex);
+    build_dispatch_table_locked();
+}
+
+/* The caller holds the dispatch_mutex. */
+void apex::build_dispatch_table_locked(void) {
+    for (int e = 0 ; e < DISPATCH_EVENTS ; e++) {
+        dispatch_event event = static_cast<dispatch_event>(e);
+        std::vector<event_listener*> handlers;
+        for (auto listener : listeners) {
+            if (listener->handles(event)) {
+                handlers.push_back(listener);
+            }
+        }
+        const dispatch_list * table = nullptr;
+        for (auto& existing : dispatch_lists) {
+            if (existing->listeners == handlers) {
+                table = existing.get();
+                break;
+            }
+        }
+        if (table == nullptr) {
+            dispatch_list * created = new dispatch_list();
+            created->profiler_only = (handlers.size() == 1 &&
+                handlers[0] == the_profiler_listener);
+            created->listeners = std::move(handlers);
+            dispatch_lists.emplace_back(created);
+            table = created;
+        }
+        dispatch_table[e] = table;
+    }
+}
+
+/* Call the handler for an event on each listener that handles it.  When
+ * the profiler_listener is the only one (the usual case), it is called
+ * directly, and because the class is final, the call isn't virtual. */
+template <typename Handler>
+inline void notify_listeners(apex * instance, dispatch_event event,
+    Handler handler) {
+    const dispatch_list * table = instance->dispatch_table[event];
+    if (table == nullptr) { return; }
+    if (table->profiler_only) {
+        handler(instance->the_profiler_listener);
+        return;
+    }
+    for (auto listener : table->listeners) {
+        handler(listener);
+    }
+}
+
+/* The start events also update the task's profiler after each listener,
+ * and fail if the profiler_listener fails (i.e. the timer is throttled). */
+inline bool notify_start(apex * instance,
+    std::shared_ptr<task_wrapper> &tt_ptr) {
+    const dispatch_list * table = instance->dispatch_table[DISPATCH_START];
+    if (table == nullptr) { return true; }
+    if (table->profiler_only) {
+        bool success = instance->the_profiler_listener->on_start(tt_ptr);
+        tt_ptr->prof = thread_instance::instance().get_current_profiler();
+        return success;
+    }
+    for (auto listener : table->listeners) {
+        bool success = listener->on_start(tt_ptr);
+        tt_ptr->prof = thread_instance::instance().get_current_profiler();
+        if (!success && listener == instance->the_profiler_listener) {
+            return false;
+        }
+    }
+    return true;
+}
+
 #ifdef APEX_HAVE_HPX
 void apex::set_hpx_runtime(hpx::runtime * hpx_runtime) {
     m_hpx_runtime = hpx_runtime;
@@ -621,7 +708,9 @@ inline std::shared_ptr<task_wrapper> _new_task(
     const uint64_t task_id,
     const std::shared_ptr<task_wrapper> parent_task, apex* instance) {
     APEX_UNUSED(instance);
-    std::shared_ptr<task_wrapper> tt_ptr = make_shared<task_wrapper>();
+    // the task_wrapper and its reference counts come from a per-thread pool
+    std::shared_ptr<task_wrapper> tt_ptr =
+        std::allocate_shared<task_wrapper>(slab_allocator<task_wrapper>());
     tt_ptr->task_id = id;
     // get the thread id that is creating this task
     tt_ptr->thread_id = thread_instance::instance().get_id();
@@ -633,15 +722,17 @@ inline std::shared_ptr<task_wrapper> _new_task(
     // was a parent passed in?
     } else */ if (parent_task != nullptr) {
         tt_ptr->parent_guid = parent_task->guid;
-        tt_ptr->parent = parent_task;
+        tt_ptr->set_parent(parent_task);
     // if not, is there a current timer?
     } else {
         profiler * p = thread_instance::instance().get_current_profiler();
         if (p != nullptr) {
             tt_ptr->parent_guid = p->guid;
-            tt_ptr->parent = p->tt_ptr;
+            if (p->tt_ptr != nullptr) {
+                tt_ptr->set_parent(p->tt_ptr);
+            }
         } else {
-            tt_ptr->parent = task_wrapper::get_apex_main_wrapper();
+            tt_ptr->set_parent(task_wrapper::get_apex_main_wrapper());
         }
     }
     if (apex_options::use_tasktree_output() || apex_options::use_hatchet_output()) {
@@ -694,6 +785,21 @@ profiler* start(const std::string &timer_name)
     if (event_filter::instance().have_filter && event_filter::exclude(timer_name)) {
         return profiler::get_disabled_profiler();
     }
+    // protect against calls after finalization
+    if (!apex::instance() || _exited) {
+        APEX_UTIL_REF_COUNT_START_AFTER_FINALIZE
+        return nullptr;
+    }
+    return start(task_identifier::get_task_id(timer_name));
+}
+
+profiler* start(const apex_function_address function_address) {
+    in_apex prevent_deadlocks;
+    // if APEX is disabled, do nothing.
+    if (apex_options::disable() == true) {
+        APEX_UTIL_REF_COUNT_DISABLED_START
+        return nullptr;
+    }
     apex* instance = apex::instance(); // get the Apex static instance
     // protect against calls after finalization
     if (!instance || _exited) {
@@ -709,28 +815,23 @@ profiler* start(const std::string &timer_name)
     profiler * new_profiler = nullptr;
     if (_notify_listeners) {
         bool success = true;
-        task_identifier * id = task_identifier::get_task_id(timer_name);
+        task_identifier * id = task_identifier::get_task_id(function_address);
         tt_ptr = _new_task(id, UINTMAX_MAX, null_task_wrapper, instance);
 #if defined(APEX_DEBUG)//_disabled)
         if (apex_options::use_verbose()) { debug_print("Start", tt_ptr); }
 #endif
         APEX_UTIL_REF_COUNT_TASK_WRAPPER
-        //read_lock_type l(instance->listener_mutex);
         /*
         std::stringstream dbg;
         dbg << thread_instance::get_id() << " Start : " << id->get_name() << endl;
             printf("%s\n",dbg.str().c_str());
         fflush(stdout);
         */
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            success = instance->listeners[i]->on_start(tt_ptr);
-            tt_ptr->prof = thread_instance::instance().get_current_profiler();
-            if (!success && i == 0) {
-                //cout << thread_instance::get_id() << " *** Not success! " <<
-                //id->get_name() << endl; fflush(stdout);
-                APEX_UTIL_REF_COUNT_FAILED_START
-                return profiler::get_disabled_profiler();
-            }
+        //read_lock_type l(instance->listener_mutex);
+        success = notify_start(instance, tt_ptr);
+        if (!success) {
+            APEX_UTIL_REF_COUNT_FAILED_START
+            return profiler::get_disabled_profiler();
         }
         // If we are allowing untied timers, clear the timer stack on this thread
         if (apex_options::untied_timers() == true) {
@@ -738,21 +839,17 @@ profiler* start(const std::string &timer_name)
             thread_instance::instance().clear_current_profiler();
         }
     }
-#if defined(APEX_DEBUG)
-    const std::string apex_process_profile_str("apex::process_profiles");
-    if (timer_name.compare(apex_process_profile_str) == 0) {
-        APEX_UTIL_REF_COUNT_APEX_INTERNAL_START
-    } else {
-        APEX_UTIL_REF_COUNT_START
-    }
-#endif
+    APEX_UTIL_REF_COUNT_START
     if (apex_options::untied_timers() == true) {
         return new_profiler;
     }
     return thread_instance::instance().restore_children_profilers(tt_ptr);
 }
 
-profiler* start(const apex_function_address function_address) {
+/* Start a timer from an already interned task identifier.  The caller is
+ * responsible for the "apex_internal" and event filter checks, which only
+ * depend on the name, so they can be done once when the id is looked up. */
+profiler* start(task_identifier * id) {
     in_apex prevent_deadlocks;
     // if APEX is disabled, do nothing.
     if (apex_options::disable() == true) {
@@ -774,28 +871,15 @@ profiler* start(const apex_function_address function_address) {
     profiler * new_profiler = nullptr;
     if (_notify_listeners) {
         bool success = true;
-        task_identifier * id = task_identifier::get_task_id(function_address);
         tt_ptr = _new_task(id, UINTMAX_MAX, null_task_wrapper, instance);
 #if defined(APEX_DEBUG)//_disabled)
         if (apex_options::use_verbose()) { debug_print("Start", tt_ptr); }
 #endif
         APEX_UTIL_REF_COUNT_TASK_WRAPPER
-        /*
-        std::stringstream dbg;
-        dbg << thread_instance::get_id() << " Start : " << id->get_name() << endl;
-            printf("%s\n",dbg.str().c_str());
-        fflush(stdout);
-        */
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            success = instance->listeners[i]->on_start(tt_ptr);
-            tt_ptr->prof = thread_instance::instance().get_current_profiler();
-            if (!success && i == 0) {
-                //cout << thread_instance::get_id() << " *** Not success! " <<
-                //id->get_name() << endl; fflush(stdout);
-                APEX_UTIL_REF_COUNT_FAILED_START
-                return profiler::get_disabled_profiler();
-            }
+        success = notify_start(instance, tt_ptr);
+        if (!success) {
+            APEX_UTIL_REF_COUNT_FAILED_START
+            return profiler::get_disabled_profiler();
         }
         // If we are allowing untied timers, clear the timer stack on this thread
         if (apex_options::untied_timers() == true) {
@@ -803,7 +887,16 @@ profiler* start(const apex_function_address function_address) {
             thread_instance::instance().clear_current_profiler();
         }
     }
+#if defined(APEX_DEBUG)
+    const std::string apex_process_profile_str("apex::process_profiles");
+    if (id->get_name(false).compare(apex_process_profile_str) == 0) {
+        APEX_UTIL_REF_COUNT_APEX_INTERNAL_START
+    } else {
+        APEX_UTIL_REF_COUNT_START
+    }
+#else
     APEX_UTIL_REF_COUNT_START
+#endif
     if (apex_options::untied_timers() == true) {
         return new_profiler;
     }
@@ -854,16 +947,11 @@ void start(std::shared_ptr<task_wrapper> tt_ptr) {
         fflush(stdout);
         */
         //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            success = instance->listeners[i]->on_start(tt_ptr);
-            tt_ptr->prof = thread_instance::instance().get_current_profiler();
-            if (!success && i == 0) {
-                //cout << thread_instance::get_id() << " *** Not success! " <<
-                //id->get_name() << endl; fflush(stdout);
-                APEX_UTIL_REF_COUNT_FAILED_START
-                tt_ptr->prof = profiler::get_disabled_profiler();
-                return;
-            }
+        success = notify_start(instance, tt_ptr);
+        if (!success) {
+            APEX_UTIL_REF_COUNT_FAILED_START
+            tt_ptr->prof = profiler::get_disabled_profiler();
+            return;
         }
         // If we are allowing untied timers, clear the timer stack on this thread
         if (apex_options::untied_timers() == true) {
@@ -909,9 +997,9 @@ profiler* resume(const std::string &timer_name) {
         APEX_UTIL_REF_COUNT_TASK_WRAPPER
         try {
             //read_lock_type l(instance->listener_mutex);
-            for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-                instance->listeners[i]->on_resume(tt_ptr);
-            }
+            notify_listeners(instance, DISPATCH_RESUME, [&](auto listener) {
+                listener->on_resume(tt_ptr);
+            });
         } catch (disabled_profiler_exception &e) {
             APEX_UTIL_REF_COUNT_FAILED_RESUME
             return profiler::get_disabled_profiler();
@@ -953,9 +1041,9 @@ profiler* resume(const apex_function_address function_address) {
         APEX_UTIL_REF_COUNT_TASK_WRAPPER
         try {
             //read_lock_type l(instance->listener_mutex);
-            for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-                instance->listeners[i]->on_resume(tt_ptr);
-            }
+            notify_listeners(instance, DISPATCH_RESUME, [&](auto listener) {
+                listener->on_resume(tt_ptr);
+            });
         } catch (disabled_profiler_exception &e) {
             APEX_UTIL_REF_COUNT_FAILED_RESUME
             return profiler::get_disabled_profiler();
@@ -992,9 +1080,11 @@ profiler* resume(profiler * p) {
         try {
             // skip the profiler_listener - we are restoring a child timer
             // for a parent that was yielded.
-            for (unsigned int i = 1 ; i < instance->listeners.size() ; i++) {
-                instance->listeners[i]->on_resume(p->tt_ptr);
-            }
+            notify_listeners(instance, DISPATCH_RESUME, [&](auto listener) {
+                if (listener != instance->the_profiler_listener) {
+                    listener->on_resume(p->tt_ptr);
+                }
+            });
         } catch (disabled_profiler_exception &e) {
             APEX_UTIL_REF_COUNT_FAILED_RESUME
             return profiler::get_disabled_profiler();
@@ -1027,6 +1117,20 @@ void reset(const std::string &timer_name) {
     }
 }
 
+void trigger_trace_capture(const std::string &reason) {
+    in_apex prevent_deadlocks;
+    // if APEX is disabled, do nothing.
+    if (apex_options::disable() == true) { return; }
+    apex* instance = apex::instance(); // get the Apex static instance
+    if (!instance || _exited) return; // protect against calls after finalization
+    if (apex_options::use_trace_event() &&
+        instance->the_trace_event_listener != nullptr) {
+        trace_event_listener * tel =
+            (trace_event_listener*)instance->the_trace_event_listener;
+        tel->capture(reason);
+    }
+}
+
 void reset(apex_function_address function_address) {
     in_apex prevent_deadlocks;
     // if APEX is disabled, do nothing.
@@ -1056,9 +1160,9 @@ void set_state(apex_thread_state state) {
 void apex::complete_task(std::shared_ptr<task_wrapper> task_wrapper_ptr) {
     apex* instance = apex::instance(); // get the Apex static instance
     if (_notify_listeners) {
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_task_complete(task_wrapper_ptr);
-        }
+        notify_listeners(instance, DISPATCH_TASK_COMPLETE, [&](auto listener) {
+            listener->on_task_complete(task_wrapper_ptr);
+        });
     }
 }
 
@@ -1093,9 +1197,9 @@ void apex::stop_internal(profiler* the_profiler) {
     std::shared_ptr<profiler> p{the_profiler};
     if (_notify_listeners) {
         //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_stop(p);
-        }
+        notify_listeners(instance, DISPATCH_STOP, [&](auto listener) {
+            listener->on_stop(p);
+        });
     }
 #if defined(APEX_DEBUG)
     const std::string apex_process_profile_str("apex::process_profiles");
@@ -1148,9 +1252,9 @@ void stop(profiler* the_profiler, bool cleanup) {
     std::shared_ptr<profiler> p{the_profiler};
     if (_notify_listeners) {
         //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_stop(p);
-        }
+        notify_listeners(instance, DISPATCH_STOP, [&](auto listener) {
+            listener->on_stop(p);
+        });
     }
     /*
     std::stringstream dbg;
@@ -1214,9 +1318,9 @@ void stop(std::shared_ptr<task_wrapper> tt_ptr) {
     std::shared_ptr<profiler> p{tt_ptr->prof};
     if (_notify_listeners) {
         //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_stop(p);
-        }
+        notify_listeners(instance, DISPATCH_STOP, [&](auto listener) {
+            listener->on_stop(p);
+        });
     }
     /*
     std::stringstream dbg;
@@ -1268,9 +1372,9 @@ void yield(profiler* the_profiler)
     std::shared_ptr<profiler> p{the_profiler};
     if (_notify_listeners) {
         //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_yield(p);
-        }
+        notify_listeners(instance, DISPATCH_YIELD, [&](auto listener) {
+            listener->on_yield(p);
+        });
     }
     //cout << thread_instance::get_id() << " Yield : " <<
     //the_profiler->tt_ptr->get_task_id()->get_name() << endl; fflush(stdout);
@@ -1319,9 +1423,9 @@ void yield(std::shared_ptr<task_wrapper> tt_ptr)
     std::shared_ptr<profiler> p{tt_ptr->prof};
     if (_notify_listeners) {
         //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_yield(p);
-        }
+        notify_listeners(instance, DISPATCH_YIELD, [&](auto listener) {
+            listener->on_yield(p);
+        });
     }
     //cout << thread_instance::get_id() << " Yield : " <<
     //tt_ptr->prof->tt_ptr->get_task_id()->get_name() << endl; fflush(stdout);
@@ -1378,9 +1482,9 @@ void sample_value(const std::string &name, double value, bool threaded)
     sample_value_event_data data(tid, name, value, threaded);
     if (_notify_listeners) {
         //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_sample_value(data);
-        }
+        notify_listeners(instance, DISPATCH_SAMPLE_VALUE, [&](auto listener) {
+            listener->on_sample_value(data);
+        });
     }
 }
 
@@ -1443,6 +1547,31 @@ std::shared_ptr<task_wrapper> new_task(
     return tt_ptr;
 }
 
+/* For callers that have already interned the name */
+std::shared_ptr<task_wrapper> new_task(
+    task_identifier * id,
+    const uint64_t task_id,
+    const std::shared_ptr<task_wrapper> parent_task) {
+    in_apex prevent_deadlocks;
+    // if APEX is disabled, do nothing.
+    if (apex_options::disable() == true) {
+        APEX_UTIL_REF_COUNT_NULL_TASK_WRAPPER
+        return nullptr; }
+    // if APEX is suspended, do nothing.
+    if (apex_options::suspend() == true) {
+        APEX_UTIL_REF_COUNT_NULL_TASK_WRAPPER
+        return nullptr; }
+    // get the Apex static instance
+    apex* instance = apex::instance();
+    // protect against calls after finalization
+    if (!instance || _exited) {
+        APEX_UTIL_REF_COUNT_NULL_TASK_WRAPPER
+        return nullptr; }
+    std::shared_ptr<task_wrapper>
+        tt_ptr(_new_task(id, task_id, parent_task, instance));
+    return tt_ptr;
+}
+
 std::shared_ptr<task_wrapper> update_task(
     std::shared_ptr<task_wrapper> wrapper,
     const std::string &timer_name) {
@@ -1720,6 +1849,9 @@ void finalize(void)
     if (apex_options::disable() == true) { return; }
     FUNCTION_ENTER
     instance->finalizing = true; // don't measure any new pthreads from pthread_create!
+    // the other ranks are waiting for this one to finish tuning with them
+    cooperative_tuning::finalize();
+    global_view::finalize();
     // FIRST FIRST, check if we have orphaned threads...
     // See apex::register_thread and apex::exit_thread for more info.
     /* this causes problems with APPLE, but that's ok because it's mostly
@@ -2052,6 +2184,34 @@ apex_policy_handle* register_periodic_policy(unsigned long period_microseconds,
     return handle;
 }
 
+apex_policy_handle* register_batch_policy(const apex_event_type when,
+                    unsigned long period_microseconds,
+                    std::function<int(apex_context const&)> f)
+{
+    in_apex prevent_deadlocks;
+    // if APEX is disabled, do nothing.
+    if (apex_options::disable() == true) { return nullptr; }
+    // don't start a handler thread for a policy that can't be registered
+    if (!policy_handler::batchable(when)) { return nullptr; }
+    if (period_microseconds == 0) {
+        period_microseconds = apex_options::policy_batch_period();
+    }
+    int id = -1;
+    /* Batches are delivered by the handler thread for this period. */
+    policy_handler * handler =
+        apex::instance()->get_policy_handler(period_microseconds);
+    if(handler != nullptr)
+    {
+        id = handler->register_batch_policy(when, f);
+    }
+    apex_policy_handle * handle = new apex_policy_handle();
+    handle->id = id;
+    handle->event_type = when;
+    handle->period = period_microseconds;
+    apex::instance()->push_policy_handle(handle);
+    return handle;
+}
+
 #ifdef APEX_HAVE_HPX
 int apex::setup_runtime_counter(const std::string & counter_name) {
     bool messaged = false;
@@ -2151,7 +2311,8 @@ void deregister_policy(apex_policy_handle * handle) {
     // if this policy has been deregistered already, return.
     if (!(apex::instance()->policy_handle_exists(handle))) { return; }
     policy_handler * handler = nullptr;
-    if (handle->event_type == APEX_PERIODIC) {
+    /* periodic and batch policies live on the handler for their period */
+    if (handle->event_type == APEX_PERIODIC || handle->period > 0) {
         handler = apex::instance()->get_policy_handler(handle->period);
     } else {
         handler = apex::instance()->get_policy_handler();
@@ -2213,6 +2374,26 @@ apex_profile* get_profile(const task_identifier &task_id) {
     return nullptr;
 }
 
+bool get_profile_snapshot(const task_identifier &task_id,
+    apex_profile &snapshot) {
+    in_apex prevent_deadlocks;
+    // if APEX is disabled, do nothing.
+    if (apex_options::disable() == true) { return false; }
+    profile * tmp = apex::__instance()->the_profiler_listener->get_profile(task_id);
+    if (tmp == nullptr) { return false; }
+    tmp->get_snapshot(snapshot);
+    return true;
+}
+
+uint64_t get_changed_profiles(uint64_t since_epoch,
+    std::vector<std::pair<task_identifier, apex_profile> > &changed) {
+    in_apex prevent_deadlocks;
+    // if APEX is disabled, do nothing.
+    if (apex_options::disable() == true) { return since_epoch; }
+    return apex::__instance()->the_profiler_listener->get_changed_profiles(
+        since_epoch, changed);
+}
+
 double current_power_high(void) {
     double power = 0.0;
 #ifdef APEX_HAVE_RCR
@@ -2249,7 +2430,7 @@ double current_power_high(void) {
     return power;
 }
 
-std::vector<task_identifier>& get_available_profiles() {
+std::vector<task_identifier> get_available_profiles() {
     return apex::__instance()->the_profiler_listener->get_available_profiles();
 }
 
@@ -2411,6 +2592,11 @@ extern "C" {
         }
     }
 
+    void apex_trigger_trace_capture(const char * reason) {
+        string tmp(reason == nullptr ? "" : reason);
+        trigger_trace_capture(tmp);
+    }
+
     void apex_set_state(apex_thread_state state) {
         set_state(state);
     }
@@ -2476,6 +2662,11 @@ extern "C" {
         return register_periodic_policy(period, f);
     }
 
+    apex_policy_handle* apex_register_batch_policy(const apex_event_type when,
+        unsigned long period, int (f)(apex_context const)) {
+        return register_batch_policy(when, period, f);
+    }
+
     void apex_deregister_policy(apex_policy_handle * handle) {
         return deregister_policy(handle);
     }
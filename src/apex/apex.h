@@ -241,6 +241,20 @@ APEX_EXPORT apex_profiler_handle apex_resume_guid(apex_profiler_type type,
  */
 APEX_EXPORT void apex_reset(apex_profiler_type type, const void * identifier);
 
+/**
+ \brief Write the recent trace events.
+
+ With APEX_TRACE_EVENT_FLIGHT_RECORDER=1, the trace events are kept in
+ per-thread circular buffers, and only written when a trigger fires.  This
+ function fires the trigger: the events from the last
+ APEX_TRACE_EVENT_FLIGHT_RECORDER_SECONDS seconds are written to the
+ trace before it returns.
+
+ \param reason The reason for the capture, written with the events.
+ \return No return value.
+ */
+APEX_EXPORT void apex_trigger_trace_capture(const char * reason);
+
 /**
  \brief Set the thread state
 
@@ -385,6 +399,26 @@ APEX_EXPORT apex_policy_handle * apex_register_policy(
 APEX_EXPORT apex_policy_handle * apex_register_periodic_policy(
     unsigned long period, apex_policy_function f);
 
+/**
+ \brief Register a batch policy with APEX.
+
+ Apex provides the ability to buffer events and deliver them to an
+ application-specified function in batches.  The function is called
+ periodically with an apex_event_batch in the data member of the context.
+ Only start, stop, yield, resume and sample value events can be batched.
+
+ \param when The APEX event type to buffer
+ \param period How frequently the batch should be delivered (in
+        microseconds).  If zero, APEX_POLICY_BATCH_PERIOD is used.
+ \param f The function to be called with each batch of events.
+ \return A handle to the policy, to be stored if the policy is to be
+         un-registered later, or NULL if the event type can't be batched.
+ \sa @ref apex_deregister_policy, @ref apex_register_policy
+ */
+APEX_EXPORT apex_policy_handle * apex_register_batch_policy(
+    const apex_event_type when, unsigned long period,
+    apex_policy_function f);
+
 /**
  \brief Deregister a policy with APEX.
 
@@ -34,6 +34,8 @@
 #include <atomic>
 #include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include "apex_types.h"
 #include "apex_config.h"
 #include "handler.hpp"
@@ -70,6 +72,15 @@ namespace apex
 ///////////////////////////////////////////////////////////////////////
 // Main class for the APEX project
 
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+/* The listeners that handle one of the frequent events.  When the
+ * profiler_listener is the only one, it is called directly. */
+struct dispatch_list {
+    std::vector<event_listener*> listeners;
+    bool profiler_only;
+};
+#endif
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 /*
  The APEX class is only instantiated once per process (i.e. it is a
@@ -90,6 +101,9 @@ private:
         m_my_locality(std::string("0")),
         finalizing(false)
     {
+        for (int e = 0 ; e < DISPATCH_EVENTS ; e++) {
+            dispatch_table[e] = nullptr;
+        }
         _initialize();
     };
     apex(apex const&);            // copy constructor is private
@@ -117,6 +131,19 @@ public:
 #endif
     std::string version_string;
     std::vector<event_listener*> listeners;
+    /* For each frequent event, the listeners that handle it, in the same
+     * order as the listeners vector.  The table is rebuilt when listeners
+     * are added or policies change, and published atomically.  A thread
+     * can still be using an old list, so lists are never freed before
+     * exit; instead, a rebuild reuses the list with the same listeners if
+     * there is one, so policy changes only ever create a list for each
+     * distinct set of listeners. */
+    std::atomic<const dispatch_list*> dispatch_table[DISPATCH_EVENTS];
+    std::vector<std::unique_ptr<const dispatch_list> > dispatch_lists;
+    /* also guards adding to the listeners and the period_handlers */
+    std::mutex dispatch_mutex;
+    void build_dispatch_table(void);
+    void build_dispatch_table_locked(void);
     std::vector<int (*)()> finalize_functions;
     std::string m_my_locality;
     std::unordered_map<int, std::string> custom_event_names;
@@ -182,6 +209,9 @@ public:
 void init_plugins(void);
 void finalize_plugins(void);
 profiler * resume(profiler * p);
+profiler * start(task_identifier * id);
+std::shared_ptr<task_wrapper> new_task(task_identifier * id,
+    const uint64_t task_id, const std::shared_ptr<task_wrapper> parent_task);
 
 #ifdef APEX_HAVE_HPX
 hpx::runtime * get_hpx_runtime_ptr(void);
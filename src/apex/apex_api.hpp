@@ -309,6 +309,21 @@ APEX_EXPORT void reset(const std::string &timer_name);
  */
 APEX_EXPORT void reset(apex_function_address function_address);
 
+/**
+ \brief Write the recent trace events.
+
+ With APEX_TRACE_EVENT_FLIGHT_RECORDER=1, the trace events are kept in
+ per-thread circular buffers, and only written when a trigger fires.  This
+ function fires the trigger: the events from the last
+ APEX_TRACE_EVENT_FLIGHT_RECORDER_SECONDS seconds are written to the
+ trace before it returns.  A policy can also fire the trigger by returning
+ APEX_TRACE_CAPTURE.
+
+ \param reason The reason for the capture, written with the events.
+ \return No return value.
+ */
+APEX_EXPORT void trigger_trace_capture(const std::string &reason);
+
 /**
  \brief Set the thread state
 
@@ -514,6 +529,29 @@ APEX_EXPORT std::set<apex_policy_handle*> register_policy(
 APEX_EXPORT apex_policy_handle* register_periodic_policy(
     unsigned long period, std::function<int(apex_context const&)> f);
 
+/**
+ \brief Register a batch policy with APEX.
+
+ Apex provides the ability to buffer events and deliver them to an
+ application-specified function in batches, rather than calling the function
+ synchronously for every event.  Events are buffered per thread, and
+ delivered periodically (and once more before shutdown) as an
+ apex_event_batch in the data member of the context.  The records in the
+ batch are ordered by timestamp.  Only start, stop, yield, resume and
+ sample value events can be batched.
+
+ \param when The APEX event type to buffer
+ \param period How frequently the batch should be delivered (in
+        microseconds).  If zero, APEX_POLICY_BATCH_PERIOD is used.
+ \param f The function to be called with each batch of events.
+ \return A handle to the policy, to be stored if the policy is to be un-registered later,
+         or nullptr if the event type can't be batched.
+ \sa @ref apex::deregister_policy, @ref apex::register_policy
+ */
+APEX_EXPORT apex_policy_handle* register_batch_policy(
+    const apex_event_type when, unsigned long period,
+    std::function<int(apex_context const&)> f);
+
 /**
  \brief Periodically sample a runtime counter.
 
@@ -590,6 +628,39 @@ APEX_EXPORT apex_profile* get_profile(const std::string &timer_name);
  */
 APEX_EXPORT apex_profile* get_profile(const task_identifier &task_id);
 
+/**
+ \brief Get a consistent copy of the current profile for the specified
+ task_identifier.
+
+ Unlike @ref apex::get_profile, the copy can't be torn by a concurrent update
+ of the profile (i.e. the calls and accumulated values always match).
+
+ \param task_id The task_identifier of the timer/counter
+ \param snapshot The profile values are copied here.
+ \return true if the profile exists, false otherwise.
+ \sa @ref apex::get_profile, @ref apex::get_changed_profiles
+ */
+APEX_EXPORT bool get_profile_snapshot(const task_identifier &task_id,
+    apex_profile &snapshot);
+
+/**
+ \brief Get the profiles that changed since an epoch.
+
+ This function will append a consistent copy of each profile that was
+ updated since the specified epoch to the changed vector, and return the
+ epoch to use for the next call.  Pass 0 to get all profiles.  Periodic
+ policies can use this to process only the timers and counters that were
+ updated, instead of reading every profile.  A profile that is updated
+ during the call may be returned by the next call as well.
+
+ \param since_epoch The epoch returned by the previous call, or 0.
+ \param changed The task_identifiers and profiles are appended here.
+ \return The epoch to pass to the next call.
+ \sa @ref apex::get_profile_snapshot
+ */
+APEX_EXPORT uint64_t get_changed_profiles(uint64_t since_epoch,
+    std::vector<std::pair<task_identifier, apex_profile> > &changed);
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
 /**
@@ -600,9 +671,9 @@ APEX_EXPORT apex_profile* get_profile(const task_identifier &task_id);
  Because profiles are updated out-of-band, it is possible that this profile
  value is out of date.  This profile can be either a timer or a sampled value.
 
- \return A vector of task_identifier objects
+ \return A copy of the vector of task_identifier objects
  */
-APEX_EXPORT std::vector<task_identifier>& get_available_profiles();
+APEX_EXPORT std::vector<task_identifier> get_available_profiles();
 
 /**
  \brief Get the current power reading
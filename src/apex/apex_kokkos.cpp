@@ -147,6 +147,7 @@ void kokkosp_init_library(int loadseq, uint64_t version,
  * profiling hooks.
  */
 void kokkosp_finalize_library() {
+    saveTuningCache();
 #ifndef APEX_HAVE_HPX
     apex::finalize();
 #endif
@@ -20,3 +20,6 @@ typedef struct KokkosPDeviceInfo {
 typedef struct SpaceHandle {
   char name[64];
 } SpaceHandle_t;
+
+/* Save the converged Kokkos autotuning results (apex_kokkos_tuning.cpp) */
+void saveTuningCache(void);
@@ -25,11 +25,17 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
 #include <stdlib.h>
 #include "apex.hpp"
 #include "Kokkos_Profiling_C_Interface.h"
 #include "apex_api.hpp"
 #include "apex_policies.hpp"
+#include "tuning_cache.hpp"
 
 std::string pVT(Kokkos_Tools_VariableInfo_ValueType t) {
     if (t == kokkos_value_double) {
@@ -121,7 +127,8 @@ public:
         total(value),
         min(value),
         max(value),
-        count(1) {
+        count(1),
+        index(idx) {
         std::stringstream ss;
         ss << "bin_" << idx;
         name = ss.str();
@@ -131,6 +138,7 @@ public:
     double min;
     double max;
     size_t count;
+    size_t index;
     std::string name;
     bool contains(double value) {
         if (value <= max && value >= min) {
@@ -193,20 +201,166 @@ public:
     uint64_t numValues;
     void makeSpace(void);
     std::vector<Bin*> bins;
-    std::string getBin(double value) {
+    /* the same bins, ordered by their minimum value */
+    std::vector<Bin*> sorted_bins;
+    /* Find (or make) the bin for this value, and add it to the bin.  The
+     * bins are searched in order of their minimum values, and only new
+     * values that aren't near a neighboring bin need the full scan. */
+    size_t getBinIndex(double value) {
+        auto it = std::upper_bound(sorted_bins.begin(), sorted_bins.end(),
+            value, [](double v, const Bin* b) { return v < b->min; });
+        // the bin that starts below the value, then the one above it.
+        // Adding the value can only lower the second one's minimum to a
+        // value above the first one's, so the order is kept.
+        if (it != sorted_bins.begin() && (*(it-1))->contains(value)) {
+            (*(it-1))->add(value);
+            return (*(it-1))->index;
+        }
+        if (it != sorted_bins.end() && (*it)->contains(value)) {
+            (*it)->add(value);
+            return (*it)->index;
+        }
         for (auto b : bins) {
             if (b->contains(value)) {
                 b->add(value);
-                return b->getName();
+                // this bin's minimum may have moved past its neighbors
+                sorted_bins.erase(std::find(sorted_bins.begin(),
+                    sorted_bins.end(), b));
+                sorted_bins.insert(std::upper_bound(sorted_bins.begin(),
+                    sorted_bins.end(), b->min,
+                    [](double v, const Bin* c) { return v < c->min; }), b);
+                return b->index;
             }
         }
         Bin * b = new Bin(value, bins.size());
-        std::string tmp{b->getName()};
         bins.push_back(b);
-        return tmp;
+        sorted_bins.insert(it, b);
+        return b->index;
+    }
+    std::string getBin(double value) {
+        return bins[getBinIndex(value)]->getName();
     }
 };
 
+/* FNV-1a over the bytes of the key */
+uint64_t hashContextKey(const std::vector<uint64_t>& key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (uint64_t v : key) {
+        for (int i = 0 ; i < 8 ; i++) {
+            h ^= (v >> (i * 8)) & 0xff;
+            h *= 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+struct ContextKeyHash {
+    size_t operator()(const std::vector<uint64_t>& key) const {
+        return (size_t)hashContextKey(key);
+    }
+};
+
+/* Converged contexts, keyed by the 64-bit hash of their input variables
+ * and tree node.  This is a flat, open-addressed (linear probing) table,
+ * and the full keys and the tuning values for each context are kept in
+ * one array each, so a lookup doesn't allocate or follow pointers.  A
+ * hash match is only a hit if the full key matches too. */
+class ConvergedContexts {
+private:
+    struct Entry {
+        uint64_t hash; // 0 is empty
+        uint32_t key_offset;
+        uint32_t key_length;
+        uint32_t offset;
+        uint32_t count;
+    };
+    std::vector<Entry> table;
+    std::vector<uint64_t> keys;
+    std::vector<Kokkos_Tools_VariableValue> values;
+    size_t used;
+    bool matches(const Entry& e, uint64_t hash,
+        const std::vector<uint64_t>& key) const {
+        return e.hash == hash && e.key_length == key.size() &&
+            std::equal(key.begin(), key.end(), keys.begin() + e.key_offset);
+    }
+    void grow(void) {
+        std::vector<Entry> old(table.size() * 2, Entry{0,0,0,0,0});
+        old.swap(table);
+        // the keys are all different, so each goes in the first empty slot
+        size_t mask = table.size() - 1;
+        for (const auto& e : old) {
+            if (e.hash == 0) { continue; }
+            size_t i = e.hash & mask;
+            while (table[i].hash != 0) {
+                i = (i + 1) & mask;
+            }
+            table[i] = e;
+        }
+    }
+public:
+    ConvergedContexts() : table(64, Entry{0,0,0,0,0}), used(0) {}
+    static uint64_t validHash(uint64_t hash) { return hash == 0 ? 1 : hash; }
+    /* Copy the converged values for this context, if there are any */
+    bool find(uint64_t hash, const std::vector<uint64_t>& key,
+        const size_t vars, Kokkos_Tools_VariableValue* out) const {
+        hash = validHash(hash);
+        size_t mask = table.size() - 1;
+        for (size_t i = hash & mask ; table[i].hash != 0 ;
+             i = (i + 1) & mask) {
+            if (!matches(table[i], hash, key)) { continue; }
+            const Entry& e = table[i];
+            if (e.count != vars) { return false; }
+            for (size_t v = 0 ; v < vars ; v++) {
+                if (values[e.offset + v].type_id != out[v].type_id) {
+                    return false;
+                }
+            }
+            for (size_t v = 0 ; v < vars ; v++) {
+                out[v].value = values[e.offset + v].value;
+            }
+            return true;
+        }
+        return false;
+    }
+    void insert(uint64_t hash, const std::vector<uint64_t>& key,
+        const size_t vars, const Kokkos_Tools_VariableValue* in) {
+        if ((used + 1) * 2 > table.size()) { grow(); }
+        hash = validHash(hash);
+        size_t mask = table.size() - 1;
+        size_t i = hash & mask;
+        while (table[i].hash != 0 && !matches(table[i], hash, key)) {
+            i = (i + 1) & mask;
+        }
+        if (table[i].hash == 0) {
+            used++;
+            table[i] = Entry{hash, (uint32_t)keys.size(),
+                (uint32_t)key.size(), 0, 0};
+            keys.insert(keys.end(), key.begin(), key.end());
+        }
+        table[i].offset = (uint32_t)values.size();
+        table[i].count = (uint32_t)vars;
+        values.insert(values.end(), in, in + vars);
+    }
+};
+
+/* The type of a variable's values, as the tuning cache stores it */
+apex::tuning_cache::setting_type cacheType(
+    const Kokkos_Tools_VariableInfo& info) {
+    if (info.type == kokkos_value_double) {
+        return apex::tuning_cache::setting_type::double_value;
+    } else if (info.type == kokkos_value_int64) {
+        return apex::tuning_cache::setting_type::int_value;
+    }
+    return apex::tuning_cache::setting_type::string_value;
+}
+
+/* Kokkos numbers the variables in the order they are declared, which
+ * can change from build to build, so the cache uses their names and
+ * types instead. */
+uint64_t cacheId(const Variable* var) {
+    return apex::tuning_cache::variable_id(var->name, cacheType(var->info));
+}
+
 class KokkosSession {
 private:
 // EXHAUSTIVE, RANDOM, NELDER_MEAD, PARALLEL_RANK_ORDER
@@ -216,8 +370,8 @@ private:
         use_history(false),
         running(false){
             verbose = apex::apex_options::use_kokkos_verbose();
-            // don't do this until the object is constructed!
-            saveCache = (apex::apex::instance()->get_node_id() == 0) ? true : false;
+            /* when the ranks can't gather their results, only rank 0 saves */
+            saveCache = (apex::apex::instance()->get_node_id() == 0);
             if (strncmp(apex::apex_options::kokkos_tuning_policy(),
                     "random", strlen("random")) == 0) {
                 strategy = apex_ah_tuning_strategy::APEX_RANDOM;
@@ -227,6 +381,15 @@ private:
             } else if (strncmp(apex::apex_options::kokkos_tuning_policy(),
                     "simulated_annealing", strlen("simulated_annealing")) == 0) {
                 strategy = apex_ah_tuning_strategy::SIMULATED_ANNEALING;
+            } else if (strncmp(apex::apex_options::kokkos_tuning_policy(),
+                    "parallel_rank_order", strlen("parallel_rank_order")) == 0) {
+                strategy = apex_ah_tuning_strategy::APEX_PARALLEL_RANK_ORDER;
+            } else if (strncmp(apex::apex_options::kokkos_tuning_policy(),
+                    "bayesian_optimization", strlen("bayesian_optimization")) == 0) {
+                strategy = apex_ah_tuning_strategy::APEX_BAYESIAN_OPTIMIZATION;
+            } else if (strncmp(apex::apex_options::kokkos_tuning_policy(),
+                    "nelder_mead", strlen("nelder_mead")) == 0) {
+                strategy = apex_ah_tuning_strategy::APEX_NELDER_MEAD;
             } else {
                 strategy = apex_ah_tuning_strategy::NELDER_MEAD;
             }
@@ -243,6 +406,7 @@ public:
     bool use_history;
     bool running;
     bool saveCache;
+    bool cacheWritten{false};
     apex_ah_tuning_strategy strategy;
     std::unordered_map<std::string, std::shared_ptr<apex_tuning_request>>
         requests;
@@ -254,9 +418,24 @@ public:
     std::unordered_map<size_t, std::string> active_requests;
     std::set<size_t> used_history;
     std::unordered_map<size_t, uint64_t> context_starts;
+    /* the name of each context we have seen, by its full key */
+    std::unordered_map<std::vector<uint64_t>, std::string, ContextKeyHash>
+        context_names;
+    /* and its input values, for finding similar contexts in the cache */
+    std::unordered_map<std::string, std::vector<apex::tuning_cache::feature>>
+        context_features;
+    /* the last time per call measured for each converged context.  The
+     * profiles are gone by the time the cache is written. */
+    std::unordered_map<std::string, double> converged_costs;
+    ConvergedContexts converged;
+    /* With drift detection, contexts that use a cached result are still
+     * measured.  Once their cost changes, they are tuned again, starting
+     * from the cached settings. */
+    std::unordered_map<std::string, apex::drift_detector> cached_drift;
+    std::set<std::string> drifted;
     void writeCache();
     bool checkForCache();
-    void readCache();
+    void readCache(const std::string& filename);
     void saveInputVar(size_t id, Variable * var);
     void saveOutputVar(size_t id, Variable * var);
     void parseVariableCache(std::ifstream& results);
@@ -265,7 +444,9 @@ public:
     std::string cacheFilename;
     std::map<size_t, struct Kokkos_Tools_VariableInfo> cachedVariables;
     std::map<size_t, std::string> cachedVariableNames;
-    std::map<std::string, std::map<size_t, struct Kokkos_Tools_VariableValue> > cachedTunings;
+    apex::tuning_cache::cache cache;
+    /* the cache came from an older text file, so it has to be saved */
+    bool textCache{false};
 };
 
 /* If we've cached values, we can bypass a lot. */
@@ -274,23 +455,30 @@ bool KokkosSession::checkForCache() {
     if (once) { return use_history; }
     once = true;
     // did the user specify a file?
-    if (strlen(apex::apex_options::kokkos_tuning_cache()) > 0) {
+    bool specified = strlen(apex::apex_options::kokkos_tuning_cache()) > 0;
+    if (specified) {
         cacheFilename = std::string(apex::apex_options::kokkos_tuning_cache());
     } else {
-        cacheFilename = std::string("./apex_converged_tuning.yaml");
+        cacheFilename = std::string("./apex_converged_tuning.cache");
     }
-    std::ifstream f(cacheFilename);
-    if (f.good()) {
-        use_history = true;
-        if(verbose) {
-            std::cout << "Cache found" << std::endl;
-        }
-        readCache();
+    if (cache.load(cacheFilename)) {
+        std::cout << "Read cache of Kokkos tuning results from: '"
+                  << cacheFilename << "'" << std::endl;
     } else {
-        if(verbose) {
-            std::cout << "Cache not found" << std::endl;
+        // maybe a text cache from an older version
+        std::string textFilename(specified ? cacheFilename :
+            std::string("./apex_converged_tuning.yaml"));
+        std::ifstream f(textFilename);
+        if (f.good()) {
+            readCache(textFilename);
+            textCache = true;
         }
     }
+    use_history = cache.size() > 0;
+    if(verbose) {
+        std::cout << (use_history ? "Cache found" : "Cache not found")
+                  << std::endl;
+    }
     return use_history;
 }
 
@@ -324,64 +512,69 @@ void KokkosSession::saveOutputVar(size_t id, Variable * var) {
 }
 
 void KokkosSession::writeCache(void) {
-    if(use_history) { return; }
-    if(!saveCache) { return; }
+    if(cacheWritten) { return; }
+    cacheWritten = true;
     // did the user specify a file?
     if (strlen(apex::apex_options::kokkos_tuning_cache()) > 0) {
         cacheFilename = std::string(apex::apex_options::kokkos_tuning_cache());
     } else {
-        cacheFilename = std::string("./apex_converged_tuning.yaml");
+        cacheFilename = std::string("./apex_converged_tuning.cache");
     }
-    std::ofstream results(cacheFilename);
-    std::cout << "Writing cache of Kokkos tuning results to: '" << cacheFilename << "'" << std::endl;
-    for (auto i : inputs) {
-        size_t id = i.first;
-        Variable* v = i.second;
-        results << "Input_" << id << ":" << std::endl;
-        results << v->toString();
-    }
-    for (auto o : outputs) {
-        size_t id = o.first;
-        Variable* v = o.second;
-        results << "Output_" << id << ":" << std::endl;
-        results << v->toString();
-    }
-    size_t count = 0;
+    apex::tuning_cache::cache results;
     for (const auto &req : requests) {
-        results << "Context_" << count++ << ":" << std::endl;
-        results << "  Name: \"" << req.first << "\"" << std::endl;
         std::shared_ptr<apex_tuning_request> request = req.second;
         // always write the random search out
         bool converged = request->has_converged() ||
             strategy == apex_ah_tuning_strategy::APEX_RANDOM;
-        results << "  Converged: " <<
-            (converged ? "true" : "false") << std::endl;
-        if (converged) {
-            results << "  Results:" << std::endl;
-            results << "    NumVars: " << var_ids[req.first].size() << std::endl;
-            for (const auto &id : var_ids[req.first]) {
-                results << "    id: " << id << std::endl;
-                Variable* var{KokkosSession::getSession().outputs[id]};
-                if (var->info.valueQuantity == kokkos_value_set) {
-                    auto param = std::static_pointer_cast<apex_param_enum>(
-                        request->get_param(var->name));
-                    results << "    value: " << param->get_value() << std::endl;
-                } else if (var->info.valueQuantity == kokkos_value_range) {
-                    if (var->info.type == kokkos_value_double) {
-                        auto param = std::static_pointer_cast<apex_param_double>(
-                            request->get_param(var->name));
-                        results << "    value: " << param->get_value() << std::endl;
-                    } else if (var->info.type == kokkos_value_int64) {
-                        auto param = std::static_pointer_cast<apex_param_long>(
-                            request->get_param(var->name));
-                        results << "    value: " << param->get_value() << std::endl;
-                    }
+        // if not converged, need to get the "best so far" values for the parameters.
+        if (!converged) { continue; }
+        apex::tuning_cache::entry e;
+        e.name = req.first;
+        e.features = context_features[req.first];
+        // the time per call, with the converged settings
+        auto cost = converged_costs.find(req.first);
+        e.cost = (cost == converged_costs.end()) ?
+            std::numeric_limits<double>::max() : cost->second;
+        e.runs = 1;
+        for (const auto &id : var_ids[req.first]) {
+            Variable* var{KokkosSession::getSession().outputs[id]};
+            apex::tuning_cache::setting value;
+            value.id = cacheId(var);
+            value.type = cacheType(var->info);
+            value.dvalue = 0.0;
+            value.lvalue = 0;
+            if (var->info.valueQuantity == kokkos_value_set) {
+                auto param = std::static_pointer_cast<apex_param_enum>(
+                    request->get_param(var->name));
+                value.svalue = param->get_value();
+                if (var->info.type == kokkos_value_double) {
+                    value.dvalue = std::stod(value.svalue);
+                } else if (var->info.type == kokkos_value_int64) {
+                    value.lvalue = std::stol(value.svalue);
                 }
+            } else if (var->info.type == kokkos_value_double) {
+                auto param = std::static_pointer_cast<apex_param_double>(
+                    request->get_param(var->name));
+                value.dvalue = param->get_value();
+            } else {
+                auto param = std::static_pointer_cast<apex_param_long>(
+                    request->get_param(var->name));
+                value.lvalue = param->get_value();
             }
+            e.settings.push_back(value);
         }
-        // if not converged, need to get the "best so far" values for the parameters.
+        results.add(e);
     }
-    results.close();
+    /* Rank 0 writes the file once, with the results from every rank.
+     * Every rank has to take part in the gather, even with no results. */
+    int rank{0};
+    if (!results.gather(rank) && !saveCache) { return; }
+    if (rank != 0) { return; }
+    if (textCache) { results.merge(cache); }
+    // only write when something new converged
+    if (results.size() == 0) { return; }
+    std::cout << "Writing cache of Kokkos tuning results to: '" << cacheFilename << "'" << std::endl;
+    results.save(cacheFilename);
 }
 
 void KokkosSession::parseVariableCache(std::ifstream& results) {
@@ -467,40 +660,48 @@ void KokkosSession::parseContextCache(std::ifstream& results) {
     std::getline(results, line);
     std::string converged = line.substr(line.find(delimiter)+2);
     if (converged.find("true") != std::string::npos) {
-        std::map<size_t, struct Kokkos_Tools_VariableValue> vars;
+        /* The text cache has no costs or input values, so these entries
+         * are only used for the same context */
+        apex::tuning_cache::entry e;
+        e.name = name;
+        e.cost = std::numeric_limits<double>::max();
+        e.runs = 1;
         // Results
         std::getline(results, line);
         // NumVars
         std::getline(results, line);
         size_t numvars = atol(line.substr(line.find(delimiter)+2).c_str());
         for (size_t i = 0 ; i < numvars ; i++) {
-            struct Kokkos_Tools_VariableValue var;
-            memset(&var, 0, sizeof(struct Kokkos_Tools_VariableValue));
+            apex::tuning_cache::setting var;
+            var.dvalue = 0.0;
+            var.lvalue = 0;
             // id
             std::getline(results, line);
             size_t id = atol(line.substr(line.find(delimiter)+2).c_str());
-            var.type_id = id;
             // value
             std::getline(results, line);
             std::string value = line.substr(line.find(delimiter)+2);
             auto info = cachedVariables.find(id);
+            if (info == cachedVariables.end()) { continue; }
+            // the text cache's ids were only good for that run
+            var.type = cacheType(info->second);
+            var.id = apex::tuning_cache::variable_id(
+                cachedVariableNames[id], var.type);
             if (info->second.type == kokkos_value_double) {
-                var.value.double_value = atof(value.c_str());
+                var.dvalue = atof(value.c_str());
             } else if (info->second.type == kokkos_value_int64) {
-                var.value.int_value = atol(value.c_str());
-            } else {
-                strcpy(var.value.string_value, value.c_str());
+                var.lvalue = atol(value.c_str());
             }
-            var.metadata = &(info->second);
-            vars.insert(std::make_pair(id, std::move(var)));
+            var.svalue = value;
+            e.settings.push_back(std::move(var));
         }
-        cachedTunings.insert(std::make_pair(name, std::move(vars)));
+        cache.add(e);
     }
 }
 
-void KokkosSession::readCache(void) {
-    std::ifstream results(cacheFilename);
-    std::cout << "Reading cache of Kokkos tuning results from: '" << cacheFilename << "'" << std::endl;
+void KokkosSession::readCache(const std::string& filename) {
+    std::ifstream results(filename);
+    std::cout << "Reading cache of Kokkos tuning results from: '" << filename << "'" << std::endl;
     std::string line;
     while (std::getline(results, line))
     {
@@ -762,6 +963,91 @@ std::string hashContext(size_t numVars,
     return tmp;
 }
 
+/* The key for a context: each input variable's id, and its bin index,
+ * value or characters, and the tree node.  The bin indexes are saved, in
+ * case the context name has to be built from them. */
+void contextKey(size_t numVars,
+    const Kokkos_Tools_VariableValue* values,
+    std::map<size_t, Variable*>& varmap, const void* tree_node,
+    std::vector<size_t>& bins, std::vector<uint64_t>& key) {
+    key.clear();
+    bins.resize(numVars);
+    for (size_t i = 0 ; i < numVars ; i++) {
+        auto id = values[i].type_id;
+        key.push_back(id);
+        Variable* var{varmap[id]};
+        uint64_t v = 0;
+        switch (var->info.type) {
+            case kokkos_value_double:
+                if (var->info.valueQuantity == kokkos_value_unbounded) {
+                    bins[i] = var->getBinIndex(values[i].value.double_value);
+                    v = bins[i];
+                } else {
+                    memcpy(&v, &(values[i].value.double_value), sizeof(v));
+                }
+                break;
+            case kokkos_value_int64:
+                if (var->info.valueQuantity == kokkos_value_unbounded) {
+                    bins[i] = var->getBinIndex(values[i].value.int_value);
+                    v = bins[i];
+                } else {
+                    v = (uint64_t)values[i].value.int_value;
+                }
+                break;
+            case kokkos_value_string:
+                // the characters, ended by the 0
+                for (const char * c = values[i].value.string_value ;
+                     *c != 0 ; c++) {
+                    key.push_back((uint64_t)*c);
+                }
+                break;
+            default:
+                break;
+        }
+        key.push_back(v);
+    }
+    key.push_back((uint64_t)tree_node);
+}
+
+/* The same name that hashContext would build, from the saved bins */
+std::string contextName(size_t numVars,
+    const Kokkos_Tools_VariableValue* values,
+    std::map<size_t, Variable*>& varmap, std::string tree_node,
+    const std::vector<size_t>& bins) {
+    std::stringstream ss;
+    std::string d{"["};
+    for (size_t i = 0 ; i < numVars ; i++) {
+        auto id = values[i].type_id;
+        ss << d << id << ":";
+        Variable* var{varmap[id]};
+        switch (var->info.type) {
+            case kokkos_value_double:
+                if (var->info.valueQuantity == kokkos_value_unbounded) {
+                    ss << var->bins[bins[i]]->getName();
+                } else {
+                    ss << values[i].value.double_value;
+                }
+                break;
+            case kokkos_value_int64:
+                if (var->info.valueQuantity == kokkos_value_unbounded) {
+                    ss << var->bins[bins[i]]->getName();
+                } else {
+                    ss << values[i].value.int_value;
+                }
+                break;
+            case kokkos_value_string:
+                ss << values[i].value.string_value;
+                break;
+            default:
+                break;
+        }
+        d = ",";
+    }
+    ss << ",tree_node:" << tree_node << "]";
+    std::string tmp{ss.str()};
+    return tmp;
+}
+
 void printContext(size_t numVars, std::string name) {
     std::cout << "-cv: " << numVars << name;
     std::cout << std::endl;
@@ -774,36 +1060,120 @@ void printTuning(const size_t numVars, Kokkos_Tools_VariableValue* values,
     std::cout << std::endl;
 }
 
-bool getCachedTunings(std::string name,
-    const size_t vars,
-    Kokkos_Tools_VariableValue* values) {
+/* The features of a context, for comparing it with the cached ones: the
+ * input values (not their bins), and the tree node */
+std::vector<apex::tuning_cache::feature> contextFeatures(size_t numVars,
+    const Kokkos_Tools_VariableValue* values,
+    std::map<size_t, Variable*>& varmap, const std::string& tree_node) {
+    std::vector<apex::tuning_cache::feature> features;
+    for (size_t i = 0 ; i < numVars ; i++) {
+        Variable* var{varmap[values[i].type_id]};
+        apex::tuning_cache::feature f{cacheId(var), true, 0.0, 0};
+        switch (var->info.type) {
+            case kokkos_value_double:
+                f.value = values[i].value.double_value;
+                break;
+            case kokkos_value_int64:
+                f.value = (double)(values[i].value.int_value);
+                break;
+            default:
+                f.numeric = false;
+                f.label = apex::tuning_cache::label(
+                    std::string(values[i].value.string_value));
+                break;
+        }
+        features.push_back(f);
+    }
+    std::sort(features.begin(), features.end(),
+        [](const apex::tuning_cache::feature& a,
+           const apex::tuning_cache::feature& b) { return a.id < b.id; });
+    features.push_back(apex::tuning_cache::feature{
+        std::numeric_limits<uint64_t>::max(), false, 0.0,
+        apex::tuning_cache::label(tree_node)});
+    return features;
+}
+
+/* Copy the cached settings for the tuning variables, if they are all
+ * there, with the same types */
+bool getCachedTunings(const apex::tuning_cache::entry& cached,
+    const std::string& name, const size_t vars,
+    Kokkos_Tools_VariableValue* values, bool sample) {
     KokkosSession& session = KokkosSession::getSession();
-    auto result = session.cachedTunings.find(name);
-    // don't have a tuning for this context?
-    if (result == session.cachedTunings.end()) { return false; }
+    std::vector<const apex::tuning_cache::setting*> found;
     for (size_t i = 0 ; i < vars ; i++) {
-        auto id = values[i].type_id;
-        auto variter = result->second.find(id);
-        auto nameiter = session.cachedVariableNames.find(id);
-        if (variter == result->second.end()) { return false; }
-        if (nameiter == session.cachedVariableNames.end()) { return false; }
-        auto var = variter->second;
-        auto varname = nameiter->second;
-        if (var.metadata->type == kokkos_value_double) {
-            values[i].value.double_value = var.value.double_value;
-            std::string tmp(name+":"+varname);
-            apex::sample_value(tmp, var.value.double_value);
-        } else if (var.metadata->type == kokkos_value_int64) {
-            values[i].value.int_value = var.value.int_value;
-            std::string tmp(name+":"+varname);
-            apex::sample_value(tmp, var.value.int_value);
-        } else if (var.metadata->type == kokkos_value_string) {
-            strncpy(values[i].value.string_value, var.value.string_value, KOKKOS_TOOLS_TUNING_STRING_LENGTH);
+        auto output = session.outputs.find(values[i].type_id);
+        if (output == session.outputs.end()) { return false; }
+        uint64_t id{cacheId(output->second)};
+        auto setting = std::find_if(cached.settings.begin(),
+            cached.settings.end(),
+            [=](const apex::tuning_cache::setting& s) { return s.id == id; });
+        if (setting == cached.settings.end() ||
+            setting->type != cacheType(output->second->info)) {
+            return false;
+        }
+        found.push_back(&(*setting));
+    }
+    for (size_t i = 0 ; i < vars ; i++) {
+        const apex::tuning_cache::setting& var = *(found[i]);
+        std::string tmp(name+":"+session.outputs[values[i].type_id]->name);
+        if (var.type == apex::tuning_cache::setting_type::double_value) {
+            values[i].value.double_value = var.dvalue;
+            if (sample) { apex::sample_value(tmp, var.dvalue); }
+        } else if (var.type == apex::tuning_cache::setting_type::int_value) {
+            values[i].value.int_value = var.lvalue;
+            if (sample) { apex::sample_value(tmp, var.lvalue); }
+        } else {
+            strncpy(values[i].value.string_value, var.svalue.c_str(),
+                KOKKOS_TOOLS_TUNING_STRING_LENGTH - 1);
+            values[i].value.string_value[
+                KOKKOS_TOOLS_TUNING_STRING_LENGTH - 1] = 0;
         }
     }
     return true;
 }
 
+enum class cache_match { none, exact, near };
+
+/* Use the cached settings for the nearest cached context, if its inputs
+ * are close enough to share a bin (within 25%), or a near match only
+ * gives the search its starting point.  The names alone can't be
+ * compared, because the bins are numbered in the order they were seen. */
+cache_match lookupCache(const std::string& name, const size_t vars,
+    Kokkos_Tools_VariableValue* values) {
+    KokkosSession& session = KokkosSession::getSession();
+    // the text caches from older versions only have the names
+    const apex::tuning_cache::entry * cached = session.cache.find(name);
+    if (cached != nullptr &&
+        getCachedTunings(*cached, name, vars, values, true)) {
+        return cache_match::exact;
+    }
+    std::vector<uint64_t> ids;
+    for (size_t i = 0 ; i < vars ; i++) {
+        auto output = session.outputs.find(values[i].type_id);
+        if (output == session.outputs.end()) { return cache_match::none; }
+        ids.push_back(cacheId(output->second));
+    }
+    double distance;
+    cached = session.cache.nearest(session.context_features[name], ids,
+        distance);
+    if (cached == nullptr ||
+        distance > apex::apex_options::kokkos_tuning_cache_distance()) {
+        return cache_match::none;
+    }
+    static const double same_bin{log2(1.25)};
+    if (distance <= same_bin) {
+        return getCachedTunings(*cached, name, vars, values, true) ?
+            cache_match::exact : cache_match::none;
+    }
+    if (session.verbose) {
+        std::cout << std::string(getDepth(), ' ');
+        std::cout << "Starting from the cached result for " << cached->name
+                  << ", at distance " << distance << std::endl;
+    }
+    return getCachedTunings(*cached, name, vars, values, false) ?
+        cache_match::near : cache_match::none;
+}
+
 void set_params(std::shared_ptr<apex_tuning_request> request,
     const size_t vars,
     Kokkos_Tools_VariableValue* values) {
@@ -847,7 +1217,8 @@ void set_params(std::shared_ptr<apex_tuning_request> request,
 }
 
 bool handle_start(const std::string & name, const size_t vars,
-    Kokkos_Tools_VariableValue* values, uint64_t& delta, bool& converged) {
+    Kokkos_Tools_VariableValue* values, uint64_t& delta, bool& converged,
+    bool warm_start) {
     KokkosSession& session = KokkosSession::getSession();
     auto search = session.requests.find(name);
     bool newSearch = false;
@@ -899,6 +1270,11 @@ bool handle_start(const std::string & name, const size_t vars,
         // Set apex_openmp_policy_tuning_strategy
         request->set_strategy(session.strategy);
         request->set_radius(0.5);
+        if (warm_start) {
+            // start from the similar context's result, and stay near it
+            request->set_warm_start(true);
+            request->set_radius(0.125);
+        }
         request->set_aggregation_times(3);
         // min, max, mean
         request->set_aggregation_function("min");
@@ -969,14 +1345,52 @@ void handle_stop(const std::string & name) {
             profile->calls >= session.window)) {
             //std::cout << "Num calls: " << profile->calls << std::endl;
             std::shared_ptr<apex_tuning_request> request = search->second;
+            double cost = (profile != nullptr && profile->calls > 0.0) ?
+                profile->minimum : std::numeric_limits<double>::max();
             // Evaluate the results
             apex::custom_event(request->get_trigger(), NULL);
+            /* the time per call with the converged settings, from the
+             * evaluation that converged and any after it */
+            if (request->has_converged() &&
+                cost < std::numeric_limits<double>::max()) {
+                session.converged_costs[name] = cost;
+            }
             // Reset counter so each measurement is fresh.
             apex::reset(name);
         }
     }
 }
 
+/* Measure a context that uses a cached result, like handle_stop does for
+ * the tuning requests, and check whether its cost has drifted. */
+void handle_cached_stop(const std::string & name) {
+    KokkosSession& session = KokkosSession::getSession();
+    auto drift = session.cached_drift.find(name);
+    if(drift == session.cached_drift.end()) { return; }
+    apex_profile * profile = apex::get_profile(name);
+    if(profile == nullptr || profile->calls == 0.0 ||
+       (session.window > 1 && profile->calls < session.window)) {
+        return;
+    }
+    double cost = profile->minimum;
+    if (drift->second.add(cost)) {
+        std::cout << "APEX: The cost for " << name << " has changed from "
+                  << drift->second.get_baseline() << " to " << cost
+                  << ", tuning again." << std::endl;
+        session.drifted.insert(name);
+        session.cached_drift.erase(drift);
+    }
+    apex::reset(name);
+}
+
+/* Called from kokkosp_finalize_library, while MPI is still running, so
+ * that the ranks can gather their results.  The session's destructor
+ * writes them otherwise. */
+void saveTuningCache(void) {
+    if (!apex::apex_options::use_kokkos_tuning()) { return; }
+    KokkosSession::getSession().writeCache();
+}
+
 extern "C" {
 /*
  * In the past, tools have responded to the profiling hooks in Kokkos.
@@ -1058,41 +1472,88 @@ void kokkosp_request_values(
     Kokkos_Tools_VariableValue* tuningVariableValues) {
     if (!apex::apex_options::use_kokkos_tuning()) { return; }
     // first, get the current timer node in the task tree
-    auto tlt = apex::thread_instance::get_top_level_timer();
-    std::string tree_node{"default"};
+    auto& tlt = apex::thread_instance::get_top_level_timer();
+    const void * tree_node{nullptr};
     if (tlt != nullptr) {
-        tree_node = tlt->tree_node->getName();
+        tree_node = tlt->tree_node->getData();
     }
     // don't track memory in this function.
     apex::in_apex prevent_memory_tracking;
     KokkosSession& session = KokkosSession::getSession();
+    // hash this combination of input vars
+    static thread_local std::vector<size_t> bins;
+    static thread_local std::vector<uint64_t> key;
+    contextKey(numContextVariables, contextVariableValues, session.inputs,
+        tree_node, bins, key);
+    uint64_t hash = hashContextKey(key);
+    // converged contexts don't need anything else
+    if (!session.verbose && session.converged.find(hash, key,
+        numTuningVariables, tuningVariableValues)) {
+        return;
+    }
     // create a unique name for this combination of input vars
-    std::string name{hashContext(numContextVariables, contextVariableValues,
-        session.inputs, tree_node)};
+    auto known = session.context_names.find(key);
+    if (known == session.context_names.end()) {
+        std::string tree_name{"default"};
+        if (tlt != nullptr) {
+            tree_name = tlt->tree_node->getName();
+        }
+        known = session.context_names.insert(std::make_pair(key,
+            contextName(numContextVariables, contextVariableValues,
+                session.inputs, tree_name, bins))).first;
+        session.context_features.insert(std::make_pair(known->second,
+            contextFeatures(numContextVariables, contextVariableValues,
+                session.inputs, tree_name)));
+    }
+    const std::string& name = known->second;
     if (session.verbose) {
         std::cout << std::string(getDepth(), ' ');
         std::cout << __APEX_FUNCTION__ << " ctx: " << contextId << std::endl;
         std::cout << std::string(getDepth(), ' ');
         printContext(numContextVariables, name);
     }
-    // check if we have a cached result
-    bool success{false};
-    if (session.use_history) {
-        success = getCachedTunings(name, numTuningVariables, tuningVariableValues);
+    // check if we have a cached result, for this context or a similar one
+    cache_match match{cache_match::none};
+    if (session.use_history && session.requests.count(name) == 0) {
+        match = lookupCache(name, numTuningVariables, tuningVariableValues);
+        /* the cached result has drifted, search again near it */
+        if (match == cache_match::exact && session.drifted.count(name) > 0) {
+            match = cache_match::near;
+        }
     }
-    if (success) {
+    if (match == cache_match::exact &&
+        apex::apex_options::tuning_drift()) {
+        // keep measuring the cached settings
+        auto drift = session.cached_drift.find(name);
+        if (drift == session.cached_drift.end()) {
+            drift = session.cached_drift.insert(std::make_pair(name,
+                apex::drift_detector())).first;
+            drift->second.set(apex::apex_options::tuning_drift_tolerance(),
+                apex::apex_options::tuning_drift_threshold());
+        }
+        session.active_requests.insert(
+            std::pair<uint32_t, std::string>(contextId, name));
+    } else if (match == cache_match::exact) {
         session.used_history.insert(contextId);
+        session.converged.insert(hash, key, numTuningVariables,
+            tuningVariableValues);
     } else {
         uint64_t delta = 0;
         bool converged = false;
-        if (handle_start(name, numTuningVariables, tuningVariableValues, delta, converged)) {
+        if (handle_start(name, numTuningVariables, tuningVariableValues,
+            delta, converged, match == cache_match::near)) {
             // throw away the time spent setting up tuning
             //session.context_starts[contextId] = session.context_starts[contextId] + delta;
         }
-        if (!converged) {
+        /* With drift detection, converged contexts are still measured,
+         * and can start tuning again */
+        if (!converged || apex::apex_options::tuning_drift()) {
             // add this name to our map of active contexts
             session.active_requests.insert(
                 std::pair<uint32_t, std::string>(contextId, name));
+        } else {
+            session.converged.insert(hash, key, numTuningVariables,
+                tuningVariableValues);
         }
     }
     if (session.verbose) {
@@ -1140,7 +1601,10 @@ void kokkosp_end_context(const size_t contextId) {
             std::cout << std::string(getDepth(), ' ');
             std::cout << name->second << "\t" << (end-(start->second)) << std::endl;
         }
-        if (session.used_history.count(contextId) == 0) {
+        if (session.cached_drift.count(name->second) > 0) {
+            apex::sample_value(name->second, (double)(end-(start->second)));
+            handle_cached_stop(name->second);
+        } else if (session.used_history.count(contextId) == 0) {
             apex::sample_value(name->second, (double)(end-(start->second)));
             handle_stop(name->second);
         } else {
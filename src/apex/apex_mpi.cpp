@@ -19,13 +19,15 @@
 #include "memory_wrapper.hpp"
 #include "apex_error_handling.hpp"
 #include "proc_read.h"
+#include "cooperative_tuning.hpp"
+#include "global_view.hpp"
 #if defined(APEX_WITH_MPI) || \
     (defined(HPX_HAVE_NETWORKING) && defined(HPX_HAVE_PARCELPORT_MPI))
 #include "mpi.h"
 #endif
 
 #define MPI_START_TIMER auto p = apex::new_task(__APEX_FUNCTION__); apex::start(p);
-#define MPI_STOP_TIMER apex::stop(p);
+#define MPI_STOP_TIMER apex::stop(p); apex::global_view::progress();
 
 /* Implementation of the C API */
 
@@ -138,6 +140,8 @@ void  mpi_abort_( MPI_Fint *comm, MPI_Fint *errorcode, MPI_Fint *ierr) {
         PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
         PMPI_Comm_size(MPI_COMM_WORLD, &size);
         apex::init("APEX MPI", rank, size);
+        apex::cooperative_tuning::init();
+        apex::global_view::init();
         return retval;
     }
     int MPI_Init_thread( int *argc, char ***argv, int required, int *provided ) {
@@ -147,6 +151,8 @@ void  mpi_abort_( MPI_Fint *comm, MPI_Fint *errorcode, MPI_Fint *ierr) {
         PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
         PMPI_Comm_size(MPI_COMM_WORLD, &size);
         apex::init("APEX MPI", rank, size);
+        apex::cooperative_tuning::init();
+        apex::global_view::init();
         return retval;
     }
     int MPI_Finalize(void) {
@@ -9,6 +9,9 @@
 
 #include <omp-tools.h>
 #include <unordered_map>
+#include <map>
+#include <mutex>
+#include <tuple>
 #include "string.h"
 #include "stdio.h"
 #include "apex_api.hpp"
@@ -22,6 +25,9 @@
 #include "inttypes.h"
 #include "event_listener.hpp"
 #include "async_thread_node.hpp"
+#include "async_activity.hpp"
+#include "slab_allocator.hpp"
+#include "task_identifier.hpp"
 #include "apex.hpp"
 #if defined(APEX_WITH_PERFETTO)
 #include "perfetto_listener.hpp"
@@ -38,41 +44,160 @@ static std::atomic<bool> enabled{false};
 
 constexpr size_t apex_ompt_buffer_request_size{16*1024};
 
+/* With APEX_OMPT_AGGREGATE_IMPLICIT_TASKS, the implicit tasks of a
+ * parallel region are timed as one event, from the first implicit task
+ * begin to the last implicit task end.  The region and each of its implicit
+ * tasks hold a reference, and whoever releases the last one records the
+ * event - worker threads can end their implicit tasks after the parallel
+ * region has ended. */
+class implicit_aggregate {
+    public:
+        apex::task_identifier * id;
+        std::shared_ptr<apex::task_wrapper> parent;
+        std::atomic<uint64_t> first_begin;
+        std::atomic<uint64_t> last_end;
+        std::atomic<uint32_t> references;
+        implicit_aggregate(apex::task_identifier * task_id,
+            std::shared_ptr<apex::task_wrapper> &region) :
+            id(task_id), parent(region), first_begin(UINT64_MAX),
+            last_end(0), references(1) { }
+        void begin(void) { references++; }
+        void end(uint64_t begin_ns, uint64_t end_ns) {
+            uint64_t first = first_begin;
+            while (begin_ns < first &&
+                !first_begin.compare_exchange_weak(first, begin_ns)) { }
+            uint64_t last = last_end;
+            while (end_ns > last &&
+                !last_end.compare_exchange_weak(last, end_ns)) { }
+        }
+        void release(void) {
+            if (--references > 0) { return; }
+            if (last_end > first_begin) {
+                auto tt = apex::new_task(id, UINT64_MAX, parent);
+                if (tt != nullptr) {
+                    // we can't start then stop because we have timestamps
+                    auto prof = std::make_shared<apex::profiler>(tt);
+                    prof->set_start(first_begin);
+                    prof->set_end(last_end);
+                    prof->stopped = true;
+                    apex::apex* instance = apex::apex::instance();
+                    instance->the_profiler_listener->push_profiler_public(prof);
+                    instance->complete_task(tt);
+                }
+            }
+            delete this;
+        }
+};
+
 class linked_timer {
     public:
         void * prev;
         std::shared_ptr<apex::task_wrapper> tw;
         bool timing;
         const void * codeptr; // for implicit tasks
-        inline void start(void) { apex::start(tw); timing = true;  }
-        inline void yield(void) { apex::yield(tw); timing = false; }
+        /* for parallel regions and aggregated implicit tasks */
+        implicit_aggregate * aggregate;
+        uint64_t begin_ns;
+        inline void start(void) {
+            if (tw == nullptr) { return; }
+            apex::start(tw); timing = true;
+        }
+        inline void yield(void) {
+            if (tw == nullptr) { return; }
+            apex::yield(tw); timing = false;
+        }
         inline void stop(void)  { apex::stop(tw);  timing = false; }
         /* constructor */
-        linked_timer(const char * name,
+        linked_timer(apex::task_identifier * id,
             uint64_t task_id,
             void *p,
             std::shared_ptr<apex::task_wrapper> &parent,
             bool auto_start,
             const void * codeptr_ra,
             bool is_par_reg) :
-            prev(p), timing(auto_start), codeptr(codeptr_ra) {
+            prev(p), timing(auto_start), codeptr(codeptr_ra),
+            aggregate(nullptr), begin_ns(0) {
             // No GUIDs generated by the runtime? Generate our own.
             if (task_id == 0ULL) {
-                tw = apex::new_task(name, UINT64_MAX, parent);
+                tw = apex::new_task(id, UINT64_MAX, parent);
             } else {
-                tw = apex::new_task(name, task_id, parent);
+                tw = apex::new_task(id, task_id, parent);
             }
             if (is_par_reg) { tw->explicit_trace_start = true; }
             if (auto_start) { this->start(); }
         }
+        /* an aggregated implicit task, which has no timer of its own */
+        linked_timer(void *p, implicit_aggregate * region) :
+            prev(p), tw(nullptr), timing(false), codeptr(nullptr),
+            aggregate(region), begin_ns(apex::profiler::now_ns()) {
+            aggregate->begin();
+        }
         /* destructor */
         ~linked_timer() {
             if (timing) {
                 apex::stop(tw);
             }
+            if (aggregate != nullptr) {
+                if (tw == nullptr) {
+                    aggregate->end(begin_ns, apex::profiler::now_ns());
+                }
+                aggregate->release();
+            }
         }
+        /* These are created and destroyed for every region and task, so
+         * they come from a per-thread pool rather than the heap. */
+        static void * operator new(size_t size) {
+            APEX_UNUSED(size);
+            return apex::slab_pool<sizeof(linked_timer)>::allocate();
+        }
+        static void operator delete(void * p) {
+            apex::slab_pool<sizeof(linked_timer)>::deallocate(p);
+        }
+};
+
+/* Region and task names are interned once per thread for each name and
+ * code address, rather than formatted for every region.  The names are
+ * "<category><kind>: UNRESOLVED ADDR <codeptr>", and the category and
+ * kind are static strings, so their addresses can be used as the key. */
+struct region_name_key {
+    const char * category;
+    const char * kind;
+    const void * codeptr;
+    bool operator==(const region_name_key& rhs) const {
+        return category == rhs.category && kind == rhs.kind &&
+            codeptr == rhs.codeptr;
+    }
 };
 
+struct region_name_hash {
+    size_t operator()(const region_name_key& k) const {
+        std::hash<const void*> h;
+        return h(k.codeptr) ^ (h(k.kind) << 1) ^ (h(k.category) << 2);
+    }
+};
+
+static apex::task_identifier * region_name(const char * category,
+    const char * kind, const void * codeptr_ra) {
+    static thread_local std::unordered_map<region_name_key,
+        apex::task_identifier*, region_name_hash> names;
+    region_name_key key{category, kind, codeptr_ra};
+    auto it = names.find(key);
+    if (it != names.end()) {
+        return it->second;
+    }
+    char regionIDstr[128] = {0};
+    if (codeptr_ra != nullptr) {
+        snprintf(regionIDstr, 128, "%s%s: UNRESOLVED ADDR %p", category, kind,
+            codeptr_ra);
+    } else {
+        snprintf(regionIDstr, 128, "%s%s", category, kind);
+    }
+    apex::task_identifier * id =
+        apex::task_identifier::get_task_id(std::string(regionIDstr));
+    names[key] = id;
+    return id;
+}
+
 /* This class is necessary so we can clean up before our globals are destroyed at exit */
 class Globals{
 private:
@@ -261,101 +386,23 @@ void stop_async_task(std::shared_ptr<apex::task_wrapper> tt, uint64_t start, uin
     instance->complete_task(tt);
 }
 
-void store_profiler_data(const std::string &name,
-        uint64_t start, uint64_t end, apex::ompt_thread_node &node,
-        std::shared_ptr<apex::task_wrapper> parent, bool otf2_trace = true) {
-    apex::in_apex prevent_deadlocks;
-    apex::async_event_data as_data;
-    as_data.flow = false;
-    // create a task_wrapper, as a GPU child of the parent on the CPU side
-    auto tt = apex::new_task(name, UINT64_MAX, parent);
-    // create an APEX profiler to store this data - we can't start
-    // then stop because we have timestamps already.
-    auto prof = std::make_shared<apex::profiler>(tt);
-    prof->set_start(start);
-    prof->set_end(end);
-    // important!  Otherwise we might get the wrong end timestamp.
-    prof->stopped = true;
-    // Get the singleton APEX instance
-    static apex::apex* instance = apex::apex::instance();
-    // fake out the profiler_listener
-    instance->the_profiler_listener->push_profiler_public(prof);
-    // Handle tracing, if necessary
-#if defined(APEX_WITH_PERFETTO)
-    if (apex::apex_options::use_perfetto()) {
-        apex::perfetto_listener * tel =
-            (apex::perfetto_listener*)instance->the_perfetto_listener;
-        tel->on_async_event(node, prof, as_data);
-    }
-#endif
-    if (apex::apex_options::use_trace_event()) {
-        apex::trace_event_listener * tel =
-            (apex::trace_event_listener*)instance->the_trace_event_listener;
-        tel->on_async_event(node, prof, as_data);
-    }
-#ifdef APEX_HAVE_OTF2
-    if (apex::apex_options::use_otf2() && otf2_trace) {
-        apex::otf2_listener * tol =
-            (apex::otf2_listener*)instance->the_otf2_listener;
-        tol->on_async_event(node, prof);
-    }
-#else
-    APEX_UNUSED(otf2_trace);
-#endif
-    // have the listeners handle the end of this task
-    instance->complete_task(tt);
-}
-
-/* Handle counters from asynchronous activity */
-void store_counter_data(const char * name, const std::string& ctx,
-    uint64_t end, double value, apex::ompt_thread_node &node) {
-    apex::in_apex prevent_deadlocks;
-    std::stringstream ss;
-    if (name == nullptr) {
-        ss << "GPU: " << ctx;
-    } else {
-        ss << "GPU: " << name << " " << ctx;
-    }
-    std::string tmp{ss.str()};
-    auto task_id = apex::task_identifier::get_task_id(tmp);
-    std::shared_ptr<apex::profiler> prof =
-        std::make_shared<apex::profiler>(task_id, value);
-    prof->is_counter = true;
-    prof->set_end(end);
-    // Get the singleton APEX instance
-    static apex::apex* instance = apex::apex::instance();
-    // fake out the profiler_listener
-    instance->the_profiler_listener->push_profiler_public(prof);
-    // Handle tracing, if necessary
-#if defined(APEX_WITH_PERFETTO)
-    if (apex::apex_options::use_perfetto()) {
-        apex::perfetto_listener * tel =
-            (apex::perfetto_listener*)instance->the_perfetto_listener;
-        tel->on_async_metric(node, prof);
-    }
-#endif
-    if (apex::apex_options::use_trace_event()) {
-        apex::trace_event_listener * tel =
-            (apex::trace_event_listener*)instance->the_trace_event_listener;
-        tel->on_async_metric(node, prof);
-    }
-#ifdef APEX_HAVE_OTF2
-    if (apex::apex_options::use_otf2()) {
-        apex::otf2_listener * tol =
-            (apex::otf2_listener*)instance->the_otf2_listener;
-        tol->on_async_metric(node, prof);
-    }
-#endif
-}
-
-void store_counter_data(const char * name, const std::string& ctx,
-    uint64_t end, size_t value, apex::ompt_thread_node &node) {
-    store_counter_data(name, ctx, end, (double)(value), node);
+/* The activity from one buffer is delivered to the listeners in a batch,
+ * after the whole buffer has been decoded. */
+typedef apex::async_activity_batch<apex::ompt_thread_node> ompt_activity_batch;
+
+/* Activity names are interned once for each record type, operation and
+ * code address, rather than built for every record. */
+template <typename F>
+static apex::task_identifier * intern_activity_name(int type, int op,
+    const void * codeptr_ra, F make_name) {
+    static apex::async_name_cache<std::tuple<int, int, const void*> > names;
+    return names.get(std::make_tuple(type, op, codeptr_ra), make_name);
 }
 
 // Simple print routine that this example uses while traversing
 // through the trace records returned as part of the buffer-completion callback
-static void print_record_ompt(ompt_record_ompt_t *rec) {
+static void print_record_ompt(ompt_record_ompt_t *rec,
+    ompt_activity_batch &batch) {
   if (rec == NULL) return;
 
   DEBUG_PRINT("rec=%p type=%d time=%lu thread_id=%lu target_id=%lu\n",
@@ -455,6 +502,38 @@ static void print_record_ompt(ompt_record_ompt_t *rec) {
          target_data_op_rec.end_time - rec->time,
          target_data_op_rec.codeptr_ra);
         int time_index = target_data_op_rec.dest_device_num;
+        if (target_data_op_rec.optype == ompt_target_data_transfer_from_device
+#if defined(APEX_HAVE_OMPT_5_1)
+            || target_data_op_rec.optype == ompt_target_data_transfer_from_device_async
+#endif
+            ) {
+            time_index = target_data_op_rec.src_device_num;
+        }
+            std::shared_ptr<apex::task_wrapper> tt;
+
+            const void* codeptr_ra;
+            {
+                std::unique_lock<std::mutex> l(target_lock);
+                // if we have a legit GPU target event, use it
+                if (target_map.count(rec->target_id) > 0) {
+                    tt = target_map[rec->target_id];
+                    // otherwise, use the host side target call
+                } else {
+                    tt = Globals::find_timer(rec->target_id);
+                }
+                codeptr_ra = active_target_addrs[rec->target_id];
+                parent_thread = target_parent_thread_ids[rec->target_id];
+                // the AMD runtime no longer gives times for the
+                // target event. So, we'll use this time, and save
+                // the stop time for this event in case it's needed.
+                if (target_start_times[rec->target_id] == 0) {
+                    target_start_times[rec->target_id] = rec->time - 1000;
+                }
+                target_end_times[rec->target_id] = target_data_op_rec.end_time;
+                std::cout << "Updated Target " << rec->target_id << ": " << target_start_times[rec->target_id] << " - " << target_end_times[rec->target_id] << std::endl;
+            }
+            apex::task_identifier * id = intern_activity_name(rec->type,
+                target_data_op_rec.optype, codeptr_ra, [&]() {
             std::stringstream ss;
             ss << "GPU: OpenMP Target DataOp";
 #if defined(APEX_HAVE_OMPT_5_1)
@@ -471,7 +550,6 @@ static void print_record_ompt(ompt_record_ompt_t *rec) {
                 }
                 case ompt_target_data_transfer_from_device: {
                     ss << " Xfer from Dev";
-                    time_index = target_data_op_rec.src_device_num;
                     break;
                 }
                 case ompt_target_data_delete: {
@@ -497,7 +575,6 @@ static void print_record_ompt(ompt_record_ompt_t *rec) {
                 }
                 case ompt_target_data_transfer_from_device_async: {
                     ss << " Xfer from Dev Async";
-                    time_index = target_data_op_rec.src_device_num;
                     break;
                 }
                 case ompt_target_data_delete_async: {
@@ -506,47 +583,28 @@ static void print_record_ompt(ompt_record_ompt_t *rec) {
                 }
 #endif
             }
-            std::shared_ptr<apex::task_wrapper> tt;
-
-            const void* codeptr_ra;
-            {
-                std::unique_lock<std::mutex> l(target_lock);
-                // if we have a legit GPU target event, use it
-                if (target_map.count(rec->target_id) > 0) {
-                    tt = target_map[rec->target_id];
-                    // otherwise, use the host side target call
-                } else {
-                    tt = Globals::find_timer(rec->target_id);
-                }
-                codeptr_ra = active_target_addrs[rec->target_id];
-                parent_thread = target_parent_thread_ids[rec->target_id];
-                // the AMD runtime no longer gives times for the
-                // target event. So, we'll use this time, and save
-                // the stop time for this event in case it's needed.
-                if (target_start_times[rec->target_id] == 0) {
-                    target_start_times[rec->target_id] = rec->time - 1000;
-                }
-                target_end_times[rec->target_id] = target_data_op_rec.end_time;
-                std::cout << "Updated Target " << rec->target_id << ": " << target_start_times[rec->target_id] << " - " << target_end_times[rec->target_id] << std::endl;
-            }
             if (codeptr_ra != nullptr) {
                 ss << ": UNRESOLVED ADDR " << codeptr_ra;
             }
-            std::string name{ss.str()};
+            return ss.str();
+            });
+            static apex::task_identifier * bytes_id =
+                apex::task_identifier::get_task_id(
+                    std::string("GPU: OpenMP Target DataOp Bytes"));
+            static apex::task_identifier * bw_id =
+                apex::task_identifier::get_task_id(
+                    std::string("GPU: OpenMP Target DataOp BW (MB/s)"));
             apex::ompt_thread_node node(target_data_op_rec.dest_device_num,
                 parent_thread, APEX_ASYNC_MEMORY);
-            store_profiler_data(name,
-                apex_ompt_translate_time(time_index, rec->time),
-                apex_ompt_translate_time(time_index, target_data_op_rec.end_time),
-                node, tt);
-            store_counter_data("OpenMP Target DataOp", "Bytes",
-                apex_ompt_translate_time(time_index, target_data_op_rec.end_time),
-                target_data_op_rec.bytes, node);
+            uint64_t end = apex_ompt_translate_time(time_index,
+                target_data_op_rec.end_time);
+            batch.add_activity(node, id,
+                apex_ompt_translate_time(time_index, rec->time), end, tt);
+            batch.add_counter(node, bytes_id, end,
+                (double)(target_data_op_rec.bytes));
             // converting from B/us to MB/s
             double bw = (target_data_op_rec.bytes) / (target_data_op_rec.end_time - rec->time);
-            store_counter_data("OpenMP Target DataOp", "BW (MB/s)",
-                apex_ompt_translate_time(time_index, target_data_op_rec.end_time),
-                bw, node);
+            batch.add_counter(node, bw_id, end, bw);
       break;
     }
   case ompt_callback_target_submit:
@@ -560,11 +618,6 @@ static void print_record_ompt(ompt_record_ompt_t *rec) {
          target_kernel_rec.host_op_id, target_kernel_rec.requested_num_teams,
          target_kernel_rec.granted_num_teams, target_kernel_rec.end_time,
          target_kernel_rec.end_time - rec->time);
-            std::stringstream ss;
-            ss << "GPU: OpenMP Target Submit";
-#if defined(APEX_HAVE_OMPT_5_1)
-            if(rec->type == ompt_callback_target_submit_emi) ss << " EMI";
-#endif
             int device_num;
             std::shared_ptr<apex::task_wrapper> tt;
             const void* codeptr_ra;
@@ -586,16 +639,24 @@ static void print_record_ompt(ompt_record_ompt_t *rec) {
                 target_end_times[rec->target_id] = target_kernel_rec.end_time;
                 std::cout << "Updated Target " << rec->target_id << ": " << target_start_times[rec->target_id] << " - " << target_end_times[rec->target_id] << std::endl;
             }
+            apex::task_identifier * id = intern_activity_name(rec->type, 0,
+                codeptr_ra, [&]() {
+            std::stringstream ss;
+            ss << "GPU: OpenMP Target Submit";
+#if defined(APEX_HAVE_OMPT_5_1)
+            if(rec->type == ompt_callback_target_submit_emi) ss << " EMI";
+#endif
             if (codeptr_ra != nullptr) {
                 ss << ": UNRESOLVED ADDR " << codeptr_ra;
             }
-            std::string name{ss.str()};
+            return ss.str();
+            });
             apex::ompt_thread_node node(device_num, parent_thread,
                 APEX_ASYNC_KERNEL);
-            store_profiler_data(name,
+            batch.add_activity(node, id,
                 apex_ompt_translate_time(device_num, rec->time),
                 apex_ompt_translate_time(device_num, target_kernel_rec.end_time),
-                node, tt);
+                tt);
     break;
     }
   default:
@@ -662,7 +723,7 @@ namespace apex {
 
 /* These methods are some helper functions for starting/stopping timers */
 
-void apex_ompt_start(const char * state,
+void apex_ompt_start(apex::task_identifier * state,
         ompt_data_t * ompt_data,
         ompt_data_t * region_data,
         bool auto_start,
@@ -770,10 +831,14 @@ static void apex_parallel_region_begin (
     APEX_UNUSED(encountering_task_frame);
     APEX_UNUSED(requested_team_size);
     APEX_UNUSED(flags);
-    char regionIDstr[128] = {0};
-    snprintf(regionIDstr, 128, "OpenMP Parallel Region: UNRESOLVED ADDR %p", codeptr_ra);
-    apex_ompt_start(regionIDstr, parallel_data, encountering_task_data, true, codeptr_ra, true);
-    DEBUG_PRINT("%" PRId64 ": Parallel Region Begin parent: %p, apex_parent: %p, region: %p, apex_region: %p, %s\n", apex_threadid, (void*)encountering_task_data, encountering_task_data->ptr, (void*)parallel_data, parallel_data->ptr, regionIDstr);
+    apex_ompt_start(region_name("", "OpenMP Parallel Region", codeptr_ra),
+        parallel_data, encountering_task_data, true, codeptr_ra, true);
+    if (apex::apex_options::ompt_aggregate_implicit_tasks()) {
+        linked_timer* region = (linked_timer*)(parallel_data->ptr);
+        region->aggregate = new implicit_aggregate(
+            region_name("", "OpenMP Implicit Task", codeptr_ra), region->tw);
+    }
+    DEBUG_PRINT("%" PRId64 ": Parallel Region Begin parent: %p, apex_parent: %p, region: %p, apex_region: %p\n", apex_threadid, (void*)encountering_task_data, encountering_task_data->ptr, (void*)parallel_data, parallel_data->ptr);
 }
 
 /* Event #4, parallel region end */
@@ -844,15 +909,8 @@ extern "C" void apex_task_create (
     }
     DEBUG_PRINT("%" PRId64 ": %s Task Create parent: %p, child: %p\n", apex_threadid, type_str, (void*)encountering_task_data, (void*)new_task_data);
 
-    if (codeptr_ra != nullptr) {
-        char regionIDstr[128] = {0};
-        snprintf(regionIDstr, 128, "%s: UNRESOLVED ADDR %p", type_str, codeptr_ra);
-        apex_ompt_start(regionIDstr, new_task_data, encountering_task_data,
-        false, codeptr_ra);
-    } else {
-        apex_ompt_start(type_str, new_task_data, encountering_task_data,
-        false);
-    }
+    apex_ompt_start(region_name("", type_str, codeptr_ra), new_task_data,
+        encountering_task_data, false, codeptr_ra);
 }
 
 /* Event #6, task schedule */
@@ -907,24 +965,22 @@ extern "C" void apex_implicit_task(
     APEX_UNUSED(thread_num);
     APEX_UNUSED(flags);
     if (endpoint == ompt_scope_begin) {
-        std::stringstream ss;
-        void * codeptr = nullptr;
-        if (flags == ompt_task_initial) {
-            ss << "OpenMP Initial Task";
-        } else {
-            ss << "OpenMP Implicit Task";
-        }
+        const void * codeptr = nullptr;
         /* If the implicit task is from a parallel region, we want to make
          * this timer unique by adding the address of the parallel region. */
         if (parallel_data != nullptr && parallel_data->ptr != nullptr) {
             linked_timer* parent = (linked_timer*)(parallel_data->ptr);
-            if (parent->codeptr != nullptr) {
-                ss << ": UNRESOLVED ADDR " << parent->codeptr;
-                codeptr = (void*)parent->codeptr;
+            /* The region times all of its implicit tasks as one event */
+            if (parent->aggregate != nullptr) {
+                task_data->ptr = (void*)(new linked_timer(task_data->ptr,
+                    parent->aggregate));
+                return;
             }
+            codeptr = parent->codeptr;
         }
-        std::string tmp{ss.str()};
-        apex_ompt_start(tmp.c_str(), task_data, parallel_data, true, codeptr);
+        apex_ompt_start(region_name("", flags == ompt_task_initial ?
+            "OpenMP Initial Task" : "OpenMP Implicit Task", codeptr),
+            task_data, parallel_data, true, codeptr);
         if (flags == ompt_task_initial) {
             the_initial_task = task_data;
         }
@@ -970,15 +1026,8 @@ extern "C" void apex_target (
             task_data->value = 0;
             task_data->ptr = nullptr;
         }
-        char regionIDstr[128] = {0};
-        if (codeptr_ra != nullptr) {
-            snprintf(regionIDstr, 128, "OpenMP Target: UNRESOLVED ADDR %p",
-            codeptr_ra);
-            apex_ompt_start(regionIDstr, task_data, nullptr, true, codeptr_ra);
-        } else {
-            snprintf(regionIDstr, 128, "OpenMP Target");
-            apex_ompt_start(regionIDstr, task_data, nullptr, true);
-        }
+        apex_ompt_start(region_name("", "OpenMP Target", codeptr_ra),
+            task_data, nullptr, true, codeptr_ra);
         {
             std::unique_lock<std::mutex> l(target_lock);
             target_map[target_id] = task_data;
@@ -1371,16 +1420,8 @@ extern "C" void apex_sync_region_wait (
                 }
             }
         }
-        char regionIDstr[128] = {0};
-        if (local_codeptr != nullptr) {
-            snprintf(regionIDstr, 128, "OpenMP %s: UNRESOLVED ADDR %p", tmp_str,
-                local_codeptr);
-            apex_ompt_start(regionIDstr, task_data, parallel_data, true,
-                local_codeptr);
-        } else {
-            snprintf(regionIDstr, 128, "OpenMP %s", tmp_str);
-            apex_ompt_start(regionIDstr, task_data, parallel_data, true);
-        }
+        apex_ompt_start(region_name("OpenMP ", tmp_str, local_codeptr),
+            task_data, parallel_data, true, local_codeptr);
     } else {
         apex_ompt_stop(task_data);
     }
@@ -1453,17 +1494,10 @@ extern "C" void apex_ompt_work (
             break;
     }
     if (endpoint == ompt_scope_begin) {
-        char regionIDstr[128] = {0};
         DEBUG_PRINT("%" PRId64 ": %s Begin task: %p, region: %p\n", apex_threadid,
         tmp_str, (void*)task_data, (void*)parallel_data);
-        if (codeptr_ra != nullptr) {
-            snprintf(regionIDstr, 128, "OpenMP Work %s: UNRESOLVED ADDR %p", tmp_str,
-            codeptr_ra);
-            apex_ompt_start(regionIDstr, task_data, parallel_data, true, codeptr_ra);
-        } else {
-            snprintf(regionIDstr, 128, "OpenMP Work %s", tmp_str);
-            apex_ompt_start(regionIDstr, task_data, parallel_data, true);
-        }
+        apex_ompt_start(region_name("OpenMP Work ", tmp_str, codeptr_ra),
+            task_data, parallel_data, true, codeptr_ra);
         /*
         if (apex::apex_options::ompt_high_overhead_events()) {
             std::stringstream ss;
@@ -1488,14 +1522,8 @@ extern "C" void apex_ompt_master (
 ) {
     if (!enabled) { return; }
     if (endpoint == ompt_scope_begin) {
-        if (codeptr_ra != nullptr) {
-            char regionIDstr[128] = {0};
-            snprintf(regionIDstr, 128, "OpenMP Master: UNRESOLVED ADDR %p",
-            codeptr_ra);
-            apex_ompt_start(regionIDstr, task_data, parallel_data, true, codeptr_ra);
-        } else {
-            apex_ompt_start("OpenMP Master", task_data, parallel_data, true);
-        }
+        apex_ompt_start(region_name("", "OpenMP Master", codeptr_ra),
+            task_data, parallel_data, true, codeptr_ra);
     } else {
         apex_ompt_stop(task_data);
     }
@@ -1578,16 +1606,8 @@ extern "C" void apex_ompt_sync_region (
             }
         }
 #endif
-        char regionIDstr[128] = {0};
-        if (local_codeptr != nullptr) {
-            snprintf(regionIDstr, 128, "OpenMP %s: UNRESOLVED ADDR %p", tmp_str,
-                local_codeptr);
-            apex_ompt_start(regionIDstr, task_data, parallel_data, true,
-                local_codeptr);
-        } else {
-            snprintf(regionIDstr, 128, "OpenMP %s", tmp_str);
-            apex_ompt_start(regionIDstr, task_data, parallel_data, true);
-        }
+        apex_ompt_start(region_name("OpenMP ", tmp_str, local_codeptr),
+            task_data, parallel_data, true, local_codeptr);
     } else {
         apex_ompt_stop(task_data);
     }
@@ -1737,15 +1757,17 @@ static void on_ompt_callback_buffer_complete (
 
   int status = 1;
   ompt_buffer_cursor_t current = begin;
+  ompt_activity_batch batch;
   while (status) {
     ompt_record_ompt_t *rec = ompt_get_record_ompt(buffer, current);
-    print_record_ompt(rec);
+    print_record_ompt(rec, batch);
     status = ompt_advance_buffer_cursor(NULL, /* TODO device */
                     buffer,
                     bytes,
                     current,
                     &current);
   }
+  batch.flush();
   if (buffer_owned) delete_buffer_ompt(buffer);
 }
 
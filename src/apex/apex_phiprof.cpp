@@ -2,34 +2,45 @@
 #include <mpi.h>
 #include <mutex>
 #include <stack>
+#include <vector>
 #include "apex.hpp"
+#include "handle_cache.hpp"
 #include <phiprof.hpp>
 
 //#warning compiling phiprof
 
-/* Correspondance between labels and ids */
+/* Correspondance between labels and ids.  Each id is an index into the
+ * interned timers, so starting a timer by id does no string work. */
 
-std::mutex mut;
+apex::shared_mutex_type mut;
 
 std::map<std::string, int> timers_labels;
-std::map<int, std::string> timers_ids;
+std::vector<const apex::interned_timer*> timers_ids;
+
+apex::handle_cache<std::string> timer_handles([](const std::string& label) {
+    return label;
+});
 
 int insertOrGet( const std::string &label ){
-    int id;
-    mut.lock();
+    {
+        apex::read_lock_type l(mut);
+        auto it = timers_labels.find( label );
+        if( it != timers_labels.end() ){
+            return it->second;
+        }
+    }
+    const apex::interned_timer * timer = timer_handles.get( label );
+    apex::write_lock_type l(mut);
     auto it = timers_labels.find( label );
-    if( it == timers_labels.end() ){
-        id = timers_labels.size();
-        timers_labels[ label ] = id;
-        timers_ids[ id ] = label;
-    } else {
-        id =  it->second;
-    }    
-    mut.unlock();
+    if( it != timers_labels.end() ){
+        return it->second;
+    }
+    int id = timers_ids.size();
+    timers_labels[ label ] = id;
+    timers_ids.push_back( timer );
     return id;
 }
 
-
 /* Simple initialization. Returns true if started succesfully */
 
 bool phiprof::initialize(){
@@ -77,39 +88,53 @@ int phiprof::getChildId(const std::string &label){
 static thread_local std::stack<std::shared_ptr<apex::task_wrapper> > my_stack;
 
 
-bool phiprof::start(const std::string &label){
-    auto t = apex::new_task( label );
-    apex::start( t );
+static void start_timer(const apex::interned_timer * timer){
+    std::shared_ptr<apex::task_wrapper> t{nullptr};
+    if (!timer->excluded) {
+        t = apex::new_task( timer->id, UINTMAX_MAX, apex::null_task_wrapper );
+        if (t != nullptr) { apex::start( t ); }
+    }
+    // excluded timers are still pushed, to match their stop
     my_stack.push(t);
+}
+
+static void stop_timer(){
+    if (my_stack.empty()) { return; }
+    auto t = my_stack.top();
+    if (t != nullptr) { apex::stop(t); }
+    my_stack.pop();
+}
+
+bool phiprof::start(const std::string &label){
+    start_timer( timer_handles.get( label ) );
     return true;
 }
 
 bool phiprof::start(int id){
-    auto label = timers_ids[ id ];
-    auto t = apex::new_task( label );
-    apex::start( t );
-    my_stack.push(t);
+    const apex::interned_timer * timer{nullptr};
+    {
+        apex::read_lock_type l(mut);
+        if( id < 0 || id >= (int)(timers_ids.size()) ){
+            return false;
+        }
+        timer = timers_ids[ id ];
+    }
+    start_timer( timer );
     return true;
 }
 
 bool phiprof::stop (const std::string &label, double workUnits, const std::string &workUnitLabel){
-    auto t = my_stack.top();
-    apex::stop(t);
-    my_stack.pop();
+    stop_timer();
     return true;
 }
 
 bool phiprof::stop (int id, double workUnits, const std::string &workUnitLabel){
-    auto t = my_stack.top();
-    apex::stop(t);
-    my_stack.pop();
+    stop_timer();
     return true;
 }
 
 bool phiprof::stop (int id){
-    auto t = my_stack.top();
-    apex::stop(t);
-    my_stack.pop();
+    stop_timer();
     return true;
 }
 
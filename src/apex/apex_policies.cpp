@@ -27,6 +27,8 @@
 #include <atomic>
 #include <utility>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 #include "apex_cxx_shared_lock.hpp"
 #include "apex_assert.h"
 #include <unistd.h>
@@ -91,6 +93,25 @@ static const char * library_for_strategy(apex_ah_tuning_strategy s) {
 }
 #endif
 
+/* Without Active Harmony, use the built-in versions of its strategies */
+static apex_ah_tuning_strategy native_strategy(apex_ah_tuning_strategy s) {
+#ifndef APEX_HAVE_ACTIVEHARMONY
+    switch(s) {
+        case apex_ah_tuning_strategy::EXHAUSTIVE:
+            return apex_ah_tuning_strategy::APEX_EXHAUSTIVE;
+        case apex_ah_tuning_strategy::RANDOM:
+            return apex_ah_tuning_strategy::APEX_RANDOM;
+        case apex_ah_tuning_strategy::NELDER_MEAD:
+            return apex_ah_tuning_strategy::APEX_NELDER_MEAD;
+        case apex_ah_tuning_strategy::PARALLEL_RANK_ORDER:
+            return apex_ah_tuning_strategy::APEX_PARALLEL_RANK_ORDER;
+        default:
+            break;
+    }
+#endif
+    return s;
+}
+
 // this is the policy engine for APEX used to determine when contention
 // is present on the socket and reduce the number of active threads
 
@@ -878,11 +899,156 @@ int apex_custom_tuning_policy(shared_ptr<apex_tuning_session> tuning_session,
 }
 #endif // APEX_HAVE_ACTIVEHARMONY
 
+/* Cooperative tuning between MPI ranks.  The Nelder-Mead, parallel rank
+ * order and Bayesian searches send every measurement to all of the ranks,
+ * and only use the measurements that have been delivered, so they take
+ * the same steps everywhere while each rank measures its share of the
+ * candidates.  The other searches run on their own.  Either way, when
+ * rank 0 has converged, every rank switches to its best settings. */
+template<typename Search>
+void __cooperative_measure(shared_ptr<apex_tuning_session> tuning_session,
+    Search & search, double cost) {
+    APEX_UNUSED(tuning_session);
+    search.evaluate(cost);
+}
+
+template<typename Search>
+void __cooperative_post(shared_ptr<apex_tuning_session> tuning_session,
+    Search & search, double cost) {
+    apex::cooperative_tuning::record r{false, {}, cost};
+    if (search.take_pending(r.index)) {
+        apex::cooperative_tuning::post(tuning_session->cooperative_name, r);
+    }
+}
+
+void __cooperative_measure(shared_ptr<apex_tuning_session> tuning_session,
+    apex::nelder_mead::NelderMead & search, double cost) {
+    __cooperative_post(tuning_session, search, cost);
+}
+
+void __cooperative_measure(shared_ptr<apex_tuning_session> tuning_session,
+    apex::parallel_rank_order::ParallelRankOrder & search, double cost) {
+    __cooperative_post(tuning_session, search, cost);
+}
+
+void __cooperative_measure(shared_ptr<apex_tuning_session> tuning_session,
+    apex::bayesian_optimization::BayesianOptimization & search, double cost) {
+    __cooperative_post(tuning_session, search, cost);
+}
+
+template<typename Search>
+void __cooperative_import(Search & search,
+    const apex::cooperative_tuning::record & r) {
+    APEX_UNUSED(search);
+    APEX_UNUSED(r);
+}
+
+void __cooperative_import(apex::nelder_mead::NelderMead & search,
+    const apex::cooperative_tuning::record & r) {
+    search.import(r.index, r.cost);
+}
+
+void __cooperative_import(apex::parallel_rank_order::ParallelRankOrder &
+    search, const apex::cooperative_tuning::record & r) {
+    search.import(r.index, r.cost);
+}
+
+void __cooperative_import(apex::bayesian_optimization::BayesianOptimization &
+    search, const apex::cooperative_tuning::record & r) {
+    search.import(r.index, r.cost);
+}
+
+template<typename Search>
+void __cooperative_deliver(shared_ptr<apex_tuning_session> tuning_session,
+    Search & search, const apex::cooperative_tuning::record & r) {
+    if (!r.final) {
+        __cooperative_import(search, r);
+        return;
+    }
+    if (tuning_session->adopted || r.index.size() != search.get_vars().size()) {
+        return;
+    }
+    size_t i = 0;
+    for (auto & v : search.get_vars()) {
+        v.second.best_index = r.index[i++];
+    }
+    tuning_session->adopted = true;
+}
+
+/* Called by the policies below, with the shutdown mutex held */
+template<typename Search>
+int apex_cooperative_policy(shared_ptr<apex_tuning_session> tuning_session,
+    Search & search) {
+    apex::cooperative_tuning::progress();
+    if (tuning_session->adopted) {
+        if (!tuning_session->converged_message) {
+            tuning_session->converged_message = true;
+            if (apex::cooperative_tuning::rank() == 0) {
+                cout << "APEX: Tuning has converged for session "
+                << tuning_session->id << " on every rank." << endl;
+                search.saveBestSettings();
+                search.printBestSettings();
+            }
+        }
+        search.saveBestSettings();
+        return APEX_NOERROR;
+    }
+    if (search.converged()) {
+        if (apex::cooperative_tuning::rank() == 0 &&
+            !tuning_session->final_posted) {
+            tuning_session->final_posted = true;
+            apex::cooperative_tuning::record r{true, {}, 0.0};
+            for (auto & v : search.get_vars()) {
+                r.index.push_back(v.second.best_index);
+            }
+            apex::cooperative_tuning::post(tuning_session->cooperative_name, r);
+        }
+        // hold the best settings until rank 0's arrive
+        search.saveBestSettings();
+        return APEX_NOERROR;
+    }
+
+    // get a measurement of our current setting
+    double new_value = tuning_session->metric_of_interest();
+
+    /* Report the performance we've just measured. */
+    __cooperative_measure(tuning_session, search, new_value);
+
+    /* Request new settings for next time */
+    search.getNewSettings();
+
+    return APEX_NOERROR;
+}
+
+/* After a search converges, keep measuring the best settings.  If their
+ * cost changes for good (the input changed, say), search again near them,
+ * with a smaller space and a bounded number of evaluations.  Called by the
+ * policies below, with the shutdown mutex held. */
+template<typename Search>
+void __watch_for_drift(shared_ptr<apex_tuning_session> tuning_session,
+    Search & search) {
+    if (!apex::apex_options::tuning_drift()) { return; }
+    double cost = tuning_session->metric_of_interest();
+    if (!tuning_session->drift.add(cost)) { return; }
+    cout << "APEX: The cost for session " << tuning_session->id
+         << " has changed from " << tuning_session->drift.get_baseline()
+         << " to " << cost << ", tuning again." << endl;
+    tuning_session->drift.reset();
+    tuning_session->converged_message = false;
+    search.retune(apex::apex_options::tuning_drift_radius(),
+        (size_t)(std::max(apex::apex_options::tuning_drift_budget(), 1)));
+    search.getNewSettings();
+}
+
 int apex_sa_policy(shared_ptr<apex_tuning_session> tuning_session,
     apex_context const context) {
     APEX_UNUSED(context);
     if (apex_final) return APEX_NOERROR; // we terminated
     std::unique_lock<std::mutex> l{shutdown_mutex};
+    if (tuning_session->cooperative) {
+        return apex_cooperative_policy(tuning_session,
+            tuning_session->sa_session);
+    }
     if (tuning_session->sa_session.converged()) {
         if (!tuning_session->converged_message) {
             tuning_session->converged_message = true;
@@ -892,6 +1058,7 @@ int apex_sa_policy(shared_ptr<apex_tuning_session> tuning_session,
             tuning_session->sa_session.printBestSettings();
         }
         tuning_session->sa_session.saveBestSettings();
+        __watch_for_drift(tuning_session, tuning_session->sa_session);
         return APEX_NOERROR;
     }
 
@@ -912,6 +1079,10 @@ int apex_exhaustive_policy(shared_ptr<apex_tuning_session> tuning_session,
     APEX_UNUSED(context);
     if (apex_final) return APEX_NOERROR; // we terminated
     std::unique_lock<std::mutex> l{shutdown_mutex};
+    if (tuning_session->cooperative) {
+        return apex_cooperative_policy(tuning_session,
+            tuning_session->exhaustive_session);
+    }
     if (tuning_session->exhaustive_session.converged()) {
         if (!tuning_session->converged_message) {
             tuning_session->converged_message = true;
@@ -941,6 +1112,10 @@ int apex_random_policy(shared_ptr<apex_tuning_session> tuning_session,
     APEX_UNUSED(context);
     if (apex_final) return APEX_NOERROR; // we terminated
     std::unique_lock<std::mutex> l{shutdown_mutex};
+    if (tuning_session->cooperative) {
+        return apex_cooperative_policy(tuning_session,
+            tuning_session->random_session);
+    }
     if (tuning_session->random_session.converged()) {
         if (!tuning_session->converged_message) {
             tuning_session->converged_message = true;
@@ -965,6 +1140,108 @@ int apex_random_policy(shared_ptr<apex_tuning_session> tuning_session,
     return APEX_NOERROR;
 }
 
+int apex_nelder_mead_policy(shared_ptr<apex_tuning_session> tuning_session,
+    apex_context const context) {
+    APEX_UNUSED(context);
+    if (apex_final) return APEX_NOERROR; // we terminated
+    std::unique_lock<std::mutex> l{shutdown_mutex};
+    if (tuning_session->cooperative) {
+        return apex_cooperative_policy(tuning_session,
+            tuning_session->nm_session);
+    }
+    if (tuning_session->nm_session.converged()) {
+        if (!tuning_session->converged_message) {
+            tuning_session->converged_message = true;
+            cout << "APEX: Tuning has converged for session " << tuning_session->id
+            << "." << endl;
+            tuning_session->nm_session.saveBestSettings();
+            tuning_session->nm_session.printBestSettings();
+        }
+        tuning_session->nm_session.saveBestSettings();
+        __watch_for_drift(tuning_session, tuning_session->nm_session);
+        return APEX_NOERROR;
+    }
+
+    // get a measurement of our current setting
+    double new_value = tuning_session->metric_of_interest();
+
+    /* Report the performance we've just measured. */
+    tuning_session->nm_session.evaluate(new_value);
+
+    /* Request new settings for next time */
+    tuning_session->nm_session.getNewSettings();
+
+    return APEX_NOERROR;
+}
+
+int apex_parallel_rank_order_policy(shared_ptr<apex_tuning_session> tuning_session,
+    apex_context const context) {
+    APEX_UNUSED(context);
+    if (apex_final) return APEX_NOERROR; // we terminated
+    std::unique_lock<std::mutex> l{shutdown_mutex};
+    if (tuning_session->cooperative) {
+        return apex_cooperative_policy(tuning_session,
+            tuning_session->pro_session);
+    }
+    if (tuning_session->pro_session.converged()) {
+        if (!tuning_session->converged_message) {
+            tuning_session->converged_message = true;
+            cout << "APEX: Tuning has converged for session " << tuning_session->id
+            << "." << endl;
+            tuning_session->pro_session.saveBestSettings();
+            tuning_session->pro_session.printBestSettings();
+        }
+        tuning_session->pro_session.saveBestSettings();
+        __watch_for_drift(tuning_session, tuning_session->pro_session);
+        return APEX_NOERROR;
+    }
+
+    // get a measurement of our current setting
+    double new_value = tuning_session->metric_of_interest();
+
+    /* Report the performance we've just measured. */
+    tuning_session->pro_session.evaluate(new_value);
+
+    /* Request new settings for next time */
+    tuning_session->pro_session.getNewSettings();
+
+    return APEX_NOERROR;
+}
+
+int apex_bayesian_optimization_policy(shared_ptr<apex_tuning_session> tuning_session,
+    apex_context const context) {
+    APEX_UNUSED(context);
+    if (apex_final) return APEX_NOERROR; // we terminated
+    std::unique_lock<std::mutex> l{shutdown_mutex};
+    if (tuning_session->cooperative) {
+        return apex_cooperative_policy(tuning_session,
+            tuning_session->bo_session);
+    }
+    if (tuning_session->bo_session.converged()) {
+        if (!tuning_session->converged_message) {
+            tuning_session->converged_message = true;
+            cout << "APEX: Tuning has converged for session " << tuning_session->id
+            << "." << endl;
+            tuning_session->bo_session.saveBestSettings();
+            tuning_session->bo_session.printBestSettings();
+        }
+        tuning_session->bo_session.saveBestSettings();
+        __watch_for_drift(tuning_session, tuning_session->bo_session);
+        return APEX_NOERROR;
+    }
+
+    // get a measurement of our current setting
+    double new_value = tuning_session->metric_of_interest();
+
+    /* Report the performance we've just measured. */
+    tuning_session->bo_session.evaluate(new_value);
+
+    /* Request new settings for next time */
+    tuning_session->bo_session.getNewSettings();
+
+    return APEX_NOERROR;
+}
+
 
 /// ----------------------------------------------------------------------------
 ///
@@ -980,6 +1257,8 @@ inline void __read_common_variables(apex_tuning_session * tuning_session) {
     tuning_session->max_threads = tuning_session->thread_cap =
         apex::hardware_concurrency();
     tuning_session->min_threads = 1;
+    tuning_session->drift.set(apex::apex_options::tuning_drift_tolerance(),
+        apex::apex_options::tuning_drift_threshold());
     if (apex::apex_options::throttle_concurrency()) {
         apex_checkThrottling = true;
         tuning_session->max_threads =
@@ -1451,6 +1730,84 @@ inline int __active_harmony_custom_setup(shared_ptr<apex_tuning_session>
 inline void __apex_active_harmony_shutdown(void) { }
 #endif
 
+/* A warm started search begins at the initial value of each parameter
+ * (the nearest one in its space), instead of in the middle of the space */
+template<typename V>
+void __set_init(V & v, const std::shared_ptr<apex_param> & param,
+    bool warm_start) {
+    if (!warm_start) {
+        v.set_init();
+        return;
+    }
+    std::string init = param->get_init();
+    size_t start{0};
+    if (!v.lvalues.empty()) {
+        long x = atol(init.c_str());
+        for (size_t i = 0 ; i < v.lvalues.size() ; i++) {
+            if (labs(v.lvalues[i] - x) < labs(v.lvalues[start] - x)) {
+                start = i;
+            }
+        }
+    } else if (!v.dvalues.empty()) {
+        double x = atof(init.c_str());
+        for (size_t i = 0 ; i < v.dvalues.size() ; i++) {
+            if (fabs(v.dvalues[i] - x) < fabs(v.dvalues[start] - x)) {
+                start = i;
+            }
+        }
+    } else {
+        auto found = std::find(v.svalues.begin(), v.svalues.end(), init);
+        if (found == v.svalues.end()) {
+            v.set_init();
+            return;
+        }
+        start = found - v.svalues.begin();
+    }
+    v.set_init(start);
+}
+
+/* The searches tune a parameter over the values from min to max (not
+ * including max, but always including min) at intervals of step.  A step
+ * that isn't positive never gets to max, so it is an error, and stepping
+ * past a max near the end of the type's range must not overflow. */
+inline void __report_step(const std::string & name, double step) {
+    cerr << "ERROR: Attempted to register tuning parameter " << name
+    << " with step " << step << ", the step has to be positive." << endl;
+}
+
+inline bool __expand_range(const std::string & name, long min, long max,
+    long step, std::vector<long> & values) {
+    if (step <= 0) {
+        __report_step(name, step);
+        return false;
+    }
+    values.push_back(min);
+    // the distance to max fits in an unsigned long, even when max-min
+    // doesn't fit in a long
+    for (long value = min ; value < max &&
+         (unsigned long)max - (unsigned long)value > (unsigned long)step ; ) {
+        value += step;
+        values.push_back(value);
+    }
+    return true;
+}
+
+inline bool __expand_range(const std::string & name, double min,
+    double max, double step, std::vector<double> & values) {
+    // NaN isn't positive either
+    if (!(step > 0.0) || std::isinf(step)) {
+        __report_step(name, step);
+        return false;
+    }
+    values.push_back(min);
+    // a step too small to change the value would never get to max
+    for (double value = min, next = min + step ;
+         next < max && next > value ; value = next, next = value + step) {
+        values.push_back(next);
+    }
+    return true;
+}
+
 inline int __sa_setup(shared_ptr<apex_tuning_session>
     tuning_session, apex_tuning_request & request) {
   APEX_UNUSED(tuning_session);
@@ -1465,12 +1822,11 @@ inline int __sa_setup(shared_ptr<apex_tuning_session>
               auto param_long =
               std::static_pointer_cast<apex_param_long>(param);
               Variable v(VariableType::longtype, param_long->value.get());
-              long lvalue = param_long->min;
-              do {
-                  v.lvalues.push_back(lvalue);
-                  lvalue = lvalue + param_long->step;
-              } while (lvalue < param_long->max);
-              v.set_init();
+              if (!__expand_range(param->get_name(), param_long->min,
+                  param_long->max, param_long->step, v.lvalues)) {
+                  return APEX_ERROR;
+              }
+              __set_init(v, param, request.warm_start);
               tuning_session->sa_session.add_var(param_name, std::move(v));
           }
           break;
@@ -1478,12 +1834,11 @@ inline int __sa_setup(shared_ptr<apex_tuning_session>
               auto param_double =
               std::static_pointer_cast<apex_param_double>(param);
               Variable v(VariableType::doubletype, param_double->value.get());
-              double dvalue = param_double->min;
-              do {
-                  v.dvalues.push_back(dvalue);
-                  dvalue = dvalue + param_double->step;
-              } while (dvalue < param_double->max);
-              v.set_init();
+              if (!__expand_range(param->get_name(), param_double->min,
+                  param_double->max, param_double->step, v.dvalues)) {
+                  return APEX_ERROR;
+              }
+              __set_init(v, param, request.warm_start);
               tuning_session->sa_session.add_var(param_name, std::move(v));
           }
           break;
@@ -1495,7 +1850,7 @@ inline int __sa_setup(shared_ptr<apex_tuning_session>
                              param_enum->possible_values) {
                   v.svalues.push_back(possible_value);
               }
-              v.set_init();
+              __set_init(v, param, request.warm_start);
               tuning_session->sa_session.add_var(param_name, std::move(v));
           }
           break;
@@ -1526,11 +1881,10 @@ inline int __exhaustive_setup(shared_ptr<apex_tuning_session>
               auto param_long =
               std::static_pointer_cast<apex_param_long>(param);
               Variable v(VariableType::longtype, param_long->value.get());
-              long lvalue = param_long->min;
-              do {
-                  v.lvalues.push_back(lvalue);
-                  lvalue = lvalue + param_long->step;
-              } while (lvalue < param_long->max);
+              if (!__expand_range(param->get_name(), param_long->min,
+                  param_long->max, param_long->step, v.lvalues)) {
+                  return APEX_ERROR;
+              }
               v.set_init();
               tuning_session->exhaustive_session.add_var(param_name, std::move(v));
           }
@@ -1539,11 +1893,10 @@ inline int __exhaustive_setup(shared_ptr<apex_tuning_session>
               auto param_double =
               std::static_pointer_cast<apex_param_double>(param);
               Variable v(VariableType::doubletype, param_double->value.get());
-              double dvalue = param_double->min;
-              do {
-                  v.dvalues.push_back(dvalue);
-                  dvalue = dvalue + param_double->step;
-              } while (dvalue < param_double->max);
+              if (!__expand_range(param->get_name(), param_double->min,
+                  param_double->max, param_double->step, v.dvalues)) {
+                  return APEX_ERROR;
+              }
               v.set_init();
               tuning_session->exhaustive_session.add_var(param_name, std::move(v));
           }
@@ -1587,11 +1940,10 @@ inline int __random_setup(shared_ptr<apex_tuning_session>
               auto param_long =
               std::static_pointer_cast<apex_param_long>(param);
               Variable v(VariableType::longtype, param_long->value.get());
-              long lvalue = param_long->min;
-              do {
-                  v.lvalues.push_back(lvalue);
-                  lvalue = lvalue + param_long->step;
-              } while (lvalue < param_long->max);
+              if (!__expand_range(param->get_name(), param_long->min,
+                  param_long->max, param_long->step, v.lvalues)) {
+                  return APEX_ERROR;
+              }
               v.set_init();
               tuning_session->random_session.add_var(param_name, std::move(v));
           }
@@ -1600,11 +1952,10 @@ inline int __random_setup(shared_ptr<apex_tuning_session>
               auto param_double =
               std::static_pointer_cast<apex_param_double>(param);
               Variable v(VariableType::doubletype, param_double->value.get());
-              double dvalue = param_double->min;
-              do {
-                  v.dvalues.push_back(dvalue);
-                  dvalue = dvalue + param_double->step;
-              } while (dvalue < param_double->max);
+              if (!__expand_range(param->get_name(), param_double->min,
+                  param_double->max, param_double->step, v.dvalues)) {
+                  return APEX_ERROR;
+              }
               v.set_init();
               tuning_session->random_session.add_var(param_name, std::move(v));
           }
@@ -1634,6 +1985,221 @@ inline int __random_setup(shared_ptr<apex_tuning_session>
   return APEX_NOERROR;
 }
 
+inline int __nelder_mead_setup(shared_ptr<apex_tuning_session>
+    tuning_session, apex_tuning_request & request) {
+  APEX_UNUSED(tuning_session);
+  // set up the Nelder Mead search!
+  // iterate over the parameters, and create variables.
+  using namespace apex::nelder_mead;
+  for(auto & kv : request.params) {
+      auto & param = kv.second;
+      const char * param_name = param->get_name().c_str();
+      switch(param->get_type()) {
+          case apex_param_type::LONG: {
+              auto param_long =
+              std::static_pointer_cast<apex_param_long>(param);
+              Variable v(VariableType::longtype, param_long->value.get());
+              if (!__expand_range(param->get_name(), param_long->min,
+                  param_long->max, param_long->step, v.lvalues)) {
+                  return APEX_ERROR;
+              }
+              __set_init(v, param, request.warm_start);
+              tuning_session->nm_session.add_var(param_name, std::move(v));
+          }
+          break;
+          case apex_param_type::DOUBLE: {
+              auto param_double =
+              std::static_pointer_cast<apex_param_double>(param);
+              Variable v(VariableType::doubletype, param_double->value.get());
+              if (!__expand_range(param->get_name(), param_double->min,
+                  param_double->max, param_double->step, v.dvalues)) {
+                  return APEX_ERROR;
+              }
+              __set_init(v, param, request.warm_start);
+              tuning_session->nm_session.add_var(param_name, std::move(v));
+          }
+          break;
+          case apex_param_type::ENUM: {
+              auto param_enum =
+              std::static_pointer_cast<apex_param_enum>(param);
+              Variable v(VariableType::stringtype, param_enum->value.get());
+              for(const std::string & possible_value :
+                             param_enum->possible_values) {
+                  v.svalues.push_back(possible_value);
+              }
+              __set_init(v, param, request.warm_start);
+              tuning_session->nm_session.add_var(param_name, std::move(v));
+          }
+          break;
+          default:
+              cerr <<
+              "ERROR: Attempted to register tuning parameter with unknown type."
+              << endl;
+              return APEX_ERROR;
+      }
+  }
+  tuning_session->nm_session.set_radius(request.radius);
+  /* request initial settings */
+  tuning_session->nm_session.getNewSettings();
+
+  return APEX_NOERROR;
+}
+
+inline int __parallel_rank_order_setup(shared_ptr<apex_tuning_session>
+    tuning_session, apex_tuning_request & request) {
+  APEX_UNUSED(tuning_session);
+  // set up the Parallel Rank Order search!
+  // iterate over the parameters, and create variables.
+  using namespace apex::parallel_rank_order;
+  for(auto & kv : request.params) {
+      auto & param = kv.second;
+      const char * param_name = param->get_name().c_str();
+      switch(param->get_type()) {
+          case apex_param_type::LONG: {
+              auto param_long =
+              std::static_pointer_cast<apex_param_long>(param);
+              Variable v(VariableType::longtype, param_long->value.get());
+              if (!__expand_range(param->get_name(), param_long->min,
+                  param_long->max, param_long->step, v.lvalues)) {
+                  return APEX_ERROR;
+              }
+              __set_init(v, param, request.warm_start);
+              tuning_session->pro_session.add_var(param_name, std::move(v));
+          }
+          break;
+          case apex_param_type::DOUBLE: {
+              auto param_double =
+              std::static_pointer_cast<apex_param_double>(param);
+              Variable v(VariableType::doubletype, param_double->value.get());
+              if (!__expand_range(param->get_name(), param_double->min,
+                  param_double->max, param_double->step, v.dvalues)) {
+                  return APEX_ERROR;
+              }
+              __set_init(v, param, request.warm_start);
+              tuning_session->pro_session.add_var(param_name, std::move(v));
+          }
+          break;
+          case apex_param_type::ENUM: {
+              auto param_enum =
+              std::static_pointer_cast<apex_param_enum>(param);
+              Variable v(VariableType::stringtype, param_enum->value.get());
+              for(const std::string & possible_value :
+                             param_enum->possible_values) {
+                  v.svalues.push_back(possible_value);
+              }
+              __set_init(v, param, request.warm_start);
+              tuning_session->pro_session.add_var(param_name, std::move(v));
+          }
+          break;
+          default:
+              cerr <<
+              "ERROR: Attempted to register tuning parameter with unknown type."
+              << endl;
+              return APEX_ERROR;
+      }
+  }
+  tuning_session->pro_session.set_radius(request.radius);
+  /* request initial settings */
+  tuning_session->pro_session.getNewSettings();
+
+  return APEX_NOERROR;
+}
+
+inline int __bayesian_optimization_setup(shared_ptr<apex_tuning_session>
+    tuning_session, apex_tuning_request & request) {
+  APEX_UNUSED(tuning_session);
+  // set up the Bayesian optimization!
+  // iterate over the parameters, and create variables.
+  using namespace apex::bayesian_optimization;
+  for(auto & kv : request.params) {
+      auto & param = kv.second;
+      const char * param_name = param->get_name().c_str();
+      switch(param->get_type()) {
+          case apex_param_type::LONG: {
+              auto param_long =
+              std::static_pointer_cast<apex_param_long>(param);
+              Variable v(VariableType::longtype, param_long->value.get());
+              if (!__expand_range(param->get_name(), param_long->min,
+                  param_long->max, param_long->step, v.lvalues)) {
+                  return APEX_ERROR;
+              }
+              __set_init(v, param, request.warm_start);
+              tuning_session->bo_session.add_var(param_name, std::move(v));
+          }
+          break;
+          case apex_param_type::DOUBLE: {
+              auto param_double =
+              std::static_pointer_cast<apex_param_double>(param);
+              Variable v(VariableType::doubletype, param_double->value.get());
+              if (!__expand_range(param->get_name(), param_double->min,
+                  param_double->max, param_double->step, v.dvalues)) {
+                  return APEX_ERROR;
+              }
+              __set_init(v, param, request.warm_start);
+              tuning_session->bo_session.add_var(param_name, std::move(v));
+          }
+          break;
+          case apex_param_type::ENUM: {
+              auto param_enum =
+              std::static_pointer_cast<apex_param_enum>(param);
+              Variable v(VariableType::stringtype, param_enum->value.get());
+              for(const std::string & possible_value :
+                             param_enum->possible_values) {
+                  v.svalues.push_back(possible_value);
+              }
+              __set_init(v, param, request.warm_start);
+              tuning_session->bo_session.add_var(param_name, std::move(v));
+          }
+          break;
+          default:
+              cerr <<
+              "ERROR: Attempted to register tuning parameter with unknown type."
+              << endl;
+              return APEX_ERROR;
+      }
+  }
+  /* request initial settings */
+  tuning_session->bo_session.getNewSettings();
+
+  return APEX_NOERROR;
+}
+
+/* The older interface only has long parameters, and without Active Harmony
+ * they are tuned with the built-in parallel rank order search, like the
+ * "pro.so" strategy we ask Active Harmony for. */
+inline int __parallel_rank_order_setup(shared_ptr<apex_tuning_session>
+    tuning_session, int num_inputs, long ** inputs, long * mins, long * maxs,
+    long * steps) {
+  using namespace apex::parallel_rank_order;
+  char tmpstr[32] = {0};
+  for (int i = 0 ; i < num_inputs ; i++ ) {
+      snprintf (tmpstr, 32, "param_%d", i);
+      if (steps[i] <= 0) {
+          cerr << "ERROR: Attempted to register tuning parameter with step "
+          << steps[i] << ", the step has to be positive." << endl;
+          return APEX_ERROR;
+      }
+      Variable v(VariableType::longtype, inputs[i]);
+      // Active Harmony includes the maximum
+      for (long lvalue = mins[i] ; lvalue <= maxs[i] ; lvalue += steps[i]) {
+          v.lvalues.push_back(lvalue);
+          // don't overflow past a maximum near LONG_MAX
+          if (lvalue > maxs[i] - steps[i]) { break; }
+      }
+      if (v.lvalues.empty()) {
+          cerr << "ERROR: Attempted to register tuning parameter with no values."
+          << endl;
+          return APEX_ERROR;
+      }
+      v.set_init();
+      tuning_session->pro_session.add_var(tmpstr, std::move(v));
+  }
+  /* request initial settings */
+  tuning_session->pro_session.getNewSettings();
+
+  return APEX_NOERROR;
+}
+
 inline int __common_setup_timer_throttling(apex_optimization_criteria_t
     criteria, apex_optimization_method_t method, unsigned long update_interval)
 {
@@ -1699,6 +2265,7 @@ inline int __common_setup_custom_tuning(shared_ptr<apex_tuning_session>
     long ** inputs, long * mins, long * maxs, long * steps)
 {
     __read_common_variables(tuning_session);
+#ifdef APEX_HAVE_ACTIVEHARMONY
     int status = __active_harmony_custom_setup(tuning_session, num_inputs,
         inputs, mins, maxs, steps);
     if(status == APEX_NOERROR) {
@@ -1709,13 +2276,56 @@ inline int __common_setup_custom_tuning(shared_ptr<apex_tuning_session>
           }
         );
     }
+#else
+    int status = __parallel_rank_order_setup(tuning_session, num_inputs,
+        inputs, mins, maxs, steps);
+    if(status == APEX_NOERROR) {
+        apex::register_policy(
+          event_type,
+          [=](apex_context const & context)->int {
+            return apex_parallel_rank_order_policy(tuning_session, context);
+          }
+        );
+    }
+#endif
     return status;
 }
 
+/* The ranks match up the sessions by name.  Active Harmony runs its own
+ * searches, so those sessions don't take part. */
+inline void __cooperative_setup(shared_ptr<apex_tuning_session>
+    tuning_session, apex_ah_tuning_strategy strategy, const string & name) {
+    int rank = apex::cooperative_tuning::rank();
+    int size = apex::cooperative_tuning::size();
+    switch (strategy) {
+        case apex_ah_tuning_strategy::APEX_NELDER_MEAD:
+            tuning_session->nm_session.set_cooperative(rank, size);
+            break;
+        case apex_ah_tuning_strategy::APEX_PARALLEL_RANK_ORDER:
+            tuning_session->pro_session.set_cooperative(rank, size);
+            break;
+        case apex_ah_tuning_strategy::APEX_BAYESIAN_OPTIMIZATION:
+            tuning_session->bo_session.set_cooperative(rank, size);
+            break;
+        case apex_ah_tuning_strategy::SIMULATED_ANNEALING:
+        case apex_ah_tuning_strategy::APEX_EXHAUSTIVE:
+        case apex_ah_tuning_strategy::APEX_RANDOM:
+            break;
+        default:
+            return;
+    }
+    tuning_session->cooperative = true;
+    tuning_session->cooperative_name = name;
+}
+
 inline int __common_setup_custom_tuning(shared_ptr<apex_tuning_session>
     tuning_session, apex_tuning_request & request) {
     __read_common_variables(tuning_session);
     int status = APEX_NOERROR;
+    request.strategy = native_strategy(request.strategy);
+    if (apex::cooperative_tuning::enabled()) {
+        __cooperative_setup(tuning_session, request.strategy, request.name);
+    }
     // if using the simulated annealing strategy, don't use AH!
     if (request.strategy == apex_ah_tuning_strategy::SIMULATED_ANNEALING) {
         status = __sa_setup(tuning_session, request);
@@ -1747,6 +2357,38 @@ inline int __common_setup_custom_tuning(shared_ptr<apex_tuning_session>
             }
             );
         }
+    } else if (request.strategy == apex_ah_tuning_strategy::APEX_NELDER_MEAD) {
+        status = __nelder_mead_setup(tuning_session, request);
+        if(status == APEX_NOERROR) {
+            apex::register_policy(
+            request.trigger,
+            [=](apex_context const & context)->int {
+                return apex_nelder_mead_policy(tuning_session, context);
+            }
+            );
+        }
+    } else if (request.strategy ==
+        apex_ah_tuning_strategy::APEX_PARALLEL_RANK_ORDER) {
+        status = __parallel_rank_order_setup(tuning_session, request);
+        if(status == APEX_NOERROR) {
+            apex::register_policy(
+            request.trigger,
+            [=](apex_context const & context)->int {
+                return apex_parallel_rank_order_policy(tuning_session, context);
+            }
+            );
+        }
+    } else if (request.strategy ==
+        apex_ah_tuning_strategy::APEX_BAYESIAN_OPTIMIZATION) {
+        status = __bayesian_optimization_setup(tuning_session, request);
+        if(status == APEX_NOERROR) {
+            apex::register_policy(
+            request.trigger,
+            [=](apex_context const & context)->int {
+                return apex_bayesian_optimization_policy(tuning_session, context);
+            }
+            );
+        }
     } else {
         int status = __active_harmony_custom_setup(tuning_session, request);
         if(status == APEX_NOERROR) {
@@ -1758,6 +2400,40 @@ inline int __common_setup_custom_tuning(shared_ptr<apex_tuning_session>
             );
         }
     }
+    if (tuning_session->cooperative) {
+        apex_ah_tuning_strategy strategy = request.strategy;
+        apex::cooperative_tuning::subscribe(request.name,
+            [=](const apex::cooperative_tuning::record & r) {
+            switch (strategy) {
+                case apex_ah_tuning_strategy::SIMULATED_ANNEALING:
+                    __cooperative_deliver(tuning_session,
+                        tuning_session->sa_session, r);
+                    break;
+                case apex_ah_tuning_strategy::APEX_EXHAUSTIVE:
+                    __cooperative_deliver(tuning_session,
+                        tuning_session->exhaustive_session, r);
+                    break;
+                case apex_ah_tuning_strategy::APEX_RANDOM:
+                    __cooperative_deliver(tuning_session,
+                        tuning_session->random_session, r);
+                    break;
+                case apex_ah_tuning_strategy::APEX_NELDER_MEAD:
+                    __cooperative_deliver(tuning_session,
+                        tuning_session->nm_session, r);
+                    break;
+                case apex_ah_tuning_strategy::APEX_PARALLEL_RANK_ORDER:
+                    __cooperative_deliver(tuning_session,
+                        tuning_session->pro_session, r);
+                    break;
+                case apex_ah_tuning_strategy::APEX_BAYESIAN_OPTIMIZATION:
+                    __cooperative_deliver(tuning_session,
+                        tuning_session->bo_session, r);
+                    break;
+                default:
+                    break;
+            }
+        });
+    }
     return status;
 }
 
@@ -31,12 +31,22 @@
 #include "simulated_annealing.hpp"
 // include the exhaustive class
 #include "exhaustive.hpp"
+// include the nelder mead and parallel rank order classes
+#include "nelder_mead.hpp"
+#include "parallel_rank_order.hpp"
+// include the bayesian optimization class
+#include "bayesian_optimization.hpp"
 // include the random class
 #include "random.hpp"
+// include the cooperative tuning between MPI ranks
+#include "cooperative_tuning.hpp"
+// include the detector for changes after tuning converges
+#include "drift_detector.hpp"
 
 enum class apex_param_type : int {NONE, LONG, DOUBLE, ENUM};
 enum class apex_ah_tuning_strategy : int {EXHAUSTIVE, RANDOM, NELDER_MEAD,
-PARALLEL_RANK_ORDER, SIMULATED_ANNEALING, APEX_EXHAUSTIVE, APEX_RANDOM};
+PARALLEL_RANK_ORDER, SIMULATED_ANNEALING, APEX_EXHAUSTIVE, APEX_RANDOM,
+APEX_NELDER_MEAD, APEX_PARALLEL_RANK_ORDER, APEX_BAYESIAN_OPTIMIZATION};
 
 struct apex_tuning_session;
 class apex_tuning_request;
@@ -75,6 +85,12 @@ class apex_param {
             tuning_session, apex_tuning_request & request);
         friend int __random_setup(std::shared_ptr<apex_tuning_session>
             tuning_session, apex_tuning_request & request);
+        friend int __nelder_mead_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
+        friend int __parallel_rank_order_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
+        friend int __bayesian_optimization_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
 };
 
 class apex_param_long : public apex_param {
@@ -112,6 +128,12 @@ class apex_param_long : public apex_param {
             tuning_session, apex_tuning_request & request);
         friend int __random_setup(std::shared_ptr<apex_tuning_session>
             tuning_session, apex_tuning_request & request);
+        friend int __nelder_mead_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
+        friend int __parallel_rank_order_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
+        friend int __bayesian_optimization_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
 };
 
 class apex_param_double : public apex_param {
@@ -149,6 +171,12 @@ class apex_param_double : public apex_param {
             tuning_session, apex_tuning_request & request);
         friend int __random_setup(std::shared_ptr<apex_tuning_session>
             tuning_session, apex_tuning_request & request);
+        friend int __nelder_mead_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
+        friend int __parallel_rank_order_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
+        friend int __bayesian_optimization_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
 };
 
 class apex_param_enum : public apex_param {
@@ -185,6 +213,12 @@ class apex_param_enum : public apex_param {
             tuning_session, apex_tuning_request & request);
         friend int __random_setup(std::shared_ptr<apex_tuning_session>
             tuning_session, apex_tuning_request & request);
+        friend int __nelder_mead_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
+        friend int __parallel_rank_order_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
+        friend int __bayesian_optimization_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
 };
 
 
@@ -200,6 +234,7 @@ class apex_tuning_request {
         double radius;
         int aggregation_times;
         std::string aggregation_function;
+        bool warm_start;
 
     public:
         apex_tuning_request(const std::string & name, std::function<double()>
@@ -207,13 +242,15 @@ class apex_tuning_request {
             : name{name}, metric{metric}, trigger{trigger},
             tuning_session_handle{0},
             running{false},
-            strategy{apex_ah_tuning_strategy::PARALLEL_RANK_ORDER}  {};
+            strategy{apex_ah_tuning_strategy::PARALLEL_RANK_ORDER},
+            radius(0.5), aggregation_times(3), aggregation_function("min"),
+            warm_start(false) {};
         apex_tuning_request(const std::string & name) : name{name},
         trigger{APEX_INVALID_EVENT},
             tuning_session_handle{0}, running{false},
             strategy{apex_ah_tuning_strategy::PARALLEL_RANK_ORDER},
-            radius(0.5), aggregation_times(3), aggregation_function("min")
-            {};
+            radius(0.5), aggregation_times(3), aggregation_function("min"),
+            warm_start(false) {};
         virtual ~apex_tuning_request()  {};
 
         const std::string & get_name() const {
@@ -303,6 +340,14 @@ class apex_tuning_request {
             radius = r;
         };
 
+        /* Start the search from the initial values of the parameters
+         * (say, the result for a similar problem) instead of the middle
+         * of the space.  The built-in simulated annealing, Nelder-Mead,
+         * parallel rank order and Bayesian searches use it. */
+        void set_warm_start(bool w) {
+            warm_start = w;
+        };
+
         void set_aggregation_times(size_t t) {
             aggregation_times = t;
         };
@@ -325,6 +370,12 @@ class apex_tuning_request {
             tuning_session, apex_tuning_request & request);
         friend int __random_setup(std::shared_ptr<apex_tuning_session>
             tuning_session, apex_tuning_request & request);
+        friend int __nelder_mead_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
+        friend int __parallel_rank_order_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
+        friend int __bayesian_optimization_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
 };
 
 
@@ -351,8 +402,23 @@ struct apex_tuning_session {
     apex::exhaustive::Exhaustive exhaustive_session;
     // if using exhaustive, this is the request.
     apex::random::Random random_session;
+    // if using nelder mead, this is the request.
+    apex::nelder_mead::NelderMead nm_session;
+    // if using parallel rank order, this is the request.
+    apex::parallel_rank_order::ParallelRankOrder pro_session;
+    // if using bayesian optimization, this is the request.
+    apex::bayesian_optimization::BayesianOptimization bo_session;
     bool converged_message = false;
 
+    // variables related to cooperative tuning between MPI ranks
+    bool cooperative = false;
+    std::string cooperative_name = "";
+    bool final_posted = false; // rank 0 has sent its best settings
+    bool adopted = false;      // and this rank has switched to them
+
+    // watches the cost of the best settings, after the search converges
+    apex::drift_detector drift;
+
     // variables related to power throttling
     double max_watts = APEX_HIGH_POWER_LIMIT;
     double min_watts = APEX_LOW_POWER_LIMIT;
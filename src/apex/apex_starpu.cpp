@@ -2,9 +2,11 @@
 #include <assert.h>
 #include <inttypes.h>
 #include "apex.hpp"
+#include "handle_cache.hpp"
 #include <starpu_profiling_tool.h>
 #include <mutex>
 #include <stack>
+#include <vector>
 
 void starpu_perf_counter_collection_start( void );
 void starpu_perf_counter_collection_stop( void );
@@ -24,6 +26,120 @@ static int id_w_cumul_execution_time;
 std::map<int,std::string> device_types;
 std::map<int,std::string> event_types;
 
+/* What the timer name of a StarPU event depends on.  The fields that
+ * don't go into the name are zero, so each name is interned once. */
+struct event_key {
+    int event;
+    int driver;
+    const void * function; // the codelet function, for exec events
+    int memnode;           // for transfer events
+    bool operator==(const event_key& rhs) const {
+        return event == rhs.event && driver == rhs.driver &&
+            function == rhs.function && memnode == rhs.memnode;
+    }
+};
+
+struct event_key_hash {
+    size_t operator()(const event_key& k) const {
+        std::hash<const void*> h;
+        std::hash<int> i;
+        return h(k.function) ^ (i(k.event) << 1) ^ (i(k.driver) << 2) ^
+            (i(k.memnode) << 3);
+    }
+};
+
+static std::string find_name(const std::map<int,std::string>& names, int key) {
+    auto found = names.find(key);
+    return found == names.end() ? std::string() : found->second;
+}
+
+static event_key make_key(struct starpu_prof_tool_info* prof_info) {
+    event_key k{(int)(prof_info->event_type), 0, nullptr, 0};
+    switch (prof_info->event_type) {
+        case starpu_prof_tool_event_driver_init_start:
+            k.driver = (int)(prof_info->driver_type);
+            break;
+        case starpu_prof_tool_event_start_cpu_exec:
+        case starpu_prof_tool_event_start_gpu_exec:
+            k.driver = (int)(prof_info->driver_type);
+            k.function = (const void*)(prof_info->fun_ptr);
+            break;
+        case starpu_prof_tool_event_start_transfer:
+            k.memnode = (int)(prof_info->memnode);
+            break;
+        default:
+            break;
+    }
+    return k;
+}
+
+/* Only called the first time an event with this key starts */
+static std::string make_name(const event_key& k) {
+    std::stringstream ss;
+    ss << find_name(event_types, k.event);
+    switch (k.event) {
+        case starpu_prof_tool_event_driver_init_start:
+            ss << ": " << find_name(device_types, k.driver);
+            break;
+        case starpu_prof_tool_event_start_cpu_exec:
+        case starpu_prof_tool_event_start_gpu_exec:
+            ss << ": " << find_name(device_types, k.driver);
+            ss << " : UNRESOLVED ADDR " << std::hex << k.function;
+            break;
+        case starpu_prof_tool_event_start_transfer:
+            ss << "[{ memnode " << k.memnode << " }]";
+            break;
+        default:
+            break;
+    }
+    return ss.str();
+}
+
+static apex::handle_cache<event_key, event_key_hash> event_timers(make_name);
+
+/* Start the timer for this event, on this thread's stack */
+static void start_event(struct starpu_prof_tool_info* prof_info,
+    std::stack<std::shared_ptr<apex::task_wrapper> >& my_stack) {
+    const apex::interned_timer * timer = event_timers.get(make_key(prof_info));
+    std::shared_ptr<apex::task_wrapper> t{nullptr};
+    if (!timer->excluded) {
+        t = apex::new_task(timer->id, UINTMAX_MAX, apex::null_task_wrapper);
+        if (t != nullptr) { apex::start(t); }
+    }
+    // excluded timers are still pushed, to match their stop
+    my_stack.push(t);
+}
+
+static bool stop_event(std::stack<std::shared_ptr<apex::task_wrapper> >& my_stack) {
+    if (my_stack.size() == 0) { return false; }
+    auto t = my_stack.top();
+    if (t != nullptr) { apex::stop(t); }
+    my_stack.pop();
+    return true;
+}
+
+/* StarPU counters are sampled with these names, so they are made once */
+static const std::string g_total_submitted_name{
+    "Total submitted tasks (g_total_submitted)"};
+static const std::string g_peak_submitted_name{
+    "Peak number of tasks submitted (g_peak_submitted)"};
+static const std::string g_peak_ready_name{
+    "Peak number of ready tasks (g_peak_ready)"};
+
+static std::string worker_counter_name(const std::string& counter, int workerid) {
+    std::stringstream ss;
+    ss << counter << " : Worker " << std::setfill('0') << std::setw(3) << workerid;
+    return ss.str();
+}
+
+static const std::string w_total_executed_name{" w_total_executed"};
+static const std::string w_cumul_execution_time_name{
+    " w_cumul_execution_time (us)"};
+
+/* The per worker counter names, made for every worker in init_counters */
+static std::vector<std::string> w_total_executed_names;
+static std::vector<std::string> w_cumul_execution_time_names;
+
 extern "C" {
 
     /* Functions plugged into the scheduler's callbacks
@@ -39,20 +155,9 @@ extern "C" {
         int64_t g_peak_ready = starpu_perf_counter_sample_get_int64_value(sample, id_g_peak_ready);
         //   printf("global: g_total_submitted = %"PRId64", g_peak_submitted = %"PRId64", g_peak_ready = %"PRId64"\n", g_total_submitted, g_peak_submitted, g_peak_ready);
 
-        std::stringstream ss1;
-        ss1 << "Total submitted tasks (g_total_submitted)";
-        std::string tmp1{ss1.str()};
-        apex::sample_value( tmp1, g_total_submitted );
-
-        std::stringstream ss2;
-        ss2 << "Peak number of tasks submitted (g_peak_submitted)";
-        std::string tmp2{ss2.str()};
-        apex::sample_value( tmp2, g_peak_submitted );
-
-        std::stringstream ss3;
-        ss3 << "Peak number of ready tasks (g_peak_ready)";
-        std::string tmp3{ss3.str()};
-        apex::sample_value( tmp3, g_peak_ready );
+        apex::sample_value( g_total_submitted_name, g_total_submitted );
+        apex::sample_value( g_peak_submitted_name, g_peak_submitted );
+        apex::sample_value( g_peak_ready_name, g_peak_ready );
     }
 
     void w_listener_cb(struct starpu_perf_counter_listener *listener, struct starpu_perf_counter_sample *sample, void *context) {
@@ -64,15 +169,16 @@ extern "C" {
 
         //  printf("worker[%d]: w_total_executed = %"PRId64", w_cumul_execution_time = %lf\n", workerid, w_total_executed, w_cumul_execution_time);
 
-        std::stringstream ss1;
-        ss1 << " w_total_executed : Worker " << std::setfill('0') << std::setw(3) << workerid;
-        std::string tmp1{ss1.str()};
-        apex::sample_value( tmp1, w_total_executed );
-
-        std::stringstream ss2;
-        ss2 << " w_cumul_execution_time (us) : Worker " << std::setfill('0') << std::setw(3) << workerid;
-        std::string tmp2{ss2.str()};
-        apex::sample_value( tmp2, w_cumul_execution_time );
+        if (workerid >= 0 && (size_t)(workerid) < w_total_executed_names.size()) {
+            apex::sample_value( w_total_executed_names[workerid], w_total_executed );
+            apex::sample_value( w_cumul_execution_time_names[workerid],
+                w_cumul_execution_time );
+        } else {
+            apex::sample_value( worker_counter_name(w_total_executed_name,
+                workerid), w_total_executed );
+            apex::sample_value( worker_counter_name(w_cumul_execution_time_name,
+                workerid), w_cumul_execution_time );
+        }
     }
 
     const enum starpu_perf_counter_scope g_scope = starpu_perf_counter_scope_global;
@@ -133,6 +239,15 @@ extern "C" {
         starpu_perf_counter_set_enable_id(w_set, id_w_total_executed);
         starpu_perf_counter_set_enable_id(w_set, id_w_cumul_execution_time);
 
+        /* before the listeners start, so the callbacks only read them */
+        unsigned workers = starpu_worker_get_count();
+        for (unsigned i = 0 ; i < workers ; i++) {
+            w_total_executed_names.push_back(
+                worker_counter_name(w_total_executed_name, (int)(i)));
+            w_cumul_execution_time_names.push_back(
+                worker_counter_name(w_cumul_execution_time_name, (int)(i)));
+        }
+
         g_listener = starpu_perf_counter_listener_init(g_set, g_listener_cb, (void *)(uintptr_t)42);
         w_listener = starpu_perf_counter_listener_init(w_set, w_listener_cb, (void *)(uintptr_t)17);
 
@@ -175,10 +290,6 @@ extern "C" {
         union starpu_prof_tool_event_info* event_info,
         struct starpu_prof_tool_api_info* api_info ) {
 
-    std::string event_name {event_types[prof_info->event_type]};
-    std::string device_name {device_types[prof_info->driver_type]};
-    std::stringstream info;
-
     bool enter = true;
     switch(  prof_info->event_type ) {
     case starpu_prof_tool_event_init:
@@ -207,8 +318,6 @@ extern "C" {
         enter = false;
         break;
     case starpu_prof_tool_event_driver_init_start:
-        info << ": " << device_name.c_str(); // << ":" << prof_info->device_number  << "}]";
-        event_name = event_name + info.str();
         break;
     default:
         std::cout <<  "Unknown callback " <<  prof_info->event_type << std::endl;
@@ -217,19 +326,11 @@ extern "C" {
 
     static thread_local std::stack<std::shared_ptr<apex::task_wrapper> > my_stack;
     if (enter) {
-        auto t = apex::new_task(event_name);
-        apex::start(t);
-        my_stack.push(t);
-    } else {
-        if (my_stack.size() == 0) {
-            std::cerr << "APEX Timer stack is empty, bug in StarPU support! "
-                << event_name
-                << std::endl;
-            return;
-        }
-        auto t = my_stack.top();
-        apex::stop(t);
-        my_stack.pop();
+        start_event(prof_info, my_stack);
+    } else if (!stop_event(my_stack)) {
+        std::cerr << "APEX Timer stack is empty, bug in StarPU support! "
+            << find_name(event_types, prof_info->event_type)
+            << std::endl;
     }
     }
 
@@ -237,20 +338,14 @@ extern "C" {
         union starpu_prof_tool_event_info* event_info,
         struct starpu_prof_tool_api_info* api_info ) {
 
-    std::string event_name {event_types[prof_info->event_type]};
-    std::string device_name {device_types[prof_info->driver_type]};
-    std::stringstream info;
-
     bool enter = true;
     switch(  prof_info->event_type ) {
         case starpu_prof_tool_event_end_cpu_exec:
         case starpu_prof_tool_event_end_gpu_exec:
+            enter = false;
             break;
         case starpu_prof_tool_event_start_cpu_exec:
         case starpu_prof_tool_event_start_gpu_exec:
-            info << ": " << device_name.c_str(); // << ":" << prof_info->device_number  << "}]";
-            info << " : UNRESOLVED ADDR " << std::hex << prof_info->fun_ptr;
-            event_name = event_name + info.str();
             break;
         default:
             std::cout <<  "Unknown callback " <<  prof_info->event_type << std::endl;
@@ -259,19 +354,11 @@ extern "C" {
 
     static thread_local std::stack<std::shared_ptr<apex::task_wrapper> > my_stack;
     if (enter) {
-        auto t = apex::new_task(event_name);
-        apex::start(t);
-        my_stack.push(t);
-    } else {
-        if (my_stack.size() == 0) {
-            std::cerr << "APEX Timer stack is empty, bug in StarPU support! "
-                << event_name
-                << std::endl;
-            return;
-        }
-        auto t = my_stack.top();
-        apex::stop(t);
-        my_stack.pop();
+        start_event(prof_info, my_stack);
+    } else if (!stop_event(my_stack)) {
+        std::cerr << "APEX Timer stack is empty, bug in StarPU support! "
+            << find_name(event_types, prof_info->event_type)
+            << std::endl;
     }
     }
 
@@ -279,29 +366,16 @@ extern "C" {
         union starpu_prof_tool_event_info* event_info,
         struct starpu_prof_tool_api_info* api_info ) {
 
-        std::string event_name {event_types[prof_info->event_type]};
-        std::string device_name {device_types[prof_info->driver_type]};
-        std::stringstream info;
-
-        info << "[{ memnode " << prof_info->memnode << " }]";
-        event_name = event_name + info.str();
         static thread_local std::stack<std::shared_ptr<apex::task_wrapper> > my_stack;
         if (prof_info->event_type == starpu_prof_tool_event_end_transfer) {
-            if (my_stack.size() == 0) {
+            if (!stop_event(my_stack)) {
                 static std::mutex mtx;
                 std::unique_lock<std::mutex> l(mtx);
-                DEBUG_PRINT("APEX Timer stack is empty, bug in StarPU support! %s, %s\n",
-                event_name.c_str(), device_name.c_str());
-                return;
+                DEBUG_PRINT("APEX Timer stack is empty, bug in StarPU support! %s\n",
+                find_name(event_types, prof_info->event_type).c_str());
             }
-            auto t = my_stack.top();
-            apex::stop(t);
-            my_stack.pop();
         } else {
-            DEBUG_PRINT("Transfer start %s %s\n", event_name.c_str(), device_name.c_str());
-            auto t = apex::new_task(event_name);
-            apex::start(t);
-            my_stack.push(t);
+            start_event(prof_info, my_stack);
         }
     }
 
@@ -313,7 +387,7 @@ extern "C" {
 
 void starpu_prof_tool_library_register(starpu_prof_tool_entry_register_func reg,
     starpu_prof_tool_entry_register_func unreg) {
-    enum  starpu_prof_tool_command info; // = starpu_prof_tool_command_reg;
+    enum  starpu_prof_tool_command info = starpu_prof_tool_command_reg;
     /* This one must be called at the *beginning* of the initialization
        Otherwise the flag might be set too late */
     //reg( starpu_prof_tool_event_init_begin, &enable_counters, info );
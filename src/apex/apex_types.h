@@ -52,7 +52,9 @@ typedef enum _apex_profiler_type {
  */
 typedef enum _error_codes {
   APEX_NOERROR = 0, /*!< No error occurred */
-  APEX_ERROR        /*!< Some error occurred - check stderr output for details */
+  APEX_ERROR,       /*!< Some error occurred - check stderr output for details */
+  APEX_TRACE_CAPTURE /*!< Returned by a policy to write the recent trace events
+                          (see APEX_TRACE_EVENT_FLIGHT_RECORDER) */
 } apex_error_code;
 
 #define APEX_MAX_EVENTS INT32_MAX /*!< The maximum number of event types.
@@ -176,6 +178,34 @@ typedef struct _context
                        for a custom_event */
 } apex_context;
 
+/** A single buffered event, delivered to batch policies.
+ *
+ */
+typedef struct _event_record
+{
+    apex_event_type event_type; /*!< The type of the event (start, stop,
+                                     yield, resume or sample value) */
+    void * task_id;             /*!< The task identifier of the timer or
+                                     counter, the same value that is passed
+                                     as apex_context.data to synchronous
+                                     policies */
+    uint64_t timestamp;         /*!< When the event happened, in nanoseconds */
+    double value;               /*!< The elapsed time (in nanoseconds) for
+                                     stop and yield events, the sampled
+                                     value for sample value events, and
+                                     zero otherwise */
+} apex_event_record;
+
+/** A batch of buffered events, passed to a batch policy as the
+ * apex_context.data member.
+ *
+ */
+typedef struct _event_batch
+{
+    size_t count;                /*!< The number of records */
+    apex_event_record * records; /*!< The records, ordered by timestamp */
+} apex_event_batch;
+
 /** The type of a profiler object
  *
  */
@@ -275,16 +305,31 @@ inline unsigned int sc_nprocessors_onln(void)
     macro (APEX_OTF2, use_otf2, bool, false, "Enable OTF2 trace output.") \
     macro (APEX_OTF2_COLLECTIVE_SIZE, otf2_collective_size, int, 1, "") \
     macro (APEX_TRACE_EVENT, use_trace_event, bool, false, "Enable Google Trace Event output. (deprecated, please use APEX_PERFETTO)") \
+    macro (APEX_TRACE_EVENT_FLIGHT_RECORDER, trace_event_flight_recorder, bool, false, "Keep only the recent Google Trace Event data in per-thread circular buffers, and write it when a trigger fires.") \
+    macro (APEX_TRACE_EVENT_FLIGHT_RECORDER_SECONDS, trace_event_flight_recorder_seconds, int, 10, "The seconds of events written when a flight recorder trigger fires.") \
+    macro (APEX_TRACE_EVENT_FLIGHT_RECORDER_MB, trace_event_flight_recorder_mb, int, 16, "The size of each thread's flight recorder buffer, in megabytes.") \
+    macro (APEX_TRACE_EVENT_TRIGGER_LATENCY_US, trace_event_trigger_latency_us, int, 0, "Fire the flight recorder trigger when a timer takes longer than this many microseconds (0 disables).") \
+    macro (APEX_TRACE_EVENT_TRIGGER_SIGNAL, trace_event_trigger_signal, int, 0, "Fire the flight recorder trigger when the process gets this signal (i.e. 10 for SIGUSR1 on Linux, 0 disables).") \
+    macro (APEX_TRACE_EVENT_MMAP, trace_event_mmap, bool, false, "Write the Google Trace Event data to per-thread memory-mapped files, which can be recovered with apex-trace-recover.py after a crash.") \
+    macro (APEX_TRACE_EVENT_COMPRESSION_THREADS, trace_event_compression_threads, int, 4, "Threads compressing the Google Trace Event output in blocks, or 0 to compress on the flushing thread.") \
+    macro (APEX_TRACE_EVENT_ZSTD, trace_event_zstd, bool, false, "Compress the Google Trace Event output with zstd instead of gzip, if APEX was built with zstd.") \
     macro (APEX_PERFETTO, use_perfetto, bool, false, "Enable Perfetto Trace output.") \
     macro (APEX_POLICY, use_policy, bool, true, "Enable APEX policy listener and execute registered policies.") \
+    macro (APEX_POLICY_BATCH_PERIOD, policy_batch_period, int, 100000, "Default delivery period for batch policies, in microseconds.") \
     macro (APEX_MEASURE_CONCURRENCY, use_concurrency, int, 0, "Periodically sample thread activity and output report at exit.") \
     macro (APEX_MEASURE_CONCURRENCY_MAX_TIMERS, concurrency_max_timers, int, 5, "Maximum number of timers in the concurrency report.") \
     macro (APEX_MEASURE_CONCURRENCY_PERIOD, concurrency_period, int, 1000000, "Thread concurrency sampling period, in microseconds.") \
+    macro (APEX_SAMPLING, use_sampling, bool, false, "Periodically sample the call stack of each thread, and output folded stacks for each timer (Linux only).") \
+    macro (APEX_SAMPLING_PERIOD, sampling_period, int, 10000, "Call stack sampling period, in microseconds of thread CPU time.") \
+    macro (APEX_SAMPLING_DEPTH, sampling_depth, int, 32, "Maximum number of frames in each sampled call stack.") \
     macro (APEX_SCREEN_OUTPUT, use_screen_output, bool, false, "Output APEX performance summary at exit.") \
     macro (APEX_SCREEN_OUTPUT_DETAIL, use_screen_output_detail, bool, false, "Output detailed APEX performance summary at exit.") \
     macro (APEX_VERBOSE, use_verbose, bool, false, "Output APEX options at entry.") \
     macro (APEX_PROFILE_OUTPUT, use_profile_output, int, false, "Output TAU profile of performance summary (profile.* files).") \
     macro (APEX_CSV_OUTPUT, use_csv_output, int, false, "Output CSV profile of performance summary.") \
+    macro (APEX_BINARY_OUTPUT, use_binary_output, bool, false, "Output columnar binary profiles (and task tree, with APEX_TASKTREE_OUTPUT).") \
+    macro (APEX_PROFILE_SNAPSHOTS, use_profile_snapshots, bool, false, "Periodically append the statistics of changed timers and counters to a snapshot file.") \
+    macro (APEX_PROFILE_SNAPSHOT_PERIOD, profile_snapshot_period, int, 1000000, "Profile snapshot period, in microseconds.") \
     macro (APEX_TASKGRAPH_OUTPUT, use_taskgraph_output, bool, false, "Output graphviz reduced taskgraph.") \
     macro (APEX_TASKTREE_OUTPUT, use_tasktree_output, bool, false, "Output CSV task tree (no cycles, unique callpaths).") \
     macro (APEX_HATCHET_OUTPUT, use_hatchet_output, bool, false, "Output json/Hatchet task tree (no cycles, unique callpaths).") \
@@ -325,6 +370,8 @@ inline unsigned int sc_nprocessors_onln(void)
         bool, false, "Disable moderate-frequency, moderate-overhead OMPT events.") \
     macro (APEX_OMPT_HIGH_OVERHEAD_EVENTS, ompt_high_overhead_events, \
         bool, false, "Disable high-frequency, high-overhead OMPT events.") \
+    macro (APEX_OMPT_AGGREGATE_IMPLICIT_TASKS, ompt_aggregate_implicit_tasks, \
+        bool, false, "Time the implicit tasks of each parallel region as one event.") \
     macro (APEX_PIN_APEX_THREADS, pin_apex_threads, bool, true, "Pin APEX asynchronous threads to the last core/PU on the system.") \
     macro (APEX_TRACK_CPU_MEMORY, track_cpu_memory, bool, false, "Track all malloc/free/new/delete calls to CPU memory and report leaks.") \
     macro (APEX_TRACK_GPU_MEMORY, track_gpu_memory, bool, false, "Track all malloc/free/new/delete calls to GPU memory and report leaks.") \
@@ -356,6 +403,12 @@ inline unsigned int sc_nprocessors_onln(void)
     macro (APEX_KOKKOS_TUNING, use_kokkos_tuning, bool, true, "Enable Kokkos autotuning.") \
     macro (APEX_KOKKOS_TUNING_WINDOW, kokkos_tuning_window, int, 5, "Minimum number of tests per candidate while autotuning.") \
     macro (APEX_KOKKOS_PROFILING_FENCES, use_kokkos_profiling_fences, bool, false, "Force Kokkos to fence after all Kokkos kernel launches (recommended, but not required).") \
+    macro (APEX_TUNING_COOPERATIVE, tuning_cooperative, bool, false, "Share autotuning measurements between MPI ranks, and use the settings rank 0 converges on everywhere.") \
+    macro (APEX_TUNING_COOPERATIVE_PERIOD, tuning_cooperative_period, int, 100000, "How often the MPI ranks exchange autotuning measurements, in microseconds.") \
+    macro (APEX_TUNING_DRIFT, tuning_drift, bool, false, "After an autotuning search converges, keep measuring the best settings, and search again near them if their cost changes.") \
+    macro (APEX_TUNING_DRIFT_BUDGET, tuning_drift_budget, int, 50, "Maximum number of evaluations in the new search after drift.") \
+    macro (APEX_GLOBAL_VIEW, global_view, bool, false, "With MPI, periodically reduce the watched timers and counters across the ranks, and give the policies on every rank their minimum, mean and maximum.") \
+    macro (APEX_GLOBAL_VIEW_PERIOD, global_view_period, int, 1000000, "How often the MPI ranks reduce the global view metrics, in microseconds.") \
     macro (APEX_START_DELAY_SECONDS, start_delay_seconds, int, 0, "Delay collection of APEX data for N seconds.") \
     macro (APEX_MAX_DURATION_SECONDS, max_duration_seconds, int, 0, "Collect APEX data for only N seconds.") \
     macro (APEX_USE_SHORT_TASK_NAMES, use_short_task_names, bool, false, "") \
@@ -364,11 +417,16 @@ inline unsigned int sc_nprocessors_onln(void)
 #define FOREACH_APEX_FLOAT_OPTION(macro) \
     macro (APEX_SCATTERPLOT_FRACTION, scatterplot_fraction, double, 0.01, "Fraction of kernel executions to include on scatterplot.") \
     macro (APEX_VALIDATE_MPI_MEMORY_USAGE_FRACTION, validate_mpi_memory_usage_fraction, double, 1.0, "") \
+    macro (APEX_KOKKOS_TUNING_CACHE_DISTANCE, kokkos_tuning_cache_distance, double, 1.0, "How close (in log2 units of the input values) a cached Kokkos tuning context has to be to start the search from its result.") \
+    macro (APEX_TUNING_DRIFT_TOLERANCE, tuning_drift_tolerance, double, 0.1, "Relative change in the cost of the tuned settings that the drift detector ignores.") \
+    macro (APEX_TUNING_DRIFT_THRESHOLD, tuning_drift_threshold, double, 1.0, "Accumulated relative change in the cost of the tuned settings that starts a new search.") \
+    macro (APEX_TUNING_DRIFT_RADIUS, tuning_drift_radius, double, 0.125, "Size of the new search after drift, as a fraction of the space around the best settings.") \
 
 #define FOREACH_APEX_STRING_OPTION(macro) \
     macro (APEX_PAPI_METRICS, papi_metrics, char*, "", "PAPI metrics requested, separated by spaces.") \
     macro (APEX_PAPI_COMPONENTS, papi_components, char*, "", "For periodic monitoring, which PAPI components to include.") \
     macro (APEX_PAPI_COMPONENT_METRICS, papi_component_metrics, char*, "", "For periodic monitoring, which PAPI metrics to include.") \
+    macro (APEX_PERF_EVENT_METRICS, perf_event_metrics, char*, "", "perf_event metrics requested when PAPI is not used, separated by spaces (i.e. cycles instructions cache-misses branch-misses task-clock).") \
     macro (APEX_PLUGINS, plugins, char*, "", "Enable APEX plugins.") \
     macro (APEX_PLUGINS_PATH, plugins_path, char*, "./", "Path to plugin library.") \
     macro (APEX_OUTPUT_FILE_PATH, output_file_path, char*, "./", "Path to where APEX output data should be written.") \
@@ -376,9 +434,14 @@ inline unsigned int sc_nprocessors_onln(void)
         APEX_DEFAULT_OTF2_ARCHIVE_PATH, "OTF2 trace directory.") \
     macro (APEX_OTF2_ARCHIVE_NAME, otf2_archive_name, char*, \
         APEX_DEFAULT_OTF2_ARCHIVE_NAME, "OTF2 trace filename.") \
+    macro (APEX_TRACE_EVENT_TRIGGER_TIMER, trace_event_trigger_timer, char*, "", "Only this timer fires the APEX_TRACE_EVENT_TRIGGER_LATENCY_US trigger (default: any timer).") \
     macro (APEX_EVENT_FILTER_FILE, task_event_filter_file, char*, "", "File containing names of timers to include/exclude during data collection.") \
-    macro (APEX_KOKKOS_TUNING_CACHE, kokkos_tuning_cache, char*, "", "Filename contining Kokkos autotuned results, tuned offline.") \
-    macro (APEX_KOKKOS_TUNING_POLICY, kokkos_tuning_policy, char*, "simulated_annealing", "Kokkos autotuning policy: random, exhaustive, simulated_annealing, nelder_mead.") \
+    macro (APEX_KOKKOS_TUNING_CACHE, kokkos_tuning_cache, char*, "", "Filename containing Kokkos autotuned results (default ./apex_converged_tuning.cache).  Results are merged into it at exit.") \
+    macro (APEX_KOKKOS_TUNING_POLICY, kokkos_tuning_policy, char*, "simulated_annealing", "Kokkos autotuning policy: random, exhaustive, simulated_annealing, nelder_mead, parallel_rank_order, bayesian_optimization.") \
+    macro (APEX_GLOBAL_VIEW_METRICS, global_view_metrics, char*, "", "Timers and counters in the global view, separated by commas.") \
+    macro (APEX_PROC_SELF_STATUS_FIELDS, proc_self_status_fields, char*, "Vm*,Threads,*ctxt_switches", "Fields to sample from /proc/self/status, as glob patterns separated by commas.") \
+    macro (APEX_PROC_SELF_IO_FIELDS, proc_self_io_fields, char*, "*", "Fields to sample from /proc/self/io, as glob patterns separated by commas.") \
+    macro (APEX_PROC_NET_DEV_FIELDS, proc_net_dev_fields, char*, "*", "Fields to sample from /proc/net/dev, as glob patterns of <device>.<receive|transmit>.<field> separated by commas.") \
     macro (APEX_ROCPROF_METRICS, rocprof_metrics, char*, "", "List of metrics to periodically sample with the Rocprofiler library (see /opt/rocm/rocprofiler/lib/metrics.xml).")
     // macro (APEX_ROCPROF_METRICS, rocprof_metrics, char*, "MemUnitBusy,MemUnitStalled,VALUUtilization,VALUBusy,SALUBusy,L2CacheHit,WriteUnitStalled,ALUStalledByLDS,LDSBankConflict", "")
 
@@ -392,6 +455,12 @@ inline unsigned int sc_nprocessors_onln(void)
 // in particular empty virtual implementations.
 #define APEX_UNUSED(expr) do { (void)(expr); } while (0)
 
+/* Per-timer hardware counters (the papi_metrics of apex_profile) come
+ * from PAPI, or from perf_event_open. */
+#if defined(APEX_HAVE_PAPI) || defined(APEX_HAVE_PERF_EVENT)
+#define APEX_HAVE_HW_COUNTERS 1
+#endif
+
 #if defined(__GNUC__)
 #define __APEX_FUNCTION__ __PRETTY_FUNCTION__
 #else
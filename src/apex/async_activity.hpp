@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "apex.hpp"
+#include "async_thread_node.hpp"
+#include "task_identifier.hpp"
+#include "trace_event_listener.hpp"
+#if defined(APEX_WITH_PERFETTO)
+#include "perfetto_listener.hpp"
+#endif
+#ifdef APEX_HAVE_OTF2
+#include "otf2_listener.hpp"
+#endif
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace apex {
+
+/* Interns the names of asynchronous activities and counters, so that a
+ * name is only built the first time its key is seen.  The key is whatever
+ * the name depends on, e.g. a kernel name pointer that the vendor library
+ * shares between records, or a (kind, device) tuple. */
+template <typename Key>
+class async_name_cache {
+private:
+    std::map<Key, task_identifier*> names;
+    std::mutex names_mutex;
+public:
+    template <typename F>
+    task_identifier * get(const Key& key, F make_name) {
+        std::unique_lock<std::mutex> l(names_mutex);
+        auto it = names.find(key);
+        if (it != names.end()) {
+            return it->second;
+        }
+        task_identifier * id = task_identifier::get_task_id(make_name());
+        names.emplace(key, id);
+        return id;
+    }
+};
+
+/* Asynchronous (GPU) activity records, decoded from a vendor's activity
+ * buffer.  Rather than building a name and calling the listeners for each
+ * record, the measurement support adds the records from one buffer to a
+ * batch, with names that were already interned, and then flushes it.  The
+ * flush sorts the records by virtual thread (the NodeType) and time, and
+ * gives each listener all the records for one virtual thread at once, so
+ * the listeners only look up the thread and take their locks once per
+ * thread.  An activity can carry the async_event_data of its host side
+ * launch, for the flow events in the trace. */
+template <typename NodeType>
+class async_activity_batch {
+private:
+    struct record {
+        NodeType node;
+        task_identifier * id;
+        uint64_t start;
+        uint64_t end;
+        double value;
+        std::shared_ptr<task_wrapper> parent;
+        bool is_counter;
+        bool has_flow;
+        bool otf2;
+        async_event_data flow;
+        /* counters are ordered by their timestamp */
+        uint64_t timestamp(void) const { return is_counter ? end : start; }
+    };
+    std::vector<record> records;
+    void deliver(NodeType& node,
+        std::vector<std::shared_ptr<profiler> >& profilers,
+        std::vector<const async_event_data*>& flows,
+        std::vector<bool>& otf2) {
+        static apex* instance = apex::instance();
+#if defined(APEX_WITH_PERFETTO)
+        if (apex_options::use_perfetto()) {
+            perfetto_listener * tel =
+                (perfetto_listener*)instance->the_perfetto_listener;
+            tel->on_async_batch(node, profilers);
+        }
+#endif
+        if (apex_options::use_trace_event()) {
+            trace_event_listener * tel =
+                (trace_event_listener*)instance->the_trace_event_listener;
+            tel->on_async_batch(node, profilers, flows);
+        }
+#ifdef APEX_HAVE_OTF2
+        if (apex_options::use_otf2()) {
+            otf2_listener * tol =
+                (otf2_listener*)instance->the_otf2_listener;
+            if (std::find(otf2.begin(), otf2.end(), false) == otf2.end()) {
+                tol->on_async_batch(node, profilers);
+            } else {
+                // leave out the activities that aren't traced in OTF2
+                std::vector<std::shared_ptr<profiler> > traced;
+                for (size_t i = 0 ; i < profilers.size() ; i++) {
+                    if (otf2[i]) { traced.push_back(profilers[i]); }
+                }
+                tol->on_async_batch(node, traced);
+            }
+        }
+#else
+        APEX_UNUSED(otf2);
+#endif
+        // have the listeners handle the end of these tasks
+        for (auto& p : profilers) {
+            if (!p->is_counter) {
+                instance->complete_task(p->tt_ptr);
+            }
+        }
+    }
+public:
+    /* A completed activity, as a GPU child of the parent on the CPU side */
+    void add_activity(const NodeType& node, task_identifier * id,
+        uint64_t start, uint64_t end,
+        std::shared_ptr<task_wrapper> parent = nullptr) {
+        records.push_back(record{node, id, start, end, 0.0, parent, false,
+            false, true, async_event_data()});
+    }
+    /* An activity with a flow event from its launch on the CPU side.
+     * Activities that can overlap on their virtual thread can be left
+     * out of the OTF2 trace. */
+    void add_activity(const NodeType& node, task_identifier * id,
+        uint64_t start, uint64_t end, std::shared_ptr<task_wrapper> parent,
+        const async_event_data& flow, bool otf2 = true) {
+        records.push_back(record{node, id, start, end, 0.0, parent, false,
+            true, otf2, flow});
+    }
+    void add_counter(const NodeType& node, task_identifier * id,
+        uint64_t end, double value) {
+        records.push_back(record{node, id, 0, end, value, nullptr, true,
+            false, true, async_event_data()});
+    }
+    size_t size(void) const { return records.size(); }
+    /* Create the profilers, and deliver them to the listeners. */
+    void flush(void) {
+        if (records.empty()) { return; }
+        in_apex prevent_deadlocks;
+        static apex* instance = apex::instance();
+        if (instance == nullptr) {
+            records.clear();
+            return;
+        }
+        std::stable_sort(records.begin(), records.end(),
+            [](const record& a, const record& b) {
+                if (a.node < b.node) { return true; }
+                if (b.node < a.node) { return false; }
+                return a.timestamp() < b.timestamp();
+            });
+        std::vector<std::shared_ptr<profiler> > profilers;
+        profilers.reserve(records.size());
+        // the flow data of each profiler or nullptr, and whether to trace
+        // it in OTF2
+        std::vector<const async_event_data*> flows;
+        std::vector<bool> otf2;
+        flows.reserve(records.size());
+        size_t first = 0;
+        for (size_t i = 0 ; i < records.size() ; i++) {
+            record& r = records[i];
+            std::shared_ptr<profiler> prof;
+            if (r.is_counter) {
+                prof = std::make_shared<profiler>(r.id, r.value);
+                prof->is_counter = true;
+                prof->set_end(r.end);
+            } else {
+                auto tt = new_task(r.id, UINT64_MAX, r.parent);
+                if (tt != nullptr) {
+                    // we can't start then stop because we have
+                    // timestamps already.
+                    prof = std::make_shared<profiler>(tt);
+                    prof->set_start(r.start);
+                    prof->set_end(r.end);
+                    // important!  Otherwise we might get the wrong end
+                    // timestamp.
+                    prof->stopped = true;
+                }
+            }
+            if (prof != nullptr) {
+                // fake out the profiler_listener
+                instance->the_profiler_listener->push_profiler_public(prof);
+                profilers.push_back(prof);
+                flows.push_back(r.has_flow ? &r.flow : nullptr);
+                otf2.push_back(r.otf2);
+            }
+            // is this the last record for this virtual thread?
+            if (i + 1 == records.size() || r.node < records[i+1].node) {
+                if (!profilers.empty()) {
+                    deliver(records[first].node, profilers, flows, otf2);
+                }
+                profilers.clear();
+                flows.clear();
+                otf2.clear();
+                first = i + 1;
+            }
+        }
+        records.clear();
+    }
+};
+
+}
+
@@ -0,0 +1,379 @@
+#include "bayesian_optimization.hpp"
+#include <algorithm>
+
+namespace apex {
+
+namespace bayesian_optimization {
+
+static const double pi{3.14159265358979323846};
+
+/* Enum values have no order, so the model only knows whether two of them
+ * are the same.  Numbers are scaled to [0,1]. */
+static bool is_categorical(const Variable& v) {
+    return v.vtype == VariableType::stringtype;
+}
+
+static double coordinate(const Variable& v, size_t index) {
+    if (is_categorical(v)) { return (double)(index); }
+    return v.maxlen == 0 ? 0.0 : (double)(index) / (double)(v.maxlen);
+}
+
+double GaussianProcess::kernel(const std::vector<double>& a,
+    const std::vector<double>& b, double scale) const {
+    double distance{0.0};
+    for (size_t d = 0 ; d < a.size() ; d++) {
+        double delta = categorical[d] ? (a[d] == b[d] ? 0.0 : 1.0) :
+            (a[d] - b[d]);
+        distance += delta * delta;
+    }
+    return exp(-distance / (2.0 * scale * scale));
+}
+
+double GaussianProcess::factor(double scale) {
+    size_t n = x.size();
+    chol.assign(n * n, 0.0);
+    for (size_t i = 0 ; i < n ; i++) {
+        for (size_t j = 0 ; j <= i ; j++) {
+            chol[i*n+j] = kernel(x[i], x[j], scale) + (i == j ? noise : 0.0);
+        }
+    }
+    /* Cholesky factorization, in place */
+    double log_det{0.0};
+    for (size_t j = 0 ; j < n ; j++) {
+        double diagonal = chol[j*n+j];
+        for (size_t p = 0 ; p < j ; p++) {
+            diagonal -= chol[j*n+p] * chol[j*n+p];
+        }
+        if (diagonal <= 0.0) {
+            return -std::numeric_limits<double>::infinity();
+        }
+        diagonal = sqrt(diagonal);
+        chol[j*n+j] = diagonal;
+        log_det += log(diagonal);
+        for (size_t i = j + 1 ; i < n ; i++) {
+            double sum = chol[i*n+j];
+            for (size_t p = 0 ; p < j ; p++) {
+                sum -= chol[i*n+p] * chol[j*n+p];
+            }
+            chol[i*n+j] = sum / diagonal;
+        }
+    }
+    /* alpha = K^-1 y, by forward and back substitution */
+    alpha = y;
+    for (size_t i = 0 ; i < n ; i++) {
+        for (size_t p = 0 ; p < i ; p++) {
+            alpha[i] -= chol[i*n+p] * alpha[p];
+        }
+        alpha[i] /= chol[i*n+i];
+    }
+    for (size_t i = n ; i-- > 0 ; ) {
+        for (size_t p = i + 1 ; p < n ; p++) {
+            alpha[i] -= chol[p*n+i] * alpha[p];
+        }
+        alpha[i] /= chol[i*n+i];
+    }
+    double fit{0.0};
+    for (size_t i = 0 ; i < n ; i++) { fit += y[i] * alpha[i]; }
+    return -0.5 * fit - log_det;
+}
+
+void GaussianProcess::fit(const std::vector<std::vector<double>>& points,
+    const std::vector<double>& costs) {
+    x = points;
+    y_mean = 0.0;
+    for (auto c : costs) { y_mean += c; }
+    y_mean = y_mean / (double)(costs.size());
+    double variance{0.0};
+    for (auto c : costs) { variance += (c - y_mean) * (c - y_mean); }
+    y_scale = sqrt(variance / (double)(costs.size()));
+    if (y_scale <= 0.0) { y_scale = 1.0; }
+    y.clear();
+    for (auto c : costs) { y.push_back(standardize(c)); }
+    double best = -std::numeric_limits<double>::infinity();
+    for (double scale : {0.05, 0.1, 0.2, 0.4, 0.8, 1.6}) {
+        double likelihood = factor(scale);
+        if (likelihood > best) {
+            best = likelihood;
+            length_scale = scale;
+        }
+    }
+    factor(length_scale);
+}
+
+void GaussianProcess::predict(const std::vector<double>& point,
+    double& mean, double& sigma) const {
+    size_t n = x.size();
+    std::vector<double> v(n);
+    mean = 0.0;
+    for (size_t i = 0 ; i < n ; i++) {
+        v[i] = kernel(point, x[i], length_scale);
+        mean += v[i] * alpha[i];
+    }
+    /* the variance is k(x,x) - v.v, with v = L^-1 k* */
+    double variance{1.0};
+    for (size_t i = 0 ; i < n ; i++) {
+        for (size_t p = 0 ; p < i ; p++) {
+            v[i] -= chol[i*n+p] * v[p];
+        }
+        v[i] /= chol[i*n+i];
+        variance -= v[i] * v[i];
+    }
+    sigma = sqrt(std::max(variance, 1.0e-12));
+}
+
+size_t BayesianOptimization::space_size() {
+    size_t size{1};
+    size_t i = 0;
+    for (auto& v : vars) {
+        size = size * (high(i, v.second) - low(i) + 1);
+        i++;
+        // more than enough to know we can't enumerate it
+        if (size > (size_t)(1) << 40) { break; }
+    }
+    return size;
+}
+
+size_t BayesianOptimization::get_max_iterations() {
+    return std::min(max_iterations, space_size());
+}
+
+/* The center of the space, then random settings, before the model is
+ * used */
+size_t BayesianOptimization::initial_samples() {
+    return std::max((size_t)(1), std::min(kmax / 4,
+        std::max((size_t)(3), 2 * vars.size())));
+}
+
+std::vector<size_t> BayesianOptimization::random_index() {
+    std::vector<size_t> index;
+    size_t i = 0;
+    for (auto& v : vars) {
+        std::uniform_int_distribution<size_t> distribution(low(i),
+            high(i, v.second));
+        index.push_back(distribution(generator));
+        i++;
+    }
+    return index;
+}
+
+std::vector<double> BayesianOptimization::to_point(
+    const std::vector<size_t>& index) {
+    std::vector<double> point;
+    size_t i = 0;
+    for (auto& v : vars) {
+        point.push_back(coordinate(v.second, index[i++]));
+    }
+    return point;
+}
+
+std::vector<std::vector<size_t>> BayesianOptimization::candidates() {
+    std::vector<std::vector<size_t>> result;
+    if (space_size() <= max_enumerated) {
+        /* every setting we haven't measured */
+        std::vector<size_t> index;
+        for (size_t i = 0 ; i < vars.size() ; i++) { index.push_back(low(i)); }
+        while (true) {
+            if (measured.count(index) == 0) { result.push_back(index); }
+            size_t i = 0;
+            for (auto& v : vars) {
+                if (++index[i] <= high(i, v.second)) { break; }
+                index[i] = low(i);
+                i++;
+            }
+            if (i == vars.size()) { break; }
+        }
+        return result;
+    }
+    /* a random sample, and the neighbors of the best setting */
+    std::set<std::vector<size_t>> unique;
+    for (size_t c = 0 ; c < random_candidates ; c++) {
+        unique.insert(random_index());
+    }
+    size_t best = std::min_element(measured_cost.begin(),
+        measured_cost.end()) - measured_cost.begin();
+    size_t i = 0;
+    for (auto& v : vars) {
+        std::vector<size_t> index(measured_index[best]);
+        if (is_categorical(v.second)) {
+            for (size_t j = low(i) ; j <= high(i, v.second) ; j++) {
+                index[i] = j;
+                unique.insert(index);
+            }
+        } else {
+            if (index[i] > low(i)) {
+                index[i] = measured_index[best][i] - 1;
+                unique.insert(index);
+            }
+            if (measured_index[best][i] < high(i, v.second)) {
+                index[i] = measured_index[best][i] + 1;
+                unique.insert(index);
+            }
+        }
+        i++;
+    }
+    for (auto& index : unique) {
+        if (measured.count(index) == 0) { result.push_back(index); }
+    }
+    return result;
+}
+
+void BayesianOptimization::apply(const std::vector<size_t>& index) {
+    size_t i = 0;
+    for (auto& v : vars) {
+        v.second.set_index(index[i++]);
+    }
+}
+
+void BayesianOptimization::getNewSettings() {
+    if (done || vars.empty() || measured.size() >= space_size()) {
+        done = true;
+        saveBestSettings();
+        return;
+    }
+    if (design.empty()) {
+        std::vector<size_t> center;
+        // the center of the space, unless the search was warm started or
+        // is being retuned
+        for (auto& v : vars) { center.push_back(v.second.current_index); }
+        design.push_back(center);
+        std::set<std::vector<size_t>> unique(design.begin(), design.end());
+        size_t samples = std::min(initial_samples(), space_size());
+        while (design.size() < samples) {
+            std::vector<size_t> index(random_index());
+            if (unique.insert(index).second) { design.push_back(index); }
+        }
+    }
+    pending.clear();
+    if (measured.size() < design.size()) {
+        for (size_t i = 0 ; i < design.size() ; i++) {
+            if (sharing.mine(i) && measured.count(design[i]) == 0 &&
+                sharing.in_flight.count(design[i]) == 0) {
+                pending = design[i];
+                break;
+            }
+        }
+    } else {
+        /* rank the candidates by their expected improvement.  Cooperating
+         * ranks draw the same random candidates, so they agree on it. */
+        if (sharing.enabled) { generator.seed(measured.size()); }
+        std::vector<bool> categorical;
+        for (auto& v : vars) {
+            categorical.push_back(is_categorical(v.second));
+        }
+        model.set_categorical(categorical);
+        model.fit(measured_point, measured_cost);
+        double target = model.standardize(best_cost);
+        std::vector<std::pair<double, std::vector<size_t>>> ranked;
+        for (auto& index : candidates()) {
+            double mean, sigma;
+            model.predict(to_point(index), mean, sigma);
+            double gain = target - mean;
+            double z = gain / sigma;
+            double improvement = gain * 0.5 * erfc(-z / sqrt(2.0)) +
+                sigma * exp(-0.5 * z * z) / sqrt(2.0 * pi);
+            ranked.push_back(std::make_pair(improvement, index));
+        }
+        size_t choice = sharing.enabled ? (size_t)(sharing.rank) : 0;
+        std::partial_sort(ranked.begin(), ranked.begin() +
+            std::min(choice + 1, ranked.size()), ranked.end(), [](
+            const std::pair<double, std::vector<size_t>>& a,
+            const std::pair<double, std::vector<size_t>>& b) {
+            return a.first > b.first ||
+                (a.first == b.first && a.second < b.second); });
+        if (ranked.empty() || ranked[0].first < min_improvement) {
+            done = true;
+            saveBestSettings();
+            return;
+        }
+        if (ranked.size() > choice &&
+            sharing.in_flight.count(ranked[choice].second) == 0) {
+            pending = ranked[choice].second;
+        }
+    }
+    if (pending.empty()) {
+        /* the rest are being measured by other ranks */
+        saveBestSettings();
+        return;
+    }
+    apply(pending);
+}
+
+/* The old measurements are stale, so they are forgotten.  Enum values
+ * have no order, so all of them are still searched. */
+void BayesianOptimization::retune(double radius, size_t budget) {
+    lower.clear();
+    upper.clear();
+    for (auto& v : vars) {
+        size_t best = v.second.best_index;
+        v.second.set_index(best);
+        if (is_categorical(v.second)) {
+            lower.push_back(0);
+            upper.push_back(v.second.maxlen);
+            continue;
+        }
+        size_t step = std::max((size_t)(1),
+            (size_t)(std::lround((double)(v.second.maxlen) * radius)));
+        lower.push_back(best > step ? best - step : 0);
+        upper.push_back(std::min(v.second.maxlen, best + step));
+    }
+    measured_index.clear();
+    measured_point.clear();
+    measured_cost.clear();
+    measured.clear();
+    pending.clear();
+    design.clear();
+    best_cost = std::numeric_limits<double>::max();
+    done = false;
+    k = 1;
+    kmax = std::min(get_max_iterations(), std::max(budget, (size_t)(1)));
+}
+
+bool BayesianOptimization::take_pending(std::vector<size_t>& index) {
+    if (pending.empty() || measured.count(pending) > 0) { return false; }
+    sharing.in_flight.insert(pending);
+    index.swap(pending);
+    pending.clear();
+    return true;
+}
+
+/* A measurement from one of the cooperating ranks (this one too) */
+void BayesianOptimization::import(const std::vector<size_t>& index,
+    double cost) {
+    sharing.in_flight.erase(index);
+    if (index.size() != vars.size() || measured.count(index) > 0) { return; }
+    measured.insert(index);
+    measured_index.push_back(index);
+    measured_point.push_back(to_point(index));
+    measured_cost.push_back(cost);
+    if (cost < best_cost) {
+        best_cost = cost;
+        size_t i = 0;
+        for (auto& v : vars) { v.second.best_index = index[i++]; }
+        if (sharing.rank == 0) {
+            std::cout << "New best! " << cost << " k: " << k << std::endl;
+        }
+    }
+    k++;
+}
+
+void BayesianOptimization::evaluate(double new_cost) {
+    if (pending.empty()) { return; }
+    measured.insert(pending);
+    measured_index.push_back(pending);
+    measured_point.push_back(to_point(pending));
+    measured_cost.push_back(new_cost);
+    if (new_cost < best_cost) {
+        best_cost = new_cost;
+        std::cout << "New best! " << new_cost << " k: " << k;
+        for (auto& v : vars) { v.second.save_best(); }
+        for (auto& v : vars) { std::cout  << ", value: " << v.second.toString(); }
+        std::cout << std::endl;
+    }
+    pending.clear();
+    k++;
+    return;
+}
+
+} // bayesian_optimization
+
+} // apex
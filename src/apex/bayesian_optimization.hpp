@@ -0,0 +1,142 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <limits>
+#include <map>
+#include <set>
+#include "apex_types.h"
+#include "cooperative_tuning.hpp"
+// the variables are shared with Nelder-Mead
+#include "nelder_mead.hpp"
+
+namespace apex {
+
+namespace bayesian_optimization {
+
+using nelder_mead::VariableType;
+using nelder_mead::Variable;
+
+/*
+ * A Gaussian process over the measured settings, with a squared
+ * exponential kernel.  For enum variables the distance is 0 or 1.  The
+ * length scale is the one (of a few) with the best marginal likelihood.
+ */
+class GaussianProcess {
+private:
+    std::vector<bool> categorical;
+    std::vector<std::vector<double>> x;
+    std::vector<double> y; // standardized
+    double y_mean;
+    double y_scale;
+    double length_scale;
+    std::vector<double> chol; // lower triangle of the covariance
+    std::vector<double> alpha;
+    const double noise{1.0e-2};
+    double kernel(const std::vector<double>& a,
+        const std::vector<double>& b, double scale) const;
+    /* returns the log marginal likelihood, or -inf if the matrix isn't
+     * positive definite */
+    double factor(double scale);
+public:
+    GaussianProcess() : y_mean(0), y_scale(1), length_scale(0.25) {}
+    void set_categorical(std::vector<bool> c) { categorical = c; }
+    void fit(const std::vector<std::vector<double>>& points,
+        const std::vector<double>& costs);
+    /* The predicted mean and standard deviation, in standardized units */
+    void predict(const std::vector<double>& point, double& mean,
+        double& sigma) const;
+    double standardize(double cost) const {
+        return (cost - y_mean) / y_scale;
+    }
+};
+
+/*
+ * Bayesian optimization: measure a few random settings, then repeatedly
+ * fit the surrogate model to everything measured so far, and measure the
+ * setting with the largest expected improvement over the best one.  When
+ * the space is small every unmeasured setting is a candidate; otherwise it
+ * is a random sample plus the neighbors of the best setting.  The search
+ * has converged when no candidate is expected to improve on the best
+ * setting by more than a small fraction of the spread of the costs.
+ */
+
+class BayesianOptimization {
+private:
+    std::map<std::string, Variable> vars;
+    std::vector<std::vector<size_t>> measured_index;
+    std::vector<std::vector<double>> measured_point;
+    std::vector<double> measured_cost;
+    std::set<std::vector<size_t>> measured;
+    std::vector<size_t> pending; // the setting being measured
+    std::vector<std::vector<size_t>> design; // the initial samples
+    /* the part of the space being searched, after retune(); when empty,
+     * all of it */
+    std::vector<size_t> lower;
+    std::vector<size_t> upper;
+    GaussianProcess model;
+    cooperative_tuning::share sharing;
+    std::mt19937 generator;
+    double best_cost;
+    size_t kmax;
+    size_t k;
+    bool done;
+    const size_t max_iterations{200};
+    const size_t max_enumerated{4096};
+    const size_t random_candidates{1024};
+    const double min_improvement{1.0e-3};
+    size_t low(size_t i) { return lower.empty() ? 0 : lower[i]; }
+    size_t high(size_t i, const Variable& v) {
+        return upper.empty() ? v.maxlen : upper[i];
+    }
+    size_t space_size();
+    size_t initial_samples();
+    std::vector<size_t> random_index();
+    std::vector<double> to_point(const std::vector<size_t>& index);
+    std::vector<std::vector<size_t>> candidates();
+    void apply(const std::vector<size_t>& index);
+public:
+    void evaluate(double new_cost);
+    BayesianOptimization() : kmax(0), k(1), done(false) {
+        best_cost = std::numeric_limits<double>::max();
+    }
+    double getEnergy() { return best_cost; }
+    bool converged() { return (done || k > kmax); }
+    void getNewSettings();
+    /* For cooperative tuning: the measurements only come from import(),
+     * each rank measures every size'th initial sample, and then rank r
+     * measures the candidate with the r'th largest expected improvement */
+    void set_cooperative(int rank, int size) { sharing.set(rank, size); }
+    /* Search again around the best settings, within radius of the space
+     * of them and for at most budget evaluations, when their cost has
+     * changed */
+    void retune(double radius, size_t budget);
+    bool take_pending(std::vector<size_t>& index);
+    void import(const std::vector<size_t>& index, double cost);
+    void saveBestSettings() {
+        for (auto& v : vars) { v.second.getBest(); }
+    }
+    void printBestSettings() {
+        std::string d("[");
+        for (auto v : vars) {
+            std::cout << d << v.second.getBest();
+            d = ",";
+        }
+        std::cout << "]" << std::endl;
+    }
+    size_t get_max_iterations();
+    std::map<std::string, Variable>& get_vars() { return vars; }
+    void add_var(std::string name, Variable var) {
+        vars.insert(std::make_pair(name, var));
+        kmax = get_max_iterations();
+    }
+};
+
+} // bayesian_optimization
+
+} // apex
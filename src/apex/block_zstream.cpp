@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "block_zstream.hpp"
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+#ifdef APEX_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace apex { namespace io {
+
+block_zstreambuf::block_zstreambuf(const char* filename, size_t threads,
+                                   block_codec codec, size_t block_size)
+    : file_{std::fopen(filename, "wb")}, codec_{codec},
+      block_size_{std::max(block_size, (size_t)(4096))}, writing_{false},
+      stopping_{false}, failed_{false}
+{
+#ifndef APEX_HAVE_ZSTD
+    codec_ = block_codec::gzip;
+#endif
+    buffer_.resize(block_size_);
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+    if (file_ == nullptr)
+        return;
+    for (size_t i = 0 ; i < threads ; i++)
+        workers_.emplace_back(&block_zstreambuf::work, this);
+}
+
+block_zstreambuf::~block_zstreambuf()
+{
+    close();
+}
+
+block_codec block_zstreambuf::best_codec()
+{
+#ifdef APEX_HAVE_ZSTD
+    return block_codec::zstd;
+#else
+    return block_codec::gzip;
+#endif
+}
+
+auto block_zstreambuf::overflow(int_type ch) -> int_type
+{
+    if (!is_open())
+        return traits_type::eof();
+    submit();
+    if (ch != traits_type::eof())
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+/* Copies whole runs into the block, instead of a character at a time */
+std::streamsize block_zstreambuf::xsputn(const char* s, std::streamsize n)
+{
+    if (!is_open())
+        return 0;
+    std::streamsize copied{0};
+    while (copied < n)
+    {
+        if (pptr() == epptr())
+            submit();
+        auto room = std::min(n - copied,
+                             static_cast<std::streamsize>(epptr() - pptr()));
+        memcpy(pptr(), s + copied, room);
+        pbump(static_cast<int>(room));
+        copied += room;
+    }
+    return n;
+}
+
+int block_zstreambuf::sync()
+{
+    if (!is_open())
+        return -1;
+    submit();
+    std::unique_lock<std::mutex> l(mutex_);
+    return failed_ ? -1 : 0;
+}
+
+bool block_zstreambuf::is_open() const
+{
+    return file_ != nullptr;
+}
+
+bool block_zstreambuf::close()
+{
+    if (!is_open())
+        return false;
+    submit();
+    {
+        std::unique_lock<std::mutex> l(mutex_);
+        written_.wait(l, [this] { return pending_.empty() && !writing_; });
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (auto& t : workers_)
+        t.join();
+    workers_.clear();
+    // the last writes can fail as the file is flushed
+    if (std::fclose(file_) != 0)
+        failed_ = true;
+    file_ = nullptr;
+    return !failed_;
+}
+
+/* Hand the current block to the pool, and start a new one */
+void block_zstreambuf::submit()
+{
+    if (pptr() == pbase())
+        return;
+    auto b = std::make_shared<block>();
+    b->input.assign(pbase(), pptr());
+    b->done = false;
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+    if (workers_.empty())
+    {
+        compress(*b);
+        b->done = true;
+        std::unique_lock<std::mutex> l(mutex_);
+        pending_.push_back(b);
+        write_done(l);
+        return;
+    }
+    std::unique_lock<std::mutex> l(mutex_);
+    // bound the memory, if the pool falls behind
+    written_.wait(l, [this] {
+        return pending_.size() < 2 * workers_.size();
+    });
+    pending_.push_back(b);
+    queue_.push_back(b);
+    work_ready_.notify_one();
+}
+
+/* Each block is a complete gzip member or zstd frame */
+void block_zstreambuf::compress(block& b)
+{
+#ifdef APEX_HAVE_ZSTD
+    if (codec_ == block_codec::zstd)
+    {
+        b.output.resize(ZSTD_compressBound(b.input.size()));
+        // 3 is the zstd default level
+        size_t bytes = ZSTD_compress(b.output.data(), b.output.size(),
+                                     b.input.data(), b.input.size(), 3);
+        b.output.resize(ZSTD_isError(bytes) ? 0 : bytes);
+        return;
+    }
+#endif
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // 16 more window bits for a gzip header and trailer
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        b.output.clear();
+        return;
+    }
+    b.output.resize(deflateBound(&zs, static_cast<uLong>(b.input.size())));
+    zs.next_in = reinterpret_cast<Bytef*>(b.input.data());
+    zs.avail_in = static_cast<uInt>(b.input.size());
+    zs.next_out = reinterpret_cast<Bytef*>(b.output.data());
+    zs.avail_out = static_cast<uInt>(b.output.size());
+    int rc = deflate(&zs, Z_FINISH);
+    b.output.resize(rc == Z_STREAM_END ? zs.total_out : 0);
+    deflateEnd(&zs);
+}
+
+void block_zstreambuf::work()
+{
+    std::unique_lock<std::mutex> l(mutex_);
+    while (true)
+    {
+        work_ready_.wait(l, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty())
+            return;
+        auto b = queue_.front();
+        queue_.pop_front();
+        l.unlock();
+        compress(*b);
+        l.lock();
+        b->done = true;
+        write_done(l);
+    }
+}
+
+/* Write the finished blocks at the front, in order.  Only one thread
+ * writes at a time, and it picks up the blocks that the others finish
+ * while it writes. */
+void block_zstreambuf::write_done(std::unique_lock<std::mutex>& l)
+{
+    if (writing_)
+        return;
+    writing_ = true;
+    while (!pending_.empty() && pending_.front()->done)
+    {
+        auto b = pending_.front();
+        pending_.pop_front();
+        l.unlock();
+        // the input is never empty, so an empty output is an error
+        bool ok = !b->output.empty() &&
+            std::fwrite(b->output.data(), 1, b->output.size(), file_) ==
+            b->output.size();
+        l.lock();
+        failed_ = failed_ || !ok;
+        written_.notify_all();
+    }
+    writing_ = false;
+    written_.notify_all();
+}
+
+} // namespace io
+} // namespace apex
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace apex { namespace io {
+
+/* How the blocks are compressed */
+enum class block_codec { gzip, zstd };
+
+/**
+ * A streambuf that compresses its output in independent blocks, like pigz.
+ * Each block is a complete gzip member (or zstd frame), and concatenated
+ * members are still a valid gzip (or zstd) file, so standard tools can read
+ * it.  The blocks are compressed on a small pool of threads, and written in
+ * order by whichever thread finishes the oldest one, so writing to the
+ * stream only costs a copy until the pool falls behind.  With no threads,
+ * the blocks are compressed by the writing thread.
+ */
+class block_zstreambuf : public std::streambuf
+{
+  public:
+    block_zstreambuf(const char* filename, size_t threads,
+                     block_codec codec, size_t block_size = 1 << 20);
+    ~block_zstreambuf();
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    /* Hands the partial block to the pool, without waiting for it */
+    int sync() override;
+    bool is_open() const;
+    /* Waits for every block to be written, and returns false if any of
+     * them couldn't be */
+    bool close(void);
+    /* The codec that this build supports, preferring zstd */
+    static block_codec best_codec(void);
+  private:
+    struct block {
+        std::vector<char> input;
+        std::vector<char> output;
+        bool done;
+    };
+    void submit(void);
+    void compress(block& b);
+    void work(void);
+    void write_done(std::unique_lock<std::mutex>& l);
+    std::FILE* file_;
+    block_codec codec_;
+    size_t block_size_;
+    std::vector<char> buffer_;
+    /* every block not written yet, in order */
+    std::deque<std::shared_ptr<block>> pending_;
+    /* the blocks waiting for a thread */
+    std::deque<std::shared_ptr<block>> queue_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable written_;
+    bool writing_;
+    bool stopping_;
+    bool failed_;
+};
+
+/**
+ * An ofstream that writes block compressed files.
+ */
+class block_zofstream : public std::ostream
+{
+  public:
+    block_zofstream(const std::string& name, size_t threads,
+                    block_codec codec)
+        : std::ostream{&buffer_}, buffer_{name.c_str(), threads, codec}
+    {
+        if (buffer_.is_open())
+            this->clear();
+        else
+            this->setstate(std::ios::badbit);
+    }
+    bool is_open() const { return buffer_.is_open(); }
+    void close()
+    {
+        if (!buffer_.close())
+            this->setstate(std::ios::failbit);
+    }
+  private:
+    block_zstreambuf buffer_;
+};
+
+} // namespace io
+} // namespace apex
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "columnar_table.hpp"
+#include <cstdio>
+#include <iostream>
+
+namespace apex {
+
+    static const char columnar_magic[8] =
+        {'A','P','E','X','C','O','L','1'};
+    static const uint32_t columnar_version = 1;
+
+    static inline uint64_t align(uint64_t offset) {
+        return (offset + 7) & ~((uint64_t)7);
+    }
+
+    /* write zeros up to the next 8 byte boundary */
+    static inline void pad(FILE * f, uint64_t &offset) {
+        static const char zeros[8] = {0};
+        uint64_t aligned = align(offset);
+        fwrite(zeros, sizeof(char), aligned - offset, f);
+        offset = aligned;
+    }
+
+    uint32_t columnar_table::intern(const std::string &value) {
+        auto it = _string_ids.find(value);
+        if (it != _string_ids.end()) { return it->second; }
+        uint32_t id = _strings.size();
+        _strings.push_back(value);
+        _string_ids[value] = id;
+        return id;
+    }
+
+    size_t columnar_table::add_column(const std::string &name,
+        column_type type) {
+        _columns.emplace_back(intern(name), type);
+        return _columns.size() - 1;
+    }
+
+    void columnar_table::append_double(size_t column, double value) {
+        _columns[column].doubles.push_back(value);
+    }
+
+    void columnar_table::append_uint(size_t column, uint32_t value) {
+        _columns[column].indices.push_back(value);
+    }
+
+    void columnar_table::append_string(size_t column,
+        const std::string &value) {
+        _columns[column].indices.push_back(intern(value));
+    }
+
+    bool columnar_table::write(const std::string &filename, uint32_t rank) {
+        uint64_t rows = _columns.empty() ? 0 : _columns[0].size();
+        for (auto& c : _columns) {
+            if (c.size() != rows) {
+                std::cerr << "Error writing " << filename << ": column '"
+                          << _strings[c.name] << "' has " << c.size()
+                          << " rows, expected " << rows << std::endl;
+                return false;
+            }
+        }
+        FILE * f = fopen(filename.c_str(), "wb");
+        if (f == nullptr) {
+            perror("opening columnar profile file");
+            return false;
+        }
+        /* Lay out the file first, so the header can be written up front. */
+        const uint64_t header_size = 56;
+        const uint64_t directory_entry_size = 16;
+        uint64_t offset = header_size +
+            (directory_entry_size * _columns.size());
+        std::vector<uint64_t> data_offsets;
+        for (auto& c : _columns) {
+            offset = align(offset);
+            data_offsets.push_back(offset);
+            offset += rows * (c.type == float64_column ?
+                sizeof(double) : sizeof(uint32_t));
+        }
+        uint64_t strings_offset = align(offset);
+
+        uint32_t kind = _kind;
+        uint32_t num_columns = _columns.size();
+        uint64_t num_strings = _strings.size();
+        uint64_t reserved = 0;
+        fwrite(columnar_magic, sizeof(char), 8, f);
+        fwrite(&columnar_version, sizeof(uint32_t), 1, f);
+        fwrite(&kind, sizeof(uint32_t), 1, f);
+        fwrite(&rank, sizeof(uint32_t), 1, f);
+        fwrite(&num_columns, sizeof(uint32_t), 1, f);
+        fwrite(&rows, sizeof(uint64_t), 1, f);
+        fwrite(&num_strings, sizeof(uint64_t), 1, f);
+        fwrite(&strings_offset, sizeof(uint64_t), 1, f);
+        fwrite(&reserved, sizeof(uint64_t), 1, f);
+        for (size_t i = 0 ; i < _columns.size() ; i++) {
+            uint32_t type = _columns[i].type;
+            fwrite(&(_columns[i].name), sizeof(uint32_t), 1, f);
+            fwrite(&type, sizeof(uint32_t), 1, f);
+            fwrite(&(data_offsets[i]), sizeof(uint64_t), 1, f);
+        }
+        offset = header_size + (directory_entry_size * _columns.size());
+        for (auto& c : _columns) {
+            pad(f, offset);
+            if (c.type == float64_column) {
+                fwrite(c.doubles.data(), sizeof(double), rows, f);
+                offset += rows * sizeof(double);
+            } else {
+                fwrite(c.indices.data(), sizeof(uint32_t), rows, f);
+                offset += rows * sizeof(uint32_t);
+            }
+        }
+        pad(f, offset);
+        uint64_t end = 0;
+        for (auto& s : _strings) {
+            end += s.size();
+            fwrite(&end, sizeof(uint64_t), 1, f);
+        }
+        for (auto& s : _strings) {
+            fwrite(s.data(), sizeof(char), s.size(), f);
+        }
+        fclose(f);
+        return true;
+    }
+
+}
+
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace apex {
+
+/* A table of typed columns, written as a flat struct-of-arrays file that
+ * the analysis scripts can memory-map instead of parsing text.  Strings
+ * (timer names, column names) are stored once, in a string table, and
+ * string columns hold indices into it.
+ *
+ * All values are in native (little-endian) byte order, and every section
+ * starts on an 8 byte boundary:
+ *
+ *   header: char magic[8] = "APEXCOL1", uint32 version, uint32 kind,
+ *           uint32 rank, uint32 num_columns, uint64 num_rows,
+ *           uint64 num_strings, uint64 string table offset, uint64 reserved
+ *   column directory: num_columns entries of uint32 name (string index),
+ *           uint32 type (column_type), uint64 data offset
+ *   column data: num_rows values of each column
+ *   string table: uint64 end[num_strings], the end of each string relative
+ *           to the start of the string data, then the string data (UTF-8,
+ *           not terminated)
+ *
+ * src/scripts/apex_columnar.py reads the file. */
+class columnar_table {
+public:
+    enum table_kind { flat_profile = 1, task_tree = 2 };
+    enum column_type { float64_column = 1, uint32_column = 2,
+        string_column = 3 };
+private:
+    class column {
+    public:
+        uint32_t name;
+        column_type type;
+        std::vector<double> doubles;
+        std::vector<uint32_t> indices;
+        column(uint32_t n, column_type t) : name(n), type(t) {};
+        size_t size(void) const {
+            return type == float64_column ? doubles.size() : indices.size();
+        }
+    };
+    table_kind _kind;
+    std::vector<column> _columns;
+    std::vector<std::string> _strings;
+    std::unordered_map<std::string, uint32_t> _string_ids;
+    uint32_t intern(const std::string &value);
+public:
+    columnar_table(table_kind kind) : _kind(kind) {};
+    /* Returns the index of the new column, for the append methods. */
+    size_t add_column(const std::string &name, column_type type);
+    void append_double(size_t column, double value);
+    void append_uint(size_t column, uint32_t value);
+    void append_string(size_t column, const std::string &value);
+    /* All columns must have the same number of rows. */
+    bool write(const std::string &filename, uint32_t rank);
+};
+
+}
+
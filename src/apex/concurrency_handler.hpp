@@ -74,6 +74,10 @@ public:
     APEX_UNUSED(tt_ptr);
   };
   void on_sample_value(sample_value_event_data &data) { APEX_UNUSED(data); };
+  bool handles(dispatch_event event) {
+    return event != DISPATCH_TASK_COMPLETE &&
+        event != DISPATCH_SAMPLE_VALUE;
+  }
   void on_periodic(periodic_event_data &data) { APEX_UNUSED(data); };
   void on_custom_event(custom_event_data &data) { APEX_UNUSED(data); };
   void on_send(message_event_data &data) { APEX_UNUSED(data); };
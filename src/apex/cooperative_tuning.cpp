@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "cooperative_tuning.hpp"
+#include "apex_options.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#if defined(APEX_WITH_MPI)
+#include "mpi.h"
+#endif
+
+namespace apex {
+
+namespace cooperative_tuning {
+
+#if defined(APEX_WITH_MPI)
+
+namespace {
+
+typedef std::vector<std::pair<std::string, record>> record_list;
+
+/* A round is two collectives: the sizes (and whether each rank is
+ * finalizing), then the records */
+enum class round_phase { idle, sizes, records };
+
+MPI_Comm comm{MPI_COMM_NULL};
+int my_rank{0};
+int comm_size{1};
+bool any_thread{false};
+std::thread::id mpi_thread;
+std::mutex mtx;
+round_phase phase{round_phase::idle};
+std::chrono::steady_clock::time_point last_round;
+MPI_Request request{MPI_REQUEST_NULL};
+std::string outgoing; // posted since the current round started
+std::string sending;  // the records in the current round
+uint64_t my_header[2];
+std::vector<uint64_t> headers;
+std::vector<int> counts;
+std::vector<int> displacements;
+std::vector<char> incoming;
+bool all_finished{false};
+std::map<std::string, handler> handlers;
+std::map<std::string, std::vector<record>> backlog;
+
+template<typename T> void write(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T> T read(const char *& in) {
+    T value;
+    memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return value;
+}
+
+void serialize(std::string& out, const std::string& session,
+    const record& r) {
+    write<uint32_t>(out, (uint32_t)(session.size()));
+    out.append(session);
+    write<uint8_t>(out, r.final ? 1 : 0);
+    write<uint32_t>(out, (uint32_t)(r.index.size()));
+    for (auto i : r.index) { write<uint64_t>(out, (uint64_t)(i)); }
+    write<double>(out, r.cost);
+}
+
+void deserialize(const char * in, const char * end, record_list& records) {
+    while (in < end) {
+        uint32_t length = read<uint32_t>(in);
+        std::string session(in, length);
+        in += length;
+        record r;
+        r.final = read<uint8_t>(in) != 0;
+        uint32_t n = read<uint32_t>(in);
+        for (uint32_t i = 0 ; i < n ; i++) {
+            r.index.push_back((size_t)(read<uint64_t>(in)));
+        }
+        r.cost = read<double>(in);
+        records.push_back(std::make_pair(std::move(session), std::move(r)));
+    }
+}
+
+void start_round(bool finished) {
+    sending.swap(outgoing);
+    outgoing.clear();
+    my_header[0] = sending.size();
+    my_header[1] = finished ? 1 : 0;
+    headers.resize(2 * comm_size);
+    PMPI_Iallgather(my_header, 2, MPI_UINT64_T, headers.data(), 2,
+        MPI_UINT64_T, comm, &request);
+    phase = round_phase::sizes;
+}
+
+/* Move the round along; true when the records have arrived */
+bool test_round(bool wait, record_list& records) {
+    int flag{0};
+    if (phase == round_phase::sizes) {
+        if (wait) {
+            PMPI_Wait(&request, MPI_STATUS_IGNORE);
+            flag = 1;
+        } else {
+            PMPI_Test(&request, &flag, MPI_STATUS_IGNORE);
+        }
+        if (!flag) { return false; }
+        counts.resize(comm_size);
+        displacements.resize(comm_size);
+        all_finished = true;
+        int total{0};
+        for (int i = 0 ; i < comm_size ; i++) {
+            counts[i] = (int)(headers[2*i]);
+            displacements[i] = total;
+            total += counts[i];
+            all_finished = all_finished && headers[2*i+1] != 0;
+        }
+        incoming.resize(std::max(total, 1));
+        PMPI_Iallgatherv(&sending[0], (int)(sending.size()), MPI_CHAR,
+            incoming.data(), counts.data(), displacements.data(), MPI_CHAR,
+            comm, &request);
+        phase = round_phase::records;
+    }
+    if (phase == round_phase::records) {
+        if (wait) {
+            PMPI_Wait(&request, MPI_STATUS_IGNORE);
+            flag = 1;
+        } else {
+            PMPI_Test(&request, &flag, MPI_STATUS_IGNORE);
+        }
+        if (!flag) { return false; }
+        phase = round_phase::idle;
+        // in rank order, so every rank sees the same sequence
+        for (int i = 0 ; i < comm_size ; i++) {
+            const char * in = incoming.data() + displacements[i];
+            deserialize(in, in + counts[i], records);
+        }
+        return true;
+    }
+    return false;
+}
+
+void deliver(const record_list& records) {
+    for (auto& r : records) {
+        handler h;
+        {
+            std::unique_lock<std::mutex> l(mtx);
+            auto found = handlers.find(r.first);
+            if (found == handlers.end()) {
+                backlog[r.first].push_back(r.second);
+                continue;
+            }
+            h = found->second;
+        }
+        h(r.second);
+    }
+}
+
+} // anonymous namespace
+
+void init(void) {
+    if (!apex_options::tuning_cooperative()) { return; }
+    int initialized{0};
+    PMPI_Initialized(&initialized);
+    if (!initialized) { return; }
+    PMPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+    if (comm_size < 2) { return; }
+    PMPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+    PMPI_Comm_dup(MPI_COMM_WORLD, &comm);
+    /* Unless MPI is fully thread safe, only the thread that initialized
+     * it takes part in the rounds */
+    int level{MPI_THREAD_SINGLE};
+    PMPI_Query_thread(&level);
+    any_thread = (level == MPI_THREAD_MULTIPLE);
+    mpi_thread = std::this_thread::get_id();
+    last_round = std::chrono::steady_clock::now();
+    if (my_rank == 0) {
+        std::cout << "APEX: cooperative tuning across " << comm_size
+                  << " ranks" << std::endl;
+    }
+}
+
+void finalize(void) {
+    if (!enabled()) { return; }
+    /* Every rank keeps taking part in rounds until all of them are
+     * finalizing, so that no collective is left waiting.  The records
+     * are no longer needed. */
+    std::unique_lock<std::mutex> l(mtx);
+    record_list records;
+    while (true) {
+        if (phase == round_phase::idle) {
+            start_round(true);
+        }
+        while (!test_round(true, records)) { }
+        if (all_finished) { break; }
+    }
+    PMPI_Comm_free(&comm);
+    comm = MPI_COMM_NULL;
+}
+
+bool enabled(void) { return comm != MPI_COMM_NULL; }
+
+int rank(void) { return my_rank; }
+
+int size(void) { return comm_size; }
+
+void post(const std::string& session, const record& r) {
+    if (!enabled()) { return; }
+    std::unique_lock<std::mutex> l(mtx);
+    serialize(outgoing, session, r);
+}
+
+void progress(void) {
+    if (!enabled()) { return; }
+    if (!any_thread && std::this_thread::get_id() != mpi_thread) { return; }
+    record_list records;
+    {
+        std::unique_lock<std::mutex> l(mtx);
+        if (phase != round_phase::idle) {
+            test_round(false, records);
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (phase == round_phase::idle &&
+            std::chrono::duration_cast<std::chrono::microseconds>(
+            now - last_round).count() >=
+            apex_options::tuning_cooperative_period()) {
+            start_round(false);
+            last_round = now;
+        }
+    }
+    deliver(records);
+}
+
+void subscribe(const std::string& session, handler h) {
+    if (!enabled()) { return; }
+    std::vector<record> early;
+    {
+        std::unique_lock<std::mutex> l(mtx);
+        handlers[session] = h;
+        auto found = backlog.find(session);
+        if (found != backlog.end()) {
+            early.swap(found->second);
+            backlog.erase(found);
+        }
+    }
+    for (auto& r : early) { h(r); }
+}
+
+#else // APEX_WITH_MPI
+
+void init(void) { }
+void finalize(void) { }
+bool enabled(void) { return false; }
+int rank(void) { return 0; }
+int size(void) { return 1; }
+void post(const std::string& session, const record& r) {
+    APEX_UNUSED(session);
+    APEX_UNUSED(r);
+}
+void progress(void) { }
+void subscribe(const std::string& session, handler h) {
+    APEX_UNUSED(session);
+    APEX_UNUSED(h);
+}
+
+#endif // APEX_WITH_MPI
+
+} // cooperative_tuning
+
+} // apex
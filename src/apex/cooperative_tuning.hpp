@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace apex {
+
+/* Cooperative tuning between MPI ranks (APEX_TUNING_COOPERATIVE).  The
+ * ranks exchange the measurements of each tuning session, by session name,
+ * in rounds of non-blocking collectives on a copy of MPI_COMM_WORLD.  Every
+ * rank gets the same records in the same order, its own included, so a
+ * search that only moves on delivered records stays in step on every rank
+ * while each rank measures its share of the candidates.  The tuning
+ * policies drive the rounds, and start one at most once per
+ * APEX_TUNING_COOPERATIVE_PERIOD. */
+namespace cooperative_tuning {
+
+/* A measurement of the settings with these value indices, or (final) the
+ * settings that every rank should switch to */
+struct record {
+    bool final;
+    std::vector<size_t> index;
+    double cost;
+};
+typedef std::function<void(const record&)> handler;
+
+/* Set up the communicator.  Every rank calls this, from MPI_Init. */
+void init(void);
+/* Finish the last rounds with the other ranks.  Every rank calls this,
+ * from apex::finalize. */
+void finalize(void);
+bool enabled(void);
+int rank(void);
+int size(void);
+/* Send a record to every rank (this one too) in the next round */
+void post(const std::string& session, const record& r);
+/* Check on the current round, deliver its records if it is done, and
+ * start the next round if it's time */
+void progress(void);
+/* Records for the session go to the handler, starting with any that
+ * arrived before this rank started the session */
+void subscribe(const std::string& session, handler h);
+
+/* What a search needs to split its candidates with the other ranks */
+class share {
+public:
+    bool enabled;
+    int rank;
+    int size;
+    /* measured here, and not delivered yet */
+    std::set<std::vector<size_t>> in_flight;
+    share() : enabled(false), rank(0), size(1) {}
+    void set(int r, int s) {
+        enabled = true;
+        rank = r;
+        size = s;
+    }
+    /* the candidates are dealt out to the ranks in turn */
+    bool mine(size_t position) const {
+        return !enabled || (int)(position % size) == rank;
+    }
+};
+
+} // cooperative_tuning
+
+} // apex
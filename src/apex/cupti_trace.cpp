@@ -33,6 +33,7 @@
 #include "otf2_listener.hpp"
 #endif
 #include "async_thread_node.hpp"
+#include "async_activity.hpp"
 #include "memory_wrapper.hpp"
 
 #include <cuda_runtime_api.h>
@@ -487,12 +488,14 @@ bool register_myself(bool isWorker = true) {
     return registered;
 }
 
-void store_profiler_data(const std::string &name, uint32_t correlationId,
-        uint64_t start, uint64_t end, apex::cuda_thread_node &node,
-        std::string category, bool reverseFlow = false, bool otf2_trace = true) {
-    apex::in_apex prevent_deadlocks;
-    // Get the singleton APEX instance
-    static apex::apex* instance = apex::apex::instance();
+/* The activity from one buffer is delivered to the listeners in a batch,
+ * after the whole buffer has been decoded. */
+typedef apex::async_activity_batch<apex::cuda_thread_node> cuda_activity_batch;
+
+void store_profiler_data(cuda_activity_batch &batch, apex::task_identifier * id,
+        uint32_t correlationId, uint64_t start, uint64_t end,
+        apex::cuda_thread_node &node, std::string category,
+        bool reverseFlow = false, bool otf2_trace = true) {
     // get the parent GUID, then erase the correlation from the map
     std::shared_ptr<apex::task_wrapper> parent = nullptr;
     apex::async_event_data as_data;
@@ -504,49 +507,23 @@ void store_profiler_data(const std::string &name, uint32_t correlationId,
         correlation_kernel_data_map.erase(correlationId);
         map_mutex.unlock();
     }
-    // Build the name
-    std::stringstream ss;
-    ss << "GPU: " << std::string(name);
-    std::string tmp{ss.str()};
-    // create a task_wrapper, as a GPU child of the parent on the CPU side
-    auto tt = apex::new_task(tmp, UINT64_MAX, parent);
-    // create an APEX profiler to store this data - we can't start
-    // then stop because we have timestamps already.
-    auto prof = std::make_shared<apex::profiler>(tt);
-    prof->set_start(start + deltaTimestamp);
-    prof->set_end(end + deltaTimestamp);
-    // important!  Otherwise we might get the wrong end timestamp.
-    prof->stopped = true;
-    // fake out the profiler_listener
-    instance->the_profiler_listener->push_profiler_public(prof);
-    // Handle tracing, if necessary
-#if defined(APEX_WITH_PERFETTO)
-    if (apex::apex_options::use_perfetto()) {
-        apex::perfetto_listener * tel =
-            (apex::perfetto_listener*)instance->the_perfetto_listener;
-        as_data.cat = category;
-        as_data.reverse_flow = reverseFlow;
-        tel->on_async_event(node, prof, as_data);
-    }
-#endif
-    if (apex::apex_options::use_trace_event()) {
-        apex::trace_event_listener * tel =
-            (apex::trace_event_listener*)instance->the_trace_event_listener;
-        as_data.cat = category;
-        as_data.reverse_flow = reverseFlow;
-        tel->on_async_event(node, prof, as_data);
-    }
-#ifdef APEX_HAVE_OTF2
-    if (apex::apex_options::use_otf2() && otf2_trace) {
-        apex::otf2_listener * tol =
-            (apex::otf2_listener*)instance->the_otf2_listener;
-        tol->on_async_event(node, prof);
-    }
-#else
-    APEX_UNUSED(otf2_trace);
-#endif
-    // have the listeners handle the end of this task
-    instance->complete_task(tt);
+    as_data.cat = category;
+    as_data.reverse_flow = reverseFlow;
+    // a GPU child of the parent on the CPU side
+    batch.add_activity(node, id, start + deltaTimestamp, end + deltaTimestamp,
+        parent, as_data, otf2_trace);
+}
+
+void store_profiler_data(cuda_activity_batch &batch, const std::string &name,
+        uint32_t correlationId, uint64_t start, uint64_t end,
+        apex::cuda_thread_node &node, std::string category,
+        bool reverseFlow = false, bool otf2_trace = true) {
+    static apex::async_name_cache<std::string> names;
+    apex::task_identifier * id = names.get(name, [&]() {
+        return std::string("GPU: ") + name;
+    });
+    store_profiler_data(batch, id, correlationId, start, end, node,
+        category, reverseFlow, otf2_trace);
 }
 
 /* Handle counters from synchronous callbacks */
@@ -565,63 +542,44 @@ void store_sync_counter_data(const char * name, const std::string& context,
 }
 
 /* Handle counters from asynchronous activity */
-void store_counter_data(const char * name, const std::string& ctx,
-    uint64_t end, double value, apex::cuda_thread_node &node, bool force = false) {
-    apex::in_apex prevent_deadlocks;
-    std::stringstream ss;
-    if (name == nullptr) {
-        ss << ctx;
-    } else {
+void store_counter_data(cuda_activity_batch &batch, const char * name,
+    const std::string& ctx, uint64_t end, double value,
+    apex::cuda_thread_node &node, bool force = false) {
+    static apex::async_name_cache<std::tuple<std::string, std::string, bool> >
+        names;
+    apex::task_identifier * id = names.get(std::make_tuple(
+        std::string(name == nullptr ? "" : name), ctx, force), [&]() {
+        std::stringstream ss;
+        if (name == nullptr) {
+            ss << ctx;
+        } else {
+            ss << name;
+            if (apex::apex_options::use_cuda_kernel_details() || force) {
+                ss << ": " << ctx;
+            }
+        }
+        return ss.str();
+    });
+    batch.add_counter(node, id, end + deltaTimestamp, value);
+}
+
+/* Kernel counters are keyed by the kernel name, which CUPTI shares
+ * between the records for the same kernel, so the name is only
+ * demangled the first time. */
+void store_kernel_counter_data(cuda_activity_batch &batch,
+    const char * name, const char * kernel, uint64_t end, double value,
+    apex::cuda_thread_node &node) {
+    static apex::async_name_cache<std::pair<const char*, const char*> > names;
+    apex::task_identifier * id = names.get(std::make_pair(name, kernel),
+        [&]() {
+        std::stringstream ss;
         ss << name;
-        if (apex::apex_options::use_cuda_kernel_details() || force) {
-            ss << ": " << ctx;
+        if (apex::apex_options::use_cuda_kernel_details()) {
+            ss << ": " << apex::demangle(kernel);
         }
-    }
-    std::string tmp{ss.str()};
-    auto task_id = apex::task_identifier::get_task_id(tmp);
-    std::shared_ptr<apex::profiler> prof =
-        std::make_shared<apex::profiler>(task_id, value);
-    prof->is_counter = true;
-    prof->set_end(end + deltaTimestamp);
-    // Get the singleton APEX instance
-    static apex::apex* instance = apex::apex::instance();
-    // fake out the profiler_listener
-    instance->the_profiler_listener->push_profiler_public(prof);
-    // Handle tracing, if necessary
-#if defined(APEX_WITH_PERFETTO)
-    if (apex::apex_options::use_perfetto()) {
-        apex::perfetto_listener * tel =
-            (apex::perfetto_listener*)instance->the_perfetto_listener;
-        tel->on_async_metric(node, prof);
-    }
-#endif
-    if (apex::apex_options::use_trace_event()) {
-        apex::trace_event_listener * tel =
-            (apex::trace_event_listener*)instance->the_trace_event_listener;
-        tel->on_async_metric(node, prof);
-    }
-#ifdef APEX_HAVE_OTF2
-    if (apex::apex_options::use_otf2()) {
-        apex::otf2_listener * tol =
-            (apex::otf2_listener*)instance->the_otf2_listener;
-        tol->on_async_metric(node, prof);
-    }
-#endif
-}
-
-void store_counter_data(const char * name, const std::string& ctx,
-    uint64_t end, int32_t value, apex::cuda_thread_node &node, bool force = false) {
-    store_counter_data(name, ctx, end, (double)(value), node, force);
-}
-
-void store_counter_data(const char * name, const std::string& ctx,
-    uint64_t end, uint32_t value, apex::cuda_thread_node &node, bool force = false) {
-    store_counter_data(name, ctx, end, (double)(value), node, force);
-}
-
-void store_counter_data(const char * name, const std::string& ctx,
-    uint64_t end, uint64_t value, apex::cuda_thread_node &node, bool force = false) {
-    store_counter_data(name, ctx, end, (double)(value), node, force);
+        return ss.str();
+    });
+    batch.add_counter(node, id, end + deltaTimestamp, value);
 }
 
 static const char * getMemcpyKindString(uint8_t kind)
@@ -781,7 +739,8 @@ static void contextActivity(CUpti_Activity *record) {
 }
 #endif
 
-static void memcpyActivity2(CUpti_Activity *record) {
+static void memcpyActivity2(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     CUpti_ActivityMemcpy2 *memcpy = (CUpti_ActivityMemcpy2 *) record;
     std::stringstream ss;
     ss << getMemcpyKindString(memcpy->copyKind) << " "
@@ -789,11 +748,11 @@ static void memcpyActivity2(CUpti_Activity *record) {
     std::string name{ss.str()};
     apex::cuda_thread_node node(memcpy->deviceId, memcpy->contextId,
         memcpy->streamId, APEX_ASYNC_MEMORY);
-    store_profiler_data(name, memcpy->correlationId, memcpy->start,
+    store_profiler_data(batch, name, memcpy->correlationId, memcpy->start,
             memcpy->end, node, "DataFlow",
             memcpy->copyKind == CUPTI_ACTIVITY_MEMCPY_KIND_DTOH);
     if (apex::apex_options::use_cuda_counters()) {
-        store_counter_data("GPU: Bytes", name, memcpy->end,
+        store_counter_data(batch, "GPU: Bytes", name, memcpy->end,
             memcpy->bytes, node, true);
         // (1024 * 1024 * 1024) / 1,000,000,000
         // constexpr double GIGABYTES{1.073741824};
@@ -801,24 +760,25 @@ static void memcpyActivity2(CUpti_Activity *record) {
         double gbytes = (double)(memcpy->bytes); // / GIGABYTES;
         // dividing bytes by nanoseconds should give us GB/s
         double bandwidth = gbytes / duration;
-        store_counter_data("GPU: Bandwidth (GB/s)", name,
+        store_counter_data(batch, "GPU: Bandwidth (GB/s)", name,
             memcpy->end, bandwidth, node, true);
     }
 }
 
-static void memcpyActivity(CUpti_Activity *record) {
+static void memcpyActivity(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     CUpti_ActivityMemcpy *memcpy = (CUpti_ActivityMemcpy *) record;
     if (memcpy->copyKind == CUPTI_ACTIVITY_MEMCPY_KIND_DTOD) {
-        return memcpyActivity2(record);
+        return memcpyActivity2(record, batch);
     }
     std::string name{getMemcpyKindString(memcpy->copyKind)};
     apex::cuda_thread_node node(memcpy->deviceId, memcpy->contextId,
         memcpy->streamId, APEX_ASYNC_MEMORY);
-    store_profiler_data(name, memcpy->correlationId, memcpy->start,
+    store_profiler_data(batch, name, memcpy->correlationId, memcpy->start,
             memcpy->end, node, "DataFlow",
             memcpy->copyKind == CUPTI_ACTIVITY_MEMCPY_KIND_DTOH);
     if (apex::apex_options::use_cuda_counters()) {
-        store_counter_data("GPU: Bytes", name, memcpy->end,
+        store_counter_data(batch, "GPU: Bytes", name, memcpy->end,
             memcpy->bytes, node, true);
         // (1024 * 1024 * 1024) / 1,000,000,000
         // constexpr double GIGABYTES{1.073741824};
@@ -826,12 +786,13 @@ static void memcpyActivity(CUpti_Activity *record) {
         double gbytes = (double)(memcpy->bytes); // / GIGABYTES;
         // dividing bytes by nanoseconds should give us GB/s
         double bandwidth = gbytes / duration;
-        store_counter_data("GPU: Bandwidth (GB/s)", name,
+        store_counter_data(batch, "GPU: Bandwidth (GB/s)", name,
             memcpy->end, bandwidth, node, true);
     }
 }
 
-static void unifiedMemoryActivity(CUpti_Activity *record) {
+static void unifiedMemoryActivity(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     CUpti_ActivityUnifiedMemoryCounter2 *memcpy =
         (CUpti_ActivityUnifiedMemoryCounter2 *) record;
     std::string name{getUvmCounterKindString(memcpy->counterKind)};
@@ -845,9 +806,9 @@ static void unifiedMemoryActivity(CUpti_Activity *record) {
             CUPTI_ACTIVITY_UNIFIED_MEMORY_COUNTER_KIND_BYTES_TRANSFER_DTOH) {
         // The context isn't available, and the streamID isn't valid
         // (per CUPTI documentation)
-        store_profiler_data(name, 0, memcpy->start, memcpy->end, node, "DataFlow");
+        store_profiler_data(batch, name, 0, memcpy->start, memcpy->end, node, "DataFlow");
         if (apex::apex_options::use_cuda_counters()) {
-            store_counter_data("GPU: Bytes", name, memcpy->end,
+            store_counter_data(batch, "GPU: Bytes", name, memcpy->end,
                     memcpy->value, node, true);
             // (1024 * 1024 * 1024) / 1,000,000,000
             constexpr double GIGABYTES{1.073741824};
@@ -855,125 +816,136 @@ static void unifiedMemoryActivity(CUpti_Activity *record) {
             double gbytes = (double)(memcpy->value) / GIGABYTES;
             // dividing bytes by nanoseconds should give us GB/s
             double bandwidth = gbytes / duration;
-            store_counter_data("GPU: Bandwidth (GB/s)", name,
+            store_counter_data(batch, "GPU: Bandwidth (GB/s)", name,
                     memcpy->end, bandwidth, node, true);
         }
     } else if (memcpy->counterKind ==
             CUPTI_ACTIVITY_UNIFIED_MEMORY_COUNTER_KIND_THROTTLING) {
-        store_profiler_data(name, 0, memcpy->start, memcpy->end, node, "DataFlow");
+        store_profiler_data(batch, name, 0, memcpy->start, memcpy->end, node, "DataFlow");
     } else if (memcpy->counterKind ==
             CUPTI_ACTIVITY_UNIFIED_MEMORY_COUNTER_KIND_GPU_PAGE_FAULT) {
-        store_profiler_data(name, 0, memcpy->start, memcpy->end, node, "DataFlow");
-        store_counter_data("Groups for same page", name, memcpy->end,
+        store_profiler_data(batch, name, 0, memcpy->start, memcpy->end, node, "DataFlow");
+        store_counter_data(batch, "Groups for same page", name, memcpy->end,
                 memcpy->value, node);
     /*
     } else if (memcpy->counterKind ==
             CUPTI_ACTIVITY_UNIFIED_MEMORY_COUNTER_KIND_CPU_PAGE_FAULT_COUNT) {
-        store_counter_data(nullptr, name, memcpy->start,
+        store_counter_data(batch, nullptr, name, memcpy->start,
                 1, node);
     */
     }
 }
 
-static void memsetActivity(CUpti_Activity *record) {
+static void memsetActivity(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     CUpti_ActivityMemset *memset = (CUpti_ActivityMemset *) record;
     const std::string name{"Memset"};
     apex::cuda_thread_node node(memset->deviceId, memset->contextId,
             memset->streamId, APEX_ASYNC_MEMORY);
-    store_profiler_data(name, memset->correlationId, memset->start,
+    store_profiler_data(batch, name, memset->correlationId, memset->start,
             memset->end, node, "DataFlow");
 }
 
-static void kernelActivity(CUpti_Activity *record) {
+static void kernelActivity(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     CUpti_ActivityKernel4 *kernel =
         (CUpti_ActivityKernel4 *) record;
-    std::string tmp = std::string(kernel->name);
+    static apex::async_name_cache<const char*> kernel_names;
+    apex::task_identifier * id = kernel_names.get(kernel->name, [&]() {
+        return std::string("GPU: ") + kernel->name;
+    });
     //DEBUG_PRINT("Kernel CorrelationId: %u\n", kernel->correlationId);
     apex::cuda_thread_node node(kernel->deviceId, kernel->contextId,
             kernel->streamId, APEX_ASYNC_KERNEL);
-    store_profiler_data(tmp, kernel->correlationId, kernel->start,
+    store_profiler_data(batch, id, kernel->correlationId, kernel->start,
             kernel->end, node, "ControlFlow");
     if (apex::apex_options::use_cuda_counters()) {
-        std::string demangled = apex::demangle(kernel->name);
-        store_counter_data("GPU: Dynamic Shared Memory (B)",
-                demangled, kernel->end, kernel->dynamicSharedMemory, node);
-        store_counter_data("GPU: Local Memory Per Thread (B)",
-                demangled, kernel->end, kernel->localMemoryPerThread, node);
-        store_counter_data("GPU: Local Memory Total (B)",
-                demangled, kernel->end, kernel->localMemoryTotal, node);
-        store_counter_data("GPU: Registers Per Thread",
-                demangled, kernel->end, kernel->registersPerThread, node);
-        store_counter_data("GPU: Shared Memory Size (B)",
-                demangled, kernel->end, kernel->sharedMemoryExecuted, node);
-        store_counter_data("GPU: Static Shared Memory (B)",
-                demangled, kernel->end, kernel->staticSharedMemory, node);
+        const char * k = kernel->name;
+        store_kernel_counter_data(batch, "GPU: Dynamic Shared Memory (B)",
+                k, kernel->end, kernel->dynamicSharedMemory, node);
+        store_kernel_counter_data(batch, "GPU: Local Memory Per Thread (B)",
+                k, kernel->end, kernel->localMemoryPerThread, node);
+        store_kernel_counter_data(batch, "GPU: Local Memory Total (B)",
+                k, kernel->end, kernel->localMemoryTotal, node);
+        store_kernel_counter_data(batch, "GPU: Registers Per Thread",
+                k, kernel->end, kernel->registersPerThread, node);
+        store_kernel_counter_data(batch, "GPU: Shared Memory Size (B)",
+                k, kernel->end, kernel->sharedMemoryExecuted, node);
+        store_kernel_counter_data(batch, "GPU: Static Shared Memory (B)",
+                k, kernel->end, kernel->staticSharedMemory, node);
         /* Get grid and block values */
         if (apex::apex_options::use_cuda_kernel_details()) {
-            store_counter_data("GPU: blockX",
-                demangled, kernel->end, kernel->blockX, node);
-            store_counter_data("GPU: blockY",
-                demangled, kernel->end, kernel->blockY, node);
-            store_counter_data("GPU: blockZ",
-                demangled, kernel->end, kernel->blockZ, node);
-            store_counter_data("GPU: gridX",
-                demangled, kernel->end, kernel->gridX, node);
-            store_counter_data("GPU: gridY",
-                demangled, kernel->end, kernel->gridY, node);
-            store_counter_data("GPU: gridZ",
-                demangled, kernel->end, kernel->gridZ, node);
+            store_kernel_counter_data(batch, "GPU: blockX",
+                k, kernel->end, kernel->blockX, node);
+            store_kernel_counter_data(batch, "GPU: blockY",
+                k, kernel->end, kernel->blockY, node);
+            store_kernel_counter_data(batch, "GPU: blockZ",
+                k, kernel->end, kernel->blockZ, node);
+            store_kernel_counter_data(batch, "GPU: gridX",
+                k, kernel->end, kernel->gridX, node);
+            store_kernel_counter_data(batch, "GPU: gridY",
+                k, kernel->end, kernel->gridY, node);
+            store_kernel_counter_data(batch, "GPU: gridZ",
+                k, kernel->end, kernel->gridZ, node);
             if (kernel->queued != CUPTI_TIMESTAMP_UNKNOWN) {
-                store_counter_data("GPU: queue delay (us)",
-                    demangled, kernel->end,
+                store_kernel_counter_data(batch, "GPU: queue delay (us)",
+                    k, kernel->end,
                     (kernel->start - kernel->queued)*1.0e-3, node);
             }
             if (kernel->submitted != CUPTI_TIMESTAMP_UNKNOWN) {
-                store_counter_data("GPU: submit delay (us)",
-                    demangled, kernel->end,
+                store_kernel_counter_data(batch, "GPU: submit delay (us)",
+                    k, kernel->end,
                     (kernel->start - kernel->submitted)*1.0e-3, node);
             }
         }
     }
 }
 
-static void openaccDataActivity(CUpti_Activity *record) {
+static void openaccDataActivity(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     CUpti_ActivityOpenAccData *data = (CUpti_ActivityOpenAccData *) record;
     std::string label{openacc_event_names[data->eventKind]};
     apex::cuda_thread_node node(data->cuDeviceId, data->cuContextId,
         data->cuStreamId, APEX_ASYNC_MEMORY);
-    store_profiler_data(label, data->externalId, data->start, data->end, node, "DataFlow");
+    store_profiler_data(batch, label, data->externalId, data->start, data->end, node, "DataFlow");
     const std::string bytes{"Bytes Transferred"};
-    store_counter_data(label.c_str(), bytes, data->end, data->bytes, node);
+    store_counter_data(batch, label.c_str(), bytes, data->end, data->bytes, node);
 }
 
-static void openaccKernelActivity(CUpti_Activity *record) {
+static void openaccKernelActivity(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     CUpti_ActivityOpenAccLaunch *data = (CUpti_ActivityOpenAccLaunch *) record;
     std::string label{openacc_event_names[data->eventKind]};
     apex::cuda_thread_node node(data->cuDeviceId, data->cuContextId,
         data->cuStreamId, APEX_ASYNC_KERNEL);
-    store_profiler_data(label, data->externalId, data->start,
+    store_profiler_data(batch, label, data->externalId, data->start,
             data->end, node, "ControlFlow");
     const std::string gangs{"Num Gangs"};
-    store_counter_data(label.c_str(), gangs, data->end, data->numGangs, node);
+    store_counter_data(batch, label.c_str(), gangs, data->end, data->numGangs, node);
     const std::string workers{"Num Workers"};
-    store_counter_data(label.c_str(), workers, data->end, data->numWorkers, node);
+    store_counter_data(batch, label.c_str(), workers, data->end, data->numWorkers, node);
     const std::string lanes{"Num Vector Lanes"};
-    store_counter_data(label.c_str(), lanes, data->end, data->vectorLength, node);
+    store_counter_data(batch, label.c_str(), lanes, data->end, data->vectorLength, node);
 }
 
-static void openaccOtherActivity(CUpti_Activity *record) {
+static void openaccOtherActivity(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     CUpti_ActivityOpenAccOther *data = (CUpti_ActivityOpenAccOther *) record;
     std::string label{openacc_event_names[data->eventKind]};
     apex::cuda_thread_node node(data->cuDeviceId, data->cuContextId,
         data->cuStreamId, APEX_ASYNC_OTHER);
-    store_profiler_data(label, data->externalId, data->start, data->end, node, "OtherFlow");
+    store_profiler_data(batch, label, data->externalId, data->start, data->end, node, "OtherFlow");
 }
 
-static void openmpActivity(CUpti_Activity *record) {
+static void openmpActivity(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     CUpti_ActivityOpenMp *data = (CUpti_ActivityOpenMp *) record;
     std::string label{openmp_event_names[data->eventKind]};
+    APEX_UNUSED(batch);
 }
 
-static void syncActivity(CUpti_Activity *record) {
+static void syncActivity(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     // when tracking memory allocations, ignore the ones in cuda device synchronize
     CUpti_ActivitySynchronization *data =
         (CUpti_ActivitySynchronization *) record;
@@ -996,13 +968,14 @@ static void syncActivity(CUpti_Activity *record) {
      * and can overlap.  So if we are OTF2 tracing, ignore them. */
     if (apex::apex_options::use_otf2() &&
         data->type == CUPTI_ACTIVITY_SYNCHRONIZATION_TYPE_EVENT_SYNCHRONIZE) {
-        store_profiler_data(label, data->correlationId, data->start, data->end, node, "SyncFlow", false, false);
+        store_profiler_data(batch, label, data->correlationId, data->start, data->end, node, "SyncFlow", false, false);
     } else {
-        store_profiler_data(label, data->correlationId, data->start, data->end, node, "SyncFlow");
+        store_profiler_data(batch, label, data->correlationId, data->start, data->end, node, "SyncFlow");
     }
 }
 
-static void printActivity(CUpti_Activity *record) {
+static void printActivity(CUpti_Activity *record,
+    cuda_activity_batch &batch) {
     //auto p = apex::scoped_timer("APEX: CUPTI printActivity");
     switch (record->kind)
     {
@@ -1022,16 +995,16 @@ static void printActivity(CUpti_Activity *record) {
 #endif
         case CUPTI_ACTIVITY_KIND_MEMCPY:
         {
-            memcpyActivity(record);
+            memcpyActivity(record, batch);
             break;
         }
         case CUPTI_ACTIVITY_KIND_MEMCPY2:
         {
-            memcpyActivity2(record);
+            memcpyActivity2(record, batch);
             break;
         }
         case CUPTI_ACTIVITY_KIND_UNIFIED_MEMORY_COUNTER: {
-            unifiedMemoryActivity(record);
+            unifiedMemoryActivity(record, batch);
             break;
         }
 #if 0 // not until CUDA 11
@@ -1042,37 +1015,37 @@ static void printActivity(CUpti_Activity *record) {
         }
 #endif
         case CUPTI_ACTIVITY_KIND_MEMSET: {
-            memsetActivity(record);
+            memsetActivity(record, batch);
             break;
         }
         case CUPTI_ACTIVITY_KIND_KERNEL:
         case CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL:
         case CUPTI_ACTIVITY_KIND_CDP_KERNEL:
         {
-            kernelActivity(record);
+            kernelActivity(record, batch);
             break;
         }
         case CUPTI_ACTIVITY_KIND_OPENACC_DATA: {
             DEBUG_PRINT("OpenACC Data!\n");
-            openaccDataActivity(record);
+            openaccDataActivity(record, batch);
             break;
         }
         case CUPTI_ACTIVITY_KIND_OPENACC_LAUNCH: {
             DEBUG_PRINT("OpenACC Launch!\n");
-            openaccKernelActivity(record);
+            openaccKernelActivity(record, batch);
             break;
         }
         case CUPTI_ACTIVITY_KIND_OPENACC_OTHER: {
             DEBUG_PRINT("OpenACC Other!\n");
-            openaccOtherActivity(record);
+            openaccOtherActivity(record, batch);
             break;
         }
         case CUPTI_ACTIVITY_KIND_OPENMP: {
-            openmpActivity(record);
+            openmpActivity(record, batch);
             break;
         }
         case CUPTI_ACTIVITY_KIND_SYNCHRONIZATION: {
-            syncActivity(record);
+            syncActivity(record, batch);
             break;
         }
         default:
@@ -1119,10 +1092,11 @@ void CUPTIAPI bufferCompleted(CUcontext ctx, uint32_t streamId,
     APEX_UNUSED(size);
 
     if (validSize > 0) {
+        cuda_activity_batch batch;
         do {
             status = cuptiActivityGetNextRecord(buffer, validSize, &record);
             if (status == CUPTI_SUCCESS) {
-                printActivity(record);
+                printActivity(record, batch);
             }
             else if (status == CUPTI_ERROR_MAX_LIMIT_REACHED)
                 break;
@@ -1130,6 +1104,7 @@ void CUPTIAPI bufferCompleted(CUcontext ctx, uint32_t streamId,
                 CUPTI_CALL(status);
             }
         } while (1);
+        batch.flush();
 
         // report any records dropped from the queue
         size_t dropped;
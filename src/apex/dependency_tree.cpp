@@ -11,6 +11,7 @@
 #include <iomanip>
 #include <sstream>
 #include <math.h>
+#include <limits>
 #include "apex_assert.h"
 #include "apex.hpp"
 
@@ -337,80 +338,74 @@ void Node::addAccumulated(double value, double incl, bool is_resume, uint64_t th
     m.unlock();
 }
 
-double Node::writeNodeCSV(std::stringstream& outfile, double total, int node_id, int num_papi_counters) {
-    static size_t depth = 0;
+const size_t nodeRow::values_per_metric;
+
+/* Compute the values of this node's row of the task tree. */
+void Node::getRow(double total, size_t depth, nodeRow& row) {
     APEX_ASSERT(total > 0.0);
-    // write out the node id and graph node index and the name
-    outfile << node_id << "," << index << ",";
-    outfile << ((parent == nullptr) ? 0 : parent->index) << ",";
-    outfile << depth << ",\"";
-    outfile << data->get_tree_name() << "\",";
-    // write out the accumulated
-    double acc = (data == task_identifier::get_main_task_id() || getAccumulated() == 0.0) ?
-        total : getAccumulated();
-    // write the number of calls
+    row.depth = depth;
+    row.parent_index = (parent == nullptr) ? 0 : parent->index;
+    row.accumulated = (data == task_identifier::get_main_task_id() ||
+        getAccumulated() == 0.0) ? total : getAccumulated();
     double ncalls = (getCalls() == 0) ? 1 : getCalls();
-    outfile << std::fixed << std::setprecision(0) << ncalls << ",";
-    outfile << thread_ids.size() << ",";
-    // write other stats - min, max, stddev
-    double mean = acc / ncalls;
-    outfile << std::setprecision(9);
-    outfile << acc << ",";
-    outfile << inclusive << ",";
-    outfile << getMinimum() << ",";
-    outfile << mean << ",";
-    outfile << getMaximum() << ",";
+    row.calls = ncalls;
+    row.threads = thread_ids.size();
+    row.inclusive = inclusive;
+    row.minimum = getMinimum();
+    row.mean = row.accumulated / ncalls;
+    row.maximum = getMaximum();
     // avoid -0.0 which will cause a -nan for stddev
-    double variance = std::max(0.0,((getSumSquares() / ncalls) - (mean * mean)));
-    double stddev = sqrt(variance);
-    outfile << stddev;
-    // write the papi metrics
-    for (int m = 0 ; m < num_papi_counters ; m++) {
-        outfile << "," << prof.papi_metrics[m];
-    }
-
-    // write any available metrics
+    double variance = std::max(0.0,((getSumSquares() / ncalls) -
+        (row.mean * row.mean)));
+    row.stddev = sqrt(variance);
+    row.has_metric.clear();
+    row.metrics.clear();
     for (auto& x : known_metrics) {
-        if (metric_map.find(x) == metric_map.end()) {
-            outfile << ",,,,,,,";
-        } else {
-            const auto& value = metric_map.find(x);
-            const auto& p = value->second.prof;
-            outfile << "," << p.accumulated;
-            outfile << "," << p.minimum;
-            double mean = p.accumulated/ncalls;
-            outfile << "," << mean;
-            outfile << "," << p.maximum;
-            // compute the standard deviation
-            double t1 = p.sum_squares / ncalls;
-            double t2 = mean * mean;
-            double t3 = t1 - t2;
-            variance = std::max(0.0,(t3));
-            stddev = sqrt(variance);
-            outfile << "," << stddev;
-            // find the median
-            auto& d = value->second.distribution;
-            // how many do we have?
-            size_t total = 0;
-            double mode = 0;
-            double median = 0;
-            size_t half = (size_t)(ncalls/2.0);
-            size_t most = 0;
-            for (auto& node : d) {
-                total += node.second;
-                if (total >= half) { median = node.first; break; }
-            }
-            for (auto& node : d) {
-                if (node.second > most) { mode = node.first; }
-            }
-            outfile << "," << median;
-            outfile << "," << mode;
+        const auto& value = metric_map.find(x);
+        if (value == metric_map.end()) {
+            row.has_metric.push_back(false);
+            row.metrics.insert(row.metrics.end(), nodeRow::values_per_metric,
+                0.0);
+            continue;
         }
+        row.has_metric.push_back(true);
+        const auto& p = value->second.prof;
+        double mean = p.accumulated/ncalls;
+        // compute the standard deviation
+        double variance = std::max(0.0,((p.sum_squares / ncalls) - (mean * mean)));
+        // find the median and mode
+        auto& d = value->second.distribution;
+        size_t count = 0;
+        double mode = 0;
+        double median = 0;
+        size_t half = (size_t)(ncalls/2.0);
+        size_t most = 0;
+        for (auto& node : d) {
+            count += node.second;
+            if (count >= half) { median = node.first; break; }
+        }
+        for (auto& node : d) {
+            if (node.second > most) { mode = node.first; }
+        }
+        row.metrics.push_back(p.accumulated);
+        row.metrics.push_back(p.minimum);
+        row.metrics.push_back(mean);
+        row.metrics.push_back(p.maximum);
+        row.metrics.push_back(sqrt(variance));
+        row.metrics.push_back(median);
+        row.metrics.push_back(mode);
     }
-    // end the line
-    outfile << std::endl;
+}
+
+/* Write the row of this node, then the rows of its children, sorted
+ * by name to make tree merging easier (I hope). */
+double Node::writeRows(double total,
+    const std::function<void(const Node&, const nodeRow&)>& write) {
+    static size_t depth = 0;
+    nodeRow row;
+    getRow(total, depth, row);
+    write(*this, row);
 
-    // sort the children by name to make tree merging easier (I hope)
     std::vector<Node*> sorted;
     for (auto& it : children) {
         sorted.push_back(it.second);
@@ -418,16 +413,81 @@ double Node::writeNodeCSV(std::stringstream& outfile, double total, int node_id,
     sort(sorted.begin(), sorted.end(), Node::compareNodeByParentName);
 
     // do all the children
-    double remainder = acc;
     depth++;
     for (auto c : sorted) {
-        //double tmp = c->writeNodeCSV(outfile, total, node_id, num_papi_counters);
         /* OMPT target handling with 0 length events is giving me headaches... */
-        double tmp = c->writeNodeCSV(outfile, acc, node_id, num_papi_counters);
-        remainder = remainder - tmp;
+        c->writeRows(row.accumulated, write);
     }
     depth--;
-    return acc;
+    return row.accumulated;
+}
+
+double Node::writeNodeCSV(std::stringstream& outfile, double total, int node_id, int num_papi_counters) {
+    return writeRows(total, [&](const Node& n, const nodeRow& row) {
+        // write out the node id and graph node index and the name
+        outfile << node_id << "," << n.index << ",";
+        outfile << row.parent_index << ",";
+        outfile << row.depth << ",\"";
+        outfile << n.data->get_tree_name() << "\",";
+        // write the number of calls
+        outfile << std::fixed << std::setprecision(0) << row.calls << ",";
+        outfile << n.thread_ids.size() << ",";
+        // write other stats - min, max, stddev
+        outfile << std::setprecision(9);
+        outfile << row.accumulated << ",";
+        outfile << row.inclusive << ",";
+        outfile << row.minimum << ",";
+        outfile << row.mean << ",";
+        outfile << row.maximum << ",";
+        outfile << row.stddev;
+        // write the papi metrics
+        for (int m = 0 ; m < num_papi_counters ; m++) {
+            outfile << "," << n.prof.papi_metrics[m];
+        }
+        // write any available metrics
+        for (size_t i = 0 ; i < row.has_metric.size() ; i++) {
+            for (size_t v = 0 ; v < nodeRow::values_per_metric ; v++) {
+                outfile << ",";
+                if (row.has_metric[i]) {
+                    outfile << row.metrics[i * nodeRow::values_per_metric + v];
+                }
+            }
+        }
+        // end the line
+        outfile << std::endl;
+    });
+}
+
+/* Same rows as writeNodeCSV, appended to the columns in the order that
+ * profiler_listener::write_tasktree() adds them. */
+double Node::writeNodeColumns(columnar_table& table, double total, int node_id, int num_papi_counters) {
+    // missing metrics are NaN, like the empty CSV fields
+    const double missing = std::numeric_limits<double>::quiet_NaN();
+    return writeRows(total, [&](const Node& n, const nodeRow& row) {
+        size_t c = 0;
+        table.append_uint(c++, node_id);
+        table.append_uint(c++, n.index);
+        table.append_uint(c++, row.parent_index);
+        table.append_uint(c++, row.depth);
+        table.append_string(c++, n.data->get_tree_name());
+        table.append_double(c++, row.calls);
+        table.append_double(c++, row.threads);
+        table.append_double(c++, row.accumulated);
+        table.append_double(c++, row.inclusive);
+        table.append_double(c++, row.minimum);
+        table.append_double(c++, row.mean);
+        table.append_double(c++, row.maximum);
+        table.append_double(c++, row.stddev);
+        for (int m = 0 ; m < num_papi_counters ; m++) {
+            table.append_double(c++, n.prof.papi_metrics[m]);
+        }
+        for (size_t i = 0 ; i < row.has_metric.size() ; i++) {
+            for (size_t v = 0 ; v < nodeRow::values_per_metric ; v++) {
+                table.append_double(c++, row.has_metric[i] ?
+                    row.metrics[i * nodeRow::values_per_metric + v] : missing);
+            }
+        }
+    });
 }
 
 void Node::addMetrics(std::map<std::string, double>& _metric_map) {
@@ -14,8 +14,11 @@
 #include <atomic>
 #include <set>
 #include <map>
+#include <vector>
+#include <functional>
 #include "apex_types.h"
 #include "task_identifier.hpp"
+#include "columnar_table.hpp"
 
 namespace apex {
 
@@ -45,6 +48,29 @@ public:
     }
 };
 
+class Node;
+
+/* The values of one row of the task tree, as written by
+ * Node::writeNodeCSV() and Node::writeNodeColumns(). */
+class nodeRow {
+public:
+    size_t depth;
+    size_t parent_index;
+    double accumulated;
+    double calls;
+    double threads;
+    double inclusive;
+    double minimum;
+    double mean;
+    double maximum;
+    double stddev;
+    /* For each known metric, whether this node has it, and if so its
+     * accumulated, minimum, mean, maximum, stddev, median and mode. */
+    static const size_t values_per_metric = 7;
+    std::vector<bool> has_metric;
+    std::vector<double> metrics;
+};
+
 class Node {
     private:
         task_identifier* data;
@@ -65,6 +91,9 @@ class Node {
         static std::mutex treeMutex;
         static std::atomic<size_t> nodeCount;
         static std::set<std::string> known_metrics;
+        void getRow(double total, size_t depth, nodeRow& row);
+        double writeRows(double total,
+            const std::function<void(const Node&, const nodeRow&)>& write);
     public:
         Node(task_identifier* id, Node* p) :
             data(id), parent(p), count(1), inclusive(0),
@@ -101,6 +130,7 @@ class Node {
         void writeNode(std::ofstream& outfile, double total);
         double writeNodeASCII(std::ofstream& outfile, double total, size_t indent);
         double writeNodeCSV(std::stringstream& outfile, double total, int node_id, int num_papi_counters);
+        double writeNodeColumns(columnar_table& table, double total, int node_id, int num_papi_counters);
         double writeNodeJSON(std::ofstream& outfile, double total, size_t indent);
         void writeTAUCallpath(std::ofstream& outfile, std::string prefix);
         static size_t getNodeCount() {
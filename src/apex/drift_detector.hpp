@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace apex {
+
+/* Detects a lasting change in the cost of a converged tuning session,
+ * with a two-sided CUSUM test (Page, 1954).  The mean of the first few
+ * costs after convergence is the baseline, and every later cost is
+ * compared to it relative to a scale, so the same threshold works for any
+ * metric:
+ *   up   <- max(0, up   + (cost - baseline)/scale - tolerance)
+ *   down <- max(0, down - (cost - baseline)/scale - tolerance)
+ * and the cost has drifted when either sum passes the threshold.  Changes
+ * smaller than the tolerance never add up, and one outlier has to be
+ * larger than the threshold to trigger it.  The scale is |baseline|, so
+ * metrics that are negative (e.g. a negated throughput) work too, but at
+ * least the standard deviation of the warmup costs over the tolerance, so
+ * that changes within the warmup noise are ignored when the baseline is
+ * zero or close to it.  If the baseline and the deviation are both zero,
+ * the changes are compared as they are. */
+class drift_detector {
+private:
+    double tolerance;
+    double threshold;
+    size_t warmup;
+    size_t count;
+    double baseline;
+    double m2; // sum of squared differences from the warmup mean
+    double scale;
+    double up;
+    double down;
+public:
+    drift_detector(double tolerance = 0.1, double threshold = 1.0,
+        size_t warmup = 5) : tolerance(tolerance), threshold(threshold),
+        warmup(std::max(warmup, (size_t)(1))) { reset(); }
+    void set(double t, double h) {
+        tolerance = t;
+        threshold = h;
+    }
+    /* Start again with a new baseline, after the search is done */
+    void reset(void) {
+        count = 0;
+        baseline = 0.0;
+        m2 = 0.0;
+        scale = 1.0;
+        up = 0.0;
+        down = 0.0;
+    }
+    /* Add a cost, and return true if it has drifted */
+    bool add(double cost) {
+        if (count < warmup) {
+            double delta = cost - baseline;
+            baseline += delta / (double)(++count);
+            m2 += delta * (cost - baseline);
+            if (count == warmup) {
+                double noise = std::sqrt(m2 / (double)count);
+                scale = std::max(std::fabs(baseline),
+                    tolerance > 0.0 ? noise / tolerance : noise);
+                if (scale == 0.0) { scale = 1.0; }
+            }
+            return false;
+        }
+        double change = (cost - baseline) / scale;
+        up = std::max(0.0, up + change - tolerance);
+        down = std::max(0.0, down - change - tolerance);
+        return (up > threshold || down > threshold);
+    }
+    double get_baseline(void) const { return baseline; }
+};
+
+} // apex
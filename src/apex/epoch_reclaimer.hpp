@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "apex_types.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace apex {
+
+/* Epoch based reclamation, for structures that readers find with one
+ * atomic load and writers replace with a copy.  Each thread has its own
+ * slot per reclaimer, on its own cache line, where a reader writes the
+ * epoch it started in and clears it when it is done, so readers never
+ * write to shared memory.  A replaced object is retired with the current
+ * epoch, and the epoch moves on; it is freed once every thread that is
+ * still reading started after that.  Readers can nest. */
+class epoch_reclaimer {
+private:
+    struct slot {
+        /* padded on both sides, new doesn't align to a cache line */
+        char before[64];
+        /* the epoch the thread's outermost reader started in, or 0 */
+        std::atomic<uint64_t> epoch;
+        /* only used by the owning thread */
+        size_t depth;
+        char after[64];
+        slot(void) : epoch(0), depth(0) {}
+    };
+    /* unique per reclaimer, indexes the thread-local slot table */
+    static size_t next_index(void) {
+        static std::atomic<size_t> index(0);
+        return index++;
+    }
+    const size_t _index;
+    std::atomic<uint64_t> _epoch;
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<slot> > _slots;
+    std::vector<std::pair<uint64_t, std::shared_ptr<const void> > > _retired;
+    /* Indexes are never reused, so a stale entry for a destroyed
+     * reclaimer is never looked up again. */
+    slot& get_slot(void) {
+        /* never destroyed, readers can run during the thread's cleanup */
+        static APEX_NATIVE_TLS std::vector<slot*> * slots = nullptr;
+        if (slots == nullptr) { slots = new std::vector<slot*>(); }
+        if (slots->size() <= _index) {
+            slots->resize(_index + 1, nullptr);
+        }
+        slot * s = (*slots)[_index];
+        if (s == nullptr) {
+            s = new slot();
+            std::unique_lock<std::mutex> l(_mutex);
+            _slots.emplace_back(s);
+            (*slots)[_index] = s;
+        }
+        return *s;
+    }
+    /* Must be called while holding the mutex */
+    void reclaim_locked(void) {
+        if (_retired.empty()) { return; }
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (auto& s : _slots) {
+            uint64_t e = s->epoch.load();
+            if (e != 0 && e < oldest) { oldest = e; }
+        }
+        _retired.erase(std::remove_if(_retired.begin(), _retired.end(),
+            [=](const std::pair<uint64_t, std::shared_ptr<const void> >& r) {
+                return r.first < oldest; }), _retired.end());
+    }
+public:
+    epoch_reclaimer(void) : _index(next_index()), _epoch(1) {}
+    epoch_reclaimer(epoch_reclaimer const&) = delete;
+    void operator=(epoch_reclaimer const&) = delete;
+    /* Scoped reader: everything loaded while it is alive stays valid */
+    class guard {
+    private:
+        slot& _slot;
+    public:
+        guard(epoch_reclaimer& r) : _slot(r.get_slot()) {
+            if (_slot.depth++ == 0) {
+                /* sequentially consistent, so it is visible before the
+                 * reader's loads, which a writer's reclaim() relies on */
+                _slot.epoch.store(r._epoch.load());
+            }
+        }
+        ~guard(void) {
+            if (--_slot.depth == 0) {
+                _slot.epoch.store(0, std::memory_order_release);
+            }
+        }
+    };
+    /* Free the object once no reader could still be using it.  It has to
+     * be unpublished (replaced) before it is retired. */
+    void retire(std::shared_ptr<const void> old) {
+        std::unique_lock<std::mutex> l(_mutex);
+        if (old != nullptr) {
+            _retired.emplace_back(_epoch.fetch_add(1), std::move(old));
+        }
+        reclaim_locked();
+    }
+    void reclaim(void) {
+        std::unique_lock<std::mutex> l(_mutex);
+        reclaim_locked();
+    }
+    size_t retired(void) {
+        std::unique_lock<std::mutex> l(_mutex);
+        return _retired.size();
+    }
+};
+
+}
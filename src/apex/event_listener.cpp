@@ -46,7 +46,8 @@ node_event_data::node_event_data(int node_id, int thread_id) {
 }
 
 sample_value_event_data::sample_value_event_data(int thread_id,
-    string counter_name, double counter_value, bool threaded) {
+    string counter_name, double counter_value, bool threaded) :
+    _task_id(nullptr) {
   this->event_type_ = APEX_SAMPLE_VALUE;
   this->is_counter = true;
   this->thread_id = thread_id;
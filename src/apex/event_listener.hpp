@@ -60,6 +60,8 @@ public:
 };
 
 class sample_value_event_data : public event_data {
+private:
+  task_identifier * _task_id;
 public:
   std::string * counter_name;
   double counter_value;
@@ -67,6 +69,14 @@ public:
   bool is_counter;
   sample_value_event_data(int thread_id, std::string counter_name, double counter_value, bool threaded);
   ~sample_value_event_data();
+  /* The counter's task identifier, looked up once and shared by all of
+   * the listeners that need it */
+  task_identifier * get_task_id(void) {
+    if (_task_id == nullptr) {
+      _task_id = task_identifier::get_task_id(*counter_name);
+    }
+    return _task_id;
+  }
 };
 
 class startup_event_data : public event_data {
@@ -130,6 +140,18 @@ public:
   ~custom_event_data();
 };
 
+/* The frequent events, for which APEX only calls the listeners that
+ * handle them.  See apex::build_dispatch_table(). */
+typedef enum _dispatch_event {
+    DISPATCH_START = 0,
+    DISPATCH_STOP,
+    DISPATCH_YIELD,
+    DISPATCH_RESUME,
+    DISPATCH_TASK_COMPLETE,
+    DISPATCH_SAMPLE_VALUE,
+    DISPATCH_EVENTS
+} dispatch_event;
+
 /* Abstract class for creating an Event Listener class */
 
 class event_listener
@@ -157,6 +179,11 @@ public:
   virtual void on_send(message_event_data &data) = 0;
   virtual void on_recv(message_event_data &data) = 0;
   virtual void set_node_id(int node_id, int node_count) = 0;
+  // listeners with empty handlers for a frequent event return false
+  virtual bool handles(dispatch_event event) {
+    APEX_UNUSED(event);
+    return true;
+  }
 };
 
 }
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace apex {
+
+/* A circular buffer of trace events for one thread, for the flight
+ * recorder mode.  Each record is a timestamp, a length and the event text.
+ * When the buffer is full the oldest records are overwritten, and when the
+ * buffer is written out, records older than the window are skipped.  The
+ * lock is only contended while a capture is copying the buffer out. */
+class flight_recorder_buffer {
+private:
+    struct record_header {
+        uint64_t timestamp;
+        uint64_t length;
+    };
+    std::vector<char> ring;
+    size_t head; // the oldest record
+    size_t used;
+    std::mutex mtx;
+    void write_bytes(size_t pos, const char * src, size_t n) {
+        size_t first = std::min(n, ring.size() - pos);
+        memcpy(ring.data() + pos, src, first);
+        memcpy(ring.data(), src + first, n - first);
+    }
+    void read_bytes(size_t pos, char * dst, size_t n) const {
+        size_t first = std::min(n, ring.size() - pos);
+        memcpy(dst, ring.data() + pos, first);
+        memcpy(dst + first, ring.data(), n - first);
+    }
+    record_header peek(void) const {
+        record_header h;
+        read_bytes(head, reinterpret_cast<char*>(&h), sizeof(h));
+        return h;
+    }
+    void drop_oldest(void) {
+        record_header h = peek();
+        size_t size = sizeof(h) + h.length;
+        head = (head + size) % ring.size();
+        used -= size;
+    }
+public:
+    flight_recorder_buffer(size_t capacity) : ring(capacity), head(0),
+        used(0) { }
+    void append(uint64_t timestamp, const char * events, size_t length) {
+        record_header h{timestamp, length};
+        size_t size = sizeof(h) + length;
+        // too big to ever fit
+        if (size > ring.size()) { return; }
+        std::unique_lock<std::mutex> l(mtx);
+        while (ring.size() - used < size) {
+            drop_oldest();
+        }
+        size_t tail = (head + used) % ring.size();
+        write_bytes(tail, reinterpret_cast<const char*>(&h), sizeof(h));
+        write_bytes((tail + sizeof(h)) % ring.size(), events, length);
+        used += size;
+    }
+    /* Write the records since the given time, and empty the buffer so
+     * that the next capture doesn't write them again.  The records are
+     * copied out under the lock and written after releasing it, so the
+     * owning thread isn't blocked on the stream. */
+    void drain(uint64_t since, std::ostream& out) {
+        std::vector<char> tmp;
+        {
+            std::unique_lock<std::mutex> l(mtx);
+            tmp.resize(used);
+            read_bytes(head, tmp.data(), used);
+            head = 0;
+            used = 0;
+        }
+        size_t pos = 0;
+        while (pos < tmp.size()) {
+            record_header h;
+            memcpy(&h, tmp.data() + pos, sizeof(h));
+            pos += sizeof(h);
+            if (h.timestamp >= since) {
+                out.write(tmp.data() + pos, h.length);
+            }
+            pos += h.length;
+        }
+    }
+};
+
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "global_view.hpp"
+#include "apex_api.hpp"
+#include "apex_options.hpp"
+#include "task_identifier.hpp"
+#include "utils.hpp"
+#include <cfloat>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#if defined(APEX_WITH_MPI)
+#include "mpi.h"
+#endif
+
+namespace apex {
+
+namespace global_view {
+
+#if defined(APEX_WITH_MPI)
+
+namespace {
+
+/* For the MPI_MINLOC reduction */
+struct value_rank {
+    double value;
+    int rank;
+};
+
+/* A round is one allreduce with MPI_MINLOC, and one with MPI_SUM, at the
+ * same time.  The first has whether each rank is finalizing, then for each
+ * metric its name hash and its value, each both ways so that the minimum
+ * of the negated one is the maximum.  The second has, for each metric,
+ * whether the rank has it yet and its value. */
+constexpr size_t minloc_header{1};
+constexpr size_t minloc_per_metric{4};
+constexpr size_t sum_per_metric{2};
+/* The hash of an unused slot */
+constexpr double empty_slot{-1.0};
+
+MPI_Comm comm{MPI_COMM_NULL};
+int my_rank{0};
+int comm_size{1};
+bool any_thread{false};
+std::thread::id mpi_thread;
+std::mutex mtx;
+bool in_round{false};
+size_t rounds{0};
+std::chrono::steady_clock::time_point last_round;
+MPI_Request requests[2]{MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+std::set<std::string> watched;
+std::vector<std::string> sending; // the metrics in the current round
+std::vector<value_rank> minloc_out;
+std::vector<value_rank> minloc_in;
+std::vector<double> sum_out;
+std::vector<double> sum_in;
+bool all_finished{false};
+bool warned_full{false};
+std::map<std::string, statistics> results;
+
+/* The same on every rank (unlike std::hash), and exact as a double */
+double hash(const std::string& name) {
+    uint64_t h{14695981039346656037ULL};
+    for (auto c : name) {
+        h = (h ^ (uint8_t)(c)) * 1099511628211ULL;
+    }
+    return (double)(h & ((1ULL << 52) - 1));
+}
+
+/* The timer's accumulated time, or the counter's mean sample */
+bool local_value(const std::string& name, double& value) {
+    apex_profile p;
+    if (!get_profile_snapshot(*(task_identifier::get_task_id(name)), p) ||
+        p.calls == 0.0) {
+        return false;
+    }
+    value = (p.type == APEX_TIMER) ? p.accumulated : p.accumulated / p.calls;
+    return true;
+}
+
+void start_round(bool finished) {
+    sending.assign(watched.begin(), watched.end());
+    minloc_out.assign(minloc_header + minloc_per_metric * max_metrics,
+        value_rank{0.0, my_rank});
+    sum_out.assign(sum_per_metric * max_metrics, 0.0);
+    minloc_out[0].value = finished ? 1.0 : 0.0;
+    for (size_t i = 0 ; i < max_metrics ; i++) {
+        value_rank * m = &(minloc_out[minloc_header + minloc_per_metric * i]);
+        double h = (i < sending.size()) ? hash(sending[i]) : empty_slot;
+        m[0].value = h;
+        m[1].value = -h;
+        double value{0.0};
+        /* the ranks that are finalizing have stopped measuring */
+        if (i < sending.size() && !finished &&
+            local_value(sending[i], value)) {
+            m[2].value = value;
+            m[3].value = -value;
+            sum_out[sum_per_metric * i] = 1.0;
+            sum_out[sum_per_metric * i + 1] = value;
+        } else {
+            m[2].value = DBL_MAX;
+            m[3].value = DBL_MAX;
+        }
+    }
+    minloc_in.resize(minloc_out.size());
+    sum_in.resize(sum_out.size());
+    PMPI_Iallreduce(minloc_out.data(), minloc_in.data(),
+        (int)(minloc_out.size()), MPI_DOUBLE_INT, MPI_MINLOC, comm,
+        &(requests[0]));
+    PMPI_Iallreduce(sum_out.data(), sum_in.data(), (int)(sum_out.size()),
+        MPI_DOUBLE, MPI_SUM, comm, &(requests[1]));
+    in_round = true;
+}
+
+/* Move the round along; true when it is done */
+bool test_round(bool wait) {
+    int flag{0};
+    if (wait) {
+        PMPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+        flag = 1;
+    } else {
+        PMPI_Testall(2, requests, &flag, MPI_STATUSES_IGNORE);
+    }
+    if (!flag) { return false; }
+    in_round = false;
+    rounds++;
+    all_finished = minloc_in[0].value != 0.0;
+    return true;
+}
+
+/* A metric only has statistics when every rank watches it in the same
+ * slot, and some rank has measured it */
+void publish(void) {
+    for (size_t i = 0 ; i < sending.size() ; i++) {
+        const value_rank * m =
+            &(minloc_in[minloc_header + minloc_per_metric * i]);
+        double present = sum_in[sum_per_metric * i];
+        if (m[0].value != -(m[1].value) || present == 0.0) { continue; }
+        statistics s;
+        s.minimum = m[2].value;
+        s.maximum = -(m[3].value);
+        s.mean = sum_in[sum_per_metric * i + 1] / present;
+        s.imbalance = (s.mean > 0.0) ? (s.maximum - s.mean) / s.mean : 0.0;
+        s.min_rank = m[2].rank;
+        s.max_rank = m[3].rank;
+        s.ranks = (int)(present);
+        s.round = rounds;
+        results[sending[i]] = s;
+    }
+}
+
+bool add(const std::string& name) {
+    if (watched.count(name) > 0) { return true; }
+    if (watched.size() == max_metrics) {
+        if (!warned_full && my_rank == 0) {
+            std::cerr << "APEX: the global view is limited to "
+                      << max_metrics << " metrics, ignoring " << name
+                      << std::endl;
+        }
+        warned_full = true;
+        return false;
+    }
+    watched.insert(name);
+    return true;
+}
+
+} // anonymous namespace
+
+void init(void) {
+    if (!apex_options::global_view()) { return; }
+    int initialized{0};
+    PMPI_Initialized(&initialized);
+    if (!initialized) { return; }
+    PMPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+    PMPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+    PMPI_Comm_dup(MPI_COMM_WORLD, &comm);
+    std::vector<std::string> names;
+    split(apex_options::global_view_metrics(), ',', names);
+    for (auto& name : names) {
+        trim(name);
+        if (!name.empty()) { add(name); }
+    }
+    /* Unless MPI is fully thread safe, only the thread that initialized
+     * it takes part in the rounds */
+    int level{MPI_THREAD_SINGLE};
+    PMPI_Query_thread(&level);
+    any_thread = (level == MPI_THREAD_MULTIPLE);
+    mpi_thread = std::this_thread::get_id();
+    last_round = std::chrono::steady_clock::now();
+    if (any_thread) {
+        register_periodic_policy(apex_options::global_view_period(),
+            [](apex_context const & context) {
+                APEX_UNUSED(context);
+                progress();
+                return APEX_NOERROR;
+            });
+    }
+    if (my_rank == 0) {
+        std::cout << "APEX: global view across " << comm_size
+                  << " ranks" << std::endl;
+    }
+}
+
+void finalize(void) {
+    if (!enabled()) { return; }
+    /* Every rank keeps taking part in rounds until all of them are
+     * finalizing, so that no collective is left waiting. */
+    std::unique_lock<std::mutex> l(mtx);
+    while (true) {
+        if (!in_round) {
+            start_round(true);
+        }
+        test_round(true);
+        if (all_finished) { break; }
+    }
+    PMPI_Comm_free(&comm);
+    comm = MPI_COMM_NULL;
+}
+
+bool enabled(void) { return comm != MPI_COMM_NULL; }
+
+void progress(void) {
+    if (!enabled()) { return; }
+    if (!any_thread && std::this_thread::get_id() != mpi_thread) { return; }
+    bool done{false};
+    {
+        /* don't wait on another thread that is already at it */
+        std::unique_lock<std::mutex> l(mtx, std::try_to_lock);
+        if (!l.owns_lock() || !enabled()) { return; }
+        if (in_round && test_round(false)) {
+            publish();
+            done = true;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (!in_round &&
+            std::chrono::duration_cast<std::chrono::microseconds>(
+            now - last_round).count() >=
+            apex_options::global_view_period()) {
+            start_round(false);
+            last_round = now;
+        }
+    }
+    if (done) { custom_event(event(), nullptr); }
+}
+
+bool watch(const std::string& name) {
+    if (!enabled()) { return false; }
+    std::unique_lock<std::mutex> l(mtx);
+    return add(name);
+}
+
+bool get(const std::string& name, statistics& stats) {
+    std::unique_lock<std::mutex> l(mtx);
+    auto found = results.find(name);
+    if (found == results.end()) { return false; }
+    stats = found->second;
+    return true;
+}
+
+#else // APEX_WITH_MPI
+
+void init(void) { }
+void finalize(void) { }
+bool enabled(void) { return false; }
+void progress(void) { }
+bool watch(const std::string& name) {
+    APEX_UNUSED(name);
+    return false;
+}
+bool get(const std::string& name, statistics& stats) {
+    APEX_UNUSED(name);
+    APEX_UNUSED(stats);
+    return false;
+}
+
+#endif // APEX_WITH_MPI
+
+apex_event_type event(void) {
+    static apex_event_type global_view_event =
+        register_custom_event("APEX global view");
+    return global_view_event;
+}
+
+} // global_view
+
+} // apex
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "apex_types.h"
+
+namespace apex {
+
+/* A global view of timers and counters across MPI ranks
+ * (APEX_GLOBAL_VIEW).  Every rank watches the same metrics, by name: the
+ * ones in APEX_GLOBAL_VIEW_METRICS, and any added with watch().  At most
+ * once per APEX_GLOBAL_VIEW_PERIOD the ranks reduce them with non-blocking
+ * allreduce collectives on a copy of MPI_COMM_WORLD, so the cost of a round
+ * grows with log(ranks), and its size with the number of metrics only.
+ * When a round completes, every rank has the minimum, mean and maximum of
+ * each metric, and fires event() so that policies can act on them.  The
+ * local value of a timer is its accumulated time, and that of a counter is
+ * its mean sample.  The rounds are driven by the MPI wrappers, and by a
+ * periodic policy too if MPI is thread safe. */
+namespace global_view {
+
+/* At most this many metrics are watched, so a round is bounded */
+constexpr size_t max_metrics{32};
+
+struct statistics {
+    double minimum;
+    double mean;
+    double maximum;
+    double imbalance; // (maximum - mean) / mean
+    int min_rank;     // the lowest rank with the minimum
+    int max_rank;     // the lowest rank with the maximum
+    int ranks;        // how many ranks have measured it so far
+    size_t round;     // the round it came from
+};
+
+/* Set up the communicator.  Every rank calls this, from MPI_Init. */
+void init(void);
+/* Finish the last rounds with the other ranks.  Every rank calls this,
+ * from apex::finalize. */
+void finalize(void);
+bool enabled(void);
+/* Check on the current round, publish its results if it is done, and
+ * start the next round if it's time */
+void progress(void);
+/* Add a timer or counter to the rounds.  Every rank has to watch it,
+ * or no rank gets its statistics. */
+bool watch(const std::string& name);
+/* The statistics from the latest round, false if there are none yet */
+bool get(const std::string& name, statistics& stats);
+/* The custom event fired on every rank when a round completes */
+apex_event_type event(void);
+
+} // global_view
+
+} // apex
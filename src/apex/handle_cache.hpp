@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include "apex_cxx_shared_lock.hpp"
+#include "event_filter.hpp"
+#include "task_identifier.hpp"
+#include "utils.hpp"
+
+namespace apex {
+
+/* A timer name that has been looked up once.  Everything that depends on
+ * the name is resolved then, so starting and stopping the timer does no
+ * string work. */
+struct interned_timer {
+    task_identifier * id;
+    // "apex_internal" or filtered timers are neither started nor stopped
+    bool excluded;
+};
+
+/* Maps the handles that a runtime gives us (string handles, codelet
+ * pointers, timer ids...) to interned timers, so that an adapter formats
+ * each name once, the first time it sees the handle, and the timers it
+ * returns stay valid for the life of the cache. */
+template <typename Handle, typename Hash = std::hash<Handle>>
+class handle_cache {
+public:
+    typedef std::function<std::string(const Handle&)> namer;
+    explicit handle_cache(namer name) : _name(name) { }
+    const interned_timer * get(const Handle& handle) {
+        {
+            read_lock_type l(_mutex);
+            auto found = _timers.find(handle);
+            if (found != _timers.end()) { return &(found->second); }
+        }
+        // name it outside the lock, it may be slow
+        std::string name(_name(handle));
+        interned_timer timer;
+        timer.id = task_identifier::get_task_id(name);
+        timer.excluded = starts_with(name, "apex_internal") ||
+            (event_filter::instance().have_filter &&
+             event_filter::exclude(name));
+        write_lock_type l(_mutex);
+        // if another thread got here first, use its timer
+        return &(_timers.emplace(handle, timer).first->second);
+    }
+private:
+    namer _name;
+    shared_mutex_type _mutex;
+    std::unordered_map<Handle, interned_timer, Hash> _timers;
+};
+
+} // apex
@@ -46,6 +46,7 @@ using namespace std;
 #include "trace_event_listener.hpp"
 #ifdef APEX_HAVE_OTF2
 #include "otf2_listener.hpp"
+#include "async_activity.hpp"
 #endif
 #include <stack>
 #include <mutex>
@@ -861,12 +862,18 @@ void handle_hip(uint32_t domain, uint32_t cid, const void* callback_data, void*
     }
 }
 
-void store_profiler_data(const std::string &name, uint32_t correlationId,
-        uint64_t start, uint64_t end, std::string category, apex::hip_thread_node &node,
+/* The activity from one buffer is delivered to the listeners in a batch,
+ * after the whole buffer has been decoded. */
+typedef apex::async_activity_batch<apex::hip_thread_node> hip_activity_batch;
+
+void store_profiler_data(hip_activity_batch &batch, const std::string &name,
+        uint32_t correlationId, uint64_t start, uint64_t end,
+        std::string category, apex::hip_thread_node &node,
         bool reverse_flow = false, bool otf2_trace = true) {
-    apex::in_apex prevent_deadlocks;
-    // Get the singleton APEX instance
-    static apex::apex* instance = apex::apex::instance();
+    static apex::async_name_cache<std::string> names;
+    apex::task_identifier * id = names.get(name, [&]() {
+        return std::string("GPU: ") + name;
+    });
     // get the parent GUID, then erase the correlation from the map
     std::shared_ptr<apex::task_wrapper> parent = nullptr;
     apex::async_event_data as_data;
@@ -874,99 +881,33 @@ void store_profiler_data(const std::string &name, uint32_t correlationId,
         parent = Globals::find_timer(correlationId);
         as_data = Globals::find_data(correlationId);
     }
-    // Build the name
-    std::stringstream ss;
-    ss << "GPU: " << std::string(name);
-    std::string tmp{ss.str()};
-    // create a task_wrapper, as a GPU child of the parent on the CPU side
-    auto tt = apex::new_task(tmp, UINT64_MAX, parent);
-    // create an APEX profiler to store this data - we can't start
-    // then stop because we have timestamps already.
-    auto prof = std::make_shared<apex::profiler>(tt);
-    prof->set_start(start + Globals::delta());
-    prof->set_end(end + Globals::delta());
-    // important!  Otherwise we might get the wrong end timestamp.
-    prof->stopped = true;
-    // fake out the profiler_listener
-    instance->the_profiler_listener->push_profiler_public(prof);
-    // Handle tracing, if necessary
-#if defined(APEX_WITH_PERFETTO)
-    if (apex::apex_options::use_perfetto()) {
-        apex::perfetto_listener * tel =
-            (apex::perfetto_listener*)instance->the_perfetto_listener;
-        as_data.cat = category;
-        as_data.reverse_flow = reverse_flow;
-        tel->on_async_event(node, prof, as_data);
-    }
-#endif
-    if (apex::apex_options::use_trace_event()) {
-        apex::trace_event_listener * tel =
-            (apex::trace_event_listener*)instance->the_trace_event_listener;
-        as_data.cat = category;
-        as_data.reverse_flow = reverse_flow;
-        tel->on_async_event(node, prof, as_data);
-    }
-#ifdef APEX_HAVE_OTF2
-    if (apex::apex_options::use_otf2() && otf2_trace) {
-        apex::otf2_listener * tol =
-            (apex::otf2_listener*)instance->the_otf2_listener;
-        tol->on_async_event(node, prof);
-    }
-#else
-    APEX_UNUSED(otf2_trace);
-#endif
-    // have the listeners handle the end of this task
-    instance->complete_task(tt);
+    as_data.cat = category;
+    as_data.reverse_flow = reverse_flow;
+    // a GPU child of the parent on the CPU side
+    batch.add_activity(node, id, start + Globals::delta(),
+        end + Globals::delta(), parent, as_data, otf2_trace);
 }
 
 /* Handle counters from asynchronous activity */
-void store_counter_data(const char * name, const std::string& ctx,
-    uint64_t end, double value, apex::hip_thread_node &node) {
-    apex::in_apex prevent_deadlocks;
-    std::stringstream ss;
-    if (name == nullptr) {
-        ss << "GPU: " << ctx;
-    } else {
-        ss << "GPU: " << name << " " << ctx;
-    }
-    std::string tmp{ss.str()};
-    auto task_id = apex::task_identifier::get_task_id(tmp);
-    std::shared_ptr<apex::profiler> prof =
-        std::make_shared<apex::profiler>(task_id, value);
-    prof->is_counter = true;
-    prof->set_end(end + Globals::delta());
-    // Get the singleton APEX instance
-    static apex::apex* instance = apex::apex::instance();
-    // fake out the profiler_listener
-    instance->the_profiler_listener->push_profiler_public(prof);
-    // Handle tracing, if necessary
-#if defined(APEX_WITH_PERFETTO)
-    if (apex::apex_options::use_perfetto()) {
-        apex::perfetto_listener * tel =
-            (apex::perfetto_listener*)instance->the_perfetto_listener;
-        tel->on_async_metric(node, prof);
-    }
-#endif
-    if (apex::apex_options::use_trace_event()) {
-        apex::trace_event_listener * tel =
-            (apex::trace_event_listener*)instance->the_trace_event_listener;
-        tel->on_async_metric(node, prof);
-    }
-#ifdef APEX_HAVE_OTF2
-    if (apex::apex_options::use_otf2()) {
-        apex::otf2_listener * tol =
-            (apex::otf2_listener*)instance->the_otf2_listener;
-        tol->on_async_metric(node, prof);
-    }
-#endif
-}
-
-void store_counter_data(const char * name, const std::string& ctx,
-    uint64_t end, size_t value, apex::hip_thread_node &node) {
-    store_counter_data(name, ctx, end, (double)(value), node);
+void store_counter_data(hip_activity_batch &batch, const char * name,
+    const std::string& ctx, uint64_t end, double value,
+    apex::hip_thread_node &node) {
+    static apex::async_name_cache<std::pair<std::string, std::string> > names;
+    apex::task_identifier * id = names.get(std::make_pair(
+        std::string(name == nullptr ? "" : name), ctx), [&]() {
+        std::stringstream ss;
+        if (name == nullptr) {
+            ss << "GPU: " << ctx;
+        } else {
+            ss << "GPU: " << name << " " << ctx;
+        }
+        return ss.str();
+    });
+    batch.add_counter(node, id, end + Globals::delta(), value);
 }
 
-void process_hip_record(const roctracer_record_t* record) {
+void process_hip_record(const roctracer_record_t* record,
+    hip_activity_batch &batch) {
     const char * name = roctracer_op_string(record->domain, record->op, record->kind);
     if (!apex::apex_options::use_hip_kernel_details()) {
         if (strncmp(name, "Marker", 6) == 0) {
@@ -983,7 +924,7 @@ void process_hip_record(const roctracer_record_t* record) {
         case HIP_OP_ID_DISPATCH: {
             std::string name = Globals::find_name(record->correlation_id);
             apex::hip_thread_node node(record->device_id, record->queue_id, APEX_ASYNC_KERNEL);
-   	        store_profiler_data(name, record->correlation_id, record->begin_ns,
+   	        store_profiler_data(batch, name, record->correlation_id, record->begin_ns,
                 record->end_ns, "ControlFlow", node);
             break;
         }
@@ -999,22 +940,22 @@ void process_hip_record(const roctracer_record_t* record) {
             } */
             apex::hip_thread_node node(record->device_id, record->queue_id, APEX_ASYNC_MEMORY);
             bool reverse_flow = (std::string(name).find("DeviceToHost") != std::string::npos);
-   	        store_profiler_data(name, record->correlation_id, record->begin_ns,
+   	        store_profiler_data(batch, name, record->correlation_id, record->begin_ns,
                 record->end_ns, "DataFlow", node, reverse_flow);
-            store_counter_data(name, "Bytes", record->end_ns,
-                record->bytes, node);
+            store_counter_data(batch, name, "Bytes", record->end_ns,
+                (double)(record->bytes), node);
             break;
         }
         case HIP_OP_ID_BARRIER: {
             apex::hip_thread_node node(record->device_id, record->queue_id, APEX_ASYNC_SYNCHRONIZE);
-   	        store_profiler_data(name, record->correlation_id, record->begin_ns,
+   	        store_profiler_data(batch, name, record->correlation_id, record->begin_ns,
                 record->end_ns, "SyncFlow", node, false, false);
             break;
         }
         case HIP_OP_ID_NUMBER:
         default: {
             apex::hip_thread_node node(record->device_id, record->queue_id, APEX_ASYNC_OTHER);
-   	        store_profiler_data(name, record->correlation_id, record->begin_ns,
+   	        store_profiler_data(batch, name, record->correlation_id, record->begin_ns,
                 record->end_ns, "OtherFlow", node);
             break;
         }
@@ -1033,10 +974,11 @@ void activity_callback(const char* begin, const char* end, void* arg) {
 
     //auto p = apex::scoped_timer("APEX: HIP Activity Buffer Flush");
     //std::cout << "**** FLUSHING ACTIVITY BUFFER ****" << std::endl;
+    hip_activity_batch batch;
     while (record < end_record) {
         // FYI, ACTIVITY_DOMAIN_HIP_OPS = ACTIVITY_DOMAIN_HCC_OPS = ACTIVITY_DOMAIN_HIP_VDI...
         if (record->domain == ACTIVITY_DOMAIN_HIP_OPS) {
-            process_hip_record(record);
+            process_hip_record(record, batch);
         } else {
             fprintf(stderr, "Unsupported domain %d\n\n", record->domain);
             abort();
@@ -1044,6 +986,7 @@ void activity_callback(const char* begin, const char* end, void* arg) {
 
         ROCTRACER_CALL_CHECK(roctracer_next_record(record, &record));
     }
+    batch.flush();
 }
 
 extern "C" {
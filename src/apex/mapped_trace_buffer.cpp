@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "mapped_trace_buffer.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace apex {
+
+/* 4MB to start with, then doubled as needed */
+static const size_t initial_mapping = 1 << 22;
+
+mapped_trace_buffer::mapped_trace_buffer(const std::string& name,
+    uint64_t node_id, uint64_t thread_index) :
+    filename(name), fd(-1), base(nullptr), mapped(0) {
+    fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "APEX: could not create trace buffer " << filename
+                  << ": " << strerror(errno) << std::endl;
+        return;
+    }
+    if (!map(initial_mapping)) {
+        return;
+    }
+    mapped_trace_header * h = header();
+    memcpy(h->magic, "APEXTRC", 8);
+    h->version = version;
+    h->state = 0;
+    h->node_id = node_id;
+    h->thread_index = thread_index;
+    h->capacity = mapped - sizeof(mapped_trace_header);
+    h->committed.store(0, std::memory_order_release);
+}
+
+mapped_trace_buffer::~mapped_trace_buffer(void) {
+    if (base != nullptr) {
+        munmap(base, mapped);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool mapped_trace_buffer::map(size_t size) {
+    if (ftruncate(fd, size) != 0) {
+        std::cerr << "APEX: could not resize trace buffer " << filename
+                  << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    void * tmp = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+        fd, 0);
+    if (tmp == MAP_FAILED) {
+        std::cerr << "APEX: could not map trace buffer " << filename
+                  << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (base != nullptr) {
+        munmap(base, mapped);
+    }
+    base = static_cast<char*>(tmp);
+    mapped = size;
+    return true;
+}
+
+bool mapped_trace_buffer::grow(size_t needed) {
+    size_t size = mapped;
+    while (size - sizeof(mapped_trace_header) < needed) {
+        size = size * 2;
+    }
+    if (!map(size)) {
+        return false;
+    }
+    header()->capacity = mapped - sizeof(mapped_trace_header);
+    return true;
+}
+
+void mapped_trace_buffer::append(const char * events, size_t length) {
+    std::unique_lock<std::mutex> l(mtx);
+    if (base == nullptr || header()->state != 0) { return; }
+    uint64_t committed = header()->committed.load(std::memory_order_relaxed);
+    if (committed + length > header()->capacity) {
+        // the events are dropped if we can't get the space
+        if (!grow(committed + length)) { return; }
+    }
+    memcpy(data() + committed, events, length);
+    header()->committed.store(committed + length, std::memory_order_release);
+}
+
+void mapped_trace_buffer::finalize(std::ostream& out) {
+    std::unique_lock<std::mutex> l(mtx);
+    if (base == nullptr) { return; }
+    header()->state = 1;
+    out.write(data(), header()->committed.load(std::memory_order_acquire));
+}
+
+void mapped_trace_buffer::remove(void) {
+    std::unique_lock<std::mutex> l(mtx);
+    unlink(filename.c_str());
+}
+
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace apex {
+
+/* The header at the start of a mapped trace buffer file.  The layout is
+ * read by src/scripts/apex-trace-recover.py, so don't change it without
+ * changing the version and the script. */
+struct mapped_trace_header {
+    char magic[8];         // "APEXTRC"
+    uint32_t version;
+    uint32_t state;        // 0 while the buffer is written, 1 when finalized
+    uint64_t node_id;
+    uint64_t thread_index;
+    uint64_t capacity;     // bytes of event data the file can hold
+    std::atomic<uint64_t> committed; // bytes of complete events
+    uint64_t reserved[2];
+};
+
+/* A trace buffer backed by a memory-mapped file.  Events are copied into
+ * the mapping with plain stores, and then the committed size in the header
+ * is updated, so the file always holds complete events up to that size.
+ * The pages belong to the file, not the process, so they survive a crash
+ * (or SIGKILL) and the recovery script can rebuild the trace from them.
+ * Only growing the file needs a system call. */
+class mapped_trace_buffer {
+private:
+    std::string filename;
+    int fd;
+    char * base;
+    size_t mapped;
+    std::mutex mtx;
+    mapped_trace_header * header(void) {
+        return reinterpret_cast<mapped_trace_header*>(base);
+    }
+    char * data(void) { return base + sizeof(mapped_trace_header); }
+    bool map(size_t size);
+    bool grow(size_t needed);
+public:
+    static const uint32_t version = 1;
+    mapped_trace_buffer(const std::string& name, uint64_t node_id,
+        uint64_t thread_index);
+    ~mapped_trace_buffer(void);
+    /* false if the file couldn't be created or mapped */
+    bool ok(void) const { return base != nullptr; }
+    /* Called by the thread that owns the buffer; the lock is only
+     * contended while the buffer is being copied out at shutdown. */
+    void append(const char * events, size_t length);
+    /* Mark the buffer as complete, and copy the events out */
+    void finalize(std::ostream& out);
+    /* Remove the file, once its events are in the trace */
+    void remove(void);
+};
+
+}
@@ -0,0 +1,270 @@
+#include "nelder_mead.hpp"
+#include <algorithm>
+
+namespace apex {
+
+namespace nelder_mead {
+
+std::vector<double> along(const VariableMap& vars,
+    const std::vector<double>& from, const std::vector<double>& to, double t) {
+    std::vector<double> point(from.size());
+    size_t i = 0;
+    for (auto& v : vars) {
+        point[i] = v.second.clamp(from[i] + t * (to[i] - from[i]));
+        i++;
+    }
+    return point;
+}
+
+std::vector<size_t> project(const VariableMap& vars,
+    const std::vector<double>& point) {
+    std::vector<size_t> index(point.size());
+    size_t i = 0;
+    for (auto& v : vars) {
+        index[i] = v.second.project(point[i]);
+        i++;
+    }
+    return index;
+}
+
+void apply(VariableMap& vars, const std::vector<size_t>& index) {
+    size_t i = 0;
+    for (auto& v : vars) {
+        v.second.set_index(index[i++]);
+    }
+}
+
+std::vector<Vertex> initial_simplex(const VariableMap& vars, bool both_ways,
+    double radius) {
+    std::vector<double> center;
+    for (auto& v : vars) { center.push_back((double)(v.second.current_index)); }
+    std::vector<Vertex> simplex;
+    simplex.push_back(Vertex{center, 0.0});
+    size_t i = 0;
+    for (auto& v : vars) {
+        /* Like the INIT_RADIUS we give Active Harmony, but at least one
+         * step */
+        double step = std::max(1.0, (double)(v.second.maxlen) * radius);
+        std::vector<double> point(center);
+        point[i] = v.second.clamp(center[i] + step);
+        /* a start at the top of the range steps down instead, or the
+         * simplex is flat in this direction */
+        if (point[i] == center[i]) {
+            point[i] = v.second.clamp(center[i] - step);
+        }
+        simplex.push_back(Vertex{point, 0.0});
+        if (both_ways) {
+            point[i] = v.second.clamp(center[i] - step);
+            simplex.push_back(Vertex{point, 0.0});
+        }
+        i++;
+    }
+    return simplex;
+}
+
+bool collapsed(const VariableMap& vars, const std::vector<Vertex>& simplex) {
+    std::vector<size_t> first(project(vars, simplex[0].point));
+    for (size_t i = 1 ; i < simplex.size() ; i++) {
+        if (project(vars, simplex[i].point) != first) { return false; }
+    }
+    return true;
+}
+
+size_t NelderMead::get_max_iterations() {
+    size_t max_iter{1};
+    for (auto& v : vars) {
+        max_iter = max_iter * (v.second.maxlen + 1);
+    }
+    // no point is measured twice, so this is never more than exhaustive
+    return std::min(max_iterations, max_iter);
+}
+
+void NelderMead::start_iteration() {
+    std::stable_sort(simplex.begin(), simplex.end(),
+        [](const Vertex& a, const Vertex& b) { return a.cost < b.cost; });
+    if (collapsed(vars, simplex)) {
+        step = Step::done;
+        return;
+    }
+    /* The centroid of all but the worst vertex */
+    size_t n = simplex.size() - 1;
+    centroid.assign(simplex[0].point.size(), 0.0);
+    for (size_t i = 0 ; i < n ; i++) {
+        for (size_t d = 0 ; d < centroid.size() ; d++) {
+            centroid[d] += simplex[i].point[d] / (double)(n);
+        }
+    }
+    reflection = along(vars, centroid, simplex[n].point, -1.0);
+    step = Step::reflect;
+}
+
+void NelderMead::replace_worst(const std::vector<double>& point, double cost) {
+    simplex.back().point = point;
+    simplex.back().cost = cost;
+    start_iteration();
+}
+
+void NelderMead::shrink() {
+    for (size_t i = 1 ; i < simplex.size() ; i++) {
+        simplex[i].point = along(vars, simplex[0].point, simplex[i].point, 0.5);
+    }
+    vertex = 1;
+    step = Step::shrink;
+}
+
+const std::vector<double>& NelderMead::next_point() {
+    switch (step) {
+        case Step::initial:
+        case Step::shrink:
+            return simplex[vertex].point;
+        case Step::reflect:
+            return reflection;
+        default:
+            return trial;
+    }
+}
+
+/* Take the next step of the search, now that we have the cost of the
+ * point from next_point() */
+void NelderMead::advance(double cost) {
+    switch (step) {
+        case Step::initial:
+        case Step::shrink: {
+            simplex[vertex].cost = cost;
+            if (++vertex == simplex.size()) { start_iteration(); }
+            break;
+        }
+        case Step::reflect: {
+            reflection_cost = cost;
+            size_t n = simplex.size() - 1;
+            if (cost < simplex[0].cost) {
+                trial = along(vars, centroid, reflection, 2.0);
+                step = Step::expand;
+            } else if (cost < simplex[n-1].cost) {
+                replace_worst(reflection, cost);
+            } else if (cost < simplex[n].cost) {
+                trial = along(vars, centroid, reflection, 0.5);
+                step = Step::contract_outside;
+            } else {
+                trial = along(vars, centroid, simplex[n].point, 0.5);
+                step = Step::contract_inside;
+            }
+            break;
+        }
+        case Step::expand: {
+            if (cost < reflection_cost) {
+                replace_worst(trial, cost);
+            } else {
+                replace_worst(reflection, reflection_cost);
+            }
+            break;
+        }
+        case Step::contract_outside: {
+            if (cost <= reflection_cost) {
+                replace_worst(trial, cost);
+            } else {
+                shrink();
+            }
+            break;
+        }
+        case Step::contract_inside: {
+            if (cost < simplex.back().cost) {
+                replace_worst(trial, cost);
+            } else {
+                shrink();
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+void NelderMead::getNewSettings() {
+    if (simplex.empty()) {
+        simplex = initial_simplex(vars, false, radius);
+        if (simplex.size() < 2) { step = Step::done; }
+    }
+    /* Run the search until it wants a point we haven't measured yet.  If
+     * it keeps going around the points it has measured, it is stuck. */
+    size_t stalled = 0;
+    while (step != Step::done) {
+        std::vector<size_t> index(project(vars, next_point()));
+        auto measured = evaluated.find(index);
+        if (measured == evaluated.end()) {
+            /* Cooperating ranks take turns measuring the next point, and
+             * the others hold the best settings until it is delivered */
+            if (sharing.in_flight.count(index) > 0 ||
+                !sharing.mine(evaluated.size())) {
+                pending.clear();
+                break;
+            }
+            pending = index;
+            apply(vars, pending);
+            return;
+        }
+        advance(measured->second);
+        if (++stalled > max_iterations) { step = Step::done; }
+    }
+    saveBestSettings();
+}
+
+/* The old measurements are stale, so they are forgotten */
+void NelderMead::retune(double r, size_t budget) {
+    for (auto& v : vars) { v.second.set_index(v.second.best_index); }
+    simplex.clear();
+    evaluated.clear();
+    pending.clear();
+    best_cost = std::numeric_limits<double>::max();
+    step = Step::initial;
+    vertex = 0;
+    radius = r;
+    k = 1;
+    kmax = std::min(get_max_iterations(), std::max(budget, (size_t)(1)));
+}
+
+bool NelderMead::take_pending(std::vector<size_t>& index) {
+    if (pending.empty() || evaluated.count(pending) > 0) { return false; }
+    sharing.in_flight.insert(pending);
+    index.swap(pending);
+    pending.clear();
+    return true;
+}
+
+/* A measurement from one of the cooperating ranks (this one too).  The
+ * search moves on when getNewSettings() finds the point measured. */
+void NelderMead::import(const std::vector<size_t>& index, double cost) {
+    sharing.in_flight.erase(index);
+    if (index.size() != vars.size() || evaluated.count(index) > 0) { return; }
+    evaluated[index] = cost;
+    if (cost < best_cost) {
+        best_cost = cost;
+        size_t i = 0;
+        for (auto& v : vars) { v.second.best_index = index[i++]; }
+        if (sharing.rank == 0) {
+            std::cout << "New best! " << cost << " k: " << k << std::endl;
+        }
+    }
+    k++;
+}
+
+void NelderMead::evaluate(double new_cost) {
+    if (pending.empty()) { return; }
+    evaluated[pending] = new_cost;
+    if (new_cost < best_cost) {
+        best_cost = new_cost;
+        std::cout << "New best! " << new_cost << " k: " << k;
+        for (auto& v : vars) { v.second.save_best(); }
+        for (auto& v : vars) { std::cout  << ", value: " << v.second.toString(); }
+        std::cout << std::endl;
+    }
+    advance(new_cost);
+    pending.clear();
+    k++;
+    return;
+}
+
+} // nelder_mead
+
+} // apex
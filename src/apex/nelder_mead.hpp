@@ -0,0 +1,207 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include "apex_types.h"
+#include "cooperative_tuning.hpp"
+
+namespace apex {
+
+namespace nelder_mead {
+
+enum class VariableType { doubletype, longtype, stringtype } ;
+
+/* The search runs in a continuous space with one coordinate per variable,
+ * from 0 to the index of its last value.  Points are projected onto the
+ * nearest index before they are measured, so long, double and enum
+ * variables are all handled the same way. */
+class Variable {
+public:
+    std::vector<double> dvalues;
+    std::vector<long> lvalues;
+    std::vector<std::string> svalues;
+    VariableType vtype;
+    size_t current_index;
+    size_t best_index;
+    void * value; // for the client to get the values
+    size_t maxlen;
+    Variable () = delete;
+    Variable (VariableType vtype, void * ptr) : vtype(vtype), current_index(0),
+        best_index(0), value(ptr), maxlen(0) { }
+    void set_current_value() {
+        if (vtype == VariableType::doubletype) {
+            *((double*)(value)) = dvalues[current_index];
+        }
+        else if (vtype == VariableType::longtype) {
+            *((long*)(value)) = lvalues[current_index];
+        }
+        else {
+            *((const char**)(value)) = svalues[current_index].c_str();
+        }
+    }
+    size_t project(double x) const {
+        if (x <= 0.0) { return 0; }
+        return std::min(maxlen, (size_t)(std::lround(x)));
+    }
+    double clamp(double x) const {
+        return std::min(std::max(x, 0.0), (double)(maxlen));
+    }
+    void set_index(size_t index) {
+        current_index = index;
+        set_current_value();
+    }
+    void save_best() { best_index = current_index; }
+    /* For initializing in the center of the space */
+    void set_init() {
+        maxlen = (std::max(std::max(dvalues.size(),
+            lvalues.size()), svalues.size())) - 1;
+        current_index = best_index = maxlen/2;
+        set_current_value();
+    }
+    /* For starting from a known good setting instead */
+    void set_init(size_t start) {
+        set_init();
+        current_index = best_index = std::min(start, maxlen);
+        set_current_value();
+    }
+    std::string getBest() {
+        if (vtype == VariableType::doubletype) {
+            *((double*)(value)) = dvalues[best_index];
+            return std::to_string(dvalues[best_index]);
+        }
+        else if (vtype == VariableType::longtype) {
+            *((long*)(value)) = lvalues[best_index];
+            return std::to_string(lvalues[best_index]);
+        }
+        //else if (vtype == VariableType::stringtype) {
+        *((const char**)(value)) = svalues[best_index].c_str();
+        return svalues[best_index];
+    }
+    std::string toString() {
+        if (vtype == VariableType::doubletype) {
+            return std::to_string(dvalues[current_index]);
+        }
+        else if (vtype == VariableType::longtype) {
+            return std::to_string(lvalues[current_index]);
+        }
+        //else if (vtype == VariableType::stringtype) {
+        return svalues[current_index];
+        //}
+    }
+};
+
+/* A point in the search space, and what it cost */
+struct Vertex {
+    std::vector<double> point;
+    double cost;
+};
+
+/* The measurements, keyed by the projected point, so that a point is never
+ * measured twice.  The search space is discrete, so once the simplex gets
+ * small its moves often land on a point it has already measured. */
+typedef std::map<std::vector<size_t>, double> EvaluationCache;
+
+/* Helpers for the simplex searches.  Points have one coordinate for each
+ * variable, in the order of the map. */
+typedef std::map<std::string, Variable> VariableMap;
+/* The point at t along the line from one point to another, clamped to the
+ * search space (t < 0 is a reflection through from) */
+std::vector<double> along(const VariableMap& vars,
+    const std::vector<double>& from, const std::vector<double>& to, double t);
+/* The nearest values to a point */
+std::vector<size_t> project(const VariableMap& vars,
+    const std::vector<double>& point);
+/* Set the variables to a projected point */
+void apply(VariableMap& vars, const std::vector<size_t>& index);
+/* The starting point (the center of the space, unless the search was
+ * warm started), and a point radius of the way across the space from it
+ * along each axis (both ways, if both_ways is set) */
+std::vector<Vertex> initial_simplex(const VariableMap& vars, bool both_ways,
+    double radius);
+/* True when every vertex projects to the same point */
+bool collapsed(const VariableMap& vars, const std::vector<Vertex>& simplex);
+
+/*
+ * Nelder-Mead downhill simplex (Nelder and Mead, 1965), with n+1 vertices
+ * for n variables:
+ *   Order the vertices by cost, and take the centroid of all but the worst
+ *   Reflect the worst vertex through the centroid
+ *   If the reflection is the new best, try expanding it further
+ *   Else if it is better than the second worst, keep it
+ *   Else contract towards the centroid, and if that fails too, shrink
+ *   the simplex towards the best vertex
+ * The search has converged when every vertex projects to the same point.
+ */
+
+class NelderMead {
+private:
+    enum class Step { initial, reflect, expand, contract_outside,
+        contract_inside, shrink, done };
+    Step step;
+    std::vector<Vertex> simplex;
+    std::vector<double> centroid;
+    std::vector<double> reflection;
+    std::vector<double> trial;
+    double reflection_cost;
+    size_t vertex; // the next vertex to measure, when initializing/shrinking
+    EvaluationCache evaluated;
+    std::vector<size_t> pending; // the point being measured
+    double best_cost;
+    size_t kmax;
+    size_t k;
+    VariableMap vars;
+    cooperative_tuning::share sharing;
+    double radius{0.5}; // of the initial simplex
+    const size_t max_iterations{1000};
+    void start_iteration();
+    void replace_worst(const std::vector<double>& point, double cost);
+    void shrink();
+    void advance(double cost);
+    const std::vector<double>& next_point();
+public:
+    void evaluate(double new_cost);
+    NelderMead() : step(Step::initial), reflection_cost(0), vertex(0),
+        kmax(0), k(1) {
+        best_cost = std::numeric_limits<double>::max();
+    }
+    double getEnergy() { return best_cost; }
+    bool converged() { return (step == Step::done || k > kmax); }
+    void getNewSettings();
+    /* For cooperative tuning: the measurements only come from import(),
+     * and each rank measures every size'th point */
+    void set_cooperative(int rank, int size) { sharing.set(rank, size); }
+    /* The size of the initial simplex, as a fraction of the space */
+    void set_radius(double r) { radius = r; }
+    /* Search again from the best settings, with a simplex of this radius
+     * and at most budget evaluations, when their cost has changed */
+    void retune(double r, size_t budget);
+    bool take_pending(std::vector<size_t>& index);
+    void import(const std::vector<size_t>& index, double cost);
+    void saveBestSettings() {
+        for (auto& v : vars) { v.second.getBest(); }
+    }
+    void printBestSettings() {
+        std::string d("[");
+        for (auto v : vars) {
+            std::cout << d << v.second.getBest();
+            d = ",";
+        }
+        std::cout << "]" << std::endl;
+    }
+    size_t get_max_iterations();
+    std::map<std::string, Variable>& get_vars() { return vars; }
+    void add_var(std::string name, Variable var) {
+        vars.insert(std::make_pair(name, var));
+        kmax = get_max_iterations();
+    }
+};
+
+} // nelder_mead
+
+} // apex
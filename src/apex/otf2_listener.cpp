@@ -2704,14 +2704,52 @@ namespace apex {
         // Something like OpenMP or CUDA/CUPTI or...?
         if (!_initialized) return ;
         uint32_t tid{make_vtid(node)};
+        // not likely, but just in case...
+        if (_terminate) { return; }
+        // don't close the archive on us!
+        read_lock_type lock(_archive_mutex);
+        write_async_event(tid, p);
+    }
+
+    void otf2_listener::on_async_metric(base_thread_node &node,
+        std::shared_ptr<profiler> &p) {
+        // This could be a callback from a library before APEX is ready
+        // Something like OpenMP or CUDA/CUPTI or...?
+        if (!_initialized) return ;
+        uint32_t tid{make_vtid(node)};
+        // not likely, but just in case...
+        if (_terminate) { return; }
+        // don't close the archive on us!
+        read_lock_type lock(_archive_mutex);
+        write_async_metric(tid, p);
+    }
+
+    /* The virtual thread and the archive lock are only looked up once
+     * for the whole batch. */
+    void otf2_listener::on_async_batch(base_thread_node &node,
+        std::vector<std::shared_ptr<profiler> > &profilers) {
+        if (!_initialized) return ;
+        uint32_t tid{make_vtid(node)};
+        if (_terminate) { return; }
+        read_lock_type lock(_archive_mutex);
+        for (auto& p : profilers) {
+            if (p->is_counter) {
+                write_async_metric(tid, p);
+            } else {
+                write_async_event(tid, p);
+            }
+        }
+    }
+
+    /* The caller holds a read lock on the archive */
+    void otf2_listener::write_async_event(uint32_t tid,
+        std::shared_ptr<profiler> &p) {
         task_identifier * id = p->tt_ptr->get_task_id();
         uint64_t idx = get_region_index(id);
         //static map<uint32_t,std::string> last_p;
         if (last_ts.count(tid) == 0) {
             last_ts[tid] = 0ULL;
         }
-        // not likely, but just in case...
-        if (_terminate) { return; }
         /* validate the time stamp.  CUPTI is notorious for giving out-of-order
          * events, so make sure this one isn't before the previous. */
         uint64_t stamp = 0L;
@@ -2720,14 +2758,6 @@ namespace apex {
         if(stamp < last) {
             uint64_t estamp = p->get_stop_ns() - globalOffset;
             if(estamp < last) {
-            /*
-                std::cerr << "APEX: Warning - Events delivered out of order on Device "
-                          << node._device << ", Context " << node._context
-                          << ", Stream " << node._stream
-                          << ".\nIgnoring event " << p->tt_ptr->task_id->get_name()
-                          << " with timestamp of " << stamp << " after last event "
-                          << "with timestamp of " << last << std::endl;
-            */
                 dropped++;
                 return;
             }
@@ -2735,8 +2765,6 @@ namespace apex {
              * we are safe to just adjust the start time. */
             stamp = last;
         }
-        // don't close the archive on us!
-        read_lock_type lock(_archive_mutex);
         // before we process the event, make sure the event write is open
         OTF2_EvtWriter* local_evt_writer = vthread_evt_writer_map[tid];
         if (local_evt_writer != nullptr) {
@@ -2755,18 +2783,11 @@ namespace apex {
             // delete the attribute list
             OTF2_AttributeList_Delete(al);
         }
-        return;
-
     }
 
-    void otf2_listener::on_async_metric(base_thread_node &node,
+    /* The caller holds a read lock on the archive */
+    void otf2_listener::write_async_metric(uint32_t tid,
         std::shared_ptr<profiler> &p) {
-        // This could be a callback from a library before APEX is ready
-        // Something like OpenMP or CUDA/CUPTI or...?
-        if (!_initialized) return ;
-        uint32_t tid{make_vtid(node)};
-        // not likely, but just in case...
-        if (_terminate) { return; }
         // create a union for storing the value
         OTF2_MetricValue omv[1];
         omv[0].floating_point = p->value;
@@ -2778,22 +2799,9 @@ namespace apex {
         uint64_t stamp = p->get_stop_ns() - globalOffset;
         uint64_t last = last_ts[tid];
         if(stamp < last) {
-            /*
-            std::cerr << "APEX: Warning - Events delivered out of order on Device "
-                      << node._device << ", Context " << node._context
-                      << ", Stream " << node._stream
-                      << ".\nIgnoring event " << id->name
-                      << " with timestamp of " << stamp << " after last event "
-                      << "with timestamp of " << last << std::endl;
-            */
             dropped++;
-                return;
-            /* This activity doesn't fully overlap with the previous, so
-             * we are safe to just adjust the start time. */
-            //stamp = last;
+            return;
         }
-        // don't close the archive on us!
-        read_lock_type lock(_archive_mutex);
         // before we process the event, make sure the event write is open
         OTF2_EvtWriter* local_evt_writer = vthread_evt_writer_map[tid];
         if (local_evt_writer != nullptr) {
@@ -2802,7 +2810,6 @@ namespace apex {
             idx, 1, omt, omv ));
         }
         last_ts[tid] = stamp;
-        return;
     }
 
 }
@@ -15,6 +15,7 @@
 #include <set>
 #include <string>
 #include <tuple>
+#include <vector>
 #include <memory>
 #include <mutex>
 #include <chrono>
@@ -196,6 +197,8 @@ namespace apex {
         std::map<base_thread_node, size_t> vthread_map;
         std::map<uint32_t, OTF2_EvtWriter*> vthread_evt_writer_map;
         uint32_t make_vtid (base_thread_node &node);
+        void write_async_event(uint32_t tid, std::shared_ptr<profiler> &p);
+        void write_async_metric(uint32_t tid, std::shared_ptr<profiler> &p);
         std::map<uint32_t,uint64_t> last_ts;
         uint64_t dropped;
         int64_t synchronizeClocks(void);
@@ -235,6 +238,9 @@ namespace apex {
         void on_task_complete(std::shared_ptr<task_wrapper> &tt_ptr) {
             APEX_UNUSED(tt_ptr);
         };
+        bool handles(dispatch_event event) {
+            return event != DISPATCH_TASK_COMPLETE;
+        }
         void on_periodic(periodic_event_data &data)
             { APEX_UNUSED(data); };
         void on_custom_event(custom_event_data &data)
@@ -245,6 +251,8 @@ namespace apex {
             std::shared_ptr<profiler> &p);
         void on_async_metric(base_thread_node &node,
             std::shared_ptr<profiler> &p);
+        void on_async_batch(base_thread_node &node,
+            std::vector<std::shared_ptr<profiler> > &profilers);
 
     };
 }
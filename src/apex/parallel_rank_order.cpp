@@ -0,0 +1,187 @@
+#include "parallel_rank_order.hpp"
+#include <algorithm>
+
+namespace apex {
+
+namespace parallel_rank_order {
+
+using nelder_mead::along;
+using nelder_mead::project;
+using nelder_mead::apply;
+using nelder_mead::initial_simplex;
+using nelder_mead::collapsed;
+
+size_t ParallelRankOrder::get_max_iterations() {
+    size_t max_iter{1};
+    for (auto& v : vars) {
+        max_iter = max_iter * (v.second.maxlen + 1);
+    }
+    // no point is measured twice, so this is never more than exhaustive
+    return std::min(max_iterations, max_iter);
+}
+
+double ParallelRankOrder::best_of(const std::vector<Vertex>& vertices) {
+    double best = std::numeric_limits<double>::max();
+    for (auto& v : vertices) { best = std::min(best, v.cost); }
+    return best;
+}
+
+void ParallelRankOrder::start_iteration() {
+    std::stable_sort(simplex.begin(), simplex.end(),
+        [](const Vertex& a, const Vertex& b) { return a.cost < b.cost; });
+    if (collapsed(vars, simplex)) {
+        step = Step::done;
+        return;
+    }
+    move(Step::reflect, -1.0);
+}
+
+/* Move every vertex but the best one along the line from the best one:
+ * -1 reflects it, -2 expands it and 0.5 shrinks it */
+void ParallelRankOrder::move(Step next, double t) {
+    candidates.clear();
+    for (size_t i = 1 ; i < simplex.size() ; i++) {
+        candidates.push_back(Vertex{along(vars, simplex[0].point,
+            simplex[i].point, t), 0.0});
+    }
+    vertex = 0;
+    step = next;
+}
+
+/* Take the next step of the search, now that we have the cost of the
+ * next candidate */
+void ParallelRankOrder::advance(double cost) {
+    if (step == Step::initial) {
+        simplex[vertex].cost = cost;
+        if (++vertex == simplex.size()) { start_iteration(); }
+        return;
+    }
+    candidates[vertex].cost = cost;
+    if (++vertex < candidates.size()) { return; }
+    /* all of the candidates have been measured */
+    switch (step) {
+        case Step::reflect: {
+            if (best_of(candidates) < simplex[0].cost) {
+                reflected = candidates;
+                move(Step::expand, -2.0);
+                return;
+            }
+            move(Step::shrink, 0.5);
+            return;
+        }
+        case Step::expand: {
+            if (best_of(reflected) <= best_of(candidates)) {
+                candidates = reflected;
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+    std::copy(candidates.begin(), candidates.end(), simplex.begin() + 1);
+    start_iteration();
+}
+
+void ParallelRankOrder::getNewSettings() {
+    if (simplex.empty()) {
+        simplex = initial_simplex(vars, true, radius);
+        if (simplex.size() < 2) { step = Step::done; }
+    }
+    /* Run the search until it wants a point we haven't measured yet.  If
+     * it keeps going around the points it has measured, it is stuck. */
+    size_t stalled = 0;
+    while (step != Step::done) {
+        const std::vector<Vertex>& next = (step == Step::initial) ?
+            simplex : candidates;
+        std::vector<size_t> index(project(vars, next[vertex].point));
+        auto measured = evaluated.find(index);
+        if (measured == evaluated.end()) {
+            if (!sharing.enabled) {
+                pending = index;
+                apply(vars, pending);
+                return;
+            }
+            /* Cooperating ranks measure the candidates of a step in
+             * parallel, each taking every size'th one.  When this rank
+             * has no more of them, it holds the best settings until the
+             * others are delivered. */
+            for (size_t i = vertex ; i < next.size() ; i++) {
+                index = project(vars, next[i].point);
+                if (sharing.mine(i) && evaluated.count(index) == 0 &&
+                    sharing.in_flight.count(index) == 0) {
+                    pending = index;
+                    apply(vars, pending);
+                    return;
+                }
+            }
+            pending.clear();
+            break;
+        }
+        advance(measured->second);
+        if (++stalled > max_iterations) { step = Step::done; }
+    }
+    saveBestSettings();
+}
+
+/* The old measurements are stale, so they are forgotten */
+void ParallelRankOrder::retune(double r, size_t budget) {
+    for (auto& v : vars) { v.second.set_index(v.second.best_index); }
+    simplex.clear();
+    candidates.clear();
+    reflected.clear();
+    evaluated.clear();
+    pending.clear();
+    best_cost = std::numeric_limits<double>::max();
+    step = Step::initial;
+    vertex = 0;
+    radius = r;
+    k = 1;
+    kmax = std::min(get_max_iterations(), std::max(budget, (size_t)(1)));
+}
+
+bool ParallelRankOrder::take_pending(std::vector<size_t>& index) {
+    if (pending.empty() || evaluated.count(pending) > 0) { return false; }
+    sharing.in_flight.insert(pending);
+    index.swap(pending);
+    pending.clear();
+    return true;
+}
+
+/* A measurement from one of the cooperating ranks (this one too).  The
+ * search moves on when getNewSettings() finds the point measured. */
+void ParallelRankOrder::import(const std::vector<size_t>& index,
+    double cost) {
+    sharing.in_flight.erase(index);
+    if (index.size() != vars.size() || evaluated.count(index) > 0) { return; }
+    evaluated[index] = cost;
+    if (cost < best_cost) {
+        best_cost = cost;
+        size_t i = 0;
+        for (auto& v : vars) { v.second.best_index = index[i++]; }
+        if (sharing.rank == 0) {
+            std::cout << "New best! " << cost << " k: " << k << std::endl;
+        }
+    }
+    k++;
+}
+
+void ParallelRankOrder::evaluate(double new_cost) {
+    if (pending.empty()) { return; }
+    evaluated[pending] = new_cost;
+    if (new_cost < best_cost) {
+        best_cost = new_cost;
+        std::cout << "New best! " << new_cost << " k: " << k;
+        for (auto& v : vars) { v.second.save_best(); }
+        for (auto& v : vars) { std::cout  << ", value: " << v.second.toString(); }
+        std::cout << std::endl;
+    }
+    advance(new_cost);
+    pending.clear();
+    k++;
+    return;
+}
+
+} // parallel_rank_order
+
+} // apex
@@ -0,0 +1,98 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include "apex_types.h"
+// the variables and simplex helpers are shared with Nelder-Mead
+#include "nelder_mead.hpp"
+
+namespace apex {
+
+namespace parallel_rank_order {
+
+using nelder_mead::VariableType;
+using nelder_mead::Variable;
+using nelder_mead::VariableMap;
+using nelder_mead::Vertex;
+using nelder_mead::EvaluationCache;
+
+/*
+ * Parallel Rank Ordering (Tabatabaee, Tiwari and Hollingsworth, 2005), the
+ * default Active Harmony strategy.  The simplex has 2n+1 vertices for n
+ * variables, and every step moves all but the best vertex at once, so the
+ * candidates could be measured in parallel:
+ *   Reflect every other vertex through the best one
+ *   If a reflection beats the best vertex, also try expanding them all,
+ *   and keep whichever set has the better best point
+ *   Else shrink every other vertex towards the best one
+ * Here the candidates are measured one per evaluation.  The search has
+ * converged when every vertex projects to the same point.
+ */
+
+class ParallelRankOrder {
+private:
+    enum class Step { initial, reflect, expand, shrink, done };
+    Step step;
+    std::vector<Vertex> simplex;
+    std::vector<Vertex> candidates;
+    std::vector<Vertex> reflected;
+    size_t vertex; // the next candidate to measure
+    EvaluationCache evaluated;
+    std::vector<size_t> pending; // the point being measured
+    double best_cost;
+    size_t kmax;
+    size_t k;
+    VariableMap vars;
+    cooperative_tuning::share sharing;
+    double radius{0.5}; // of the initial simplex
+    const size_t max_iterations{1000};
+    void start_iteration();
+    void move(Step next, double t);
+    void advance(double cost);
+    static double best_of(const std::vector<Vertex>& vertices);
+public:
+    void evaluate(double new_cost);
+    ParallelRankOrder() : step(Step::initial), vertex(0), kmax(0), k(1) {
+        best_cost = std::numeric_limits<double>::max();
+    }
+    double getEnergy() { return best_cost; }
+    bool converged() { return (step == Step::done || k > kmax); }
+    void getNewSettings();
+    /* For cooperative tuning: the measurements only come from import(),
+     * and the candidates of each step are dealt out to the ranks */
+    void set_cooperative(int rank, int size) { sharing.set(rank, size); }
+    /* The size of the initial simplex, as a fraction of the space */
+    void set_radius(double r) { radius = r; }
+    /* Search again from the best settings, with a simplex of this radius
+     * and at most budget evaluations, when their cost has changed */
+    void retune(double r, size_t budget);
+    bool take_pending(std::vector<size_t>& index);
+    void import(const std::vector<size_t>& index, double cost);
+    void saveBestSettings() {
+        for (auto& v : vars) { v.second.getBest(); }
+    }
+    void printBestSettings() {
+        std::string d("[");
+        for (auto v : vars) {
+            std::cout << d << v.second.getBest();
+            d = ",";
+        }
+        std::cout << "]" << std::endl;
+    }
+    size_t get_max_iterations();
+    std::map<std::string, Variable>& get_vars() { return vars; }
+    void add_var(std::string name, Variable var) {
+        vars.insert(std::make_pair(name, var));
+        kmax = get_max_iterations();
+    }
+};
+
+} // parallel_rank_order
+
+} // apex
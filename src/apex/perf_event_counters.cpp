@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+/* perf_event_open is Linux only, and APEX_WITH_PERF_EVENT can turn it off */
+#if defined(APEX_HAVE_PERF_EVENT)
+
+#include "perf_event_counters.hpp"
+#include "apex_types.h"
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+
+namespace apex {
+
+    static std::vector<perf_event_attr> event_attrs;
+    static std::vector<std::string> event_names;
+
+    /* The counters of one thread, closed when the thread exits */
+    class thread_counters {
+    public:
+        int fds[perf_event_counters::max_events];
+        perf_event_mmap_page * pages[perf_event_counters::max_events];
+        size_t count;
+        bool opened;
+        thread_counters(void) : count(0), opened(false) {}
+        void open(void);
+        ~thread_counters(void) {
+            size_t page_size = sysconf(_SC_PAGESIZE);
+            for (size_t i = 0 ; i < count ; i++) {
+                if (pages[i] != nullptr) { munmap(pages[i], page_size); }
+                if (fds[i] >= 0) { close(fds[i]); }
+            }
+        }
+    };
+
+    static APEX_NATIVE_TLS thread_counters my_counters;
+
+    static int open_event(perf_event_attr &attr, int group_fd) {
+        return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+
+    /* Convert a perf style event name to an event type and config */
+    static bool parse_event(const std::string &name, perf_event_attr &attr) {
+        static const std::map<std::string, std::pair<uint32_t, uint64_t> >
+            known = {
+            {"cycles", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES}},
+            {"cpu-cycles", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES}},
+            {"instructions", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS}},
+            {"cache-references", {PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_CACHE_REFERENCES}},
+            {"cache-misses", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}},
+            {"branches", {PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_BRANCH_INSTRUCTIONS}},
+            {"branch-instructions", {PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_BRANCH_INSTRUCTIONS}},
+            {"branch-misses", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}},
+            {"bus-cycles", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES}},
+            {"ref-cycles", {PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES}},
+            {"stalled-cycles-frontend", {PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_STALLED_CYCLES_FRONTEND}},
+            {"stalled-cycles-backend", {PERF_TYPE_HARDWARE,
+                PERF_COUNT_HW_STALLED_CYCLES_BACKEND}},
+            {"cpu-clock", {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK}},
+            {"task-clock", {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK}},
+            {"page-faults", {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}},
+            {"minor-faults", {PERF_TYPE_SOFTWARE,
+                PERF_COUNT_SW_PAGE_FAULTS_MIN}},
+            {"major-faults", {PERF_TYPE_SOFTWARE,
+                PERF_COUNT_SW_PAGE_FAULTS_MAJ}},
+            {"context-switches", {PERF_TYPE_SOFTWARE,
+                PERF_COUNT_SW_CONTEXT_SWITCHES}},
+            {"cpu-migrations", {PERF_TYPE_SOFTWARE,
+                PERF_COUNT_SW_CPU_MIGRATIONS}},
+            {"alignment-faults", {PERF_TYPE_SOFTWARE,
+                PERF_COUNT_SW_ALIGNMENT_FAULTS}},
+            {"emulation-faults", {PERF_TYPE_SOFTWARE,
+                PERF_COUNT_SW_EMULATION_FAULTS}}
+        };
+        memset(&attr, 0, sizeof(perf_event_attr));
+        attr.size = sizeof(perf_event_attr);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        auto it = known.find(name);
+        if (it != known.end()) {
+            attr.type = it->second.first;
+            attr.config = it->second.second;
+            return true;
+        }
+        // raw event, e.g. r01c2
+        if (name.size() > 1 && name[0] == 'r') {
+            char * end = nullptr;
+            attr.config = strtoull(name.c_str() + 1, &end, 16);
+            if (end != nullptr && *end == '\0') {
+                attr.type = PERF_TYPE_RAW;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Open the counters on this thread, as one group when possible, and
+     * map the control pages for rdpmc. */
+    void thread_counters::open(void) {
+        opened = true;
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        int leader = -1;
+        for (auto attr : event_attrs) {
+            int fd = open_event(attr, leader);
+            if (fd < 0 && leader >= 0) {
+                // i.e. not enough counters for the group
+                fd = open_event(attr, -1);
+            }
+            if (leader < 0) { leader = fd; }
+            perf_event_mmap_page * page = nullptr;
+            if (fd >= 0) {
+                void * tmp = mmap(nullptr, page_size, PROT_READ, MAP_SHARED,
+                    fd, 0);
+                if (tmp != MAP_FAILED) {
+                    page = static_cast<perf_event_mmap_page*>(tmp);
+                }
+            }
+            fds[count] = fd;
+            pages[count] = page;
+            count++;
+        }
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    static inline uint64_t rdpmc(uint32_t counter) {
+        uint32_t low, high;
+        __asm__ volatile("rdpmc" : "=a" (low), "=d" (high) : "c" (counter));
+        return ((uint64_t)high << 32) | low;
+    }
+
+    /* The user space read protocol from linux/perf_event.h.  Returns false
+     * if the counter can't be read this way right now. */
+    static inline bool read_mapped(perf_event_mmap_page * page,
+        long long &value) {
+        uint32_t seq;
+        uint64_t count;
+        do {
+            seq = page->lock;
+            __asm__ volatile("" ::: "memory");
+            uint32_t index = page->index;
+            if (!page->cap_user_rdpmc || index == 0) { return false; }
+            count = page->offset;
+            uint64_t pmc = rdpmc(index - 1);
+            uint16_t width = page->pmc_width;
+            // sign extend the counter to 64 bits
+            int64_t signed_pmc = (int64_t)(pmc << (64 - width)) >> (64 - width);
+            count += signed_pmc;
+            __asm__ volatile("" ::: "memory");
+        } while (page->lock != seq);
+        value = count;
+        return true;
+    }
+#else
+    static inline bool read_mapped(perf_event_mmap_page * page,
+        long long &value) {
+        APEX_UNUSED(page);
+        APEX_UNUSED(value);
+        return false;
+    }
+#endif
+
+    std::vector<std::string> perf_event_counters::initialize(
+        const std::string &metrics) {
+        std::stringstream tmpstr(metrics);
+        std::istream_iterator<std::string> tmpstr_it(tmpstr);
+        std::istream_iterator<std::string> tmpstr_end;
+        std::vector<std::string> requested(tmpstr_it, tmpstr_end);
+        for (auto& name : requested) {
+            if (event_names.size() == max_events) {
+                std::cerr << "APEX: Too many perf_event metrics, ignoring "
+                          << name << std::endl;
+                continue;
+            }
+            perf_event_attr attr;
+            if (!parse_event(name, attr)) {
+                std::cerr << "APEX: Unknown perf_event metric " << name
+                          << std::endl;
+                continue;
+            }
+            // make sure it can be opened at all
+            int fd = open_event(attr, -1);
+            if (fd < 0) {
+                std::cerr << "APEX: Can't open perf_event metric " << name
+                          << ": " << strerror(errno) << std::endl;
+                continue;
+            }
+            close(fd);
+            event_attrs.push_back(attr);
+            event_names.push_back(name);
+        }
+        return event_names;
+    }
+
+    size_t perf_event_counters::num_events(void) {
+        return event_attrs.size();
+    }
+
+    void perf_event_counters::read(long long * values) {
+        thread_counters &t = my_counters;
+        if (!t.opened) { t.open(); }
+        for (size_t i = 0 ; i < t.count ; i++) {
+            if (t.pages[i] != nullptr && read_mapped(t.pages[i], values[i])) {
+                continue;
+            }
+            uint64_t value = 0;
+            if (t.fds[i] < 0 ||
+                ::read(t.fds[i], &value, sizeof(uint64_t)) != sizeof(uint64_t)) {
+                value = 0;
+            }
+            values[i] = value;
+        }
+    }
+
+}
+
+#endif // APEX_HAVE_PERF_EVENT
+
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace apex {
+
+/* Per-timer hardware and software counters from perf_event_open, for
+ * systems without PAPI.  The counters requested with
+ * APEX_PERF_EVENT_METRICS (perf names like "cycles", "instructions",
+ * "cache-misses", "branch-misses", "task-clock", "page-faults",
+ * "context-switches", or raw "r<hex>" events) are opened as one group per
+ * thread, counting only user space, so they work without privileges
+ * whenever perf_event_paranoid allows self-monitoring (including most
+ * containers, at least for the software events).  Each thread opens its
+ * counters the first time it reads them.
+ *
+ * Hardware counters are read with rdpmc from the mmap'd control page when
+ * the kernel allows user space access, which avoids a system call per read.
+ * Otherwise, and for the software events, the counters are read with
+ * read().  Values are not scaled for multiplexing. */
+class perf_event_counters {
+public:
+    /* At most this many counters, the size of apex_profile::papi_metrics */
+    static const size_t max_events = 8;
+    /* Parse the requested metrics, and open them on the calling thread.
+     * Returns the names of the metrics that could be opened, in the
+     * order of the values from read(). */
+    static std::vector<std::string> initialize(const std::string &metrics);
+    static size_t num_events(void);
+    /* Read the current counts on the calling thread into values. */
+    static void read(long long * values);
+};
+
+}
+
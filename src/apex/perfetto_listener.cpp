@@ -202,8 +202,8 @@ void perfetto_listener::on_async_event(base_thread_node &node,
     std::shared_ptr<profiler> &p, const async_event_data& data) {
     const size_t tid{make_tid(node)};
     uint64_t pguid = 0;
-    if (p->tt_ptr != nullptr && p->tt_ptr->parent != nullptr) {
-        pguid = p->tt_ptr->parent->guid;
+    if (p->tt_ptr != nullptr && p->tt_ptr->has_parent()) {
+        pguid = p->tt_ptr->parent_guid;
     }
     TRACE_EVENT_BEGIN(_category,
         perfetto::DynamicString{p->get_task_id()->get_name()},
@@ -224,5 +224,30 @@ void perfetto_listener::on_async_metric(base_thread_node &node,
         p->value);
 }
 
+void perfetto_listener::on_async_batch(base_thread_node &node,
+    std::vector<std::shared_ptr<profiler> > &profilers) {
+    const size_t tid{make_tid(node)};
+    for (auto& p : profilers) {
+        if (p->is_counter) {
+            TRACE_COUNTER(_category,
+                p->get_task_id()->get_name().c_str(),
+                (uint64_t)p->get_stop_ns(),
+                p->value);
+            continue;
+        }
+        uint64_t pguid = 0;
+        if (p->tt_ptr != nullptr && p->tt_ptr->has_parent()) {
+            pguid = p->tt_ptr->parent_guid;
+        }
+        TRACE_EVENT_BEGIN(_category,
+            perfetto::DynamicString{p->get_task_id()->get_name()},
+            perfetto::Track(tid),
+            (uint64_t)p->get_start_ns(), _guid, p->guid, _pguid, pguid);
+        TRACE_EVENT_END(_category,
+            perfetto::Track(tid),
+            (uint64_t)p->get_stop_ns());
+    }
+}
+
 }// end namespace
 
@@ -36,6 +36,9 @@ public:
   	void on_task_complete(std::shared_ptr<task_wrapper> &tt_ptr) {
     	APEX_UNUSED(tt_ptr);
   	};
+  	bool handles(dispatch_event event) {
+    	return event != DISPATCH_TASK_COMPLETE;
+  	}
   	void on_sample_value(sample_value_event_data &data);
   	void on_periodic(periodic_event_data &data);
   	void on_custom_event(custom_event_data &data);
@@ -45,6 +48,8 @@ public:
     void on_async_event(base_thread_node &node, std::shared_ptr<profiler> &p,
         const async_event_data& data);
     void on_async_metric(base_thread_node &node, std::shared_ptr<profiler> &p);
+    void on_async_batch(base_thread_node &node,
+        std::vector<std::shared_ptr<profiler> > &profilers);
 
 private:
     void get_file_name();
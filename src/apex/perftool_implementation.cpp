@@ -9,12 +9,21 @@
 #include "perfstubs_api/tool.h"
 #include <stdlib.h>
 #include "apex.h"
+#include "apex.hpp"
+#include "handle_cache.hpp"
 #include "thread_instance.hpp"
 #include <mutex>
-#include <unordered_map>
 
 std::mutex my_mutex;
 
+namespace {
+    /* PerfStubs creates a timer once per call site, so one name can have
+     * several handles; give them all the same interned timer, which is
+     * the opaque handle returned to PerfStubs. */
+    apex::handle_cache<std::string> timer_handles(
+        [](const std::string& name) { return name; });
+}
+
 extern "C" {
     // library function declarations
     void ps_tool_initialize(void) {
@@ -34,14 +43,34 @@ extern "C" {
 
     // measurement function declarations
     void* ps_tool_timer_create(const char *timer_name) {
-        return strdup(timer_name);
+        return const_cast<apex::interned_timer*>(
+            timer_handles.get(std::string(timer_name)));
     }
     void ps_tool_timer_start(const void *timer) {
-        apex_start(APEX_NAME_STRING, const_cast<void*>(timer));
+        const apex::interned_timer * handle =
+            static_cast<const apex::interned_timer*>(timer);
+        if (handle->excluded) { return; }
+        apex::start(handle->id);
     }
     void ps_tool_timer_stop(const void *timer) {
-        APEX_UNUSED(timer);
-        apex_stop(apex::thread_instance::instance().get_current_profiler());
+        const apex::interned_timer * handle =
+            static_cast<const apex::interned_timer*>(timer);
+        if (handle->excluded) { return; }
+        /* Stop this timer, not whichever one happens to be current.  If
+         * the timers overlap, APEX stops (and later restarts) the timers
+         * that were started after this one. */
+        apex::profiler * p =
+            apex::thread_instance::find_current_profiler(handle->id);
+        if (p == nullptr) {
+            if (apex::apex_options::use_verbose()) {
+                std::cerr << "APEX: PerfStubs timer "
+                          << handle->id->get_name()
+                          << " stopped, but not running on this thread"
+                          << std::endl;
+            }
+            return;
+        }
+        apex::stop(p);
     }
     void ps_tool_start_string(const char *timer) {
         apex_start(APEX_NAME_STRING, const_cast<char*>(timer));
@@ -22,42 +22,53 @@
 #include "apex.hpp"
 #include "policy_handler.hpp"
 #include <iostream>
-#include <list>
 #include <atomic>
 #include <mutex>
 #include <memory>
+#include <algorithm>
 #if !defined(_WIN32) && (defined(__unix__) || defined(__unix) ||\
     (defined(__APPLE__) && defined(__MACH__)))
 #include <unistd.h>
 #endif
 #include "tau_listener.hpp"
+#include "trace_event_listener.hpp"
+#include "task_identifier.hpp"
+#include "apex_clock.hpp"
 
 using namespace std;
 
 namespace apex {
 
-    class policy_manager {
-    public:
-        static std::atomic<size_t>& get() {
-            static std::atomic<size_t> active;
-            return active;
-        };
-        policy_manager() {
-            get()++;
-        }
-        ~policy_manager() {
-            get()--;
-        }
-    };
-
     std::atomic<int> next_id(0);
+    std::atomic<size_t> next_buffer_index(0);
+    /* The handler whose timer runs on this thread, and the handler whose
+     * batches this thread is delivering, if any.  Policies can register
+     * and deregister policies, and neither can wait for itself. */
+    static APEX_NATIVE_TLS policy_handler * timer_handler = nullptr;
+    static APEX_NATIVE_TLS policy_handler * delivering_handler = nullptr;
+
+    /* Policies run in the measurement path, so their captures are done on
+     * the trace listener's capture thread. */
+    static void request_trace_capture(void) {
+        if (!apex_options::use_trace_event()) { return; }
+        apex* instance = apex::instance();
+        if (instance == nullptr ||
+            instance->the_trace_event_listener == nullptr) { return; }
+        trace_event_listener * tel =
+            (trace_event_listener*)instance->the_trace_event_listener;
+        tel->request_capture("policy");
+    }
 
 #ifdef APEX_HAVE_HPX
     std::atomic<bool> hpx_timer_stopped{false};
     std::mutex hpx_timer_mutex;
-    policy_handler::policy_handler (void) : handler() { }
+    policy_handler::policy_handler (void) : handler(),
+        _buffer_index(next_buffer_index++), _has_timer(false),
+        _timer_stopped(false), _shut_down(false) { }
 #else
-    policy_handler::policy_handler (void) : handler() { }
+    policy_handler::policy_handler (void) : handler(),
+        _buffer_index(next_buffer_index++), _has_timer(false),
+        _timer_stopped(false), _shut_down(false) { }
 #endif
 
     /*
@@ -72,6 +83,8 @@ namespace apex {
 #ifdef APEX_HAVE_HPX
     policy_handler::policy_handler (uint64_t period_microseconds) :
         handler(period_microseconds),
+        _buffer_index(next_buffer_index++), _has_timer(false),
+        _timer_stopped(false), _shut_down(false),
         hpx_timer(hpx::bind(&policy_handler::_handler, this), _period,
         "apex_internal_policy_handler")
     {
@@ -79,7 +92,9 @@ namespace apex {
     }
 #else
     policy_handler::policy_handler (uint64_t period_microseconds) :
-        handler(period_microseconds)
+        handler(period_microseconds),
+        _buffer_index(next_buffer_index++), _has_timer(false),
+        _timer_stopped(false), _shut_down(false)
     {
         _init();
     }
@@ -90,21 +105,30 @@ namespace apex {
             initialize_worker_thread_for_tau();
             _handler_initialized = true;
         }
+        timer_handler = this;
         this->_reset();
         if (_terminate) return true;
         if (apex_options::use_tau()) {
             tau_listener::Tau_start_wrapper("policy_handler::_handler");
         }
+        deliver_batches();
         periodic_event_data data;
         this->on_periodic(data);
+        // free the replaced policy snapshots that readers are done with
+        _reclaimer.reclaim();
         if (apex_options::use_tau()) {
             tau_listener::Tau_stop_wrapper("policy_handler::_handler");
         }
         return true;
     }
 
+    policy_handler::~policy_handler (void) {
+        // the policy_snapshot destructors free the current snapshots, and
+        // the reclaimer frees the retired ones
+    }
+
     void policy_handler::_init(void) {
-        policy_manager::get() = 0;
+        _has_timer = true;
 #ifdef APEX_HAVE_HPX
         hpx_timer.start();
 #else
@@ -127,334 +151,272 @@ namespace apex {
 #endif
     }
 
+    policy_list * policy_handler::get_policy_list(
+        const apex_event_type & when) {
+        switch(when) {
+            case APEX_STARTUP: return &startup_policies;
+            case APEX_SHUTDOWN: return &shutdown_policies;
+            case APEX_NEW_NODE: return &new_node_policies;
+            case APEX_NEW_THREAD: return &new_thread_policies;
+            case APEX_EXIT_THREAD: return &exit_thread_policies;
+            case APEX_START_EVENT: return &start_event_policies;
+            case APEX_RESUME_EVENT: return &resume_event_policies;
+            case APEX_STOP_EVENT: return &stop_event_policies;
+            case APEX_YIELD_EVENT: return &yield_event_policies;
+            case APEX_SAMPLE_VALUE: return &sample_value_policies;
+            case APEX_SEND: return &send_policies;
+            case APEX_RECV: return &recv_policies;
+            case APEX_PERIODIC: return &periodic_policies;
+            //case APEX_CUSTOM_EVENT_1:
+            default: return nullptr;
+        }
+    }
+
+    policy_list * policy_handler::get_batch_policy_list(
+        const apex_event_type & when) {
+        switch(when) {
+            case APEX_START_EVENT: return &batch_start_policies;
+            case APEX_RESUME_EVENT: return &batch_resume_policies;
+            case APEX_STOP_EVENT: return &batch_stop_policies;
+            case APEX_YIELD_EVENT: return &batch_yield_policies;
+            case APEX_SAMPLE_VALUE: return &batch_sample_value_policies;
+            default: return nullptr;
+        }
+    }
+
     int policy_handler::register_policy(const apex_event_type & when,
             std::function<int(apex_context const&)> f) {
-        // save the old policy setting
-        bool old_policy_setting = apex_options::use_policy();
-        // prevent policies from iterating - kind of like a lock, but faster.
-        apex_options::use_policy(false);
-        // Sleep just a tiny bit - that allows other threads that might be
-        // currently processing policies to clear out. This is actually
-        // more efficient than a lock transaction on every policy execution.
-        while(policy_manager::get() > 0) {
-#if defined(_WIN32)
-            Sleep(1);
-#else
-            usleep(apex_options::policy_drain_timeout()); // sleep 1ms
-#endif
-        }
         int id = next_id++;
         std::shared_ptr<policy_instance> instance(
                 std::make_shared<policy_instance>(id, f));
+        std::unique_lock<std::mutex> l(_write_mutex);
+        policy_list * policies = get_policy_list(when);
+        if (policies != nullptr) {
+            const policy_vector * current = policies->load();
+            policy_vector * next = (current == nullptr) ?
+                new policy_vector() : new policy_vector(*current);
+            next->push_back(instance);
+            _reclaimer.retire(std::shared_ptr<const policy_vector>(
+                policies->publish(next)));
+        } else {
+            const custom_policy_map * current = custom_event_policies.load();
+            custom_policy_map * next = (current == nullptr) ?
+                new custom_policy_map() : new custom_policy_map(*current);
+            (*next)[when].push_back(instance);
+            _reclaimer.retire(std::shared_ptr<const custom_policy_map>(
+                custom_event_policies.publish(next)));
+        }
+        policies_changed();
+        if (when == APEX_PERIODIC) {
+            l.unlock();
+            update_timer();
+        }
+        return id;
+    }
+
+    bool policy_handler::batchable(const apex_event_type & when) {
         switch(when) {
-            case APEX_STARTUP: {
-                //write_lock_type l(startup_mutex);
-                startup_policies.push_back(instance);
-                break;
-            }
-            case APEX_SHUTDOWN: {
-                //write_lock_type l(shutdown_mutex);
-                shutdown_policies.push_back(instance);
-                break;
-            }
-            case APEX_NEW_NODE: {
-                //write_lock_type l(new_node_mutex);
-                new_node_policies.push_back(instance);
-                break;
-            }
-            case APEX_NEW_THREAD: {
-                //write_lock_type l(new_thread_mutex);
-                new_thread_policies.push_back(instance);
-                break;
-            }
-            case APEX_EXIT_THREAD: {
-                //write_lock_type l(exit_thread_mutex);
-                exit_thread_policies.push_back(instance);
-                break;
-            }
-            case APEX_START_EVENT: {
-                //write_lock_type l(start_event_mutex);
-                start_event_policies.push_back(instance);
-                break;
-            }
-            case APEX_RESUME_EVENT: {
-                //write_lock_type l(resume_event_mutex);
-                resume_event_policies.push_back(instance);
-                break;
-            }
-            case APEX_STOP_EVENT: {
-                //write_lock_type l(stop_event_mutex);
-                stop_event_policies.push_back(instance);
-                break;
-            }
-            case APEX_YIELD_EVENT: {
-                //write_lock_type l(yield_event_mutex);
-                yield_event_policies.push_back(instance);
-                break;
-            }
-            case APEX_SAMPLE_VALUE: {
-                //write_lock_type l(sample_value_mutex);
-                sample_value_policies.push_back(instance);
-                break;
-            }
-            case APEX_SEND: {
-                //write_lock_type l(sample_value_mutex);
-                send_policies.push_back(instance);
-                break;
-            }
-            case APEX_RECV: {
-                //write_lock_type l(sample_value_mutex);
-                recv_policies.push_back(instance);
-                break;
-            }
-            case APEX_PERIODIC: {
-                //write_lock_type l(periodic_mutex);
-                periodic_policies.push_back(instance);
-                break;
-            }
-            //case APEX_CUSTOM_EVENT_1:
-            default: {
-                //write_lock_type l(custom_event_mutex);
-                static std::mutex foo;
-                foo.lock();
-                if(custom_event_policies.find(when) == custom_event_policies.end()) {
-                    std::list<std::shared_ptr<policy_instance> > new_list;
-                    custom_event_policies.insert(std::make_pair(when, std::move(new_list)));
-                }
-                foo.unlock();
-                custom_event_policies[when].push_back(instance);
-                break;
-            }
+            case APEX_START_EVENT:
+            case APEX_RESUME_EVENT:
+            case APEX_STOP_EVENT:
+            case APEX_YIELD_EVENT:
+            case APEX_SAMPLE_VALUE:
+                return true;
+            default:
+                std::cerr << "Warning: batch policies are only supported for "
+                    << "start, stop, yield, resume and sample value events."
+                    << std::endl;
+                return false;
         }
-        apex_options::use_policy(old_policy_setting);
+    }
+
+    int policy_handler::register_batch_policy(const apex_event_type & when,
+            std::function<int(apex_context const&)> f) {
+        policy_list * policies = get_batch_policy_list(when);
+        if (policies == nullptr) {
+            return -1;
+        }
+        int id = next_id++;
+        std::shared_ptr<policy_instance> instance(
+                std::make_shared<policy_instance>(id, f));
+        std::unique_lock<std::mutex> l(_write_mutex);
+        const policy_vector * current = policies->load();
+        policy_vector * next = (current == nullptr) ?
+            new policy_vector() : new policy_vector(*current);
+        next->push_back(instance);
+        _reclaimer.retire(std::shared_ptr<const policy_vector>(
+            policies->publish(next)));
+        policies_changed();
+        l.unlock();
+        update_timer();
         return id;
+    }
 
+    /* Build a copy of the snapshot without the policy, or return false
+     * if the policy isn't in this snapshot. */
+    static bool copy_without_policy(const policy_vector & current,
+        policy_vector & next, int id) {
+        bool found = false;
+        next.reserve(current.size());
+        for (const std::shared_ptr<policy_instance>& policy : current) {
+            if (!found && policy->id == id) {
+                found = true;
+                continue;
+            }
+            next.push_back(policy);
+        }
+        return found;
     }
 
-    int policy_handler::deregister_policy(apex_policy_handle * handle) {
-        if (handle == nullptr) {
-            return APEX_NOERROR;
+    /* Must be called while holding the write mutex. */
+    bool policy_handler::remove_policy(policy_list & policies,
+        apex_policy_handle * handle) {
+        const policy_vector * current = policies.load();
+        if (current == nullptr) { return false; }
+        policy_vector * next = new policy_vector();
+        if (!copy_without_policy(*current, *next, handle->id)) {
+            delete next;
+            return false;
         }
-        // save the old policy setting
-        bool old_policy_setting = apex_options::use_policy();
-        // prevent policies from iterating - kind of like a lock, but faster.
-        apex_options::use_policy(false);
-        // Sleep just a tiny bit - that allows other threads that might be
-        // currently processing policies to clear out. This is actually
-        // more efficient than a lock transaction on every policy execution.
-        while (policy_manager::get() > 0) {
-#if defined(_WIN32)
-            Sleep(1);
-#else
-            usleep(apex_options::policy_drain_timeout()); // sleep 1ms
-#endif
+        // an empty list is always represented by a null snapshot
+        if (next->empty()) {
+            delete next;
+            next = nullptr;
         }
-        switch(handle->event_type) {
-            case APEX_STARTUP: {
-                //write_lock_type l(startup_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = startup_policies.begin() ;
-                    it != startup_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        startup_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_SHUTDOWN: {
-                //write_lock_type l(shutdown_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = shutdown_policies.begin() ;
-                    it != shutdown_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        shutdown_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_NEW_NODE: {
-                //write_lock_type l(new_node_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = new_node_policies.begin() ;
-                    it != new_node_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        new_node_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_NEW_THREAD: {
-                //write_lock_type l(new_thread_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = new_thread_policies.begin() ;
-                    it != new_thread_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        new_thread_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_EXIT_THREAD: {
-                //write_lock_type l(exit_thread_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = exit_thread_policies.begin() ;
-                    it != exit_thread_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        exit_thread_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_START_EVENT: {
-                //write_lock_type l(start_event_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = start_event_policies.begin() ;
-                    it != start_event_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        start_event_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_RESUME_EVENT: {
-                //write_lock_type l(resume_event_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = resume_event_policies.begin() ;
-                    it != resume_event_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        resume_event_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_STOP_EVENT: {
-                //write_lock_type l(stop_event_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = stop_event_policies.begin() ;
-                    it != stop_event_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        stop_event_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_YIELD_EVENT: {
-                //write_lock_type l(yield_event_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = yield_event_policies.begin() ;
-                    it != yield_event_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        yield_event_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_SAMPLE_VALUE: {
-                //write_lock_type l(sample_value_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = sample_value_policies.begin() ;
-                    it != sample_value_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        sample_value_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_SEND: {
-                //write_lock_type l(send_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = send_policies.begin() ;
-                    it != send_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        send_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            case APEX_RECV: {
-                //write_lock_type l(recv_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = recv_policies.begin() ;
-                    it != recv_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        recv_policies.erase(it);
-                        break;
-                    }
+        _reclaimer.retire(std::shared_ptr<const policy_vector>(
+            policies.publish(next)));
+        return true;
+    }
+
+    /* The timer calls the periodic policies and delivers the batches, so
+     * stop it when neither are left, and start it again when one is
+     * registered.  The timer's own thread can't wait for itself to stop;
+     * it keeps running, and the other threads check again after stopping
+     * it, in case a policy it called registered another one meanwhile.
+     * Must not be called while holding the write mutex. */
+    void policy_handler::update_timer(void) {
+        if (!_has_timer || timer_handler == this) { return; }
+        std::unique_lock<std::mutex> l(_timer_mutex);
+        while (!_shut_down && needs_timer() == _timer_stopped) {
+            if (_timer_stopped) {
+                _timer_stopped = false;
+                _terminate = false;
+#ifdef APEX_HAVE_HPX
+                {
+                    std::unique_lock<mutex> hl(hpx_timer_mutex);
+                    hpx_timer_stopped = false;
                 }
-                break;
-            }
-            case APEX_PERIODIC: {
-                //write_lock_type l(periodic_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = periodic_policies.begin() ;
-                    it != periodic_policies.end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                            _terminate = true;
+                hpx_timer.start();
+#else
+                run();
+#endif
+            } else {
+                _timer_stopped = true;
+                _terminate = true;
 #ifdef APEX_HAVE_HPX
-                            this->_reset();
+                this->_reset();
 #else
-                            cancel();
+                cancel();
 #endif
-                        periodic_policies.erase(it);
-                        break;
-                    }
-                }
-                break;
-            }
-            //case APEX_CUSTOM_EVENT_1:
-            default: {
-                //write_lock_type l(custom_event_mutex);
-                std::list<std::shared_ptr<policy_instance> >::iterator it;
-                for(it = custom_event_policies[handle->event_type].begin() ; it
-                    != custom_event_policies[handle->event_type].end() ; it++) {
-                    std::shared_ptr<policy_instance> policy = *it;
-                    if (policy->id == handle->id) {
-                        custom_event_policies[handle->event_type].erase(it);
-                        break;
-                    }
-                }
-                break;
             }
         }
-        handle = nullptr;
-        apex_options::use_policy(old_policy_setting);
+    }
+
+    bool policy_handler::needs_timer(void) {
+        return !periodic_policies.empty() ||
+            !batch_start_policies.empty() ||
+            !batch_resume_policies.empty() ||
+            !batch_stop_policies.empty() ||
+            !batch_yield_policies.empty() ||
+            !batch_sample_value_policies.empty();
+    }
+
+    /* Only the events with policies need to be sent to this handler. */
+    bool policy_handler::handles(dispatch_event event) {
+        switch (event) {
+            case DISPATCH_START:
+                return !start_event_policies.empty() ||
+                    !batch_start_policies.empty();
+            case DISPATCH_STOP:
+                return !stop_event_policies.empty() ||
+                    !batch_stop_policies.empty();
+            case DISPATCH_YIELD:
+                return !yield_event_policies.empty() ||
+                    !batch_yield_policies.empty();
+            case DISPATCH_RESUME:
+                return !resume_event_policies.empty() ||
+                    !batch_resume_policies.empty();
+            case DISPATCH_SAMPLE_VALUE:
+                return !sample_value_policies.empty() ||
+                    !batch_sample_value_policies.empty();
+            default:
+                return false;
+        }
+    }
+
+    /* Let APEX know that the events this handler needs have changed.  While
+     * APEX is initializing, there is no instance yet, and the table is
+     * built once all of the listeners have been created. */
+    void policy_handler::policies_changed(void) {
+        apex * instance = apex::__instance();
+        if (instance != nullptr) {
+            instance->build_dispatch_table();
+        }
+    }
+
+    int policy_handler::deregister_policy(apex_policy_handle * handle) {
+        if (handle == nullptr) {
+            return APEX_NOERROR;
+        }
+        policy_list * batch = get_batch_policy_list(handle->event_type);
+        // hand over whatever is buffered before a batch policy goes away,
+        // unless a batch policy is removing one while it is delivered
+        if (batch != nullptr && !batch->empty() &&
+            delivering_handler != this) {
+            deliver_batches();
+        }
+        std::unique_lock<std::mutex> l(_write_mutex);
+        policy_list * policies = get_policy_list(handle->event_type);
+        if (policies != nullptr) {
+            bool timed = false;
+            if (remove_policy(*policies, handle)) {
+                timed = (handle->event_type == APEX_PERIODIC);
+            } else if (batch != nullptr) {
+                timed = remove_policy(*batch, handle);
+            }
+            policies_changed();
+            if (timed) {
+                l.unlock();
+                update_timer();
+            }
+        } else {
+            const custom_policy_map * current = custom_event_policies.load();
+            if (current == nullptr) { return APEX_NOERROR; }
+            auto it = current->find(handle->event_type);
+            if (it == current->end()) { return APEX_NOERROR; }
+            policy_vector remaining;
+            if (!copy_without_policy(it->second, remaining, handle->id)) {
+                return APEX_NOERROR;
+            }
+            custom_policy_map * next = new custom_policy_map(*current);
+            if (remaining.empty()) {
+                next->erase(handle->event_type);
+            } else {
+                (*next)[handle->event_type] = std::move(remaining);
+            }
+            if (next->empty()) {
+                delete next;
+                next = nullptr;
+            }
+            _reclaimer.retire(std::shared_ptr<const custom_policy_map>(
+                custom_event_policies.publish(next)));
+        }
         return APEX_NOERROR;
     }
 
     inline void policy_handler::call_policies(
-            const std::list<std::shared_ptr<policy_instance> > & policies,
+            const policy_vector & policies,
             void *data, const apex_event_type& event_type) {
-        /* we are using this flag to prevent race conditions on the
-         * list of policies. If the list changes, we can't iterate
-         * over it. */
-        if (!apex_options::use_policy()) { return; }
-        // scoped variable to increment/decrement active policies
-        policy_manager mgr;
-        APEX_UNUSED(mgr);
         for(const std::shared_ptr<policy_instance>& policy : policies) {
             apex_context my_context;
             my_context.event_type = event_type;
@@ -462,16 +424,134 @@ namespace apex {
             my_context.data = data;
             // last chance to interrupt policy execution at shutdown
             if (_terminate) return;
-            // to check if policy is already deregistered(race condition).
-            if(policy == nullptr) continue;
-            const bool result = policy->func(my_context);
-            if(result != APEX_NOERROR) {
+            const int result = policy->func(my_context);
+            if (result == APEX_TRACE_CAPTURE) {
+                request_trace_capture();
+            } else if(result != APEX_NOERROR) {
                 printf("Warning: registered policy function failed!\n");
             }
             if (!apex_options::use_policy()) { return; }
         }
     }
 
+    inline void policy_handler::call_policies(
+            const policy_list & policies,
+            void *data, const apex_event_type& event_type) {
+        // nothing registered?  Then this event costs nothing.
+        if (policies.empty()) { return; }
+        if (!apex_options::use_policy()) { return; }
+        // register as a reader *before* loading the snapshot, so that
+        // a concurrent writer won't reclaim it while we iterate.
+        epoch_reclaimer::guard reader(_reclaimer);
+        APEX_UNUSED(reader);
+        const policy_vector * snapshot = policies.load();
+        if (snapshot == nullptr) { return; }
+        call_policies(*snapshot, data, event_type);
+    }
+
+    /* Each thread keeps one buffer per handler, indexed by the handler's
+     * buffer index.  Indexes are never reused, so a stale entry for a
+     * destroyed handler is never looked up again. */
+    policy_event_buffer * policy_handler::get_event_buffer(void) {
+        static APEX_NATIVE_TLS std::vector<policy_event_buffer*> buffers;
+        if (buffers.size() <= _buffer_index) {
+            buffers.resize(_buffer_index + 1, nullptr);
+        }
+        policy_event_buffer * buffer = buffers[_buffer_index];
+        if (buffer == nullptr) {
+            buffer = new policy_event_buffer();
+            std::unique_lock<std::mutex> l(_buffer_mutex);
+            _buffers.emplace_back(buffer);
+            buffers[_buffer_index] = buffer;
+        }
+        return buffer;
+    }
+
+    inline void policy_handler::buffer_event(const apex_event_type event_type,
+        void * task_id, uint64_t timestamp, double value) {
+        policy_event_buffer * buffer = get_event_buffer();
+        std::unique_lock<std::mutex> l(buffer->mtx);
+        buffer->records.push_back({event_type, task_id, timestamp, value});
+    }
+
+    void policy_handler::deliver_batch(const policy_list & policies,
+        apex_event_record * records, size_t count,
+        const apex_event_type event_type) {
+        if (count == 0 || policies.empty()) { return; }
+        epoch_reclaimer::guard reader(_reclaimer);
+        APEX_UNUSED(reader);
+        const policy_vector * snapshot = policies.load();
+        if (snapshot == nullptr) { return; }
+        apex_event_batch batch;
+        batch.count = count;
+        batch.records = records;
+        // don't check _terminate, we also deliver during shutdown.
+        for(const std::shared_ptr<policy_instance>& policy : *snapshot) {
+            apex_context my_context;
+            my_context.event_type = event_type;
+            my_context.policy_handle = nullptr;
+            my_context.data = (void*)&batch;
+            const int result = policy->func(my_context);
+            if (result == APEX_TRACE_CAPTURE) {
+                request_trace_capture();
+            } else if(result != APEX_NOERROR) {
+                printf("Warning: registered policy function failed!\n");
+            }
+            if (!apex_options::use_policy()) { return; }
+        }
+    }
+
+    /* Drain the per-thread buffers and hand the events to the batch
+     * policies, one call per event type, ordered by timestamp. */
+    void policy_handler::deliver_batches(void) {
+        std::unique_lock<std::mutex> dl(_deliver_mutex);
+        /* the policies may deregister batch policies, which then must not
+         * deliver again on this thread */
+        struct delivery_scope {
+            policy_handler * outer;
+            delivery_scope(policy_handler * h) : outer(delivering_handler) {
+                delivering_handler = h;
+            }
+            ~delivery_scope() { delivering_handler = outer; }
+        } scope(this);
+        APEX_UNUSED(scope);
+        _delivery.clear();
+        {
+            std::unique_lock<std::mutex> bl(_buffer_mutex);
+            for (auto& buffer : _buffers) {
+                std::unique_lock<std::mutex> l(buffer->mtx);
+                _delivery.insert(_delivery.end(),
+                    buffer->records.begin(), buffer->records.end());
+                // clear() keeps the capacity, so the worker doesn't
+                // reallocate in the next period.
+                buffer->records.clear();
+            }
+        }
+        if (_delivery.empty() || !apex_options::use_policy()) { return; }
+        std::sort(_delivery.begin(), _delivery.end(),
+            [](const apex_event_record& a, const apex_event_record& b) {
+                if (a.event_type != b.event_type) {
+                    return a.event_type < b.event_type;
+                }
+                return a.timestamp < b.timestamp;
+            });
+        size_t first = 0;
+        while (first < _delivery.size()) {
+            const apex_event_type event_type = _delivery[first].event_type;
+            size_t last = first;
+            while (last < _delivery.size() &&
+                   _delivery[last].event_type == event_type) {
+                last++;
+            }
+            policy_list * policies = get_batch_policy_list(event_type);
+            if (policies != nullptr) {
+                deliver_batch(*policies, &(_delivery[first]),
+                    last - first, event_type);
+            }
+            first = last;
+        }
+    }
+
     void policy_handler::on_startup(startup_event_data &data) {
         call_policies(startup_policies, (void *)&data, data.event_type_);
     }
@@ -481,24 +561,41 @@ namespace apex {
         return;
     }
 
+    void policy_handler::on_pre_shutdown(void) {
+        deliver_batches();
+    }
+
     void policy_handler::on_shutdown(shutdown_event_data &data) {
         APEX_UNUSED(data);
-        if (_terminate) return;
-        // prevent periodic policies from executing while we are shutting down.
-        _terminate = true;
+        {
+            // a stopped timer sets _terminate too, so don't check that.
+            std::unique_lock<std::mutex> l(_timer_mutex);
+            if (_shut_down) return;
+            _shut_down = true;
+            // prevent periodic policies from executing while we are shutting down.
+            _terminate = true;
 #ifdef APEX_HAVE_HPX
-        //this->_reset();
+            //this->_reset();
 #else
-        cancel();
+            cancel();
 #endif
+        }
+        if (shutdown_policies.empty()) { return; }
         if (!apex_options::use_policy()) { return; }
-        for(const std::shared_ptr<policy_instance>& policy : shutdown_policies) {
+        epoch_reclaimer::guard reader(_reclaimer);
+        APEX_UNUSED(reader);
+        const policy_vector * snapshot = shutdown_policies.load();
+        if (snapshot == nullptr) { return; }
+        // don't check _terminate here, we just set it.
+        for(const std::shared_ptr<policy_instance>& policy : *snapshot) {
             apex_context my_context;
             my_context.event_type = APEX_SHUTDOWN;
             my_context.policy_handle = nullptr;
             my_context.data = nullptr;
-            const bool result = policy->func(my_context);
-            if(result != APEX_NOERROR) {
+            const int result = policy->func(my_context);
+            if (result == APEX_TRACE_CAPTURE) {
+                request_trace_capture();
+            } else if(result != APEX_NOERROR) {
                 printf("Warning: registered policy function failed!\n");
             }
             if (!apex_options::use_policy()) { return; }
@@ -520,27 +617,48 @@ namespace apex {
     bool policy_handler::on_start(std::shared_ptr<task_wrapper> &tt_ptr) {
         call_policies(start_event_policies, (void *)tt_ptr->get_task_id(),
             APEX_START_EVENT);
+        if (!batch_start_policies.empty()) {
+            buffer_event(APEX_START_EVENT, (void *)tt_ptr->get_task_id(),
+                our_clock::now_ns(), 0.0);
+        }
         return true;
     }
 
     bool policy_handler::on_resume(std::shared_ptr<task_wrapper> &tt_ptr) {
         call_policies(resume_event_policies, (void *)tt_ptr->get_task_id(),
             APEX_RESUME_EVENT);
+        if (!batch_resume_policies.empty()) {
+            buffer_event(APEX_RESUME_EVENT, (void *)tt_ptr->get_task_id(),
+                our_clock::now_ns(), 0.0);
+        }
         return true;
     }
 
     void policy_handler::on_stop(std::shared_ptr<profiler> &p) {
         call_policies(stop_event_policies, (void *)p->tt_ptr->get_task_id(),
             APEX_STOP_EVENT);
+        if (!batch_stop_policies.empty()) {
+            buffer_event(APEX_STOP_EVENT, (void *)p->tt_ptr->get_task_id(),
+                p->end_ns, p->elapsed());
+        }
     }
 
     void policy_handler::on_yield(std::shared_ptr<profiler> &p) {
         call_policies(yield_event_policies, (void *)p->tt_ptr->get_task_id(),
             APEX_YIELD_EVENT);
+        if (!batch_yield_policies.empty()) {
+            buffer_event(APEX_YIELD_EVENT, (void *)p->tt_ptr->get_task_id(),
+                p->end_ns, p->elapsed());
+        }
     }
 
     void policy_handler::on_sample_value(sample_value_event_data &data) {
         call_policies(sample_value_policies, &data, APEX_SAMPLE_VALUE);
+        if (!batch_sample_value_policies.empty()) {
+            buffer_event(APEX_SAMPLE_VALUE,
+                (void *)data.get_task_id(),
+                our_clock::now_ns(), data.counter_value);
+        }
     }
 
     void policy_handler::on_send(message_event_data &data) {
@@ -552,33 +670,18 @@ namespace apex {
     }
 
     void policy_handler::on_custom_event(custom_event_data &data) {
+        if (custom_event_policies.empty()) { return; }
         if (!apex_options::use_policy()) { return; }
-        // scoped variable to increment/decrement active policies
-        policy_manager mgr;
-        APEX_UNUSED(mgr);
-        for(const std::shared_ptr<policy_instance>& policy :
-            custom_event_policies[data.event_type_]) {
-            apex_context my_context;
-            my_context.event_type = data.event_type_;
-            my_context.policy_handle = nullptr;
-            my_context.data = data.data;
-            // last chance to interrupt policy execution at shutdown
-            // HOWEVER, if the event is shutdown, run the policy.
-            if (_terminate) return;
-            const bool result = policy->func(my_context);
-            if(result != APEX_NOERROR) {
-                printf("Warning: registered policy function failed!\n");
-            }
-            if (!apex_options::use_policy()) { return; }
-        }
+        epoch_reclaimer::guard reader(_reclaimer);
+        APEX_UNUSED(reader);
+        const custom_policy_map * snapshot = custom_event_policies.load();
+        if (snapshot == nullptr) { return; }
+        auto it = snapshot->find(data.event_type_);
+        if (it == snapshot->end()) { return; }
+        call_policies(it->second, data.data, data.event_type_);
     }
 
     void policy_handler::on_periodic(periodic_event_data &data) {
-        // get the read lock first. Because if we are shutting down,
-        // the _terminate flag will be set after the write lock has
-        // been acquired.  Yes, the periodic lock will be held a few
-        // instructions longer, but this prevents race condition
-        // SegVs during shutdown.
         call_policies(periodic_policies, (void *)&data, APEX_PERIODIC);
     }
 
@@ -16,16 +16,18 @@
 #include "apex_types.h"
 #include "handler.hpp"
 #include "event_listener.hpp"
+#include "epoch_reclaimer.hpp"
 #include <stack>
 #include <vector>
 #include <map>
 #include <set>
-#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
 #include <functional>
 #include <chrono>
 #include <memory>
 #include <array>
-#include "apex_cxx_shared_lock.hpp"
 
 #ifdef SIGEV_THREAD_ID
 #ifndef sigev_notify_thread_id
@@ -40,47 +42,108 @@ class policy_instance
 {
 public:
     int id;
-    std::function<bool(apex_context const&)> func;
-    policy_instance(int id_, std::function<bool(apex_context const&)> func_) : id(id_),
+    std::function<int(apex_context const&)> func;
+    policy_instance(int id_, std::function<int(apex_context const&)> func_) : id(id_),
         func(func_) {};
 };
 
+typedef std::vector<std::shared_ptr<policy_instance> > policy_vector;
+typedef std::unordered_map<int, policy_vector> custom_policy_map;
+
+/* An immutable, copy-on-write snapshot of registered policies.  Readers
+ * get the current snapshot with a single atomic pointer load, and an
+ * empty list is represented by a null pointer so that events without
+ * policies cost nothing.  Writers (serialized by the policy_handler)
+ * build a new snapshot and publish it atomically.  The replaced snapshot
+ * is returned to the caller, which retires it to the handler's
+ * epoch_reclaimer, so it is freed once no reader could still be iterating
+ * over it (RCU style). */
+template<typename T>
+class policy_snapshot
+{
+private:
+    std::atomic<const T*> _current;
+public:
+    policy_snapshot(void) : _current(nullptr) {};
+    ~policy_snapshot(void) { delete _current.load(); };
+    policy_snapshot(policy_snapshot const&) = delete;
+    void operator=(policy_snapshot const&) = delete;
+    bool empty(void) const {
+        return _current.load(std::memory_order_relaxed) == nullptr;
+    };
+    const T * load(void) const { return _current.load(); };
+    const T * publish(const T * next) { return _current.exchange(next); };
+};
+
+typedef policy_snapshot<policy_vector> policy_list;
+typedef policy_snapshot<custom_policy_map> custom_policy_list;
+
+/* Per-thread buffer of events waiting for delivery to batch policies.
+ * The mutex is only contended while the handler thread drains it. */
+class policy_event_buffer
+{
+public:
+    std::mutex mtx;
+    std::vector<apex_event_record> records;
+};
+
 class policy_handler : public handler, public event_listener
 {
 private:
     void _init(void);
-    std::list<std::shared_ptr<policy_instance> > startup_policies;
-    std::list<std::shared_ptr<policy_instance> > shutdown_policies;
-    std::list<std::shared_ptr<policy_instance> > new_node_policies;
-    std::list<std::shared_ptr<policy_instance> > new_thread_policies;
-    std::list<std::shared_ptr<policy_instance> > exit_thread_policies;
-    std::list<std::shared_ptr<policy_instance> > start_event_policies;
-    std::list<std::shared_ptr<policy_instance> > stop_event_policies;
-    std::list<std::shared_ptr<policy_instance> > yield_event_policies;
-    std::list<std::shared_ptr<policy_instance> > resume_event_policies;
-    std::list<std::shared_ptr<policy_instance> > sample_value_policies;
-    std::list<std::shared_ptr<policy_instance> > send_policies;
-    std::list<std::shared_ptr<policy_instance> > recv_policies;
-    std::list<std::shared_ptr<policy_instance> > periodic_policies;
-    std::map<apex_event_type, std::list<std::shared_ptr<policy_instance > > >
-        custom_event_policies;
-    shared_mutex_type startup_mutex;
-    shared_mutex_type shutdown_mutex;
-    shared_mutex_type new_node_mutex;
-    shared_mutex_type new_thread_mutex;
-    shared_mutex_type exit_thread_mutex;
-    shared_mutex_type start_event_mutex;
-    shared_mutex_type stop_event_mutex;
-    shared_mutex_type yield_event_mutex;
-    shared_mutex_type resume_event_mutex;
-    shared_mutex_type sample_value_mutex;
-    shared_mutex_type send_mutex;
-    shared_mutex_type recv_mutex;
-    shared_mutex_type custom_event_mutex;
-    shared_mutex_type periodic_mutex;
-    void call_policies(
-        const std::list<std::shared_ptr<policy_instance> > & policies,
+    policy_list startup_policies;
+    policy_list shutdown_policies;
+    policy_list new_node_policies;
+    policy_list new_thread_policies;
+    policy_list exit_thread_policies;
+    policy_list start_event_policies;
+    policy_list stop_event_policies;
+    policy_list yield_event_policies;
+    policy_list resume_event_policies;
+    policy_list sample_value_policies;
+    policy_list send_policies;
+    policy_list recv_policies;
+    policy_list periodic_policies;
+    custom_policy_list custom_event_policies;
+    policy_list batch_start_policies;
+    policy_list batch_stop_policies;
+    policy_list batch_yield_policies;
+    policy_list batch_resume_policies;
+    policy_list batch_sample_value_policies;
+    /* serializes writers (register/deregister), never taken by readers */
+    std::mutex _write_mutex;
+    /* frees replaced snapshots once no thread can still be iterating them */
+    epoch_reclaimer _reclaimer;
+    /* unique per handler, indexes the thread-local buffer table */
+    const size_t _buffer_index;
+    std::mutex _buffer_mutex;
+    std::vector<std::unique_ptr<policy_event_buffer> > _buffers;
+    /* serializes delivery, and owns the scratch space used for it */
+    std::mutex _deliver_mutex;
+    std::vector<apex_event_record> _delivery;
+    /* serializes stopping and restarting the timer thread */
+    std::mutex _timer_mutex;
+    /* only handlers created with a period have a timer */
+    bool _has_timer;
+    /* stopped because no periodic or batch policies were left */
+    bool _timer_stopped;
+    bool _shut_down;
+    void update_timer(void);
+    policy_list * get_policy_list(const apex_event_type & when);
+    policy_list * get_batch_policy_list(const apex_event_type & when);
+    bool needs_timer(void);
+    policy_event_buffer * get_event_buffer(void);
+    void buffer_event(const apex_event_type event_type, void * task_id,
+        uint64_t timestamp, double value);
+    void deliver_batch(const policy_list & policies,
+        apex_event_record * records, size_t count,
+        const apex_event_type event_type);
+    bool remove_policy(policy_list & policies, apex_policy_handle * handle);
+    void call_policies(const policy_vector & policies,
+        void *event_data, const apex_event_type& event_type);
+    void call_policies(const policy_list & policies,
         void *event_data, const apex_event_type& event_type);
+    void policies_changed(void);
 #ifdef APEX_HAVE_HPX
     hpx::util::interval_timer hpx_timer;
 #endif
@@ -91,12 +154,12 @@ public:
     policy_handler (std::chrono::duration<Rep, Period> const& period);
 */
     policy_handler(uint64_t period_microseconds);
-    ~policy_handler (void) { };
+    ~policy_handler (void);
     void on_startup(startup_event_data &data);
     void on_dump(dump_event_data &data);
     void on_reset(task_identifier * id)
         { APEX_UNUSED(id); };
-    void on_pre_shutdown(void) {};
+    void on_pre_shutdown(void);
     void on_shutdown(shutdown_event_data &data);
     void on_new_node(node_event_data &data);
     void on_new_thread(new_thread_event_data &data);
@@ -108,6 +171,7 @@ public:
     void on_task_complete(std::shared_ptr<task_wrapper> &tt_ptr) {
         APEX_UNUSED(tt_ptr);
     };
+    bool handles(dispatch_event event);
     void on_sample_value(sample_value_event_data &data);
     void on_custom_event(custom_event_data &data);
     void on_periodic(periodic_event_data &data);
@@ -118,7 +182,11 @@ public:
 
     int register_policy(const apex_event_type & when,
                         std::function<int(apex_context const&)> f);
+    int register_batch_policy(const apex_event_type & when,
+                        std::function<int(apex_context const&)> f);
+    static bool batchable(const apex_event_type & when);
     int deregister_policy(apex_policy_handle * handle);
+    void deliver_batches(void);
     bool _handler(void);
     void _reset(void);
 };
@@ -55,6 +55,10 @@ using namespace std;
 #endif
 
 #include <dirent.h>
+#include <fnmatch.h>
+#include <functional>
+#include <unordered_map>
+#include <vector>
 
 namespace apex {
 
@@ -532,220 +536,175 @@ namespace apex {
         return true;
     }
 
-    bool parse_proc_self_status() {
-        if (!apex_options::use_proc_self_status()) return false;
-        FILE *f = fopen("/proc/self/status", "r");
-        const std::string vm_prefix("Vm");
-        const std::string thread_prefix("Threads");
-        const std::string ctx_substr("ctxt_switches");
-        if (f) {
-            char line[4096] = {0};
-            while ( fgets( line, 4096, f)) {
-                string tmp(line);
-                if (!tmp.compare(0,vm_prefix.size(),vm_prefix)) {
-                    const REGEX_NAMESPACE::regex separator(":");
-                    REGEX_NAMESPACE::sregex_token_iterator token(tmp.begin(),
-                            tmp.end(), separator, -1);
-                    REGEX_NAMESPACE::sregex_token_iterator end;
-                    string name = *token++;
-                    if (token != end) {
-                        string value = *token;
-                        char* pEnd;
-                        double d1 = strtod (value.c_str(), &pEnd);
-                        string mname("status:" + name);
-                        if (pEnd != NULL) {
-                        int len = strlen(pEnd);
-                            if( pEnd[len-1] == '\n' )
-                                pEnd[len-1] = 0;
-                            mname.append(pEnd);
-                        }
-                        if (pEnd) { sample_value(mname, d1); }
-                    }
-                }
-                if (!tmp.compare(0,thread_prefix.size(),thread_prefix)) {
-                    const REGEX_NAMESPACE::regex separator(":");
-                    REGEX_NAMESPACE::sregex_token_iterator token(tmp.begin(),
-                            tmp.end(), separator, -1);
-                    REGEX_NAMESPACE::sregex_token_iterator end;
-                    string name = *token++;
-                    if (token != end) {
-                        string value = *token;
-                        char* pEnd;
-                        double d1 = strtod (value.c_str(), &pEnd);
-                        string mname("status:" + name);
-                        if (pEnd != NULL) {
-                        int len = strlen(pEnd);
-                            if( pEnd[len-1] == '\n' )
-                                pEnd[len-1] = 0;
-                            mname.append(pEnd);
-                        }
-                        if (pEnd) { sample_value(mname, d1); }
-                    }
-                }
-                if (tmp.find(ctx_substr) != tmp.npos) {
-                    const REGEX_NAMESPACE::regex separator(":");
-                    REGEX_NAMESPACE::sregex_token_iterator token(tmp.begin(),
-                            tmp.end(), separator, -1);
-                    REGEX_NAMESPACE::sregex_token_iterator end;
-                    string name = *token++;
-                    if (token != end) {
-                        string value = *token;
-                        char* pEnd;
-                        double d1 = strtod (value.c_str(), &pEnd);
-                        string mname("status:" + name);
-                        if (pEnd != NULL) {
-                        int len = strlen(pEnd);
-                            if( pEnd[len-1] == '\n' )
-                                pEnd[len-1] = 0;
-                            mname.append(pEnd);
-                        }
-                        if (pEnd) { sample_value(mname, d1); }
-                    }
+    proc_field_table::proc_field_table(const char* filename,
+        size_t header_lines, const char* patterns, namer name) :
+        _filename(filename), _header_lines(header_lines), _name(name) {
+        split(patterns, ',', _patterns);
+        for (auto& pattern : _patterns) { trim(pattern); }
+    }
+
+    bool proc_field_table::sample(void) {
+        if (!read()) { return false; }
+        if (!same_keys()) { resolve(); }
+        for (auto& line : _lines) {
+            const std::string& text = _text[line.index];
+            const char* next = text.c_str() + text.find(':') + 1;
+            size_t column{0};
+            double value{0.0};
+            // the fields are in column order
+            for (auto& field : line.fields) {
+                while (column <= field.column) {
+                    char* end;
+                    value = strtod(next, &end);
+                    next = end;
+                    column++;
                 }
+                if (field.sampled && field.last == value) { continue; }
+                field.last = value;
+                field.sampled = true;
+                sample_value(field.counter, value);
             }
-            fclose(f);
-        } else {
-            return false;
         }
         return true;
     }
 
-    bool parse_proc_self_io() {
-        if (!apex_options::use_proc_self_io()) return false;
-        FILE *f = fopen("/proc/self/io", "r");
-        if (f) {
-            char line[4096] = {0};
-            while ( fgets( line, 4096, f)) {
-                string tmp(line);
-                const REGEX_NAMESPACE::regex separator(":");
-                REGEX_NAMESPACE::sregex_token_iterator token(tmp.begin(), tmp.end(),
-                        separator, -1);
-                REGEX_NAMESPACE::sregex_token_iterator end;
-                string name = *token++;
-                if (token != end) {
-                    string value = *token;
-                    char* pEnd;
-                    double d1 = strtod (value.c_str(), &pEnd);
-                    string mname("io:" + name);
-                    if (pEnd) { sample_value(mname, d1); }
-                }
+    bool proc_field_table::read(void) {
+        FILE *f = fopen(_filename.c_str(), "r");
+        if (!f) { return false; }
+        char line[4096] = {0};
+        size_t count{0};
+        // reuse the strings from the last period
+        while (fgets(line, 4096, f)) {
+            if (count == _text.size()) { _text.emplace_back(); }
+            _text[count++].assign(line);
+        }
+        fclose(f);
+        _text.resize(count);
+        return true;
+    }
+
+    /* Where the key is, without the whitespace around it */
+    bool proc_field_table::find_key(const std::string& line, size_t& begin,
+        size_t& length) {
+        size_t colon = line.find(':');
+        if (colon == line.npos) { return false; }
+        begin = line.find_first_not_of(" \t");
+        size_t end = line.find_last_not_of(" \t", colon - 1);
+        if (begin >= colon || end == line.npos) { return false; }
+        length = end + 1 - begin;
+        return true;
+    }
+
+    bool proc_field_table::same_keys(void) {
+        if (_text.size() != _keys.size() + _header_lines) { return false; }
+        for (size_t i = _header_lines ; i < _text.size() ; i++) {
+            const std::string& key = _keys[i - _header_lines];
+            size_t begin, length;
+            if (!find_key(_text[i], begin, length)) {
+                if (!key.empty()) { return false; }
+                continue;
             }
-            fclose(f);
-        } else {
-            return false;
+            if (_text[i].compare(begin, length, key) != 0) { return false; }
         }
         return true;
     }
 
-    bool parse_proc_netdev() {
-        if (!apex_options::use_proc_net_dev()) return false;
-        FILE *f = fopen("/proc/self/net/dev", "r");
-        if (f) {
-            char line[4096] = {0};
-            char * rc = fgets(line, 4096, f); // skip this line
-            if (rc == nullptr) {
-                fclose(f);
-                return false;
+    bool proc_field_table::selected(const std::string& name) {
+        for (auto& pattern : _patterns) {
+            if (fnmatch(pattern.c_str(), name.c_str(), 0) == 0) {
+                return true;
             }
-            rc = fgets(line, 4096, f); // skip this line
-            if (rc == nullptr) {
-                fclose(f);
-                return false;
+        }
+        return false;
+    }
+
+    void proc_field_table::resolve(void) {
+        // keep the values of the counters that are still there
+        std::unordered_map<std::string, double> last;
+        for (auto& line : _lines) {
+            for (auto& field : line.fields) {
+                if (field.sampled) { last[field.counter] = field.last; }
             }
-            while (fgets(line, 4096, f)) {
-                string outer_tmp(line);
-                outer_tmp = trim(outer_tmp);
-                const REGEX_NAMESPACE::regex separator("[|:\\s]+");
-                REGEX_NAMESPACE::sregex_token_iterator token(outer_tmp.begin(),
-                        outer_tmp.end(), separator, -1);
-                REGEX_NAMESPACE::sregex_token_iterator end;
-                string devname = *token++; // device name
-                string tmp = *token++;
-                char* pEnd;
-                double d1 = strtod (tmp.c_str(), &pEnd);
-                string cname = devname + ".receive.bytes";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.packets";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.errs";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.drop";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.fifo";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.frame";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.compressed";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.multicast";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.bytes";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.packets";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.errs";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.drop";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.fifo";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.colls";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.carrier";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.compressed";
-                sample_value(cname, d1);
+        }
+        _lines.clear();
+        _keys.clear();
+        for (size_t i = _header_lines ; i < _text.size() ; i++) {
+            size_t begin, length;
+            if (!find_key(_text[i], begin, length)) {
+                _keys.emplace_back();
+                continue;
             }
-            fclose(f);
-        } else {
-            return false;
+            _keys.emplace_back(_text[i], begin, length);
+            std::vector<proc_field> fields;
+            _name(_keys.back(), _text[i].c_str() + _text[i].find(':') + 1,
+                fields);
+            proc_line line{i, {}};
+            for (auto& field : fields) {
+                if (!selected(field.name)) { continue; }
+                auto found = last.find(field.counter);
+                field.sampled = (found != last.end());
+                field.last = field.sampled ? found->second : 0.0;
+                line.fields.push_back(field);
+            }
+            if (!line.fields.empty()) { _lines.push_back(line); }
         }
-        return true;
+    }
+
+    /* The tables are never deleted: the reader thread is detached, and
+     * may still be sampling them as the process exits. */
+    bool parse_proc_self_status() {
+        if (!apex_options::use_proc_self_status()) return false;
+        static proc_field_table * table = new proc_field_table(
+            "/proc/self/status", 0,
+            apex_options::proc_self_status_fields(),
+            [](const std::string& key, const char* values,
+                std::vector<proc_field>& fields) {
+                char* end;
+                strtod(values, &end);
+                if (end == values) { return; } // not a number
+                // the unit is part of the name, i.e. "status:VmRSS kB"
+                std::string counter("status:" + key + end);
+                counter.erase(counter.find_last_not_of(" \t\n") + 1);
+                fields.push_back(proc_field{0, key, counter, 0.0, false});
+            });
+        return table->sample();
+    }
+
+    bool parse_proc_self_io() {
+        if (!apex_options::use_proc_self_io()) return false;
+        static proc_field_table * table = new proc_field_table(
+            "/proc/self/io", 0,
+            apex_options::proc_self_io_fields(),
+            [](const std::string& key, const char* values,
+                std::vector<proc_field>& fields) {
+                APEX_UNUSED(values);
+                fields.push_back(proc_field{0, key, "io:" + key, 0.0, false});
+            });
+        return table->sample();
+    }
+
+    bool parse_proc_netdev() {
+        if (!apex_options::use_proc_net_dev()) return false;
+        // the first two lines are the column headers
+        static proc_field_table * table = new proc_field_table(
+            "/proc/self/net/dev", 2,
+            apex_options::proc_net_dev_fields(),
+            [](const std::string& key, const char* values,
+                std::vector<proc_field>& fields) {
+                APEX_UNUSED(values);
+                static const char* columns[] = {
+                    "receive.bytes", "receive.packets", "receive.errs",
+                    "receive.drop", "receive.fifo", "receive.frame",
+                    "receive.compressed", "receive.multicast",
+                    "transmit.bytes", "transmit.packets", "transmit.errs",
+                    "transmit.drop", "transmit.fifo", "transmit.colls",
+                    "transmit.carrier", "transmit.compressed"};
+                for (size_t i = 0 ; i < 16 ; i++) {
+                    std::string name(key + "." + columns[i]);
+                    fields.push_back(proc_field{i, name, name, 0.0, false});
+                }
+            });
+        return table->sample();
     }
 
     // there will be N devices, with M sensors per device.
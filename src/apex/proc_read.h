@@ -22,6 +22,7 @@
 #include <thread>
 #include <string>
 #include <memory>
+#include <functional>
 //#include "pthread_wrapper.hpp"
 #include "apex_options.hpp"
 
@@ -135,6 +136,50 @@ bool parse_proc_self_status();
 bool parse_proc_netdev();
 bool parse_sensor_data();
 
+/* One value in a /proc file that a sampler collects */
+struct proc_field {
+    size_t column;       // which number after the key
+    std::string name;    // what the selection patterns match
+    std::string counter; // the counter name, made once
+    double last;         // the last value sampled
+    bool sampled;        // whether there is a last value
+};
+
+/* The selected fields on one line of the file */
+struct proc_line {
+    size_t index;
+    std::vector<proc_field> fields;
+};
+
+/* Reads a /proc file of "key: values" lines.  The fields to collect
+ * are selected with glob patterns, and resolved the first time the
+ * file is read into a table of lines, columns and counter names, so
+ * each period only parses the selected numbers.  A counter is only
+ * sampled when its value changes.  If the keys change (a network
+ * device comes or goes), the table is resolved again. */
+class proc_field_table {
+public:
+    typedef std::function<void(const std::string& key,
+        const char* values, std::vector<proc_field>& fields)> namer;
+    proc_field_table(const char* filename, size_t header_lines,
+        const char* patterns, namer name);
+    bool sample(void);
+private:
+    bool read(void);
+    static bool find_key(const std::string& line, size_t& begin,
+        size_t& length);
+    bool same_keys(void);
+    bool selected(const std::string& name);
+    void resolve(void);
+    std::string _filename;
+    size_t _header_lines;
+    std::vector<std::string> _patterns;
+    namer _name;
+    std::vector<std::string> _text;  // this period's lines
+    std::vector<std::string> _keys;  // the keys when resolved
+    std::vector<proc_line> _lines;   // the lines with selected fields
+};
+
 /* Ideally, this will read from RCR. If not available, read it directly.
    Rather than write the same function seven times for seven different
    filenames, just write once and use a foreach macro to expand it to
@@ -17,12 +17,17 @@
 #include "string.h"
 #include <set>
 #include <limits>
+#include <mutex>
+#include <atomic>
 
 // Use this if you want the min, max and stddev.
 #define FULL_STATISTICS
 
 namespace apex {
 
+class task_identifier;
+class profile_index;
+
 class profile {
 private:
     apex_profile _profile;
@@ -33,9 +38,17 @@ private:
      * _profile.  Only needed when updating the values. */
     std::mutex _mtx;
     std::set<uint64_t> thread_ids;
+    /* Kept by the profile_index: the epoch of the last update, and this
+     * profile's place in the list of profiles ordered by that epoch. */
+    friend class profile_index;
+    std::atomic<uint64_t> _epoch;
+    profile * _older;
+    profile * _newer;
+    const task_identifier * _id;
 public:
     profile(double initial, double inclusive, int num_metrics, double * papi_metrics, bool
-        yielded = false, apex_profile_type type = APEX_TIMER) {
+        yielded = false, apex_profile_type type = APEX_TIMER) :
+        _epoch(0), _older(nullptr), _newer(nullptr), _id(nullptr) {
         memset(&(this->_profile), 0, sizeof(apex_profile));
         _profile.type = type;
         if (!yielded) {
@@ -46,7 +59,7 @@ public:
         _profile.stops = 1.0;
         _profile.accumulated = initial;
         _profile.inclusive_accumulated = inclusive;
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
         for (int i = 0 ; i < num_metrics ; i++) {
             _profile.papi_metrics[i] = papi_metrics[i];
         }
@@ -69,7 +82,8 @@ public:
     };
     profile(double initial, double inclusive, int num_metrics, double * papi_metrics, bool
         yielded, double allocations, double frees, double bytes_allocated,
-        double bytes_freed) {
+        double bytes_freed) : _epoch(0), _older(nullptr),
+        _newer(nullptr), _id(nullptr) {
         _profile.type = APEX_TIMER;
         if (!yielded) {
             _profile.calls = 1.0;
@@ -79,7 +93,7 @@ public:
         _profile.stops = 1.0;
         _profile.accumulated = initial;
         _profile.inclusive_accumulated = inclusive;
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
         for (int i = 0 ; i < num_metrics ; i++) {
             _profile.papi_metrics[i] = papi_metrics[i];
         }
@@ -102,7 +116,8 @@ public:
     };
     /* This constructor is so that we can create a dummy wrapper around profile
      * data after we've done a reduction across ranks. */
-    profile(apex_profile * values) {
+    profile(apex_profile * values) : _epoch(0), _older(nullptr),
+        _newer(nullptr), _id(nullptr) {
         memcpy(&_profile, values, sizeof(apex_profile));
     }
     void increment(double increase, double inclusive, int num_metrics, double * papi_metrics,
@@ -111,7 +126,7 @@ public:
         _profile.accumulated += increase;
         _profile.inclusive_accumulated += inclusive;
         _profile.stops = _profile.stops + 1.0;
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
         for (int i = 0 ; i < num_metrics ; i++) {
             _profile.papi_metrics[i] += papi_metrics[i];
         }
@@ -227,6 +242,13 @@ public:
     double get_bytes_freed() { return _profile.bytes_freed; }
     apex_profile_type get_type() { return _profile.type; }
     apex_profile * get_profile() { return &_profile; };
+    /* Copy the values while no update is in progress, so that the
+     * copy is consistent (calls and accumulated match, etc.). */
+    void get_snapshot(apex_profile &snapshot) {
+        _mtx.lock();
+        memcpy(&snapshot, &_profile, sizeof(apex_profile));
+        _mtx.unlock();
+    }
     bool get_throttled() { return _profile.throttled; };
     void set_throttled() { _profile.throttled = true; };
 };
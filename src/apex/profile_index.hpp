@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "task_identifier.hpp"
+#include "profile.hpp"
+#include "epoch_reclaimer.hpp"
+#include <unordered_map>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <memory>
+
+namespace apex {
+
+/* The index of all profiles, keyed by task identifier.  Profiles are
+ * looked up far more often than they are created, so each shard of the
+ * index is an immutable map that readers find with a single atomic load,
+ * without taking any lock.  Creating a profile copies the (small) shard
+ * and publishes the copy.  Replaced shard maps are freed by the epoch
+ * reclaimer, once no reader could still be using them.  Profiles are never removed individually,
+ * only all at once at shutdown. */
+class profile_index {
+public:
+    typedef std::unordered_map<task_identifier, profile*> shard_map;
+private:
+    static const size_t num_shards = 64;
+    class shard {
+    public:
+        std::atomic<const shard_map*> current;
+        std::mutex write_mutex;
+        shard(void) : current(nullptr) {};
+    };
+    std::array<shard, num_shards> _shards;
+    std::atomic<size_t> _size;
+    std::atomic<uint64_t> _epoch;
+    epoch_reclaimer _reclaimer;
+    /* Every profile, ordered by the epoch of its last update.  An update
+     * only moves its profile to the newest end the first time in each
+     * epoch, so finding the changed profiles walks only those. */
+    std::mutex _changed_mutex;
+    profile * _newest;
+    profile * _oldest;
+    std::vector<std::unique_ptr<const task_identifier> > _ids;
+    shard& get_shard(const task_identifier &id) {
+        return _shards[std::hash<task_identifier>()(id) % num_shards];
+    }
+    void retire(const shard_map * old) {
+        _reclaimer.retire(std::shared_ptr<const shard_map>(old));
+    }
+public:
+    profile_index(void) : _size(0), _epoch(1),
+        _newest(nullptr), _oldest(nullptr) {};
+    ~profile_index(void) {
+        for (auto& s : _shards) {
+            delete s.current.load();
+        }
+    };
+    profile_index(profile_index const&) = delete;
+    void operator=(profile_index const&) = delete;
+    /* Lock-free lookup, returns nullptr if there is no profile yet. */
+    profile * find(const task_identifier &id) {
+        shard& s = get_shard(id);
+        epoch_reclaimer::guard reader(_reclaimer);
+        APEX_UNUSED(reader);
+        const shard_map * current = s.current.load();
+        if (current == nullptr) { return nullptr; }
+        auto it = current->find(id);
+        if (it == current->end()) { return nullptr; }
+        return it->second;
+    }
+    /* Add a profile to the index.  If another thread added a profile for
+     * this id first, that profile is returned, and the caller still owns
+     * the one it passed in. */
+    profile * insert(const task_identifier &id, profile * p) {
+        shard& s = get_shard(id);
+        std::unique_lock<std::mutex> l(s.write_mutex);
+        const shard_map * current = s.current.load();
+        if (current != nullptr) {
+            auto it = current->find(id);
+            if (it != current->end()) { return it->second; }
+        }
+        shard_map * next = (current == nullptr) ?
+            new shard_map() : new shard_map(*current);
+        (*next)[id] = p;
+        _size++;
+        {
+            std::unique_lock<std::mutex> cl(_changed_mutex);
+            _ids.emplace_back(new task_identifier(id));
+            p->_id = _ids.back().get();
+        }
+        retire(s.current.exchange(next));
+        return p;
+    }
+    /* Visit every profile.  The visit sees each shard as it was when the
+     * visit reached it; profiles created during the visit may be missed. */
+    template<typename F> void for_each(F f) {
+        epoch_reclaimer::guard reader(_reclaimer);
+        APEX_UNUSED(reader);
+        for (auto& s : _shards) {
+            const shard_map * current = s.current.load();
+            if (current == nullptr) { continue; }
+            for (auto& kv : *current) {
+                f(kv.first, kv.second);
+            }
+        }
+    }
+    /* Remove all profiles from the index.  The caller owns the profiles,
+     * and should free them first. */
+    void clear(void) {
+        for (auto& s : _shards) {
+            std::unique_lock<std::mutex> l(s.write_mutex);
+            retire(s.current.exchange(nullptr));
+        }
+        _size = 0;
+        std::unique_lock<std::mutex> cl(_changed_mutex);
+        _newest = _oldest = nullptr;
+        _ids.clear();
+    }
+    size_t size(void) const { return _size; }
+    /* Note that a profile in the index changed, after changing it. */
+    void touch(profile * p) {
+        /* Already moved in this epoch?  Then a visit_changed() that
+         * advances the epoch after this check still sees the change. */
+        if (p->_epoch.load() == _epoch.load()) { return; }
+        std::unique_lock<std::mutex> l(_changed_mutex);
+        uint64_t now = _epoch.load();
+        if (p->_epoch.load() == now) { return; }
+        if (p->_older != nullptr || p->_newer != nullptr || _oldest == p) {
+            if (p->_older != nullptr) { p->_older->_newer = p->_newer; }
+            else { _oldest = p->_newer; }
+            if (p->_newer != nullptr) { p->_newer->_older = p->_older; }
+            else { _newest = p->_older; }
+        }
+        p->_older = _newest;
+        p->_newer = nullptr;
+        if (_newest != nullptr) { _newest->_newer = p; }
+        else { _oldest = p; }
+        _newest = p;
+        p->_epoch = now;
+    }
+    /* Visit every profile changed in or after the given epoch, newest
+     * first.  Starts a new epoch, and returns it for the next visit. */
+    template<typename F> uint64_t visit_changed(uint64_t since_epoch, F f) {
+        std::unique_lock<std::mutex> l(_changed_mutex);
+        uint64_t next_epoch = ++_epoch;
+        for (profile * p = _newest ;
+             p != nullptr && p->_epoch.load() >= since_epoch ;
+             p = p->_older) {
+            f(*(p->_id), p);
+        }
+        return next_epoch;
+    }
+};
+
+}
+
@@ -8,6 +8,8 @@
 
 #include "profile_reducer.hpp"
 #include "apex.hpp"
+#include "columnar_table.hpp"
+#include "utils.hpp"
 #include "string.h"
 #include <vector>
 #include <iostream>
@@ -59,7 +61,7 @@ std::map<std::string, apex_profile*> reduce_profiles_for_screen() {
 
     std::map<std::string, apex_profile*> all_profiles;
     /* Get a list of all profile names */
-    std::vector<task_identifier>& tids = get_available_profiles();
+    std::vector<task_identifier> tids = get_available_profiles();
     /* Build a map of names to IDs.  I know, that sounds weird but hear me out.
      * Timers that are identified by address have to be looked up by address,
      * not by name.  So we map the names to ids, then use the ids to look them up. */
@@ -351,7 +353,7 @@ std::map<std::string, apex_profile*> reduce_profiles_for_screen() {
 
     void reduce_flat_profiles(int node_id, int num_papi_counters,
         std::vector<std::string> metric_names, profiler_listener* listener) {
-#ifndef APEX_HAVE_PAPI // prevent compiler warnings
+#ifndef APEX_HAVE_HW_COUNTERS // prevent compiler warnings
         APEX_UNUSED(num_papi_counters);
         APEX_UNUSED(metric_names);
 #endif
@@ -359,7 +361,7 @@ std::map<std::string, apex_profile*> reduce_profiles_for_screen() {
         if (node_id == 0) {
             csv_output << "\"rank\",\"name\",\"type\",\"num samples/calls\",\"yields\",\"minimum\",\"mean\","
                 << "\"maximum\",\"stddev\",\"total\",\"inclusive (ns)\",\"num threads\",\"total per thread\"";
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
             for (int i = 0 ; i < num_papi_counters ; i++) {
                 csv_output << ",\"" << metric_names[i] << "\"";
             }
@@ -371,7 +373,7 @@ std::map<std::string, apex_profile*> reduce_profiles_for_screen() {
         }
 
         /* Get a list of all profile names */
-        std::vector<task_identifier>& tids = get_available_profiles();
+        std::vector<task_identifier> tids = get_available_profiles();
         for (auto tid : tids) {
             std::string name{tid.get_name()};
             auto p = listener->get_profile(tid);
@@ -396,7 +398,7 @@ std::map<std::string, apex_profile*> reduce_profiles_for_screen() {
             }
             csv_output << std::llround(p->get_num_threads()) << ",";
             csv_output << std::llround(p->get_accumulated()/p->get_num_threads());
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
             for (int i = 0 ; i < num_papi_counters ; i++) {
                 csv_output << "," << std::llround(p->get_papi_metrics()[i]);
             }
@@ -412,5 +414,81 @@ std::map<std::string, apex_profile*> reduce_profiles_for_screen() {
         reduce_profiles(csv_output, "apex_profiles.csv");
     }
 
+    /* Unlike the CSV output, each rank writes its own file, and the values
+     * are not rounded.  The column names match the CSV header. */
+    void write_flat_profile_columns(int node_id, int num_papi_counters,
+        std::vector<std::string> metric_names, profiler_listener* listener) {
+#ifndef APEX_HAVE_HW_COUNTERS // prevent compiler warnings
+        APEX_UNUSED(num_papi_counters);
+        APEX_UNUSED(metric_names);
+#endif
+        columnar_table table(columnar_table::flat_profile);
+        typedef columnar_table t;
+        size_t rank = table.add_column("rank", t::uint32_column);
+        size_t name = table.add_column("name", t::string_column);
+        size_t type = table.add_column("type", t::string_column);
+        size_t calls = table.add_column("num samples/calls", t::float64_column);
+        size_t yields = table.add_column("yields", t::float64_column);
+        size_t minimum = table.add_column("minimum", t::float64_column);
+        size_t mean = table.add_column("mean", t::float64_column);
+        size_t maximum = table.add_column("maximum", t::float64_column);
+        size_t stddev = table.add_column("stddev", t::float64_column);
+        size_t total = table.add_column("total", t::float64_column);
+        size_t inclusive = table.add_column("inclusive (ns)", t::float64_column);
+        size_t threads = table.add_column("num threads", t::float64_column);
+        size_t per_thread = table.add_column("total per thread", t::float64_column);
+        std::vector<size_t> papi;
+#if APEX_HAVE_HW_COUNTERS
+        for (int i = 0 ; i < num_papi_counters ; i++) {
+            papi.push_back(table.add_column(metric_names[i], t::float64_column));
+        }
+#endif
+        bool memory = apex_options::track_cpu_memory() ||
+            apex_options::track_gpu_memory();
+        size_t allocations = 0, bytes_allocated = 0, frees = 0, bytes_freed = 0;
+        if (memory) {
+            allocations = table.add_column("allocations", t::float64_column);
+            bytes_allocated = table.add_column("bytes allocated", t::float64_column);
+            frees = table.add_column("frees", t::float64_column);
+            bytes_freed = table.add_column("bytes freed", t::float64_column);
+        }
+
+        /* Get a list of all profile names */
+        std::vector<task_identifier> tids = get_available_profiles();
+        for (auto tid : tids) {
+            auto p = listener->get_profile(tid);
+            if (p == nullptr) { continue; }
+            table.append_uint(rank, node_id);
+            table.append_string(name, tid.get_name());
+            bool timer = p->get_type() == APEX_TIMER;
+            table.append_string(type, timer ? "timer" : "counter");
+            table.append_double(calls, p->get_calls());
+            table.append_double(yields, p->get_stops() - p->get_calls());
+            table.append_double(minimum, p->get_minimum());
+            table.append_double(mean, p->get_mean());
+            table.append_double(maximum, p->get_maximum());
+            table.append_double(stddev, p->get_stddev());
+            table.append_double(total, p->get_accumulated());
+            table.append_double(inclusive,
+                timer ? p->get_inclusive_accumulated() : 0.0);
+            table.append_double(threads, p->get_num_threads());
+            table.append_double(per_thread,
+                p->get_accumulated()/p->get_num_threads());
+            for (size_t i = 0 ; i < papi.size() ; i++) {
+                table.append_double(papi[i], p->get_papi_metrics()[i]);
+            }
+            if (memory) {
+                table.append_double(allocations, p->get_allocations());
+                table.append_double(bytes_allocated, p->get_bytes_allocated());
+                table.append_double(frees, p->get_frees());
+                table.append_double(bytes_freed, p->get_bytes_freed());
+            }
+        }
+        std::stringstream filename;
+        filename << apex_options::output_file_path() << filesystem_separator()
+                 << "apex_profiles." << node_id << ".bin";
+        table.write(filename.str(), node_id);
+    }
+
 } // namespace
 
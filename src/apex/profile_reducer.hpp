@@ -22,5 +22,8 @@ void reduce_profiles(std::stringstream& csv_output, std::string filename);
 void reduce_flat_profiles(int node_id, int num_papi_counters,
     std::vector<std::string> metric_names,
     profiler_listener* listener);
+void write_flat_profile_columns(int node_id, int num_papi_counters,
+    std::vector<std::string> metric_names,
+    profiler_listener* listener);
 
 }
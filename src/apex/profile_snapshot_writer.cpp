@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "profile_snapshot_writer.hpp"
+#include "profiler_listener.hpp"
+#include "profiler.hpp"
+#include "apex.hpp"
+#include "utils.hpp"
+#include "tau_listener.hpp"
+#include <cstring>
+#include <sstream>
+#include <iostream>
+
+namespace apex {
+
+    static const char snapshot_magic[8] =
+        {'A','P','E','X','S','N','P','1'};
+    static const uint32_t snapshot_version = 1;
+
+    /* append a value to the block, in native byte order */
+    template<typename T>
+    static inline void append(std::vector<char> &block, const T &value) {
+        const char * bytes = reinterpret_cast<const char*>(&value);
+        block.insert(block.end(), bytes, bytes + sizeof(T));
+    }
+
+    static inline void pad(std::vector<char> &block) {
+        while (block.size() % 8 != 0) { block.push_back(0); }
+    }
+
+    profile_snapshot_writer::profile_snapshot_writer(
+        profiler_listener * listener, unsigned int period) :
+        handler(period), _listener(listener), _file(nullptr), _epoch(0),
+        _next_id(0) {
+        // timestamps are relative to the start of execution
+        profiler::get_global_start();
+        run();
+    }
+
+    profile_snapshot_writer::~profile_snapshot_writer(void) {
+        finish();
+    }
+
+    bool profile_snapshot_writer::_handler(void) {
+        if (!_handler_initialized) {
+            initialize_worker_thread_for_tau();
+            _handler_initialized = true;
+        }
+        if (_terminate) return true;
+        if (apex_options::use_tau()) {
+            tau_listener::Tau_start_wrapper(
+                "profile_snapshot_writer::_handler");
+        }
+        write_snapshot();
+        if (apex_options::use_tau()) {
+            tau_listener::Tau_stop_wrapper(
+                "profile_snapshot_writer::_handler");
+        }
+        return true;
+    }
+
+    void profile_snapshot_writer::finish(void) {
+        if (_listener == nullptr) { return; }
+        // stop the thread first, so that this is the last interval
+        cancel();
+        write_snapshot();
+        std::unique_lock<std::mutex> l(_write_mutex);
+        if (_file != nullptr) {
+            fclose(_file);
+            _file = nullptr;
+        }
+        _listener = nullptr;
+    }
+
+    /* Must be called while holding the write mutex.  The file is opened
+     * on the first snapshot, when the rank is known. */
+    bool profile_snapshot_writer::open_file(void) {
+        if (_file != nullptr) { return true; }
+        std::stringstream ss;
+        ss << apex_options::output_file_path() << filesystem_separator()
+           << "apex_profile_snapshots." << apex::instance()->get_node_id()
+           << ".bin";
+        _file = fopen(ss.str().c_str(), "wb");
+        if (_file == nullptr) {
+            perror("opening profile snapshot file");
+            return false;
+        }
+        fwrite(snapshot_magic, sizeof(char), 8, _file);
+        uint32_t node_id = apex::instance()->get_node_id();
+        uint64_t period = apex_options::profile_snapshot_period();
+        uint64_t reserved = 0;
+        fwrite(&snapshot_version, sizeof(uint32_t), 1, _file);
+        fwrite(&node_id, sizeof(uint32_t), 1, _file);
+        fwrite(&period, sizeof(uint64_t), 1, _file);
+        fwrite(&reserved, sizeof(uint64_t), 1, _file);
+        return true;
+    }
+
+    /* Must be called while holding the write mutex.  Writes the header
+     * and payload in one piece, so a block is either complete, or at the
+     * truncated end of the file. */
+    void profile_snapshot_writer::write_block(uint32_t kind, uint32_t count,
+        uint64_t timestamp) {
+        pad(_block);
+        uint64_t bytes = _block.size();
+        std::vector<char> header;
+        append(header, kind);
+        append(header, count);
+        append(header, bytes);
+        append(header, timestamp);
+        fwrite(header.data(), sizeof(char), header.size(), _file);
+        fwrite(_block.data(), sizeof(char), _block.size(), _file);
+    }
+
+    void profile_snapshot_writer::write_snapshot(void) {
+        std::unique_lock<std::mutex> l(_write_mutex);
+        if (_listener == nullptr) { return; }
+        _changed.clear();
+        // only the profiles that changed since the last snapshot
+        _epoch = _listener->get_changed_profiles(_epoch, _changed);
+        if (_changed.empty() || !open_file()) { return; }
+        uint64_t start = profiler::get_global_start();
+        uint64_t timestamp = our_clock::now_ns() - start;
+
+        /* First, assign ids to the profiles we haven't seen before. */
+        _block.clear();
+        uint32_t new_names = 0;
+        for (auto& c : _changed) {
+            if (_written.count(c.first) > 0) { continue; }
+            apex_profile zero;
+            memset(&zero, 0, sizeof(apex_profile));
+            uint32_t id = _next_id++;
+            _written[c.first] = std::make_pair(id, zero);
+            std::string name(c.first.get_name());
+            uint32_t type = c.second.type;
+            uint32_t length = name.size();
+            append(_block, id);
+            append(_block, type);
+            append(_block, length);
+            _block.insert(_block.end(), name.begin(), name.end());
+            new_names++;
+        }
+        if (new_names > 0) {
+            write_block(names_block, new_names, timestamp);
+        }
+
+        /* Then, compute the change since the last snapshot. */
+        std::vector<uint32_t> ids;
+        std::vector<uint32_t> flags;
+        std::vector<double> columns[num_columns];
+        for (auto& c : _changed) {
+            auto& written = _written[c.first];
+            apex_profile &last = written.second;
+            const apex_profile &now = c.second;
+            uint32_t flag = 0;
+            apex_profile base;
+            memset(&base, 0, sizeof(apex_profile));
+            if (now.times_reset != last.times_reset || now.calls < last.calls) {
+                flag = flag_reset;
+            } else {
+                base = last;
+            }
+            double delta_calls = now.calls - base.calls;
+            double delta_stops = now.stops - base.stops;
+            double delta_accumulated = now.accumulated - base.accumulated;
+            // reported again, without any change?
+            if (flag == 0 && delta_calls == 0.0 && delta_stops == 0.0 &&
+                delta_accumulated == 0.0) {
+                continue;
+            }
+            ids.push_back(written.first);
+            flags.push_back(flag);
+            columns[calls].push_back(delta_calls);
+            columns[stops].push_back(delta_stops);
+            columns[accumulated].push_back(delta_accumulated);
+            columns[inclusive_accumulated].push_back(
+                now.inclusive_accumulated - base.inclusive_accumulated);
+            columns[sum_squares].push_back(now.sum_squares - base.sum_squares);
+            columns[minimum].push_back(now.minimum);
+            columns[maximum].push_back(now.maximum);
+            columns[allocations].push_back(now.allocations - base.allocations);
+            columns[frees].push_back(now.frees - base.frees);
+            columns[bytes_allocated].push_back(
+                now.bytes_allocated - base.bytes_allocated);
+            columns[bytes_freed].push_back(now.bytes_freed - base.bytes_freed);
+            last = now;
+        }
+        if (ids.size() > 0) {
+            _block.clear();
+            for (auto id : ids) { append(_block, id); }
+            for (auto flag : flags) { append(_block, flag); }
+            pad(_block);
+            for (size_t i = 0 ; i < num_columns ; i++) {
+                const char * bytes =
+                    reinterpret_cast<const char*>(columns[i].data());
+                _block.insert(_block.end(), bytes,
+                    bytes + (columns[i].size() * sizeof(double)));
+            }
+            write_block(interval_block, ids.size(), timestamp);
+        }
+        // hand the data to the OS, so a crash of the process doesn't lose it
+        fflush(_file);
+    }
+
+}
+
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "handler.hpp"
+#include "apex_types.h"
+#include "task_identifier.hpp"
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <utility>
+
+namespace apex {
+
+class profiler_listener;
+
+/* Periodically appends the statistics of every timer and counter that
+ * changed since the last snapshot to an append-only binary file, so that
+ * a job that is killed still leaves a usable profile behind.  The file is
+ * written by the handler thread, never by the worker threads.
+ *
+ * The file is a 32 byte header, followed by blocks.  All values are in
+ * native (little-endian) byte order, and every block starts and ends on
+ * an 8 byte boundary so that the columns can be memory-mapped directly:
+ *
+ *   header: char magic[8] = "APEXSNP1", uint32 version, uint32 node_id,
+ *           uint64 period (microseconds), uint64 reserved
+ *   block:  uint32 kind, uint32 count, uint64 payload bytes,
+ *           uint64 timestamp (nanoseconds since APEX started), payload
+ *
+ *   kind 1 (names): count entries of uint32 id, uint32 type
+ *           (apex_profile_type), uint32 length, the name (not terminated),
+ *           then padding to 8 bytes after the last entry.
+ *   kind 2 (interval): uint32 id[count], uint32 flags[count], padding,
+ *           then one double[count] column for each of the snapshot_columns.
+ *           Values are the change since the previous interval, except the
+ *           minimum and maximum, which are the current values.  When flag
+ *           bit 0 is set, the profile was reset, and the values are relative
+ *           to zero instead of the previous interval.
+ *
+ * src/scripts/apex-snapshots.py reads the file. */
+class profile_snapshot_writer : public handler {
+public:
+    enum snapshot_block_kind { names_block = 1, interval_block = 2 };
+    enum snapshot_column { calls = 0, stops, accumulated,
+        inclusive_accumulated, sum_squares, minimum, maximum, allocations,
+        frees, bytes_allocated, bytes_freed, num_columns };
+    static const uint32_t flag_reset = 1;
+private:
+    profiler_listener * _listener;
+    std::mutex _write_mutex;
+    FILE * _file;
+    uint64_t _epoch;
+    uint32_t _next_id;
+    /* the id and last written values for every profile seen so far */
+    std::unordered_map<task_identifier,
+        std::pair<uint32_t, apex_profile> > _written;
+    /* scratch space, reused from one interval to the next */
+    std::vector<std::pair<task_identifier, apex_profile> > _changed;
+    std::vector<char> _block;
+    bool open_file(void);
+    void write_block(uint32_t kind, uint32_t count, uint64_t timestamp);
+    void write_snapshot(void);
+public:
+    profile_snapshot_writer(profiler_listener * listener,
+        unsigned int period);
+    ~profile_snapshot_writer(void);
+    bool _handler(void);
+    /* stop the thread, and write the last interval */
+    void finish(void);
+};
+
+}
+
@@ -45,7 +45,7 @@ public:
     std::shared_ptr<task_wrapper> tt_ptr;     // for timers
     uint64_t start_ns;
     uint64_t end_ns;
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
     long long papi_start_values[8];
     long long papi_stop_values[8];
 #endif
@@ -76,7 +76,7 @@ public:
         task_id(task->get_task_id()),
         tt_ptr(task),
         start_ns(our_clock::now_ns()),
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
         papi_start_values{0,0,0,0,0,0,0,0},
         papi_stop_values{0,0,0,0,0,0,0,0},
 #endif
@@ -97,7 +97,7 @@ public:
         task_id(id),
         tt_ptr(nullptr),
         start_ns(our_clock::now_ns()),
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
         papi_start_values{0,0,0,0,0,0,0,0},
         papi_stop_values{0,0,0,0,0,0,0,0},
 #endif
@@ -113,7 +113,7 @@ public:
         task_id(id),
         tt_ptr(nullptr),
         start_ns(our_clock::now_ns()),
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
         papi_start_values{0,0,0,0,0,0,0,0},
         papi_stop_values{0,0,0,0,0,0,0,0},
 #endif
@@ -143,7 +143,7 @@ public:
         thread_id(in.thread_id)
     {
         //printf("COPY!\n"); fflush(stdout);
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
         for (int i = 0 ; i < 8 ; i++) {
             papi_start_values[i] = in.papi_start_values[i];
             papi_stop_values[i] = in.papi_stop_values[i];
@@ -76,6 +76,9 @@ const int num_non_worker_threads_registered = 1; // including the main thread
 #include "tau_listener.hpp"
 #include "utils.hpp"
 #include "profile_reducer.hpp"
+#if APEX_HAVE_PERF_EVENT
+#include "perf_event_counters.hpp"
+#endif
 
 #include <cstdlib>
 #include <ctime>
@@ -125,6 +128,15 @@ std::unordered_set<profile*> free_profiles;
         return _thequeue;
     }
 
+    size_t profiler_listener::queue_backlog(void) {
+        std::unique_lock<std::mutex> queue_lock(queue_mtx);
+        size_t backlog = 0;
+        for (auto q : allqueues) {
+            backlog += q->size_approx();
+        }
+        return backlog;
+    }
+
     /* We do this in two stages, to make the common case fast. */
     dependency_queue_t * profiler_listener::_construct_dependency_queue() {
         dependency_queue_t * _thequeue = new dependency_queue_t();
@@ -152,27 +164,23 @@ std::unordered_set<profile*> free_profiles;
   double profiler_listener::get_non_idle_time() {
     double non_idle_time = 0.0;
     /* Iterate over all timers and accumulate the time spent in them */
-    unordered_map<task_identifier, profile*>::const_iterator it2;
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    for(it2 = task_map.begin(); it2 != task_map.end(); it2++) {
-      profile * p = it2->second;
+    task_map.for_each([&](const task_identifier& id, profile * p) {
       if (apex_options::throttle_timers()) {
         if (!apex_options::use_tau()) {
-            task_identifier id = it2->first;
             unordered_set<task_identifier>::const_iterator it4;
             {
                 read_lock_type l(throttled_event_set_mutex);
                 it4 = throttled_tasks.find(id);
             }
             if (it4!= throttled_tasks.end()) {
-                continue;
+                return;
             }
         }
       }
       if (p->get_type() == APEX_TIMER) {
         non_idle_time += p->get_accumulated();
       }
-    }
+    });
     return non_idle_time;
   }
 
@@ -226,11 +234,11 @@ std::unordered_set<profile*> free_profiles;
     queue_signal.post();
 #endif
 #endif // APEX_SYNCHRONOUS_PROCESSING
-    if (id.name == string(APEX_IDLE_RATE)) {
+    if (id.name.compare(APEX_IDLE_RATE) == 0) {
         return get_idle_rate();
-    } else if (id.name == string(APEX_IDLE_TIME)) {
+    } else if (id.name.compare(APEX_IDLE_TIME) == 0) {
         return get_idle_time();
-    } else if (id.name == string(APEX_NON_IDLE_TIME)) {
+    } else if (id.name.compare(APEX_NON_IDLE_TIME) == 0) {
         profile * theprofile = new profile(get_non_idle_time(), 0, 0, nullptr, false);
         {
             std::unique_lock<std::mutex> l(free_profile_set_mutex);
@@ -238,19 +246,28 @@ std::unordered_set<profile*> free_profiles;
         }
         return theprofile;
     }
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    unordered_map<task_identifier, profile*>::const_iterator it = task_map.find(id);
-    if (it != task_map.end()) {
-      return (*it).second;
-    }
-    return nullptr;
+    return task_map.find(id);
+  }
+
+  /* Copy every profile that changed since the given epoch, and return
+   * the epoch to pass next time.  A profile that changes while we are
+   * copying may be reported again next time, but is never missed. */
+  uint64_t profiler_listener::get_changed_profiles(uint64_t since_epoch,
+    std::vector<std::pair<task_identifier, apex_profile> >& changed) {
+    return task_map.visit_changed(since_epoch,
+        [&](const task_identifier& id, profile * p) {
+        apex_profile snapshot;
+        p->get_snapshot(snapshot);
+        changed.emplace_back(id, snapshot);
+    });
   }
 
   void profiler_listener::reset_all(void) {
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    for(auto &it : task_map) {
-        it.second->reset();
-    }
+    task_map.for_each([this](const task_identifier& id, profile * p) {
+        APEX_UNUSED(id);
+        p->reset();
+        task_map.touch(p);
+    });
     if (apex_options::use_jupyter_support()) {
         // restart the main timer
         main_timer = std::make_shared<profiler>(task_wrapper::get_apex_main_wrapper());
@@ -279,7 +296,7 @@ std::unordered_set<profile*> free_profiles;
     }
     double values[8] = {0};
     double tmp_num_counters = 0;
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
     tmp_num_counters = num_papi_counters;
     for (int i = 0 ; i < num_papi_counters ; i++) {
         if (p.papi_stop_values[i] > p.papi_start_values[i]) {
@@ -289,13 +306,34 @@ std::unordered_set<profile*> free_profiles;
         }
     }
 #endif
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    unordered_map<task_identifier, profile*>::const_iterator it =
-        task_map.find(*(p.get_task_id()));
-    if (it != task_map.end()) {
-          // A profile for this ID already exists.
-        theprofile = (*it).second;
-        task_map_lock.unlock();
+    theprofile = task_map.find(*(p.get_task_id()));
+    bool created = false;
+    if (theprofile == nullptr) {
+        // Create a new profile for this name.
+        if ((apex_options::track_cpu_memory() ||
+             apex_options::track_gpu_memory()) && !p.is_counter) {
+            theprofile = new profile(p.is_reset ==
+                reset_type::CURRENT ? 0.0 : p.elapsed(), p.inclusive(),
+                tmp_num_counters, values, p.is_resume,
+                p.allocations, p.frees, p.bytes_allocated,
+                p.bytes_freed);
+        } else {
+            theprofile = new profile(p.is_reset ==
+                reset_type::CURRENT ? 0.0 : p.elapsed(), p.inclusive(),
+                tmp_num_counters, values, p.is_resume,
+                p.is_counter ? APEX_COUNTER : APEX_TIMER);
+        }
+        profile * existing = task_map.insert(*(p.get_task_id()), theprofile);
+        if (existing == theprofile) {
+            created = true;
+        } else {
+            // another thread created it first, so update that one.
+            delete theprofile;
+            theprofile = existing;
+        }
+    }
+    if (!created) {
+        // A profile for this ID already exists.
         if(p.is_reset == reset_type::CURRENT) {
             theprofile->reset();
         } else {
@@ -344,23 +382,6 @@ std::unordered_set<profile*> free_profiles;
             }
         }
       } else {
-        // Create a new profile for this name.
-        if ((apex_options::track_cpu_memory() ||
-             apex_options::track_gpu_memory()) && !p.is_counter) {
-            theprofile = new profile(p.is_reset ==
-                reset_type::CURRENT ? 0.0 : p.elapsed(), p.inclusive(),
-                tmp_num_counters, values, p.is_resume,
-                p.allocations, p.frees, p.bytes_allocated,
-                p.bytes_freed);
-            task_map[*(p.get_task_id())] = theprofile;
-        } else {
-            theprofile = new profile(p.is_reset ==
-                reset_type::CURRENT ? 0.0 : p.elapsed(), p.inclusive(),
-                tmp_num_counters, values, p.is_resume,
-                p.is_counter ? APEX_COUNTER : APEX_TIMER);
-            task_map[*(p.get_task_id())] = theprofile;
-        }
-        task_map_lock.unlock();
 #ifdef APEX_HAVE_HPX
 #ifdef APEX_REGISTER_HPX3_COUNTERS
         if(!_done) {
@@ -386,6 +407,7 @@ std::unordered_set<profile*> free_profiles;
 #endif
 #endif
       }
+      task_map.touch(theprofile);
       /* write the sample to the file */
       if (apex_options::task_scatterplot()) {
         if (!p.is_counter) {
@@ -463,11 +485,10 @@ std::unordered_set<profile*> free_profiles;
    * called at shutdown. But a good idea to do regardless. */
   void profiler_listener::delete_profiles(void) {
     // iterate over the map and free the objects in the map
-    unordered_map<task_identifier, profile*>::const_iterator it;
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    for(it = task_map.begin(); it != task_map.end(); it++) {
-      delete it->second;
-    }
+    task_map.for_each([](const task_identifier& id, profile * p) {
+      APEX_UNUSED(id);
+      delete p;
+    });
     // clear the map.
     task_map.clear();
 
@@ -494,7 +515,7 @@ std::unordered_set<profile*> free_profiles;
           double &total_accumulated,
           double &total_main, double &wall_main, bool include_stops = false,
           bool include_papi = false) {
-#ifndef APEX_HAVE_PAPI
+#ifndef APEX_HAVE_HW_COUNTERS
       APEX_UNUSED(include_papi);
 #endif
       string shorter(action_name);
@@ -606,7 +627,7 @@ std::unordered_set<profile*> free_profiles;
                     screen_output << string_format(FORMAT_PERCENT, tmp);
                 }
             }
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
         if (include_papi) {
             for (int i = 0 ; i < num_papi_counters ; i++) {
                 screen_output  << spaces << string_format(FORMAT_SCIENTIFIC,
@@ -741,7 +762,6 @@ std::unordered_set<profile*> free_profiles;
     std::vector<std::string> id_vector;
     // iterate over the counters, and sort their names
     {
-        std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
         for(auto it2 : all_profiles) {
             std::string name = it2.first;
             apex_profile * p = it2.second;
@@ -786,6 +806,12 @@ std::unordered_set<profile*> free_profiles;
          /* Advance index forward so the next iteration doesn't pick it up as well. */
          index += 2;
     }
+#if APEX_HAVE_PERF_EVENT
+    if (perf_event_counters::num_events() > 0) {
+        tmpstr.clear();
+        for (auto& m : metric_names) { tmpstr += "| " + m + " "; }
+    }
+#endif
 
     // Declare vector of pairs
     vector<pair<std::string, apex_profile*> > timer_vector;
@@ -1025,12 +1051,9 @@ std::unordered_set<profile*> free_profiles;
     task_dependencies.clear();
 
     // output nodes with  "main" [shape=box; style=filled; fillcolor="#ff0000" ];
-    unordered_map<task_identifier, profile*>::const_iterator it;
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    for(it = task_map.begin(); it != task_map.end(); it++) {
-      profile * p = it->second;
+    task_map.for_each([&](const task_identifier& id, profile * p) {
       // shouldn't happen, but?
-      if (p == nullptr) continue;
+      if (p == nullptr) return;
       /*
       int divisor = num_worker_threads;
       std::string divided_label("time per thread: ");
@@ -1044,7 +1067,7 @@ std::unordered_set<profile*> free_profiles;
       if (p->get_type() == APEX_TIMER) {
         std::string decoration;
         std::string font;
-        task_identifier task_id = it->first;
+        task_identifier task_id = id;
         // if the node is dark, make the font white for readability
         if (p->get_accumulated_seconds() > 0.5 * wall_clock_main) {
             font = "; fontcolor=white";
@@ -1074,7 +1097,7 @@ std::unordered_set<profile*> free_profiles;
             "s\\l\" ];" << std::endl;
         delete(c);
       }
-    }
+    });
     myfile << "}\n";
     myfile.close();
   }
@@ -1199,14 +1222,7 @@ std::unordered_set<profile*> free_profiles;
                 tree_stream << ",\"median " << x << "\"";
                 tree_stream << ",\"mode " << x << "\"";
             }
-            /* First, we need to tokenize the list of metrics */
-            std::stringstream tmpstr(apex_options::papi_metrics());
-            // use stream iterators to copy the stream to the vector as whitespace
-            // separated strings
-            std::istream_iterator<std::string> tmpstr_it(tmpstr);
-            std::istream_iterator<std::string> tmpstr_end;
-            std::vector<std::string> tmpstr_results(tmpstr_it, tmpstr_end);
-            for (auto m : tmpstr_results) {
+            for (auto m : metric_names) {
                 tree_stream << ",\"" << m << "\"";
             }
             tree_stream << "\n";
@@ -1215,6 +1231,42 @@ std::unordered_set<profile*> free_profiles;
         std::string filename{"apex_tasktree.csv"};
         reduce_profiles(tree_stream, filename);
     }
+    if (apex_options::use_tasktree_output() &&
+        apex_options::use_binary_output()) {
+        // one file per rank, with the same columns as the CSV
+        columnar_table table(columnar_table::task_tree);
+        typedef columnar_table t;
+        table.add_column("process rank", t::uint32_column);
+        table.add_column("node index", t::uint32_column);
+        table.add_column("parent index", t::uint32_column);
+        table.add_column("depth", t::uint32_column);
+        table.add_column("name", t::string_column);
+        table.add_column("calls", t::float64_column);
+        table.add_column("threads", t::float64_column);
+        table.add_column("total time(s)", t::float64_column);
+        table.add_column("inclusive time(s)", t::float64_column);
+        table.add_column("minimum time(s)", t::float64_column);
+        table.add_column("mean time(s)", t::float64_column);
+        table.add_column("maximum time(s)", t::float64_column);
+        table.add_column("stddev time(s)", t::float64_column);
+        for (int i = 0 ; i < num_papi_counters ; i++) {
+            table.add_column(metric_names[i], t::float64_column);
+        }
+        for (auto& x : dependency::Node::getKnownMetrics()) {
+            table.add_column("total " + x, t::float64_column);
+            table.add_column("minimum " + x, t::float64_column);
+            table.add_column("mean " + x, t::float64_column);
+            table.add_column("maximum " + x, t::float64_column);
+            table.add_column("stddev " + x, t::float64_column);
+            table.add_column("median " + x, t::float64_column);
+            table.add_column("mode " + x, t::float64_column);
+        }
+        root->tree_node->writeNodeColumns(table, wall_clock_main, node_id, num_papi_counters);
+        stringstream binname;
+        binname << apex_options::output_file_path();
+        binname << filesystem_separator() << "apex_tasktree." << node_id << ".bin";
+        table.write(binname.str(), node_id);
+    }
   }
 
   /* Write TAU profiles from the collected data. */
@@ -1232,16 +1284,12 @@ std::unordered_set<profile*> free_profiles;
 
     // Determine number of counter events, as these need to be
     // excluded from the number of normal timers
-    unordered_map<task_identifier, profile*>::const_iterator it2;
-    {
-        std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-        for(it2 = task_map.begin(); it2 != task_map.end(); it2++) {
-            profile * p = it2->second;
-            if(p->get_type() == APEX_COUNTER) {
-                counter_events++;
-            }
+    task_map.for_each([&](const task_identifier& id, profile * p) {
+        APEX_UNUSED(id);
+        if(p->get_type() == APEX_COUNTER) {
+            counter_events++;
         }
-    }
+    });
     size_t function_count = task_map.size() - counter_events;
     if (apex_options::use_tasktree_output() || apex_options::use_hatchet_output()) {
         auto root = task_wrapper::get_apex_main_wrapper();
@@ -1260,10 +1308,8 @@ std::unordered_set<profile*> free_profiles;
     profile * mainp = nullptr;
     double not_main = 0.0;
     {
-        std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-        for(it2 = task_map.begin(); it2 != task_map.end(); it2++) {
-            profile * p = it2->second;
-            task_identifier task_id = it2->first;
+        task_map.for_each([&](const task_identifier& id, profile * p) {
+            task_identifier task_id = id;
             if(p->get_type() == APEX_TIMER) {
                 string action_name = task_id.get_name();
                 if(action_name.compare(APEX_MAIN_STR) == 0) {
@@ -1274,7 +1320,7 @@ std::unordered_set<profile*> free_profiles;
                     not_main += (p->get_accumulated_useconds());
                 }
             }
-        }
+        });
         if (mainp != nullptr) {
             myfile << "\".TAU application\" ";
             format_line (myfile, mainp, not_main);
@@ -1295,14 +1341,13 @@ std::unordered_set<profile*> free_profiles;
     if(counter_events > 0) {
       myfile << counter_events << " userevents" << endl;
       myfile << "# eventname numevents max min mean sumsqr" << endl;
-      for(it2 = task_map.begin(); it2 != task_map.end(); it2++) {
-        profile * p = it2->second;
+      task_map.for_each([&](const task_identifier& id, profile * p) {
         if(p->get_type() == APEX_COUNTER) {
-          task_identifier task_id = it2->first;
+          task_identifier task_id = id;
           myfile << "\"" << task_id.get_name() << "\" ";
           format_counter_line (myfile, p);
         }
-      }
+      });
     }
     myfile.close();
   }
@@ -1642,6 +1687,15 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
 #if APEX_HAVE_PAPI
       initialize_PAPI(true);
 #endif
+#if APEX_HAVE_PERF_EVENT
+      /* PAPI takes precedence, if both are available and requested */
+      if (num_papi_counters == 0 &&
+          strlen(apex_options::perf_event_metrics()) > 0) {
+        metric_names = perf_event_counters::initialize(
+            apex_options::perf_event_metrics());
+        num_papi_counters = metric_names.size();
+      }
+#endif
 
       /* This commented out code is to change the priority of the consumer thread.
        * IDEALLY, I would like to make this a low priority thread, but that is as
@@ -1680,6 +1734,11 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
       // time the whole application.
       main_timer = std::make_shared<profiler>(
         task_wrapper::get_apex_main_wrapper());
+      // periodically write the changed profiles to disk
+      if (apex_options::use_profile_snapshots()) {
+        _snapshot_writer = new profile_snapshot_writer(this,
+            apex_options::profile_snapshot_period());
+      }
 #if APEX_HAVE_PAPI
       if (num_papi_counters > 0 && !apex_options::papi_suspend() &&
         _pls.thread_papi_state == papi_running) {
@@ -1689,6 +1748,11 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
             index = index + _pls.event_set_sizes[i];
         }
       }
+#endif
+#if APEX_HAVE_PERF_EVENT
+      if (perf_event_counters::num_events() > 0 && !apex_options::papi_suspend()) {
+        perf_event_counters::read(main_timer->papi_start_values);
+      }
 #endif
     }
     node_id = data.comm_rank;
@@ -1728,7 +1792,8 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
           apex_options::use_taskgraph_output() ||
           apex_options::use_tasktree_output() ||
           apex_options::use_hatchet_output() ||
-          apex_options::use_csv_output())
+          apex_options::use_csv_output() ||
+          apex_options::use_binary_output())
       {
         size_t ignored = 0;
         { // we need to lock in case another thread appears
@@ -1779,6 +1844,9 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
             finalize_profiles(data, reduced);
         }
       }
+      if (apex_options::use_binary_output()) {
+        write_flat_profile_columns(node_id, num_papi_counters, metric_names, this);
+      }
       if (apex_options::use_taskgraph_output())
       {
         write_taskgraph();
@@ -1834,7 +1902,10 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
       }
 #endif
 #endif // APEX_SYNCHRONOUS_PROCESSING
-
+      // all profiles are processed, so write the last snapshot
+      if (_snapshot_writer != nullptr) {
+          _snapshot_writer->finish();
+      }
     }
   }
 
@@ -1917,6 +1988,11 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
             _pls.thread_papi_state = papi_suspended;
           }
       }
+#endif
+#if APEX_HAVE_PERF_EVENT
+      if (perf_event_counters::num_events() > 0 && !apex_options::papi_suspend()) {
+          perf_event_counters::read(p->papi_start_values);
+      }
 #endif
     } else {
         return false;
@@ -1974,6 +2050,11 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
                 index = index + _pls.event_set_sizes[i];
             }
         }
+#endif
+#if APEX_HAVE_PERF_EVENT
+        if (perf_event_counters::num_events() > 0 && !apex_options::papi_suspend()) {
+            perf_event_counters::read(p->papi_stop_values);
+        }
 #endif
         // moved this to _common_start
         //p->thread_id = _pls.my_tid;
@@ -2027,13 +2108,11 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
     if (!_done) {
       // don't make a shared pointer if not necessary!
 #ifdef APEX_SYNCHRONOUS_PROCESSING
-      profiler p(task_identifier::get_task_id(
-        *data.counter_name), data.counter_value);
+      profiler p(data.get_task_id(), data.counter_value);
       p.is_counter = data.is_counter;
 #else // APEX_SYNCHRONOUS_PROCESSING
       std::shared_ptr<profiler> p =
-        std::make_shared<profiler>(task_identifier::get_task_id(
-        *data.counter_name), data.counter_value);
+        std::make_shared<profiler>(data.get_task_id(), data.counter_value);
       p->is_counter = data.is_counter;
 #endif // APEX_SYNCHRONOUS_PROCESSING
       push_profiler(_pls.my_tid, p);
@@ -2047,8 +2126,8 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
     // get the right task identifier, based on whether there are aliases
     task_identifier * id = tt_ptr->get_task_id();
     // if the parent task is not null, use it (obviously)
-    if (tt_ptr->parent != nullptr) {
-        task_identifier * pid = tt_ptr->parent->get_task_id();
+    if (tt_ptr->has_parent()) {
+        task_identifier * pid = tt_ptr->parent.task_id;
         dependency_queue()->enqueue(new task_dependency(pid, id));
         return;
     }
@@ -2110,6 +2189,10 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
   profiler_listener::~profiler_listener (void) {
       _done = true; // yikes!
       finalize();
+      if (_snapshot_writer != nullptr) {
+          delete _snapshot_writer;
+          _snapshot_writer = nullptr;
+      }
       delete_profiles();
 #ifndef APEX_SYNCHRONOUS_PROCESSING
 #ifndef APEX_HAVE_HPX
@@ -30,6 +30,8 @@
 #include <string>
 
 #include "profile.hpp"
+#include "profile_index.hpp"
+#include "profile_snapshot_writer.hpp"
 #include "thread_instance.hpp"
 #include <fstream>
 
@@ -90,7 +92,7 @@ public:
 static const char * task_scatterplot_sample_filename = "apex_task_samples.";
 static const char * counter_scatterplot_sample_filename = "apex_counter_samples.";
 
-class profiler_listener : public event_listener {
+class profiler_listener final : public event_listener {
 private:
   void _init(void);
   bool _initialized;
@@ -122,8 +124,9 @@ private:
     bool is_yield); // internal, inline function
   void push_profiler(int my_tid, std::shared_ptr<profiler> &p);
   void push_profiler(int my_tid, profiler &p);
-  std::unordered_map<task_identifier, profile*> task_map;
-  std::mutex _task_map_mutex;
+  profile_index task_map;
+  std::mutex _available_profiles_mutex;
+  std::vector<task_identifier> _available_profiles;
   std::unordered_map<task_identifier, std::unordered_map<task_identifier,
     int>* > task_dependencies;
   /* an vector of profiler queues - so the consumer thread can access them */
@@ -151,6 +154,7 @@ private:
   std::stringstream task_scatterplot_samples;
   std::stringstream counter_scatterplot_samples;
   std::string timestamp_started;
+  profile_snapshot_writer * _snapshot_writer;
 public:
   void set_node_id(int node_id, int node_count) {
     APEX_UNUSED(node_count);
@@ -158,7 +162,7 @@ public:
   }
   profiler_listener (void) : _initialized(false), _main_timer_stopped(false), _done(false),
                              node_id(0), task_map() , num_papi_counters(0),
-                             metric_names(0)
+                             metric_names(0), _snapshot_writer(nullptr)
   {
       if (apex_options::task_scatterplot()) {
         profiler::get_global_start();
@@ -225,26 +229,31 @@ public:
   void reset(task_identifier * id);
   void reset_all(void);
   profile * get_profile(const task_identifier &id);
+  // the number of profilers waiting to be processed, on all threads
+  size_t queue_backlog(void);
   double get_non_idle_time(void);
   profile * get_idle_time(void);
   profile * get_idle_rate(void);
-  std::vector<task_identifier>& get_available_profiles() {
-    static std::vector<task_identifier> ids;
-    _task_map_mutex.lock();
-    if (task_map.size() > ids.size()) {
-        ids.clear();
-        for (auto kv : task_map) {
-           ids.push_back(kv.first);
-        }
+  // a copy, because another thread can rebuild the list while it is used
+  std::vector<task_identifier> get_available_profiles() {
+    std::unique_lock<std::mutex> l(_available_profiles_mutex);
+    // only rebuild the list when profiles have been added
+    if (task_map.size() > _available_profiles.size()) {
+        _available_profiles.clear();
+        task_map.for_each([this](const task_identifier& id, profile * p) {
+            APEX_UNUSED(p);
+            _available_profiles.push_back(id);
+        });
     }
-    _task_map_mutex.unlock();
-    return ids;
+    return _available_profiles;
   }
+  uint64_t get_changed_profiles(uint64_t since_epoch,
+    std::vector<std::pair<task_identifier, apex_profile> >& changed);
   void process_profiles(void);
   static void process_profiles_wrapper(void);
   static void consumer_process_profiles_wrapper(void);
   bool concurrent_cleanup(int i);
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
   std::vector<std::string>& get_metric_names(void) { return metric_names; };
 #endif
   void stop_main_timer(void);
@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+/* timer_create() with SIGEV_THREAD_ID is Linux only */
+#if defined(__linux__)
+
+#include "sampling_listener.hpp"
+#include "apex.hpp"
+#include "apex_options.hpp"
+#include "address_resolution.hpp"
+#include "task_identifier.hpp"
+#include "tau_listener.hpp"
+#include "utils.hpp"
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+namespace apex {
+
+    /* The signal handler can only use state it can reach without locking
+     * or allocating: the thread's own sampler, and the global flag. */
+    static APEX_NATIVE_TLS sampling_listener::sampler_thread * my_sampler = nullptr;
+    static std::atomic<bool> sampling_active(false);
+    /* how often the handler thread drains the ring buffers */
+    static const unsigned int drain_period = 100000;
+
+    const size_t sampling_listener::sampler_thread::max_timers;
+
+    sampling_listener::sampler_thread::sampler_thread(size_t depth,
+        size_t records) : num_timers(0), record_size(depth + 2),
+        capacity(records), head(0), tail(0), dropped(0), stack_low(0),
+        stack_high(0), armed(false) {
+        ring.resize(record_size * capacity);
+        /* the frame walk in the signal handler stays inside these bounds */
+        pthread_attr_t attr;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            void * addr;
+            size_t size;
+            if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+                stack_low = reinterpret_cast<uintptr_t>(addr);
+                stack_high = stack_low + size;
+            }
+            pthread_attr_destroy(&attr);
+        }
+    }
+
+    sampling_listener::sampling_listener(void) :
+        handler(drain_period), _dropped(0), _installed(false) {
+        _depth = std::max(1, apex_options::sampling_depth());
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = signal_handler;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGPROF, &action, nullptr) != 0) {
+            perror("installing the APEX sampling signal handler");
+            return;
+        }
+        _installed = true;
+        sampling_active = true;
+        run();
+    }
+
+    sampling_listener::~sampling_listener(void) {
+        stop_sampling();
+    }
+
+    /* Walk the frame pointers from the interrupted context.  backtrace()
+     * is not async-signal-safe (it can take the loader lock and allocate),
+     * but this only reads the registers and the thread's own stack.  Each
+     * frame has to be aligned, inside the stack and above the last one, so
+     * code built without frame pointers ends the walk early instead of
+     * faulting.  On other architectures, only the timer is recorded. */
+    static size_t walk_frames(const void * context, uintptr_t low,
+        uintptr_t high, uintptr_t * frames, size_t max_frames) {
+        const ucontext_t * uc = static_cast<const ucontext_t*>(context);
+#if defined(__x86_64__)
+        uintptr_t pc = uc->uc_mcontext.gregs[REG_RIP];
+        uintptr_t fp = uc->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+        uintptr_t pc = uc->uc_mcontext.pc;
+        uintptr_t fp = uc->uc_mcontext.regs[29];
+#else
+        APEX_UNUSED(uc);
+        APEX_UNUSED(low);
+        APEX_UNUSED(high);
+        APEX_UNUSED(frames);
+        APEX_UNUSED(max_frames);
+        return 0;
+#endif
+#if defined(__x86_64__) || defined(__aarch64__)
+        size_t n = 0;
+        if (max_frames == 0) { return 0; }
+        frames[n++] = pc;
+        while (n < max_frames) {
+            if (fp < low || fp > high - 2 * sizeof(uintptr_t) ||
+                (fp % sizeof(uintptr_t)) != 0) {
+                break;
+            }
+            /* the saved frame pointer, then the return address */
+            const uintptr_t * frame = reinterpret_cast<const uintptr_t*>(fp);
+            if (frame[1] == 0) { break; }
+            frames[n++] = frame[1];
+            if (frame[0] <= fp) { break; }
+            fp = frame[0];
+        }
+        return n;
+#endif
+    }
+
+    void sampling_listener::signal_handler(int sig, siginfo_t * info,
+        void * context) {
+        APEX_UNUSED(sig);
+        APEX_UNUSED(info);
+        sampler_thread * t = my_sampler;
+        if (t == nullptr || !sampling_active) { return; }
+        int saved_errno = errno;
+        uint64_t head = t->head.load(std::memory_order_relaxed);
+        if (head - t->tail.load(std::memory_order_acquire) >= t->capacity) {
+            t->dropped++;
+            errno = saved_errno;
+            return;
+        }
+        uintptr_t * record = &(t->ring[(head % t->capacity) * t->record_size]);
+        size_t n = t->num_timers.load(std::memory_order_relaxed);
+        record[0] = (n == 0) ? 0 : reinterpret_cast<uintptr_t>(
+            t->timers[std::min(n, sampler_thread::max_timers) - 1]);
+        record[1] = (context == nullptr || t->stack_high == 0) ? 0 :
+            walk_frames(context, t->stack_low, t->stack_high, &record[2],
+                t->record_size - 2);
+        t->head.store(head + 1, std::memory_order_release);
+        errno = saved_errno;
+    }
+
+    /* Get this thread's sampler, and start its timer the first time. */
+    sampling_listener::sampler_thread * sampling_listener::get_thread(void) {
+        if (my_sampler != nullptr) { return my_sampler; }
+        if (_terminate || !_installed) { return nullptr; }
+        // enough room for four drains' worth of samples
+        size_t records = std::max(64, std::min(4096,
+            4 * (int)(drain_period / std::max(1,
+            apex_options::sampling_period()))));
+        sampler_thread * t = new sampler_thread(_depth, records);
+        {
+            std::unique_lock<std::mutex> l(_thread_mutex);
+            _threads.emplace_back(t);
+        }
+        struct sigevent sev;
+        memset(&sev, 0, sizeof(sev));
+        sev.sigev_notify = SIGEV_THREAD_ID;
+        sev.sigev_signo = SIGPROF;
+        sev.sigev_notify_thread_id = syscall(SYS_gettid);
+        if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &(t->timer)) != 0) {
+            perror("creating the APEX sampling timer");
+        } else {
+            struct itimerspec spec;
+            long period = std::max(1, apex_options::sampling_period());
+            spec.it_interval.tv_sec = period / 1000000;
+            spec.it_interval.tv_nsec = (period % 1000000) * 1000;
+            spec.it_value = spec.it_interval;
+            timer_settime(t->timer, 0, &spec, nullptr);
+            t->armed = true;
+        }
+        my_sampler = t;
+        return t;
+    }
+
+    inline void sampling_listener::push_timer(task_identifier * id) {
+        sampler_thread * t = get_thread();
+        if (t == nullptr) { return; }
+        size_t n = t->num_timers.load(std::memory_order_relaxed);
+        if (n < sampler_thread::max_timers) {
+            t->timers[n] = id;
+        }
+        // publish the timer before the new count, for the signal handler
+        t->num_timers.store(n + 1, std::memory_order_release);
+    }
+
+    inline void sampling_listener::pop_timer(void) {
+        sampler_thread * t = my_sampler;
+        if (t == nullptr) { return; }
+        size_t n = t->num_timers.load(std::memory_order_relaxed);
+        if (n > 0) {
+            t->num_timers.store(n - 1, std::memory_order_release);
+        }
+    }
+
+    bool sampling_listener::on_start(std::shared_ptr<task_wrapper> &tt_ptr) {
+        push_timer(tt_ptr->get_task_id());
+        return true;
+    }
+
+    bool sampling_listener::on_resume(std::shared_ptr<task_wrapper> &tt_ptr) {
+        push_timer(tt_ptr->get_task_id());
+        return true;
+    }
+
+    void sampling_listener::on_stop(std::shared_ptr<profiler> &p) {
+        APEX_UNUSED(p);
+        pop_timer();
+    }
+
+    void sampling_listener::on_yield(std::shared_ptr<profiler> &p) {
+        APEX_UNUSED(p);
+        pop_timer();
+    }
+
+    void sampling_listener::on_exit_thread(event_data &data) {
+        APEX_UNUSED(data);
+        sampler_thread * t = my_sampler;
+        if (t == nullptr) { return; }
+        // the buffer is kept until it is drained
+        my_sampler = nullptr;
+        std::unique_lock<std::mutex> l(_thread_mutex);
+        if (t->armed) {
+            timer_delete(t->timer);
+            t->armed = false;
+        }
+    }
+
+    void sampling_listener::stop_sampling(void) {
+        sampling_active = false;
+        {
+            std::unique_lock<std::mutex> l(_thread_mutex);
+            for (auto& t : _threads) {
+                if (t->armed) {
+                    timer_delete(t->timer);
+                    t->armed = false;
+                }
+            }
+        }
+        if (_installed) {
+            // signals may still be pending, so leave the handler in place
+            _installed = false;
+            cancel();
+        }
+    }
+
+    void sampling_listener::on_pre_shutdown(void) {
+        stop_sampling();
+    }
+
+    bool sampling_listener::_handler(void) {
+        if (!_handler_initialized) {
+            initialize_worker_thread_for_tau();
+            _handler_initialized = true;
+        }
+        if (_terminate) return true;
+        if (apex_options::use_tau()) {
+            tau_listener::Tau_start_wrapper("sampling_listener::_handler");
+        }
+        drain();
+        if (apex_options::use_tau()) {
+            tau_listener::Tau_stop_wrapper("sampling_listener::_handler");
+        }
+        return true;
+    }
+
+    /* Move the samples from the ring buffers to the aggregated counts. */
+    void sampling_listener::drain(void) {
+        std::unique_lock<std::mutex> tl(_thread_mutex);
+        std::unique_lock<std::mutex> sl(_sample_mutex);
+        std::vector<uintptr_t> key;
+        for (auto& t : _threads) {
+            uint64_t tail = t->tail.load(std::memory_order_relaxed);
+            uint64_t head = t->head.load(std::memory_order_acquire);
+            for ( ; tail < head ; tail++) {
+                const uintptr_t * record =
+                    &(t->ring[(tail % t->capacity) * t->record_size]);
+                key.assign(1, record[0]);
+                key.insert(key.end(), record + 2, record + 2 + record[1]);
+                _samples[key]++;
+            }
+            t->tail.store(tail, std::memory_order_release);
+            _dropped += t->dropped.exchange(0);
+        }
+    }
+
+    /* Resolve a frame to a function name, without the offset, so that
+     * all the samples in a function are merged in the flame graph. */
+    static std::string resolve_frame(uintptr_t ip) {
+#ifdef APEX_HAVE_BFD
+        std::string * name = lookup_address(ip, false);
+        std::string result(demangle(*name));
+        delete name;
+#else
+        std::string result;
+        Dl_info info;
+        if (dladdr((const void *)ip, &info) != 0 && info.dli_sname != nullptr) {
+            result = demangle(info.dli_sname);
+        } else {
+            std::stringstream ss;
+            if (dladdr((const void *)ip, &info) != 0 &&
+                info.dli_fname != nullptr) {
+                ss << info.dli_fname << "+";
+                ip = ip - (uintptr_t)info.dli_fbase;
+            }
+            ss << "0x" << std::hex << ip;
+            result = ss.str();
+        }
+#endif
+        // ';' separates the frames in the folded format
+        std::replace(result.begin(), result.end(), ';', ':');
+        return result;
+    }
+
+    void sampling_listener::write_samples(int node_id) {
+        std::unique_lock<std::mutex> sl(_sample_mutex);
+        if (_samples.empty()) { return; }
+        std::unordered_map<uintptr_t, std::string> names;
+        std::stringstream ss;
+        ss << apex_options::output_file_path() << filesystem_separator()
+           << "apex_samples." << node_id << ".folded";
+        std::ofstream folded(ss.str());
+        // stacks with different addresses in the same functions are merged
+        std::map<std::string, size_t> stacks;
+        size_t total = 0;
+        for (auto& s : _samples) {
+            const std::vector<uintptr_t>& key = s.first;
+            task_identifier * id = reinterpret_cast<task_identifier*>(key[0]);
+            std::string stack = (id == nullptr) ? "(no timer)" : id->get_name();
+            std::replace(stack.begin(), stack.end(), ';', ':');
+            /* outermost frame first; the innermost is the interrupted pc,
+             * and the others are return addresses, which point past the call */
+            for (size_t i = key.size() - 1 ; i > 0 ; i--) {
+                uintptr_t ip = (i == 1) ? key[i] : key[i] - 1;
+                auto name = names.find(ip);
+                if (name == names.end()) {
+                    name = names.emplace(ip, resolve_frame(ip)).first;
+                }
+                stack += ";" + name->second;
+            }
+            stacks[stack] += s.second;
+            total += s.second;
+        }
+        for (auto& s : stacks) {
+            folded << s.first << " " << s.second << "\n";
+        }
+        folded.close();
+        if (apex_options::use_verbose()) {
+            std::cout << "Wrote " << total << " samples (" << _dropped
+                      << " dropped) to " << ss.str() << std::endl;
+        }
+    }
+
+    void sampling_listener::on_dump(dump_event_data &data) {
+        drain();
+        write_samples(data.node_id);
+        if (data.reset) {
+            on_reset(nullptr);
+        }
+    }
+
+    void sampling_listener::on_reset(task_identifier * id) {
+        if (id == nullptr) {
+            std::unique_lock<std::mutex> sl(_sample_mutex);
+            _samples.clear();
+            _dropped = 0;
+        }
+    }
+
+}
+
+#endif // __linux__
+
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "handler.hpp"
+#include "event_listener.hpp"
+#include <signal.h>
+#include <time.h>
+#include <cstdint>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef SIGEV_THREAD_ID
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif /* ifndef sigev_notify_thread_id */
+#endif /* ifdef SIGEV_THREAD_ID */
+
+namespace apex {
+
+/* Statistical call stack sampling.  Every thread that starts a timer gets
+ * a timer_create(CLOCK_THREAD_CPUTIME_ID) timer, which sends SIGPROF to
+ * that thread after each APEX_SAMPLING_PERIOD microseconds of CPU time.
+ * The signal handler captures the call stack by walking the frame pointers
+ * from the interrupted context (x86_64 and aarch64; elsewhere only the
+ * timer is recorded), and attributes it to the innermost APEX timer
+ * running on the thread.  Frames in code built without frame pointers are
+ * missing from the stacks, so build with -fno-omit-frame-pointer for
+ * complete ones.  Samples are stored in a
+ * lock-free ring buffer per thread (one writer, the signal handler, and
+ * one reader, the handler thread), which the handler thread drains
+ * periodically.  At exit, the addresses are resolved (with BFD, when
+ * available) and written as folded stacks, one line per unique stack:
+ *
+ *   timer;outermost frame;...;innermost frame count
+ *
+ * to apex_samples.<rank>.folded, which flamegraph.pl, speedscope, etc.
+ * can read.  Each APEX timer is the root of its own flame graph. */
+class sampling_listener : public handler, public event_listener {
+public:
+    /* per-thread state, shared with the signal handler */
+    class sampler_thread {
+    public:
+        /* the running timers, written only by the owning thread */
+        static const size_t max_timers = 256;
+        task_identifier * timers[max_timers];
+        std::atomic<size_t> num_timers;
+        /* sample records: timer, number of frames, then the frames */
+        std::vector<uintptr_t> ring;
+        size_t record_size;
+        size_t capacity;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+        std::atomic<uint64_t> dropped;
+        /* the thread's stack, which bounds the frame pointer walk */
+        uintptr_t stack_low;
+        uintptr_t stack_high;
+        timer_t timer;
+        bool armed;
+        sampler_thread(size_t depth, size_t records);
+    };
+private:
+    std::mutex _thread_mutex;
+    std::vector<std::unique_ptr<sampler_thread> > _threads;
+    /* sample counts for each unique (timer, frames...) key */
+    std::mutex _sample_mutex;
+    std::map<std::vector<uintptr_t>, size_t> _samples;
+    uint64_t _dropped;
+    size_t _depth;
+    bool _installed;
+    static void signal_handler(int sig, siginfo_t * info, void * context);
+    sampler_thread * get_thread(void);
+    void push_timer(task_identifier * id);
+    void pop_timer(void);
+    void stop_sampling(void);
+    void drain(void);
+    void write_samples(int node_id);
+public:
+    sampling_listener(void);
+    ~sampling_listener(void);
+    void on_startup(startup_event_data &data) { APEX_UNUSED(data); };
+    void on_dump(dump_event_data &data);
+    void on_reset(task_identifier * id);
+    void on_pre_shutdown(void);
+    void on_shutdown(shutdown_event_data &data) { APEX_UNUSED(data); };
+    void on_new_node(node_event_data &data) { APEX_UNUSED(data); };
+    void on_new_thread(new_thread_event_data &data) { APEX_UNUSED(data); };
+    void on_exit_thread(event_data &data);
+    bool on_start(std::shared_ptr<task_wrapper> &tt_ptr);
+    void on_stop(std::shared_ptr<profiler> &p);
+    void on_yield(std::shared_ptr<profiler> &p);
+    bool on_resume(std::shared_ptr<task_wrapper> &tt_ptr);
+    void on_task_complete(std::shared_ptr<task_wrapper> &tt_ptr) {
+        APEX_UNUSED(tt_ptr);
+    };
+    void on_sample_value(sample_value_event_data &data) { APEX_UNUSED(data); };
+    bool handles(dispatch_event event) {
+        return event != DISPATCH_TASK_COMPLETE &&
+            event != DISPATCH_SAMPLE_VALUE;
+    }
+    void on_periodic(periodic_event_data &data) { APEX_UNUSED(data); };
+    void on_custom_event(custom_event_data &data) { APEX_UNUSED(data); };
+    void on_send(message_event_data &data) { APEX_UNUSED(data); };
+    void on_recv(message_event_data &data) { APEX_UNUSED(data); };
+    void set_node_id(int node_id, int node_count) { APEX_UNUSED(node_id);
+        APEX_UNUSED(node_count); }
+    bool _handler(void);
+};
+
+}
+
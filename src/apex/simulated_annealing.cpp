@@ -42,6 +42,21 @@ double SimulatedAnnealing::acceptance_probability(double new_cost) {
     return exp(-1.0 * ((new_cost-cost) / temp));
 }
 
+/* The neighbors are chosen with a standard deviation of a quarter of the
+ * space times 1-k/kmax, so pick the point in the schedule where that is
+ * the radius, and end it budget evaluations later.  The old costs are
+ * stale, so they are forgotten. */
+void SimulatedAnnealing::retune(double radius, size_t budget) {
+    double scope = std::min(std::max(4.0 * radius, 0.01), 1.0);
+    budget = std::max(budget, (size_t)(1));
+    k = (size_t)((1.0 - scope) / scope * (double)(budget)) + 1;
+    kmax = k + budget;
+    cost = std::numeric_limits<double>::max();
+    best_cost = cost;
+    for (auto& v : vars) { v.second.restore_best(); }
+    since_restart = 1;
+}
+
 void SimulatedAnnealing::evaluate(double new_cost) {
     /*   T <- temperature( (k+1)/kmax ) */
     temp = (double)(k)/(double)(kmax);
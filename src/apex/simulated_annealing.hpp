@@ -101,6 +101,11 @@ public:
         current_index = neighbor_index = best_index = half;
         //std::cout << "Initialized to " << current_index << std::endl;
     }
+    /* For starting from a known good setting instead */
+    void set_init(size_t start) {
+        set_init();
+        current_index = neighbor_index = best_index = std::min(start, maxlen);
+    }
     std::string getBest() {
         if (vtype == VariableType::doubletype) {
             *((double*)(value)) = dvalues[best_index];
@@ -181,6 +186,10 @@ public:
         std::cout << "]" << std::endl;
     }
     double acceptance_probability(double new_cost);
+    /* Search again from the best settings, staying about radius of the
+     * space away from them, for budget evaluations, when their cost has
+     * changed */
+    void retune(double radius, size_t budget);
     size_t get_max_iterations();
     std::map<std::string, Variable>& get_vars() { return vars; }
     void add_var(std::string name, Variable var) {
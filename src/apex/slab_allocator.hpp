@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "apex_types.h"
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+namespace apex {
+
+/* A pool of fixed size blocks, carved from slabs.  Each thread keeps its
+ * own list of free blocks, so allocating and freeing doesn't lock.  Blocks
+ * can be freed on any thread: when a thread has too many free blocks (i.e.
+ * it frees tasks that other threads create), half of them are moved to a
+ * shared list, which threads refill from before allocating a new slab.
+ * Slabs are never returned to the system, so the memory used is bounded
+ * by the peak number of live blocks. */
+template <size_t BlockSize>
+class slab_pool {
+private:
+    struct block { block * next; };
+    static const size_t blocks_per_slab = 256;
+    static const size_t max_cached = 2 * blocks_per_slab;
+    struct shared_list {
+        std::mutex mtx;
+        block * head;
+        size_t count;
+        shared_list(void) : head(nullptr), count(0) {}
+    };
+    /* never destroyed, blocks can be freed during static destruction */
+    static shared_list& shared(void) {
+        static shared_list * list = new shared_list();
+        return *list;
+    }
+    /* plain data, so it is still valid after the thread's cleanup */
+    struct thread_list {
+        block * head;
+        size_t count;
+        bool exited;
+    };
+    static thread_list& local(void) {
+        static APEX_NATIVE_TLS thread_list list = {nullptr, 0, false};
+        return list;
+    }
+    /* gives this thread's free blocks back when the thread exits */
+    struct thread_cleanup {
+        ~thread_cleanup(void) {
+            thread_list& l = local();
+            give_back(l, l.count);
+            l.exited = true;
+        }
+    };
+    /* move count blocks from this thread's list to the shared list */
+    static void give_back(thread_list& l, size_t count) {
+        if (count == 0) { return; }
+        block * first = l.head;
+        block * last = first;
+        for (size_t i = 1 ; i < count ; i++) { last = last->next; }
+        l.head = last->next;
+        l.count -= count;
+        shared_list& s = shared();
+        std::unique_lock<std::mutex> lock(s.mtx);
+        last->next = s.head;
+        s.head = first;
+        s.count += count;
+    }
+    static void refill(thread_list& l) {
+        static APEX_NATIVE_TLS thread_cleanup cleanup;
+        APEX_UNUSED(cleanup);
+        shared_list& s = shared();
+        {
+            std::unique_lock<std::mutex> lock(s.mtx);
+            size_t count = 0;
+            while (s.head != nullptr && count < blocks_per_slab) {
+                block * b = s.head;
+                s.head = b->next;
+                b->next = l.head;
+                l.head = b;
+                count++;
+            }
+            s.count -= count;
+            l.count += count;
+        }
+        if (l.head != nullptr) { return; }
+        char * slab = static_cast<char*>(
+            ::operator new(block_size * blocks_per_slab));
+        for (size_t i = 0 ; i < blocks_per_slab ; i++) {
+            block * b = reinterpret_cast<block*>(slab + (i * block_size));
+            b->next = l.head;
+            l.head = b;
+        }
+        l.count += blocks_per_slab;
+    }
+public:
+    static const size_t block_size =
+        ((BlockSize + alignof(std::max_align_t) - 1) /
+        alignof(std::max_align_t)) * alignof(std::max_align_t);
+    static void * allocate(void) {
+        thread_list& l = local();
+        if (l.head == nullptr) {
+            if (l.exited) { return ::operator new(block_size); }
+            refill(l);
+        }
+        block * b = l.head;
+        l.head = b->next;
+        l.count--;
+        return b;
+    }
+    static void deallocate(void * p) {
+        thread_list& l = local();
+        block * b = static_cast<block*>(p);
+        b->next = l.head;
+        l.head = b;
+        l.count++;
+        if (l.exited) {
+            give_back(l, l.count);
+        } else if (l.count > max_cached) {
+            give_back(l, max_cached / 2);
+        }
+    }
+};
+
+/* An allocator for std::allocate_shared, so that an object and its
+ * reference counts are one block from a slab_pool. */
+template <typename T>
+class slab_allocator {
+public:
+    typedef T value_type;
+    slab_allocator(void) noexcept {}
+    template <typename U>
+    slab_allocator(const slab_allocator<U>&) noexcept {}
+    T * allocate(size_t n) {
+        if (n != 1) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(slab_pool<sizeof(T)>::allocate());
+    }
+    void deallocate(T * p, size_t n) noexcept {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+        slab_pool<sizeof(T)>::deallocate(p);
+    }
+    template <typename U>
+    bool operator==(const slab_allocator<U>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const slab_allocator<U>&) const noexcept { return false; }
+};
+
+}
+
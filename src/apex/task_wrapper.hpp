@@ -52,9 +52,25 @@ struct task_wrapper {
   */
     uint64_t parent_guid;
 /**
-  \brief A managed pointer to the parent task_wrapper for this task.
-  */
-    std::shared_ptr<task_wrapper> parent;
+  \brief What the listeners need to know about the parent task.  The parent
+         task_wrapper itself is only weakly referenced, so that a chain of
+         tasks (recursion, continuations) doesn't keep all of its ancestors
+         alive.
+  */
+    struct parent_data {
+        task_identifier * task_id;
+        dependency::Node* tree_node;
+        long unsigned int thread_id;
+        std::weak_ptr<task_wrapper> task;
+        /* the parent's start when this task was created, if it is gone */
+        uint64_t start_ns;
+        /* The parent may not have started yet when this task is created,
+         * so its start time is looked up when the flow event is written. */
+        double get_flow_us() {
+            std::shared_ptr<task_wrapper> p = task.lock();
+            return double(p != nullptr ? p->start_ns : start_ns) * 1.0e-3;
+        }
+    } parent;
 /**
   \brief A node in the task tree representing this task type
   */
@@ -94,11 +110,12 @@ struct task_wrapper {
         prof(nullptr),
         guid(0ull),
         parent_guid(0ull),
-        parent(nullptr),
+        parent({nullptr, nullptr, 0UL, {}, 0ull}),
         tree_node(nullptr),
         alias(nullptr),
         thread_id(0UL),
         create_ns(our_clock::now_ns()),
+        start_ns(0ull),
         explicit_trace_start(false)
     { }
 /**
@@ -130,13 +147,26 @@ struct task_wrapper {
         }
         return tt_ptr;
     }
+/**
+  \brief Keep what we need from the parent task.
+  */
+    void set_parent(const std::shared_ptr<task_wrapper>& p) {
+        parent.task_id = p->get_task_id();
+        parent.tree_node = p->tree_node;
+        parent.thread_id = p->thread_id;
+        parent.task = p;
+        parent.start_ns = p->start_ns;
+    }
+    bool has_parent() {
+        return parent.task_id != nullptr;
+    }
     void assign_heritage() {
         // make/find a node for ourselves
-        tree_node = parent->tree_node->appendChild(task_id);
+        tree_node = parent.tree_node->appendChild(task_id);
     }
     void update_heritage() {
         // make/find a node for ourselves
-        tree_node = parent->tree_node->replaceChild(task_id, alias);
+        tree_node = parent.tree_node->replaceChild(task_id, alias);
     }
     double get_create_us() {
         return double(create_ns) * 1.0e-3;
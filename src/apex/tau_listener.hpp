@@ -41,6 +41,9 @@ public:
   void on_task_complete(std::shared_ptr<task_wrapper> &tt_ptr) {
     APEX_UNUSED(tt_ptr);
   };
+  bool handles(dispatch_event event) {
+    return event != DISPATCH_TASK_COMPLETE;
+  }
   void on_sample_value(sample_value_event_data &data);
   void on_periodic(periodic_event_data &data);
   void on_custom_event(custom_event_data &data);
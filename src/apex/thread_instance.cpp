@@ -373,4 +373,14 @@ profiler * thread_instance::get_current_profiler(void) {
     return instance().current_profilers.back();
 }
 
+/* Find the innermost running timer for this task id on this thread, which
+ * is not always the current one when timers overlap. */
+profiler * thread_instance::find_current_profiler(task_identifier * id) {
+    auto &the_stack = instance().current_profilers;
+    for (auto p = the_stack.rbegin() ; p != the_stack.rend() ; ++p) {
+        if ((*p)->get_task_id() == id) { return *p; }
+    }
+    return nullptr;
+}
+
 }
@@ -156,6 +156,7 @@ public:
   static profiler * restore_children_profilers(std::shared_ptr<task_wrapper> &tt_ptr);
   static void set_current_profiler(profiler * the_profiler);
   static profiler * get_current_profiler(void);
+  static profiler * find_current_profiler(task_identifier * id);
   static void clear_current_profiler(profiler * the_profiler,
         bool save_children, std::shared_ptr<task_wrapper> &tt_ptr);
   static void clear_current_profiler() {
@@ -9,12 +9,15 @@
 #include "trace_event_listener.hpp"
 #include "thread_instance.hpp"
 #include "apex.hpp"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <memory>
 #include <iomanip>
 #include <future>
 #include <thread>
+#include <signal.h>
 
 using namespace std;
 
@@ -22,13 +25,38 @@ namespace apex {
 
 bool trace_event_listener::_initialized(false);
 
+/* Set by the APEX_TRACE_EVENT_TRIGGER_SIGNAL handler, which can't do the
+ * capture itself; the next event on any thread starts it. */
+static std::atomic<bool> _signal_capture{false};
+
+static void capture_signal_handler(int sig) {
+    APEX_UNUSED(sig);
+    _signal_capture = true;
+}
+
 trace_event_listener::trace_event_listener (void) : _terminate(false),
-    num_events(0), _end_time(0.0) {
+    num_events(0), _capturing(false), _capture_closed(false),
+    _end_time(0.0) {
     _initialized = true;
+    if (apex_options::trace_event_flight_recorder() &&
+        apex_options::trace_event_trigger_signal() > 0) {
+        struct sigaction act;
+        memset(&act, 0, sizeof(act));
+        sigemptyset(&act.sa_mask);
+        act.sa_flags = SA_RESTART;
+        act.sa_handler = capture_signal_handler;
+        sigaction(apex_options::trace_event_trigger_signal(), &act, nullptr);
+    }
 }
 
 trace_event_listener::~trace_event_listener (void) {
     close_trace();
+    for (auto buffer : mapped_buffers) {
+        delete buffer;
+    }
+    for (auto buffer : flight_buffers) {
+        delete buffer;
+    }
 }
 
 void trace_event_listener::end_trace_time(void) {
@@ -56,7 +84,7 @@ void trace_event_listener::on_startup(startup_event_data &data) {
        << ",\"ph\":\"M\",\"pid\":" << saved_node_id
        << ",\"args\":{\"sort_index\":\""
        << setw(8) << setfill('0') << saved_node_id << "\"}},\n";
-    write_to_trace(ss);
+    write_metadata(ss);
     return;
 }
 
@@ -102,8 +130,8 @@ inline void trace_event_listener::_common_start(std::shared_ptr<task_wrapper> &t
         ss.precision(3);
         ss << fixed;
         uint64_t pguid = 0;
-        if (tt_ptr->parent != nullptr) {
-            pguid = tt_ptr->parent->guid;
+        if (tt_ptr->has_parent()) {
+            pguid = tt_ptr->parent_guid;
         }
         ss << "{\"name\":\"" << tt_ptr->get_task_id()->get_name()
               << "\",\"cat\":\"CPU\""
@@ -112,7 +140,7 @@ inline void trace_event_listener::_common_start(std::shared_ptr<task_wrapper> &t
               << ",\"ts\":" << tt_ptr->prof->get_start_us()
               << ",\"args\":{\"GUID\":" << tt_ptr->prof->guid << ",\"Parent GUID\":" << pguid << "}},\n";
 /* Only write the counter at the end, it's less data! */
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
         int i = 0;
         for (auto metric :
             apex::instance()->the_profiler_listener->get_metric_names()) {
@@ -160,7 +188,7 @@ long unsigned int trace_event_listener::get_thread_id_metadata() {
        << ",\"ph\":\"M\",\"pid\":" << saved_node_id
        << ",\"tid\":" << tid
        << ",\"args\":{\"sort_index\":\"" << setw(5) << setfill('0') << tid << "\"}},\n";
-    write_to_trace(ss);
+    write_metadata(ss);
     return tid;
 }
 
@@ -192,21 +220,21 @@ inline void trace_event_listener::_common_stop(std::shared_ptr<profiler> &p) {
         ss.precision(3);
         ss << fixed;
         uint64_t pguid = 0;
-        if (p->tt_ptr != nullptr && p->tt_ptr->parent != nullptr) {
-            pguid = p->tt_ptr->parent->guid;
+        if (p->tt_ptr != nullptr && p->tt_ptr->has_parent()) {
+            pguid = p->tt_ptr->parent_guid;
         }
         // if the parent tid is not the same, create a flow event BEFORE the single event
-        if (p->tt_ptr->parent != nullptr
+        if (p->tt_ptr->has_parent()
 #ifndef APEX_HAVE_HPX // ...except for HPX - make the flow event regardless
-            && p->tt_ptr->parent->thread_id != _tid
+            && p->tt_ptr->parent.thread_id != _tid
 #endif
             ) {
             //std::cout << "FLOWING!" << std::endl;
             uint64_t flow_id = reversed_node_id + get_flow_id();
-            write_flow_event(ss, p->tt_ptr->parent->get_flow_us(), 's', "ControlFlow", flow_id,
-                saved_node_id, p->tt_ptr->parent->thread_id, p->tt_ptr->parent->task_id->get_name());
+            write_flow_event(ss, p->tt_ptr->parent.get_flow_us(), 's', "ControlFlow", flow_id,
+                saved_node_id, p->tt_ptr->parent.thread_id, p->tt_ptr->parent.task_id->get_name());
             write_flow_event(ss, p->get_start_us(), 'f', "ControlFlow", flow_id,
-                saved_node_id, _tid, p->tt_ptr->parent->task_id->get_name());
+                saved_node_id, _tid, p->tt_ptr->parent.task_id->get_name());
         }
         if (p->tt_ptr->explicit_trace_start) {
             ss << "{\"name\":\"" << p->get_task_id()->get_name()
@@ -224,7 +252,7 @@ inline void trace_event_listener::_common_stop(std::shared_ptr<profiler> &p) {
               << p->get_stop_us() - p->get_start_us()
               << ",\"args\":{\"GUID\":" << p->guid << ",\"Parent GUID\":" << pguid << "}},\n";
         }
-#if APEX_HAVE_PAPI
+#if APEX_HAVE_HW_COUNTERS
         int i = 0;
         for (auto metric :
             apex::instance()->the_profiler_listener->get_metric_names()) {
@@ -242,6 +270,10 @@ inline void trace_event_listener::_common_stop(std::shared_ptr<profiler> &p) {
         }
 #endif
         write_to_trace(ss);
+        if (apex_options::trace_event_flight_recorder() &&
+            apex_options::trace_event_trigger_latency_us() > 0) {
+            check_latency_trigger(p);
+        }
     }
     flush_trace_if_necessary();
     return;
@@ -320,7 +352,7 @@ std::string trace_event_listener::make_tid (base_thread_node &node) {
            << ",\"ph\":\"M\",\"pid\":" << saved_node_id
            << ",\"tid\":" << id_shifted
            << ",\"args\":{\"sort_index\":" << id_shifted << "}},\n";
-        write_to_trace(ss);
+        write_metadata(ss);
     }
     tid = vthread_map[node];
     std::stringstream ss;
@@ -336,33 +368,7 @@ void trace_event_listener::on_async_event(base_thread_node &node,
         ss.precision(3);
         ss << fixed;
         std::string tid{make_tid(node)};
-        uint64_t pguid = 0;
-        if (p->tt_ptr != nullptr && p->tt_ptr->parent != nullptr) {
-            pguid = p->tt_ptr->parent->guid;
-        }
-        ss << "{\"name\":\"" << p->get_task_id()->get_name()
-              << "\",\"cat\":\"GPU\""
-              << ",\"ph\":\"X\",\"pid\":"
-              << saved_node_id << ",\"tid\":" << tid
-              << ",\"ts\":" << p->get_start_us() << ",\"dur\":"
-              << p->get_stop_us() - p->get_start_us()
-              << ",\"args\":{\"GUID\":" << p->guid << ",\"Parent GUID\":" << pguid << "}},\n";
-        // write a flow event pair!
-        // make sure the start of the flow is before the end of the flow, ideally the middle of the parent
-        if (data.flow) {
-            uint64_t flow_id = reversed_node_id + get_flow_id();
-        if (data.reverse_flow) {
-            double begin_ts = (p->get_stop_us() + p->get_start_us()) * 0.5;
-            double end_ts = std::min(p->get_stop_us(), data.parent_ts_stop);
-            write_flow_event(ss, begin_ts, 's', data.cat, flow_id, saved_node_id, atol(tid.c_str()), data.name);
-            write_flow_event(ss, end_ts, 't', data.cat, flow_id, saved_node_id, data.parent_tid, data.name);
-        } else {
-            double begin_ts = std::min(p->get_start_us(), ((data.parent_ts_stop + data.parent_ts_start) * 0.5));
-            double end_ts = p->get_start_us();
-            write_flow_event(ss, begin_ts, 's', data.cat, flow_id, saved_node_id, data.parent_tid, data.name);
-            write_flow_event(ss, end_ts, 't', data.cat, flow_id, saved_node_id, atol(tid.c_str()), data.name);
-        }
-        }
+        write_async_event(ss, tid, p, data);
         write_to_trace(ss);
     }
     //flush_trace_if_necessary();
@@ -370,22 +376,84 @@ void trace_event_listener::on_async_event(base_thread_node &node,
 
 void trace_event_listener::on_async_metric(base_thread_node &node,
     std::shared_ptr<profiler> &p) {
+    APEX_UNUSED(node);
     if (!_terminate) {
         std::stringstream ss;
         ss.precision(3);
         ss << fixed;
-        std::string tid{make_tid(node)};
-        ss << "{\"name\": \"" << p->get_task_id()->get_name()
-              << "\",\"cat\":\"GPU\""
-              << ",\"ph\":\"C\",\"pid\": " << saved_node_id
-              << ",\"ts\":" << p->get_stop_us()
-              << ",\"args\":{\"value\":" << p->value
-              << "}},\n";
+        write_async_metric(ss, p);
         write_to_trace(ss);
     }
     //flush_trace_if_necessary();
 }
 
+/* The whole batch is on one virtual thread, and is written at once.
+ * flows has the flow data for each profiler, or nullptr. */
+void trace_event_listener::on_async_batch(base_thread_node &node,
+    std::vector<std::shared_ptr<profiler> > &profilers,
+    std::vector<const async_event_data*> &flows) {
+    if (!_terminate) {
+        std::stringstream ss;
+        ss.precision(3);
+        ss << fixed;
+        std::string tid{make_tid(node)};
+        async_event_data no_flow;
+        no_flow.flow = false;
+        for (size_t i = 0 ; i < profilers.size() ; i++) {
+            auto& p = profilers[i];
+            if (p->is_counter) {
+                write_async_metric(ss, p);
+            } else {
+                write_async_event(ss, tid, p,
+                    flows[i] == nullptr ? no_flow : *(flows[i]));
+            }
+        }
+        write_to_trace(ss);
+    }
+}
+
+void trace_event_listener::write_async_event(std::stringstream& ss,
+    const std::string& tid, std::shared_ptr<profiler> &p,
+    const async_event_data& data) {
+    uint64_t pguid = 0;
+    if (p->tt_ptr != nullptr && p->tt_ptr->has_parent()) {
+        pguid = p->tt_ptr->parent_guid;
+    }
+    ss << "{\"name\":\"" << p->get_task_id()->get_name()
+          << "\",\"cat\":\"GPU\""
+          << ",\"ph\":\"X\",\"pid\":"
+          << saved_node_id << ",\"tid\":" << tid
+          << ",\"ts\":" << p->get_start_us() << ",\"dur\":"
+          << p->get_stop_us() - p->get_start_us()
+          << ",\"args\":{\"GUID\":" << p->guid << ",\"Parent GUID\":" << pguid << "}},\n";
+    // write a flow event pair!
+    // make sure the start of the flow is before the end of the flow, ideally the middle of the parent
+    if (data.flow) {
+        uint64_t flow_id = reversed_node_id + get_flow_id();
+    if (data.reverse_flow) {
+        double begin_ts = (p->get_stop_us() + p->get_start_us()) * 0.5;
+        double end_ts = std::min(p->get_stop_us(), data.parent_ts_stop);
+        write_flow_event(ss, begin_ts, 's', data.cat, flow_id, saved_node_id, atol(tid.c_str()), data.name);
+        write_flow_event(ss, end_ts, 't', data.cat, flow_id, saved_node_id, data.parent_tid, data.name);
+    } else {
+        double begin_ts = std::min(p->get_start_us(), ((data.parent_ts_stop + data.parent_ts_start) * 0.5));
+        double end_ts = p->get_start_us();
+        write_flow_event(ss, begin_ts, 's', data.cat, flow_id, saved_node_id, data.parent_tid, data.name);
+        write_flow_event(ss, end_ts, 't', data.cat, flow_id, saved_node_id, atol(tid.c_str()), data.name);
+    }
+    }
+}
+
+void trace_event_listener::write_async_metric(std::stringstream& ss,
+    std::shared_ptr<profiler> &p) {
+    ss << "{\"name\": \"" << p->get_task_id()->get_name()
+          << "\",\"cat\":\"GPU\""
+          << ",\"ph\":\"C\",\"pid\": " << saved_node_id
+          << ",\"ts\":" << p->get_stop_us()
+          << ",\"args\":{\"value\":" << p->value
+          << "}},\n";
+}
+
 size_t trace_event_listener::get_thread_index(void) {
     static size_t numthreads{0};
     _vthread_mutex.lock();
@@ -435,7 +503,63 @@ std::stringstream* trace_event_listener::get_thread_stream(size_t index) {
 #endif
 }
 
+/* Each thread gets its own file, so appending to it needs no shared lock.
+ * If the file can't be mapped, the thread uses the in-memory buffer. */
+mapped_trace_buffer* trace_event_listener::get_mapped_buffer(size_t index) {
+    std::stringstream ss;
+    ss << apex_options::output_file_path() << "/";
+    ss << "trace_events." << apex::instance()->get_node_id() << "."
+       << index << ".mmap";
+    mapped_trace_buffer * tmp = new mapped_trace_buffer(ss.str(),
+        apex::instance()->get_node_id(), index);
+    if (!tmp->ok()) {
+        delete tmp;
+        return nullptr;
+    }
+    std::unique_lock<std::mutex> l(_vthread_mutex);
+    mapped_buffers.push_back(tmp);
+    return tmp;
+}
+
+flight_recorder_buffer* trace_event_listener::get_flight_buffer(void) {
+    flight_recorder_buffer * tmp = new flight_recorder_buffer(
+        ((size_t)apex_options::trace_event_flight_recorder_mb()) << 20);
+    std::unique_lock<std::mutex> l(_vthread_mutex);
+    flight_buffers.push_back(tmp);
+    return tmp;
+}
+
 void trace_event_listener::write_to_trace(std::stringstream& events) {
+    if (apex_options::trace_event_flight_recorder()) {
+        static APEX_NATIVE_TLS flight_recorder_buffer * recorder =
+            get_flight_buffer();
+        std::string tmp{events.str()};
+        recorder->append(profiler::now_ns(), tmp.data(), tmp.size());
+        return;
+    }
+    if (apex_options::trace_event_mmap()) {
+        static APEX_NATIVE_TLS mapped_trace_buffer * buffer =
+            get_mapped_buffer(get_thread_index());
+        if (buffer != nullptr) {
+            std::string tmp{events.str()};
+            buffer->append(tmp.data(), tmp.size());
+            return;
+        }
+    }
+    write_to_stream(events);
+}
+
+/* The flight recorder keeps the thread names and other metadata, so that
+ * every capture can use them. */
+void trace_event_listener::write_metadata(std::stringstream& events) {
+    if (apex_options::trace_event_flight_recorder()) {
+        write_to_stream(events);
+    } else {
+        write_to_trace(events);
+    }
+}
+
+void trace_event_listener::write_to_stream(std::stringstream& events) {
     static APEX_NATIVE_TLS size_t index = get_thread_index();
     static APEX_NATIVE_TLS std::mutex * mtx = get_thread_mutex(index);
     static APEX_NATIVE_TLS std::stringstream * strm = get_thread_stream(index);
@@ -450,15 +574,26 @@ std::string trace_event_listener::get_file_name() {
     ss << apex_options::output_file_path() << "/";
     ss << "trace_events." << saved_node_id << ".json";
 #ifdef APEX_HAVE_ZLIB
-    ss << ".gz";
+    ss << (get_trace_codec() == io::block_codec::zstd ? ".zst" : ".gz");
 #endif
     std::string tmp{ss.str()};
     return tmp;
 }
 
 #ifdef APEX_HAVE_ZLIB
-io::gzofstream& trace_event_listener::get_trace_file() {
-    static io::gzofstream _trace_file(get_file_name());
+io::block_codec trace_event_listener::get_trace_codec() {
+    if (apex_options::trace_event_zstd()) {
+        return io::block_zstreambuf::best_codec();
+    }
+    return io::block_codec::gzip;
+}
+
+/* The trace is compressed in blocks on a few threads, so that compression
+ * doesn't hold up the flushes */
+io::block_zofstream& trace_event_listener::get_trace_file() {
+    static io::block_zofstream _trace_file(get_file_name(),
+        (size_t)(std::max(apex_options::trace_event_compression_threads(), 0)),
+        get_trace_codec());
     // automatically opens
     static bool header{false};
     if (!header) {
@@ -483,16 +618,19 @@ std::ofstream& trace_event_listener::get_trace_file() {
 #endif
 
 void trace_event_listener::flush_trace(trace_event_listener* listener) {
-    static atomic<bool> flushing{false};
-    while (flushing) {} // wait for asynchronous flushing, if it's happening
-    flushing = true;
+    // wait for asynchronous flushing, if it's happening
+    static std::mutex flushing;
+    std::unique_lock<std::mutex> l(flushing);
     //std::cout << "**** FLUSHING TRACE BUFFER ****" << std::endl;
     auto p = scoped_timer("APEX: Trace Buffer Flush");
     auto& trace_file = listener->get_trace_file();
 #ifdef SERIAL
     // flush the trace
     listener->_vthread_mutex.lock();
-    trace_file << listener->trace.rdbuf();
+    // inserting an empty buffer would set the failbit on the trace file
+    if (listener->trace.rdbuf()->in_avail() > 0) {
+        trace_file << listener->trace.rdbuf();
+    }
     // reset the buffer
     listener->trace.str("");
     listener->_vthread_mutex.unlock();
@@ -502,23 +640,111 @@ void trace_event_listener::flush_trace(trace_event_listener* listener) {
     listener->_vthread_mutex.lock();
     size_t count = listener->streams.size();
     listener->_vthread_mutex.unlock();
-    std::stringstream ss;
+    std::string events;
     for (size_t index = 0 ; index < count ; index++) {
         auto p2 = scoped_timer("APEX: " + to_string(index) + " thread flush");
         std::mutex * mtx = listener->get_thread_mutex(index);
         std::stringstream * strm = listener->get_thread_stream(index);
+        /* take the events, so that the thread can go on while they are
+         * written */
         mtx->lock();
-        ss << strm->rdbuf();
+        events = strm->str();
         strm->str("");
         mtx->unlock();
+        trace_file.write(events.data(), events.size());
     }
     // flush the trace
-    trace_file << ss.rdbuf() << std::flush;
+    trace_file << std::flush;
 #endif
-    flushing = false;
+}
+
+void trace_event_listener::check_latency_trigger(std::shared_ptr<profiler> &p) {
+    double duration = p->get_stop_us() - p->get_start_us();
+    if (duration <= apex_options::trace_event_trigger_latency_us()) {
+        return;
+    }
+    std::string name{p->get_task_id()->get_name()};
+    if (strlen(apex_options::trace_event_trigger_timer()) > 0 &&
+        name.compare(apex_options::trace_event_trigger_timer()) != 0) {
+        return;
+    }
+    std::stringstream ss;
+    ss << name << " took " << duration << " us";
+    request_capture(ss.str());
+}
+
+/* Triggers from the measurement path capture on another thread, and are
+ * ignored while a capture is in progress.  The thread is joined by the
+ * next request, or when the trace is closed. */
+void trace_event_listener::request_capture(const std::string& reason) {
+    if (_capturing.exchange(true)) { return; }
+    std::unique_lock<std::mutex> l(_capture_thread_mutex);
+    if (_capture_closed) {
+        _capturing = false;
+        return;
+    }
+    // the previous capture is done, because _capturing was false
+    if (_capture_thread.joinable()) {
+        _capture_thread.join();
+    }
+    _capture_thread = std::thread(&trace_event_listener::capture, this,
+        reason);
+}
+
+void trace_event_listener::wait_for_capture(void) {
+    std::unique_lock<std::mutex> l(_capture_thread_mutex);
+    _capture_closed = true;
+    if (_capture_thread.joinable()) {
+        _capture_thread.join();
+    }
+}
+
+void trace_event_listener::capture(const std::string reason) {
+    std::unique_lock<std::mutex> l(_capture_mutex);
+    _capturing = true;
+    if (!apex_options::trace_event_flight_recorder() || _terminate) {
+        _capturing = false;
+        return;
+    }
+    uint64_t now = profiler::now_ns();
+    uint64_t window = ((uint64_t)apex_options::trace_event_flight_recorder_seconds())
+        * 1000000000ULL;
+    uint64_t since = now > window ? now - window : 0;
+    // write the metadata first
+    flush_trace(this);
+    auto& trace_file = get_trace_file();
+    std::stringstream ss;
+    ss.precision(3);
+    ss << fixed;
+    ss << "{\"name\":\"APEX Trace Capture\""
+       << ",\"ph\":\"i\",\"s\":\"g\",\"pid\":" << saved_node_id
+       << ",\"tid\":0,\"ts\":" << (double)now * 1.0e-3
+       << ",\"args\":{\"reason\":\"";
+    for (char c : reason) {
+        if (c == '"' || c == '\\') { ss << '\\'; }
+        ss << c;
+    }
+    ss << "\"}},\n";
+    trace_file << ss.str();
+    _vthread_mutex.lock();
+    std::vector<flight_recorder_buffer*> buffers(flight_buffers);
+    _vthread_mutex.unlock();
+    for (auto buffer : buffers) {
+        buffer->drain(since, trace_file);
+    }
+    trace_file << std::flush;
+    _capturing = false;
 }
 
 void trace_event_listener::flush_trace_if_necessary(void) {
+    if (apex_options::trace_event_flight_recorder()) {
+        if (_signal_capture && _signal_capture.exchange(false)) {
+            request_capture("signal");
+        }
+        return;
+    }
+    // the mapped buffers are already in their files
+    if (apex_options::trace_event_mmap()) { return; }
     auto tmp = ++num_events;
     /* flush after every 100k events */
     if (tmp % 1000000 == 0) {
@@ -531,6 +757,9 @@ void trace_event_listener::flush_trace_if_necessary(void) {
 void trace_event_listener::close_trace(void) {
     static bool closed{false};
     if (closed) return;
+    // wait for a capture to finish
+    wait_for_capture();
+    std::unique_lock<std::mutex> l(_capture_mutex);
     auto& trace_file = get_trace_file();
     std::stringstream ss;
     ss.precision(3);
@@ -541,10 +770,35 @@ void trace_event_listener::close_trace(void) {
        << fixed << _end_time << "}\n";
     ss << "]\n";
     ss << "}\n" << std::endl;
-    write_to_trace(ss);
-    flush_trace(this);
+    if (apex_options::trace_event_mmap()) {
+        /* copy the mapped buffers into the trace, then anything from
+         * threads that couldn't map a file, then the end of the trace */
+        _vthread_mutex.lock();
+        for (auto buffer : mapped_buffers) {
+            buffer->finalize(trace_file);
+        }
+        _vthread_mutex.unlock();
+        flush_trace(this);
+        trace_file << ss.rdbuf() << std::flush;
+    } else {
+        write_to_stream(ss);
+        flush_trace(this);
+    }
     //printf("Closing trace...\n"); fflush(stdout);
     trace_file.close();
+    if (trace_file.fail()) {
+        /* keep the mapped buffers, apex-trace-recover.py can read them */
+        std::cerr << "APEX: Error writing the trace to " << get_file_name()
+                  << std::endl;
+        closed = true;
+        return;
+    }
+    /* the trace is complete, so the mapped buffers aren't needed */
+    _vthread_mutex.lock();
+    for (auto buffer : mapped_buffers) {
+        buffer->remove();
+    }
+    _vthread_mutex.unlock();
     closed = true;
 }
 
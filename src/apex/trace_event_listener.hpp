@@ -10,16 +10,19 @@
 
 #include "event_listener.hpp"
 #include "async_thread_node.hpp"
+#include "mapped_trace_buffer.hpp"
+#include "flight_recorder.hpp"
 #include <memory>
 #include <sstream>
 #ifdef APEX_HAVE_ZLIB
-#include "gzstream.hpp"
+#include "block_zstream.hpp"
 #else
 #include <fstream>
 #endif
 #include <map>
 #include <atomic>
-#include <map>
+#include <thread>
+#include <vector>
 
 namespace apex {
 
@@ -46,6 +49,9 @@ public:
   	void on_task_complete(std::shared_ptr<task_wrapper> &tt_ptr) {
     	APEX_UNUSED(tt_ptr);
   	};
+  	bool handles(dispatch_event event) {
+    	return event != DISPATCH_TASK_COMPLETE;
+  	}
   	void on_sample_value(sample_value_event_data &data);
   	void on_periodic(periodic_event_data &data);
   	void on_custom_event(custom_event_data &data);
@@ -56,7 +62,13 @@ public:
     void on_async_event(base_thread_node &node, std::shared_ptr<profiler> &p,
         const async_event_data& data);
     void on_async_metric(base_thread_node &node, std::shared_ptr<profiler> &p);
+    void on_async_batch(base_thread_node &node,
+        std::vector<std::shared_ptr<profiler> > &profilers,
+        std::vector<const async_event_data*> &flows);
     void end_trace_time(void);
+    /* With APEX_TRACE_EVENT_FLIGHT_RECORDER, write the recent events */
+    void capture(const std::string reason);
+    void request_capture(const std::string& reason);
 
 private:
   	void _init(void);
@@ -65,6 +77,9 @@ private:
     void close_trace(void);
     void flush_trace_if_necessary(void);
   	void _common_start(std::shared_ptr<task_wrapper> &tt_ptr);
+    void write_async_event(std::stringstream& ss, const std::string& tid,
+        std::shared_ptr<profiler> &p, const async_event_data& data);
+    void write_async_metric(std::stringstream& ss, std::shared_ptr<profiler> &p);
   	void _common_stop(std::shared_ptr<profiler> &p);
     std::string make_tid (base_thread_node &node);
     long unsigned int get_thread_id_metadata();
@@ -72,19 +87,35 @@ private:
     size_t get_thread_index(void);
     std::mutex * get_thread_mutex(size_t index);
     std::stringstream * get_thread_stream(size_t index);
+    mapped_trace_buffer * get_mapped_buffer(size_t index);
     void write_to_trace(std::stringstream& events);
+    void write_to_stream(std::stringstream& events);
+    void write_metadata(std::stringstream& events);
+    flight_recorder_buffer * get_flight_buffer(void);
+    void check_latency_trigger(std::shared_ptr<profiler> &p);
     int saved_node_id;
     uint64_t reversed_node_id;
     std::atomic<size_t> num_events;
     std::string get_file_name();
 #ifdef APEX_HAVE_ZLIB
-  	io::gzofstream& get_trace_file();
+  	io::block_zofstream& get_trace_file();
+    static io::block_codec get_trace_codec(void);
 #else
   	std::ofstream& get_trace_file();
 #endif
   	std::stringstream trace;
     std::map<size_t, std::mutex*> mutexes;
     std::map<size_t, std::stringstream*> streams;
+    /* with APEX_TRACE_EVENT_MMAP, one per thread */
+    std::vector<mapped_trace_buffer*> mapped_buffers;
+    /* with APEX_TRACE_EVENT_FLIGHT_RECORDER, one per thread */
+    std::vector<flight_recorder_buffer*> flight_buffers;
+    void wait_for_capture(void);
+    std::mutex _capture_mutex;
+    std::atomic<bool> _capturing;
+    std::mutex _capture_thread_mutex;
+    std::thread _capture_thread;
+    bool _capture_closed;
     std::mutex _vthread_mutex;
     std::map<base_thread_node, size_t> vthread_map;
     double _end_time;
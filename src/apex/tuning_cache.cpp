@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "tuning_cache.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(APEX_WITH_MPI)
+#include "mpi.h"
+#endif
+
+namespace apex {
+
+namespace tuning_cache {
+
+/* The file is a header, then the entries, in native byte order.  The
+ * feature and setting ids are variable_id() hashes; version 1 files used
+ * the runtime's ids, and can't be read.
+ *   char magic[8] = "APEXTUN"; uint32_t version; uint32_t count;
+ *   entry: uint32_t name length, name,
+ *          uint32_t features, each { uint64_t id; uint8_t numeric;
+ *                                    double value; uint64_t label },
+ *          uint32_t settings, each { uint64_t id; uint8_t type;
+ *                                    double dvalue; int64_t lvalue;
+ *                                    uint32_t string length, string },
+ *          double cost; uint32_t runs */
+static const char magic[8] = "APEXTUN";
+
+namespace {
+
+template<typename T> void write(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void write_string(std::string& out, const std::string& value) {
+    write<uint32_t>(out, (uint32_t)(value.size()));
+    out.append(value);
+}
+
+/* Reads from the mapped file, and fails instead of reading past it */
+class reader {
+    const char * next;
+    const char * end;
+public:
+    reader(const char * data, size_t size) : next(data), end(data + size) {}
+    template<typename T> bool read(T& value) {
+        if ((size_t)(end - next) < sizeof(T)) { return false; }
+        memcpy(&value, next, sizeof(T));
+        next += sizeof(T);
+        return true;
+    }
+    bool read_string(std::string& value) {
+        uint32_t length;
+        if (!read(length) || (size_t)(end - next) < length) { return false; }
+        value.assign(next, length);
+        next += length;
+        return true;
+    }
+};
+
+bool same_settings(const entry& e, const std::vector<uint64_t>& ids) {
+    if (e.settings.size() != ids.size()) { return false; }
+    std::vector<uint64_t> mine;
+    for (auto& s : e.settings) { mine.push_back(s.id); }
+    std::sort(mine.begin(), mine.end());
+    std::vector<uint64_t> theirs(ids);
+    std::sort(theirs.begin(), theirs.end());
+    return mine == theirs;
+}
+
+/* Whether the features describe the same kind of context: the same input
+ * variables, and the same non-numeric values */
+bool comparable(const std::vector<feature>& a,
+    const std::vector<feature>& b) {
+    if (a.empty() || a.size() != b.size()) { return false; }
+    for (size_t i = 0 ; i < a.size() ; i++) {
+        if (a[i].id != b[i].id || a[i].numeric != b[i].numeric) {
+            return false;
+        }
+        if (!a[i].numeric && a[i].label != b[i].label) { return false; }
+    }
+    return true;
+}
+
+/* Contexts are the same if they have the same input values and tuning
+ * variables.  The name is only for people: it isn't comparable across
+ * runs or ranks.  Entries from older text caches have no features, so
+ * the name is all they have. */
+std::string key(const entry& e) {
+    std::string k;
+    if (e.features.empty()) {
+        k.assign(e.name);
+        k.push_back('\0');
+        return k;
+    }
+    for (auto& f : e.features) {
+        write<uint64_t>(k, f.id);
+        if (f.numeric) {
+            write<double>(k, f.value);
+        } else {
+            write<uint64_t>(k, f.label);
+        }
+    }
+    std::vector<uint64_t> ids;
+    for (auto& s : e.settings) { ids.push_back(s.id); }
+    std::sort(ids.begin(), ids.end());
+    for (auto id : ids) {
+        write<uint64_t>(k, id);
+    }
+    return k;
+}
+
+/* log scale, so that 1000 and 2000 are as close as 1 and 2 */
+double scaled(double value) {
+    return std::copysign(std::log2(1.0 + std::fabs(value)), value);
+}
+
+} // anonymous namespace
+
+uint64_t label(const std::string& value) {
+    uint64_t h = 14695981039346656037ULL;
+    for (auto c : value) {
+        h ^= (uint64_t)(unsigned char)(c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+uint64_t variable_id(const std::string& name, setting_type type) {
+    std::string k(name);
+    k.push_back('\0');
+    k.push_back((char)(static_cast<uint8_t>(type)));
+    return label(k);
+}
+
+bool cache::parse(const char * data, size_t size) {
+    reader in(data, size);
+    char check[8];
+    uint32_t file_version{0};
+    uint32_t count;
+    if (!in.read(check) || memcmp(check, magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    if (!in.read(file_version)) { return false; }
+    if (file_version != version) {
+        std::cerr << "APEX: tuning cache version " << file_version
+                  << " is not supported (expected " << version << ")"
+                  << std::endl;
+        return false;
+    }
+    if (!in.read(count)) { return false; }
+    for (uint32_t i = 0 ; i < count ; i++) {
+        entry e;
+        uint32_t n;
+        if (!in.read_string(e.name) || !in.read(n)) { return false; }
+        for (uint32_t f = 0 ; f < n ; f++) {
+            feature x;
+            uint8_t numeric;
+            if (!in.read(x.id) || !in.read(numeric) || !in.read(x.value) ||
+                !in.read(x.label)) { return false; }
+            x.numeric = numeric != 0;
+            e.features.push_back(x);
+        }
+        if (!in.read(n)) { return false; }
+        for (uint32_t s = 0 ; s < n ; s++) {
+            setting x;
+            uint8_t type;
+            if (!in.read(x.id) || !in.read(type) || !in.read(x.dvalue) ||
+                !in.read(x.lvalue) || !in.read_string(x.svalue)) {
+                return false;
+            }
+            if (type > static_cast<uint8_t>(setting_type::string_value)) {
+                return false;
+            }
+            x.type = static_cast<setting_type>(type);
+            e.settings.push_back(x);
+        }
+        if (!in.read(e.cost) || !in.read(e.runs)) { return false; }
+        add(e);
+    }
+    return true;
+}
+
+bool cache::load(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) { return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)(sizeof(magic))) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)(st.st_size);
+    void * data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "APEX: could not map tuning cache " << filename
+                  << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    // not a binary cache at all, maybe an older text one
+    if (memcmp(data, magic, sizeof(magic)) != 0) {
+        munmap(data, size);
+        return false;
+    }
+    bool good = parse(static_cast<const char*>(data), size);
+    munmap(data, size);
+    if (!good) {
+        std::cerr << "APEX: tuning cache " << filename
+                  << " is not readable" << std::endl;
+    }
+    return good;
+}
+
+std::string cache::serialize(void) const {
+    std::string out;
+    out.append(magic, sizeof(magic));
+    write<uint32_t>(out, version);
+    write<uint32_t>(out, (uint32_t)(entries.size()));
+    for (auto& e : entries) {
+        write_string(out, e.name);
+        write<uint32_t>(out, (uint32_t)(e.features.size()));
+        for (auto& f : e.features) {
+            write<uint64_t>(out, f.id);
+            write<uint8_t>(out, f.numeric ? 1 : 0);
+            write<double>(out, f.value);
+            write<uint64_t>(out, f.label);
+        }
+        write<uint32_t>(out, (uint32_t)(e.settings.size()));
+        for (auto& s : e.settings) {
+            write<uint64_t>(out, s.id);
+            write<uint8_t>(out, static_cast<uint8_t>(s.type));
+            write<double>(out, s.dvalue);
+            write<int64_t>(out, s.lvalue);
+            write_string(out, s.svalue);
+        }
+        write<double>(out, e.cost);
+        write<uint32_t>(out, e.runs);
+    }
+    return out;
+}
+
+bool cache::save(const std::string& filename) const {
+    /* The lock is on a separate file, because the cache itself is
+     * replaced by a rename */
+    std::string lockname(filename + ".lock");
+    int lock = open(lockname.c_str(), O_RDWR | O_CREAT, 0644);
+    if (lock < 0) {
+        std::cerr << "APEX: could not lock tuning cache " << filename
+                  << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    int locked;
+    while ((locked = fcntl(lock, F_SETLKW, &fl)) != 0 && errno == EINTR) { }
+    /* Some network filesystems don't do locks (ENOLCK).  Merging without
+     * the lock could lose another process's results, so don't. */
+    if (locked != 0) {
+        std::cerr << "APEX: could not lock tuning cache " << filename
+                  << ": " << strerror(errno) << std::endl;
+        close(lock);
+        return false;
+    }
+    cache merged;
+    merged.load(filename);
+    merged.merge(*this);
+    std::string out(merged.serialize());
+    std::string tmpname(filename + ".tmp." + std::to_string(getpid()));
+    bool good{false};
+    {
+        std::ofstream tmp(tmpname, std::ios::binary | std::ios::trunc);
+        tmp.write(out.data(), out.size());
+        good = tmp.good();
+    }
+    if (good && rename(tmpname.c_str(), filename.c_str()) != 0) {
+        good = false;
+    }
+    if (!good) {
+        std::cerr << "APEX: could not write tuning cache " << filename
+                  << ": " << strerror(errno) << std::endl;
+        unlink(tmpname.c_str());
+    }
+    fl.l_type = F_UNLCK;
+    fcntl(lock, F_SETLK, &fl);
+    close(lock);
+    return good;
+}
+
+void cache::add(const entry& e) {
+    std::string k(key(e));
+    auto found = by_key.find(k);
+    if (found == by_key.end()) {
+        by_key.insert(std::make_pair(k, entries.size()));
+        entries.push_back(e);
+        return;
+    }
+    entry& existing = entries[found->second];
+    uint32_t runs = existing.runs + e.runs;
+    if (e.cost < existing.cost) {
+        existing = e;
+    }
+    existing.runs = runs;
+}
+
+void cache::merge(const cache& other) {
+    for (auto& e : other.entries) { add(e); }
+}
+
+bool cache::gather(int& rank) {
+    rank = 0;
+#if defined(APEX_WITH_MPI)
+    int initialized{0};
+    int finalized{0};
+    PMPI_Initialized(&initialized);
+    PMPI_Finalized(&finalized);
+    if (!initialized || finalized) { return false; }
+    int size{1};
+    PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (size == 1) { return true; }
+    std::string mine(serialize());
+    int length{(int)(mine.size())};
+    std::vector<int> lengths(rank == 0 ? size : 0);
+    PMPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0,
+        MPI_COMM_WORLD);
+    std::vector<int> displacements(lengths.size(), 0);
+    for (size_t i = 1 ; i < lengths.size() ; i++) {
+        displacements[i] = displacements[i-1] + lengths[i-1];
+    }
+    std::string all(rank == 0 ?
+        (size_t)(displacements.back() + lengths.back()) : 0, '\0');
+    PMPI_Gatherv(&mine[0], length, MPI_CHAR, &all[0], lengths.data(),
+        displacements.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (rank != 0) { return true; }
+    for (int i = 1 ; i < size ; i++) {
+        cache theirs;
+        if (theirs.parse(all.data() + displacements[i], lengths[i])) {
+            merge(theirs);
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+const entry * cache::find(const std::string& name) const {
+    for (auto& e : entries) {
+        if (e.name == name && e.features.empty()) { return &e; }
+    }
+    return nullptr;
+}
+
+double cache::distance(const std::vector<feature>& a,
+    const std::vector<feature>& b) {
+    if (!comparable(a, b)) { return std::numeric_limits<double>::max(); }
+    double sum{0.0};
+    for (size_t i = 0 ; i < a.size() ; i++) {
+        if (!a[i].numeric) { continue; }
+        double delta = scaled(a[i].value) - scaled(b[i].value);
+        sum += delta * delta;
+    }
+    return std::sqrt(sum);
+}
+
+const entry * cache::nearest(const std::vector<feature>& features,
+    const std::vector<uint64_t>& setting_ids, double& distance) const {
+    const entry * best{nullptr};
+    distance = std::numeric_limits<double>::max();
+    for (auto& e : entries) {
+        if (!same_settings(e, setting_ids)) { continue; }
+        double d = cache::distance(features, e.features);
+        if (d < distance) {
+            distance = d;
+            best = &e;
+        }
+    }
+    return best;
+}
+
+} // tuning_cache
+
+} // apex
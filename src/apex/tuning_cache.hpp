@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace apex {
+
+/* A cache of converged autotuning results, kept between runs.  Each entry
+ * is a tuning context: its name, the values of the input variables that
+ * describe it (the features), the converged settings, and their cost.
+ * Entries are identified by their features and the ids of their tuning
+ * variables; the name is kept for the output.  A variable's id is a hash
+ * of its name and value type (see variable_id()), not the id the runtime
+ * gave it, which depends on the order the variables were declared in.
+ *
+ * The file is binary and versioned, and is read through a memory map.
+ * Saving merges with whatever is already in the file, under a lock, so
+ * several runs can all save to the same file.  The ranks of one job
+ * gather their results to rank 0, which saves them once.  When
+ * there is no entry for a context, the entry with the nearest features
+ * can be used instead: numbers are compared on a log scale, and
+ * everything else (strings, the tree node) has to match. */
+namespace tuning_cache {
+
+struct feature {
+    uint64_t id;
+    bool numeric;
+    double value;   // if numeric
+    uint64_t label; // if not, a hash of the value
+};
+
+enum class setting_type : uint8_t { double_value, int_value, string_value };
+
+struct setting {
+    uint64_t id;
+    setting_type type;
+    double dvalue;
+    int64_t lvalue;
+    std::string svalue;
+};
+
+struct entry {
+    std::string name;
+    std::vector<feature> features;
+    std::vector<setting> settings;
+    double cost;   // lower is better
+    uint32_t runs; // how many saved results were merged into this one
+};
+
+uint64_t label(const std::string& value);
+/* The id of an input or tuning variable, the same in every run and build */
+uint64_t variable_id(const std::string& name, setting_type type);
+
+class cache {
+private:
+    std::vector<entry> entries;
+    std::unordered_map<std::string, size_t> by_key;
+    bool parse(const char * data, size_t size);
+    std::string serialize(void) const;
+public:
+    static const uint32_t version{2};
+    /* false if the file doesn't exist, or isn't a cache of this version */
+    bool load(const std::string& filename);
+    /* Merge this cache into the file, keeping the lower cost result for
+     * each context.  Other processes saving to the same file wait. */
+    bool save(const std::string& filename) const;
+    /* An entry for a context already in the cache (the same features
+     * and tuning variables) replaces it if it has a lower cost */
+    void add(const entry& e);
+    void merge(const cache& other);
+    /* Merge the caches of all the MPI ranks into rank 0's.  Every rank has
+     * to call this, while MPI is running.  False, and rank 0, without MPI. */
+    bool gather(int& rank);
+    size_t size(void) const { return entries.size(); }
+    const std::vector<entry>& get_entries(void) const { return entries; }
+    /* An entry without features, from an older text cache */
+    const entry * find(const std::string& name) const;
+    /* The entry with the same kind of features and settings whose
+     * features are closest to these, and the distance to it */
+    const entry * nearest(const std::vector<feature>& features,
+        const std::vector<uint64_t>& setting_ids, double& distance) const;
+    static double distance(const std::vector<feature>& a,
+        const std::vector<feature>& b);
+};
+
+} // tuning_cache
+
+} // apex
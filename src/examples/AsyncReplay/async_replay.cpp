@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+/* Replays synthetic GPU activity buffers through the batched ingestion path
+ * (async_activity_batch), so that it can be tested and timed without a GPU.
+ * Like a vendor's buffer, each synthetic buffer has the records from several
+ * devices and streams, in the order the activities completed.  Run with
+ * APEX_TRACE_EVENT=1 or APEX_OTF2=1 to exercise the tracing listeners. */
+
+#include "apex_api.hpp"
+#include "async_activity.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define DEVICES 2
+#define STREAMS 4
+#define BUFFERS 100
+#define RECORDS_PER_BUFFER 1000
+
+/* A record in the synthetic activity buffer */
+enum synthetic_kind { SYNTHETIC_KERNEL, SYNTHETIC_MEMCPY };
+struct synthetic_record {
+    synthetic_kind kind;
+    uint32_t device;
+    uint32_t stream;
+    uint32_t name;
+    uint64_t start;
+    uint64_t end;
+    uint64_t bytes;
+};
+
+const char * kernel_names[] = {"GPU: synthetic kernel A",
+    "GPU: synthetic kernel B", "GPU: synthetic kernel C"};
+const size_t num_kernel_names = sizeof(kernel_names) / sizeof(kernel_names[0]);
+const std::string memcpy_name("GPU: synthetic memcpy");
+const std::string bytes_name("GPU: synthetic bytes");
+
+/* Fill a buffer: each stream runs its activities back to back, and the
+ * streams are interleaved in completion order. */
+void make_buffer(std::vector<synthetic_record>& buffer,
+    std::vector<uint64_t>& stream_clock, std::mt19937& gen) {
+    std::uniform_int_distribution<uint32_t> pick_stream(0, DEVICES * STREAMS - 1);
+    std::uniform_int_distribution<uint32_t> pick_name(0, num_kernel_names);
+    std::uniform_int_distribution<uint64_t> duration(1000, 100000);
+    buffer.clear();
+    for (size_t i = 0 ; i < RECORDS_PER_BUFFER ; i++) {
+        uint32_t s = pick_stream(gen);
+        synthetic_record r;
+        r.device = s / STREAMS;
+        r.stream = s % STREAMS;
+        r.name = pick_name(gen);
+        r.kind = r.name == num_kernel_names ? SYNTHETIC_MEMCPY : SYNTHETIC_KERNEL;
+        r.start = stream_clock[s];
+        r.end = r.start + duration(gen);
+        r.bytes = r.kind == SYNTHETIC_MEMCPY ? (r.end - r.start) * 8 : 0;
+        stream_clock[s] = r.end;
+        buffer.push_back(r);
+    }
+}
+
+/* Decode a buffer, as the CUPTI, roctracer or OMPT support would */
+void replay_buffer(const std::vector<synthetic_record>& buffer,
+    apex::task_identifier ** kernel_ids, apex::task_identifier * memcpy_id,
+    apex::task_identifier * bytes_id, uint64_t offset) {
+    apex::async_activity_batch<apex::cuda_thread_node> batch;
+    for (const auto& r : buffer) {
+        if (r.kind == SYNTHETIC_KERNEL) {
+            apex::cuda_thread_node node(r.device, 0, r.stream, APEX_ASYNC_KERNEL);
+            batch.add_activity(node, kernel_ids[r.name],
+                r.start + offset, r.end + offset);
+        } else {
+            apex::cuda_thread_node node(r.device, 0, r.stream, APEX_ASYNC_MEMORY);
+            /* a flow event from the (pretend) launch on the main thread,
+             * which happened just before the copy started */
+            double launch_us = (double)(r.start + offset) * 1.0e-3 - 1.0;
+            apex::async_event_data flow(launch_us, "DataFlow", r.start,
+                0, "synthetic memcpy");
+            batch.add_activity(node, memcpy_id, r.start + offset,
+                r.end + offset, nullptr, flow);
+            batch.add_counter(node, bytes_id, r.end + offset, (double)r.bytes);
+        }
+    }
+    batch.flush();
+}
+
+int main (int argc, char** argv) {
+    APEX_UNUSED(argc);
+    APEX_UNUSED(argv);
+    apex::init("apex async activity replay", 0, 1);
+    apex::profiler * p = apex::start(__func__);
+    /* Intern the names once, as the measurement support does */
+    apex::task_identifier * kernel_ids[num_kernel_names];
+    for (size_t i = 0 ; i < num_kernel_names ; i++) {
+        kernel_ids[i] = apex::task_identifier::get_task_id(
+            std::string(kernel_names[i]));
+    }
+    apex::task_identifier * memcpy_id =
+        apex::task_identifier::get_task_id(memcpy_name);
+    apex::task_identifier * bytes_id =
+        apex::task_identifier::get_task_id(bytes_name);
+    std::mt19937 gen(12345);
+    std::vector<uint64_t> stream_clock(DEVICES * STREAMS, 0);
+    std::vector<synthetic_record> buffer;
+    std::vector<size_t> kernel_counts(num_kernel_names, 0);
+    size_t memcpy_count = 0;
+    /* the activity happens during this run */
+    uint64_t offset = apex::profiler::now_ns();
+    double seconds = 0.0;
+    for (int b = 0 ; b < BUFFERS ; b++) {
+        make_buffer(buffer, stream_clock, gen);
+        for (const auto& r : buffer) {
+            if (r.kind == SYNTHETIC_KERNEL) {
+                kernel_counts[r.name]++;
+            } else {
+                memcpy_count++;
+            }
+        }
+        auto begin = std::chrono::steady_clock::now();
+        replay_buffer(buffer, kernel_ids, memcpy_id, bytes_id, offset);
+        auto end = std::chrono::steady_clock::now();
+        seconds += std::chrono::duration<double>(end - begin).count();
+    }
+    cout << "Replayed " << BUFFERS * RECORDS_PER_BUFFER << " records in "
+         << seconds << " seconds ("
+         << (seconds * 1.0e9) / (BUFFERS * RECORDS_PER_BUFFER)
+         << " ns/record)" << endl;
+    apex::stop(p);
+    /* all the profiles have been processed once APEX is finalized */
+    apex::finalize();
+    bool passed = true;
+    for (size_t i = 0 ; i < num_kernel_names ; i++) {
+        apex_profile * profile = apex::get_profile(std::string(kernel_names[i]));
+        if (profile == nullptr || profile->calls != kernel_counts[i]) {
+            cerr << kernel_names[i] << ": expected " << kernel_counts[i]
+                 << " calls, got " << (profile ? profile->calls : 0) << endl;
+            passed = false;
+        }
+    }
+    apex_profile * profile = apex::get_profile(memcpy_name);
+    if (profile == nullptr || profile->calls != memcpy_count) {
+        cerr << memcpy_name << ": expected " << memcpy_count << " calls, got "
+             << (profile ? profile->calls : 0) << endl;
+        passed = false;
+    }
+    profile = apex::get_profile(bytes_name);
+    if (profile == nullptr || profile->calls != memcpy_count) {
+        cerr << bytes_name << ": expected " << memcpy_count << " samples, got "
+             << (profile ? profile->calls : 0) << endl;
+        passed = false;
+    }
+    apex::cleanup();
+    if (passed) {
+        cout << "Test passed." << endl;
+        return 0;
+    }
+    return 1;
+}
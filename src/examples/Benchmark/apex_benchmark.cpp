@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+/* Microbenchmarks for the APEX measurement API.  Each benchmark is run with
+ * 1, 2, 4... up to --threads threads, and reports the time per event, the
+ * heap allocations per event made by the measuring threads, and the largest
+ * backlog of the profiler_listener's consumer queues.  The results are
+ * written as JSON.  The listeners, event filter and throttling are chosen
+ * with the usual APEX environment variables - see apex-benchmark.py, which
+ * runs this program over a matrix of them. */
+
+#include "apex_api.hpp"
+#include "apex.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/* Count the heap allocations made by each thread.  The counter is plain
+ * thread local data, so counting doesn't perturb the timings. */
+static thread_local uint64_t thread_allocations = 0;
+
+void * operator new(size_t size) {
+    thread_allocations++;
+    void * p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) { throw std::bad_alloc(); }
+    return p;
+}
+void * operator new[](size_t size) {
+    thread_allocations++;
+    void * p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) { throw std::bad_alloc(); }
+    return p;
+}
+void * operator new(size_t size, const std::nothrow_t&) noexcept {
+    thread_allocations++;
+    return malloc(size == 0 ? 1 : size);
+}
+void * operator new[](size_t size, const std::nothrow_t&) noexcept {
+    thread_allocations++;
+    return malloc(size == 0 ? 1 : size);
+}
+void operator delete(void * p) noexcept { free(p); }
+void operator delete[](void * p) noexcept { free(p); }
+void operator delete(void * p, size_t) noexcept { free(p); }
+void operator delete[](void * p, size_t) noexcept { free(p); }
+void operator delete(void * p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void * p, const std::nothrow_t&) noexcept { free(p); }
+
+/* All threads start each benchmark together */
+class barrier {
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t count;
+    size_t waiting;
+    size_t generation;
+public:
+    barrier(size_t c) : count(c), waiting(0), generation(0) {}
+    void wait(void) {
+        std::unique_lock<std::mutex> lock(mtx);
+        size_t gen = generation;
+        if (++waiting == count) {
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(lock, [&]{ return gen != generation; });
+    }
+};
+
+struct benchmark {
+    const char * name;
+    /* the number of APEX events in one iteration */
+    size_t events;
+    void (*run)(size_t iterations);
+};
+
+void timed_function(void) {}
+
+void start_stop_name(size_t iterations) {
+    const std::string name("benchmark start_stop_name");
+    for (size_t i = 0 ; i < iterations ; i++) {
+        apex::profiler * p = apex::start(name);
+        apex::stop(p);
+    }
+}
+
+void start_stop_address(size_t iterations) {
+    for (size_t i = 0 ; i < iterations ; i++) {
+        apex::profiler * p = apex::start((apex_function_address)timed_function);
+        apex::stop(p);
+    }
+}
+
+void start_stop_task_wrapper(size_t iterations) {
+    const std::string name("benchmark start_stop_task_wrapper");
+    for (size_t i = 0 ; i < iterations ; i++) {
+        auto t = apex::new_task(name);
+        apex::start(t);
+        apex::stop(t);
+    }
+}
+
+void yield_resume(size_t iterations) {
+    const std::string name("benchmark yield_resume");
+    for (size_t i = 0 ; i < iterations ; i++) {
+        apex::profiler * p = apex::start(name);
+        apex::yield(p);
+        p = apex::resume(name);
+        apex::stop(p);
+    }
+}
+
+void sample_value(size_t iterations) {
+    const std::string name("benchmark sample_value");
+    for (size_t i = 0 ; i < iterations ; i++) {
+        apex::sample_value(name, (double)i);
+    }
+}
+
+void new_task_parent(size_t iterations) {
+    const std::string name("benchmark new_task_parent");
+    auto parent = apex::new_task("benchmark parent");
+    apex::start(parent);
+    for (size_t i = 0 ; i < iterations ; i++) {
+        auto t = apex::new_task(name, UINTMAX_MAX, parent);
+        apex::start(t);
+        apex::stop(t);
+    }
+    apex::stop(parent);
+}
+
+const benchmark benchmarks[] = {
+    {"start_stop_name", 2, start_stop_name},
+    {"start_stop_address", 2, start_stop_address},
+    {"start_stop_task_wrapper", 2, start_stop_task_wrapper},
+    {"yield_resume", 4, yield_resume},
+    {"sample_value", 1, sample_value},
+    {"new_task_parent", 2, new_task_parent}
+};
+
+struct result {
+    std::string name;
+    size_t threads;
+    uint64_t events;
+    double ns_per_event;
+    double events_per_second;
+    double allocations_per_event;
+    size_t max_backlog;
+};
+
+size_t backlog(void) {
+    apex::apex * instance = apex::apex::instance();
+    if (instance == nullptr || instance->the_profiler_listener == nullptr) {
+        return 0;
+    }
+    return instance->the_profiler_listener->queue_backlog();
+}
+
+/* Give the consumer thread time to catch up, so that one benchmark's
+ * backlog doesn't slow down the next one. */
+void drain(void) {
+    for (int i = 0 ; i < 10000 && backlog() > 0 ; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+result run_benchmark(const benchmark& b, size_t threads, size_t iterations) {
+    barrier start_line(threads + 1);
+    std::vector<double> elapsed(threads);
+    std::vector<uint64_t> allocations(threads);
+    std::atomic<size_t> running(threads);
+    std::vector<std::thread> workers;
+    for (size_t t = 0 ; t < threads ; t++) {
+        workers.push_back(std::thread([&, t]() {
+            apex::register_thread("benchmark worker");
+            // warm up, so the timers and thread data exist
+            b.run(iterations / 100 + 1);
+            start_line.wait();
+            uint64_t allocated = thread_allocations;
+            auto begin = std::chrono::steady_clock::now();
+            b.run(iterations);
+            auto end = std::chrono::steady_clock::now();
+            allocations[t] = thread_allocations - allocated;
+            elapsed[t] =
+                std::chrono::duration<double, std::nano>(end - begin).count();
+            running--;
+            apex::exit_thread();
+        }));
+    }
+    start_line.wait();
+    size_t max_backlog = 0;
+    while (running > 0) {
+        max_backlog = std::max(max_backlog, backlog());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    max_backlog = std::max(max_backlog, backlog());
+    for (auto& w : workers) { w.join(); }
+    drain();
+    result r;
+    r.name = b.name;
+    r.threads = threads;
+    r.events = b.events * iterations * threads;
+    double total = 0.0;
+    double longest = 0.0;
+    uint64_t allocated = 0;
+    for (size_t t = 0 ; t < threads ; t++) {
+        total += elapsed[t];
+        longest = std::max(longest, elapsed[t]);
+        allocated += allocations[t];
+    }
+    r.ns_per_event = total / r.events;
+    r.events_per_second = r.events / (longest * 1.0e-9);
+    r.allocations_per_event = (double)allocated / r.events;
+    r.max_backlog = max_backlog;
+    return r;
+}
+
+/* The version string has several lines */
+std::string json_string(const std::string& in) {
+    std::stringstream ss;
+    ss << "\"";
+    for (char c : in) {
+        if (c == '"' || c == '\\') {
+            ss << '\\' << c;
+        } else if (c == '\n') {
+            ss << "\\n";
+        } else if ((unsigned char)c >= 0x20) {
+            ss << c;
+        }
+    }
+    ss << "\"";
+    return ss.str();
+}
+
+void write_json(std::ostream& out, size_t max_threads, size_t iterations,
+    const std::vector<result>& results) {
+    using apex::apex_options;
+    out << "{\n";
+    out << "  \"version\": " << json_string(apex::version()) << ",\n";
+    out << "  \"config\": {\n";
+    out << "    \"max_threads\": " << max_threads << ",\n";
+    out << "    \"iterations\": " << iterations << ",\n";
+    out << "    \"hardware_threads\": "
+        << std::thread::hardware_concurrency() << ",\n";
+    out << "    \"listeners\": [\"profiler\"";
+    if (apex_options::use_policy()) { out << ", \"policy\""; }
+    if (apex_options::use_trace_event()) { out << ", \"trace_event\""; }
+    if (apex_options::use_perfetto()) { out << ", \"perfetto\""; }
+    if (apex_options::use_otf2()) { out << ", \"otf2\""; }
+    if (apex_options::use_tau()) { out << ", \"tau\""; }
+    if (apex_options::use_concurrency() > 0) { out << ", \"concurrency\""; }
+    if (apex_options::use_sampling()) { out << ", \"sampling\""; }
+    out << "],\n";
+    out << "    \"event_filter\": "
+        << (strlen(apex_options::task_event_filter_file()) > 0 ?
+            "true" : "false") << ",\n";
+    out << "    \"throttle_timers\": "
+        << (apex_options::throttle_timers() ? "true" : "false") << "\n";
+    out << "  },\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0 ; i < results.size() ; i++) {
+        const result& r = results[i];
+        out << "    {\"benchmark\": \"" << r.name << "\", "
+            << "\"threads\": " << r.threads << ", "
+            << "\"events\": " << r.events << ", "
+            << "\"ns_per_event\": " << r.ns_per_event << ", "
+            << "\"events_per_second\": " << r.events_per_second << ", "
+            << "\"allocations_per_event\": " << r.allocations_per_event
+            << ", \"max_backlog\": " << r.max_backlog << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+void usage(const char * program) {
+    cerr << "Usage: " << program << " [--threads N] [--iterations I]"
+         << " [--benchmark name] [--output file.json]" << endl;
+    cerr << "Benchmarks:";
+    for (const auto& b : benchmarks) { cerr << " " << b.name; }
+    cerr << endl;
+}
+
+int main(int argc, char** argv) {
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t iterations = 100000;
+    std::string only;
+    std::string output;
+    for (int i = 1 ; i < argc ; i++) {
+        std::string arg(argv[i]);
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (arg == "--threads") {
+            max_threads = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--iterations") {
+            iterations = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--benchmark") {
+            only = argv[++i];
+        } else if (arg == "--output") {
+            output = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (max_threads == 0 || iterations == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    apex::init("apex benchmark", 0, 1);
+    std::vector<result> results;
+    for (const auto& b : benchmarks) {
+        if (!only.empty() && only != b.name) { continue; }
+        for (size_t threads = 1 ; ;
+             threads = std::min(threads * 2, max_threads)) {
+            results.push_back(run_benchmark(b, threads, iterations));
+            const result& r = results.back();
+            cerr << b.name << ", " << threads << " threads: "
+                 << r.ns_per_event << " ns/event, "
+                 << r.allocations_per_event << " allocations/event, "
+                 << r.max_backlog << " max backlog" << endl;
+            if (threads == max_threads) { break; }
+        }
+    }
+    if (results.empty()) {
+        usage(argv[0]);
+        apex::finalize();
+        return 1;
+    }
+    /* Write before finalizing, so the output doesn't include the time to
+     * write the profiles. */
+    if (output.empty()) {
+        write_json(cout, max_threads, iterations, results);
+    } else {
+        std::ofstream out(output);
+        write_json(out, max_threads, iterations, results);
+    }
+    apex::finalize();
+    return 0;
+}
@@ -23,7 +23,8 @@ int main (int argc, char ** argv) {
     APEX_UNUSED(argv);
     apex::init("Custom Tuning Test", 0, 1);
 
-#ifdef APEX_HAVE_ACTIVEHARMONY
+    /* Without Active Harmony, APEX uses its built-in parallel rank
+     * order search */
     int num_inputs = 2;
     long * inputs[2] = {0L,0L};
     long mins[2] = {0,0};    // all minimums are 1
@@ -51,10 +52,6 @@ int main (int argc, char ** argv) {
     std::cerr << "Tuning session 1 handle: " << session << std::endl;
     std::cerr << "Tuning session 2 handle: " << session_2 << std::endl;
 
-#else
-    std::cerr << "Active Harmony not enabled" << std::endl;
-#endif
-
     for (int i = 0 ; i < num_iterations ; i++) {
         value = (10 * param_1) - (2 * param_2);
         apex::custom_event(my_custom_event, NULL);
@@ -64,14 +61,10 @@ int main (int argc, char ** argv) {
         std::cout << "x = " << x << " sv = " << sv << std::endl;
     }
     std::cout << "done." << std::endl;
-#ifdef APEX_HAVE_ACTIVEHARMONY
     if(param_1 != 5 || param_2 != 5) {
         std::cout << "Test passed." << std::endl;
     } else {
         std::cout << "Test failed." << std::endl;
     }
-#else
-    std::cout << "Test passed (but APEX was built without Active Harmony.)." << std::endl;
-#endif
     apex::finalize();
 }
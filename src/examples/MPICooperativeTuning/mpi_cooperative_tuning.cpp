@@ -0,0 +1,86 @@
+#include <mpi.h>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <cstring>
+#include "apex_api.hpp"
+#include "apex_policies.hpp"
+
+/* Every rank tunes the same session, by name.  With
+ * APEX_TUNING_COOPERATIVE=1 the ranks split the candidates of the search
+ * between them, and all switch to the same settings when it converges. */
+
+int main (int argc, char ** argv) {
+    MPI_Init(&argc, &argv);
+    int rank{0};
+    int size{1};
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    apex_tuning_request request("cooperative_tuning_example");
+    if (argc > 1) {
+        if (strcmp(argv[1], "nelder_mead") == 0) {
+            request.set_strategy(apex_ah_tuning_strategy::APEX_NELDER_MEAD);
+        } else if (strcmp(argv[1], "bayesian_optimization") == 0) {
+            request.set_strategy(
+                apex_ah_tuning_strategy::APEX_BAYESIAN_OPTIMIZATION);
+        } else {
+            request.set_strategy(
+                apex_ah_tuning_strategy::APEX_PARALLEL_RANK_ORDER);
+        }
+    } else {
+        request.set_strategy(apex_ah_tuning_strategy::APEX_PARALLEL_RANK_ORDER);
+    }
+
+    apex_event_type my_custom_event =
+        apex::register_custom_event("Get New Params");
+    request.set_trigger(my_custom_event);
+
+    std::shared_ptr<apex_param_long> param_long =
+        request.add_param_long("long", 5, 0, 20, 1);
+    std::shared_ptr<apex_param_double> param_double =
+        request.add_param_double("double", 5.0, 0.0, 20.0, 1.0);
+    std::list<std::string> enum_vals{"a", "b", "c", "d", "e"};
+    std::shared_ptr<apex_param_enum> param_enum =
+        request.add_param_enum("enum", "c", enum_vals);
+
+    double value = 0.0;
+    std::function<double(void)> func = [&]()->double{
+        return value;
+    };
+    request.set_metric(func);
+    apex::setup_custom_tuning(request);
+
+    int measured = 0;
+    for(int i = 0; i < 5000; ++i) {
+        std::string s = param_enum->get_value();
+        double x = 3.0;
+        if(s == "a") {
+            x = 1.0;
+        } else if(s == "b") {
+            x = 2.0;
+        } else if(s == "d" || s == "e") {
+            x = -1.0;
+        }
+        value = x*(param_long->get_value() + param_double->get_value());
+        if (!request.has_converged()) { measured++; }
+        apex::custom_event(my_custom_event, NULL);
+    }
+
+    /* every rank should have ended up with the same settings */
+    double lowest{0.0};
+    double highest{0.0};
+    MPI_Allreduce(&value, &lowest, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(&value, &highest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    if (rank == 0) {
+        std::cout << size << " ranks converged after " << measured
+                  << " iterations, value = " << value << std::endl;
+        if (lowest == highest && value < 0) {
+            std::cout << "Test passed." << std::endl;
+        } else {
+            std::cout << "Test failed." << std::endl;
+        }
+    }
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <mpi.h>
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "apex_api.hpp"
+#include "global_view.hpp"
+
+/* Every rank samples a counter with a different value.  With
+ * APEX_GLOBAL_VIEW=1 the ranks reduce it while they communicate, and a
+ * policy on every rank checks the global minimum, mean and maximum. */
+
+int main (int argc, char ** argv) {
+    MPI_Init(&argc, &argv);
+    int rank{0};
+    int size{1};
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    const std::string counter("rank value");
+    apex::global_view::watch(counter);
+    std::atomic<int> complete{0};
+    std::atomic<bool> correct{true};
+    apex::register_policy(apex::global_view::event(),
+        [&](apex_context const & context)->int {
+            APEX_UNUSED(context);
+            apex::global_view::statistics stats;
+            /* until every rank has sampled it */
+            if (!apex::global_view::get(counter, stats) ||
+                stats.ranks < size) {
+                return APEX_NOERROR;
+            }
+            complete++;
+            if (stats.minimum != 1.0 || stats.maximum != (double)(size) ||
+                stats.mean != (double)(size + 1) / 2.0 ||
+                stats.min_rank != 0 || stats.max_rank != size - 1) {
+                std::cerr << "Rank " << rank << ", round " << stats.round
+                          << ": min " << stats.minimum << " mean "
+                          << stats.mean << " max " << stats.maximum
+                          << std::endl;
+                correct = false;
+            }
+            return APEX_NOERROR;
+        });
+
+    for (int i = 0 ; i < 200 ; i++) {
+        apex::sample_value(counter, (double)(rank + 1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    int passed = (complete > 0 && correct) ? 1 : 0;
+    int all_passed{0};
+    MPI_Allreduce(&passed, &all_passed, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (rank == 0) {
+        std::cout << "Global view rounds checked on rank 0: " << complete
+                  << std::endl;
+        if (all_passed) {
+            std::cout << "Test passed." << std::endl;
+        } else {
+            std::cout << "Test failed." << std::endl;
+        }
+    }
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <functional>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include "apex_api.hpp"
+#include "apex_policies.hpp"
+
+/* The best setting moves halfway through the run, like after a mesh
+ * refinement.  With APEX_TUNING_DRIFT=1 the session notices that the cost
+ * of its converged setting has changed, and tunes again near it. */
+
+int main (int argc, char ** argv) {
+    apex::init("Tuning Drift Test", 0, 1);
+
+    apex_tuning_request request("tuning_drift_example");
+    if (argc > 1) {
+        if (strcmp(argv[1], "nelder_mead") == 0) {
+            request.set_strategy(apex_ah_tuning_strategy::APEX_NELDER_MEAD);
+        } else if (strcmp(argv[1], "bayesian_optimization") == 0) {
+            request.set_strategy(
+                apex_ah_tuning_strategy::APEX_BAYESIAN_OPTIMIZATION);
+        } else if (strcmp(argv[1], "simulated_annealing") == 0) {
+            request.set_strategy(apex_ah_tuning_strategy::SIMULATED_ANNEALING);
+        } else {
+            request.set_strategy(
+                apex_ah_tuning_strategy::APEX_PARALLEL_RANK_ORDER);
+        }
+    } else {
+        request.set_strategy(apex_ah_tuning_strategy::APEX_PARALLEL_RANK_ORDER);
+    }
+
+    apex_event_type my_custom_event =
+        apex::register_custom_event("Get New Params");
+    request.set_trigger(my_custom_event);
+
+    std::shared_ptr<apex_param_long> param_long =
+        request.add_param_long("long", 50, 0, 100, 1);
+
+    double value = 0.0;
+    std::function<double(void)> func = [&]()->double{
+        return value;
+    };
+    request.set_metric(func);
+    apex::setup_custom_tuning(request);
+
+    const long before{20};
+    const long after{28};
+    long target{before};
+    long tuned{-1};
+    for(int i = 0; i < 2000; ++i) {
+        if (i == 1000) {
+            tuned = param_long->get_value();
+            target = after;
+        }
+        long x = param_long->get_value();
+        value = 100.0 + (double)((x - target) * (x - target));
+        apex::custom_event(my_custom_event, NULL);
+    }
+
+    long retuned = param_long->get_value();
+    std::cout << "Tuned to " << tuned << " for " << before << ", then "
+              << retuned << " for " << after << std::endl;
+    if (request.has_converged() &&
+        labs(retuned - after) < labs(tuned - after)) {
+        std::cout << "Test passed." << std::endl;
+    } else {
+        std::cout << "Test failed." << std::endl;
+    }
+    apex::finalize();
+    return 0;
+}
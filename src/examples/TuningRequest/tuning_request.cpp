@@ -4,6 +4,7 @@
 #include <functional>
 #include <memory>
 #include <list>
+#include <cstring>
 #include "apex_api.hpp"
 #include "apex_policies.hpp"
 
@@ -14,13 +15,26 @@ apex_event_type my_custom_event = APEX_CUSTOM_EVENT_1;
  * The Main function
  */
 int main (int argc, char ** argv) {
-    APEX_UNUSED(argc);
-    APEX_UNUSED(argv);
     apex::init("Custom Tuning Test", 0, 1);
 
-#ifdef APEX_HAVE_ACTIVEHARMONY
-
     apex_tuning_request request("tuning_request_example");
+    /* The default is parallel rank order, which is built in when APEX
+     * is built without Active Harmony */
+    if (argc > 1) {
+        if (strcmp(argv[1], "nelder_mead") == 0) {
+            request.set_strategy(apex_ah_tuning_strategy::APEX_NELDER_MEAD);
+        } else if (strcmp(argv[1], "parallel_rank_order") == 0) {
+            request.set_strategy(
+                apex_ah_tuning_strategy::APEX_PARALLEL_RANK_ORDER);
+        } else if (strcmp(argv[1], "bayesian_optimization") == 0) {
+            request.set_strategy(
+                apex_ah_tuning_strategy::APEX_BAYESIAN_OPTIMIZATION);
+        } else if (strcmp(argv[1], "exhaustive") == 0) {
+            request.set_strategy(apex_ah_tuning_strategy::APEX_EXHAUSTIVE);
+        } else if (strcmp(argv[1], "simulated_annealing") == 0) {
+            request.set_strategy(apex_ah_tuning_strategy::SIMULATED_ANNEALING);
+        }
+    }
 
     // Trigger
     my_custom_event = apex::register_custom_event("Get New Params");
@@ -46,8 +60,12 @@ int main (int argc, char ** argv) {
     apex_tuning_session_handle session = apex::setup_custom_tuning(request);
     (void)session; // ignore unused warning
     bool exhaustive = false;
+    int converged_at = -1;
 
     for(int i = 0; i < 500; ++i) {
+        if (converged_at < 0 && request.has_converged()) {
+            converged_at = i;
+        }
         apex::profiler * p = apex::start("Iteration");
         std::string s = param_enum->get_value();
         double x = 0.0;
@@ -73,17 +91,16 @@ int main (int argc, char ** argv) {
         apex::custom_event(my_custom_event, NULL);
     }
 
-
-#endif
-
-#ifdef APEX_HAVE_ACTIVEHARMONY
+    if (converged_at >= 0) {
+        std::cout << "Converged after " << converged_at
+                  << " evaluations (an exhaustive search takes 2000)." << std::endl;
+    } else {
+        std::cout << "Did not converge." << std::endl;
+    }
     if(value < 0 || !exhaustive) {
         std::cout << "Test passed." << std::endl;
     } else {
         std::cout << "Test failed." << std::endl;
     }
-#else
-    std::cout << "Test passed (but APEX was built without Active Harmony.)." << std::endl;
-#endif
     apex::finalize();
 }
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+
+# Run the APEX microbenchmarks (apexBenchmark, from src/examples/Benchmark)
+# with each listener alone and combined, with and without an event filter and
+# timer throttling, and merge the results into one JSON file.  With --compare,
+# show the change from an earlier run of this script.
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+# The listener configurations.  Each one is run with the other listeners
+# explicitly disabled, so the environment of the caller doesn't leak in.
+listener_options = ['APEX_POLICY', 'APEX_TRACE_EVENT', 'APEX_MEASURE_CONCURRENCY', 'APEX_SAMPLING']
+listener_configs = [
+    ('profiler', {}),
+    ('policy', {'APEX_POLICY': '1'}),
+    ('trace_event', {'APEX_TRACE_EVENT': '1'}),
+    ('concurrency', {'APEX_MEASURE_CONCURRENCY': '1'}),
+    ('sampling', {'APEX_SAMPLING': '1'}),
+    ('all', {'APEX_POLICY': '1', 'APEX_TRACE_EVENT': '1',
+             'APEX_MEASURE_CONCURRENCY': '1', 'APEX_SAMPLING': '1'}),
+]
+
+def parseArgs():
+    parser = argparse.ArgumentParser(description='Run the APEX microbenchmarks over a matrix of configurations.')
+    parser.add_argument('--binary', type=str, required=False, default='apexBenchmark',
+        help='The benchmark program (default: apexBenchmark)')
+    parser.add_argument('--threads', type=int, required=False, default=os.cpu_count(),
+        metavar='N', help='Maximum number of threads (default: all cores)')
+    parser.add_argument('--iterations', type=int, required=False, default=100000,
+        metavar='I', help='Iterations of each benchmark, per thread (default: 100000)')
+    parser.add_argument('--benchmark', type=str, required=False, default=None,
+        help='Only run this benchmark (default: all)')
+    parser.add_argument('--listeners', type=str, required=False, default=None,
+        help='Comma separated list of listener configurations to run (default: all of ' +
+        ','.join([c[0] for c in listener_configs]) + ')')
+    parser.add_argument('--output', type=str, required=False, default='apex_benchmark.json',
+        help='The merged output file (default: apex_benchmark.json)')
+    parser.add_argument('--compare', type=str, required=False, default=None,
+        help='An earlier output file to compare with')
+    return parser.parse_args()
+
+def gitCommit():
+    try:
+        here = os.path.dirname(os.path.abspath(__file__))
+        return subprocess.check_output(['git', 'rev-parse', 'HEAD'], cwd=here,
+            stderr=subprocess.DEVNULL).decode().strip()
+    except (OSError, subprocess.CalledProcessError):
+        return 'unknown'
+
+def runOne(args, env, workdir):
+    outfile = os.path.join(workdir, 'result.json')
+    command = [args.binary, '--threads', str(args.threads),
+               '--iterations', str(args.iterations), '--output', outfile]
+    if args.benchmark is not None:
+        command += ['--benchmark', args.benchmark]
+    subprocess.check_call(command, env=env, cwd=workdir,
+        stdout=subprocess.DEVNULL)
+    with open(outfile) as f:
+        return json.load(f)
+
+def runMatrix(args):
+    workdir = tempfile.mkdtemp(prefix='apex_benchmark_')
+    # A filter that excludes nothing the benchmarks do, so it only adds
+    # the cost of checking each timer.
+    filter_file = os.path.join(workdir, 'filter.json')
+    with open(filter_file, 'w') as f:
+        json.dump({'exclude': ['not a benchmark.*']}, f)
+    configs = listener_configs
+    if args.listeners is not None:
+        wanted = args.listeners.split(',')
+        configs = [c for c in listener_configs if c[0] in wanted]
+    runs = []
+    for name, listeners in configs:
+        for use_filter in [False, True]:
+            for throttle in [False, True]:
+                env = dict(os.environ)
+                for option in listener_options:
+                    env[option] = listeners.get(option, '0')
+                env['APEX_SCREEN_OUTPUT'] = '0'
+                env['APEX_EVENT_FILTER_FILE'] = filter_file if use_filter else ''
+                env['APEX_THROTTLE_TIMERS'] = '1' if throttle else '0'
+                print('Running', name, 'filter' if use_filter else '',
+                      'throttle' if throttle else '', file=sys.stderr)
+                result = runOne(args, env, workdir)
+                result['config']['name'] = name
+                runs.append(result)
+    return {'commit': gitCommit(), 'runs': runs}
+
+def key(run, result):
+    config = run['config']
+    return (config['name'], config['event_filter'], config['throttle_timers'],
+            result['benchmark'], result['threads'])
+
+def compare(base, current):
+    old = {}
+    for run in base['runs']:
+        for result in run['results']:
+            old[key(run, result)] = result
+    print('%-12s %-6s %-8s %-24s %7s %12s %12s %8s' % ('listeners', 'filter', 'throttle',
+          'benchmark', 'threads', 'base ns/ev', 'ns/event', 'change'))
+    for run in current['runs']:
+        for result in run['results']:
+            k = key(run, result)
+            if k not in old:
+                continue
+            before = old[k]['ns_per_event']
+            after = result['ns_per_event']
+            change = (after - before) / before * 100.0 if before > 0 else 0.0
+            print('%-12s %-6s %-8s %-24s %7d %12.1f %12.1f %+7.1f%%' % (k[0], k[1], k[2],
+                  k[3], k[4], before, after, change))
+
+def main():
+    args = parseArgs()
+    merged = runMatrix(args)
+    with open(args.output, 'w') as f:
+        json.dump(merged, f, indent=2)
+    print('Results written to', args.output, file=sys.stderr)
+    if args.compare is not None:
+        with open(args.compare) as f:
+            compare(json.load(f), merged)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+
+# Rebuild APEX profiles from the periodic snapshot file written with
+# APEX_PROFILE_SNAPSHOTS=1 (apex_profile_snapshots.<rank>.bin).
+# See src/apex/profile_snapshot_writer.hpp for the file format.
+
+import numpy as np
+import argparse
+import mmap
+import os
+import struct
+
+MAGIC = b'APEXSNP1'
+HEADER = struct.Struct('<8sIIQQ')
+BLOCK = struct.Struct('<IIQQ')
+NAMES_BLOCK = 1
+INTERVAL_BLOCK = 2
+FLAG_RESET = 1
+COLUMNS = ['calls', 'stops', 'accumulated', 'inclusive', 'sum_squares',
+    'minimum', 'maximum', 'allocations', 'frees', 'bytes_allocated',
+    'bytes_freed']
+# these columns are current values, not the change since the last interval
+ABSOLUTE = ['minimum', 'maximum']
+TYPES = {0: 'timer', 1: 'counter'}
+
+def parseArgs():
+    parser = argparse.ArgumentParser(description='Post-process APEX profile snapshots.')
+    parser.add_argument('--filename', type=str, required=False,
+        help='The filename to parse (default: ./apex_profile_snapshots.0.bin)',
+        default='./apex_profile_snapshots.0.bin')
+    parser.add_argument('--list', dest='list_intervals', action='store_true',
+        help='List the intervals in the file (default: false)', default=False)
+    parser.add_argument('--interval', dest='interval', type=int, default=-1, required=False,
+        metavar='N', help='Rebuild the profile as of interval N (default: the last one)')
+    parser.add_argument('--delta', dest='delta', action='store_true',
+        help='Only show the change during the interval (default: false)', default=False)
+    parser.add_argument('--csv', dest='csv', action='store_true',
+        help='Write CSV instead of a table (default: false)', default=False)
+    args = parser.parse_args()
+    if not os.path.isfile(args.filename):
+        parser.print_usage()
+        parser.exit()
+    return args
+
+class Interval:
+    def __init__(self, timestamp, ids, flags, columns):
+        self.timestamp = timestamp
+        self.ids = ids
+        self.flags = flags
+        self.columns = columns
+
+def readSnapshots(filename):
+    """ Memory-map the file, and return the header, the names and the
+        intervals.  The columns of each interval are views of the mapped
+        file, nothing is copied.  A truncated block at the end of the
+        file (i.e. the job was killed while writing) is ignored. """
+    f = open(filename, 'rb')
+    mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    magic, version, node_id, period, _ = HEADER.unpack_from(mm, 0)
+    if magic != MAGIC:
+        raise ValueError(filename + ' is not an APEX snapshot file')
+    header = {'version': version, 'rank': node_id, 'period': period}
+    names = {}
+    intervals = []
+    offset = HEADER.size
+    while offset + BLOCK.size <= len(mm):
+        kind, count, size, timestamp = BLOCK.unpack_from(mm, offset)
+        offset = offset + BLOCK.size
+        if offset + size > len(mm):
+            break
+        if kind == NAMES_BLOCK:
+            pos = offset
+            for i in range(count):
+                nid, ntype, length = struct.unpack_from('<III', mm, pos)
+                pos = pos + 12
+                names[nid] = (mm[pos:pos+length].decode('utf-8', 'replace'),
+                    TYPES.get(ntype, str(ntype)))
+                pos = pos + length
+        elif kind == INTERVAL_BLOCK:
+            ids = np.frombuffer(mm, dtype='<u4', count=count, offset=offset)
+            flags = np.frombuffer(mm, dtype='<u4', count=count, offset=offset + 4*count)
+            pos = offset + 8*count
+            pos = pos + (-pos % 8)
+            columns = {}
+            for name in COLUMNS:
+                columns[name] = np.frombuffer(mm, dtype='<f8', count=count, offset=pos)
+                pos = pos + 8*count
+            intervals.append(Interval(timestamp, ids, flags, columns))
+        offset = offset + size
+    return header, names, intervals
+
+def rebuild(names, intervals, last, delta):
+    """ Accumulate the intervals up to and including 'last'. """
+    num = max(names.keys()) + 1 if len(names) > 0 else 0
+    profile = {name: np.zeros(num) for name in COLUMNS}
+    seen = np.zeros(num, dtype=bool)
+    first = last if delta else 0
+    for interval in intervals[first:last+1]:
+        reset = (interval.flags & FLAG_RESET) != 0
+        for name in COLUMNS:
+            values = interval.columns[name]
+            if name in ABSOLUTE:
+                profile[name][interval.ids] = values
+            else:
+                # a reset profile starts over from zero
+                profile[name][interval.ids[reset]] = 0.0
+                profile[name][interval.ids] += values
+        seen[interval.ids] = True
+    return profile, seen
+
+def show(names, profile, seen, args):
+    rows = []
+    for nid in np.nonzero(seen)[0]:
+        name, ptype = names.get(int(nid), ('unknown', 'timer'))
+        calls = profile['calls'][nid]
+        total = profile['accumulated'][nid]
+        mean = total / calls if calls > 0 else 0.0
+        rows.append((name, ptype, calls, mean, total, profile['minimum'][nid],
+            profile['maximum'][nid]))
+    rows.sort(key=lambda r: r[4], reverse=True)
+    if args.csv:
+        print('"name","type","calls","mean","total","minimum","maximum"')
+        for r in rows:
+            print('"%s","%s",%d,%f,%f,%f,%f' % r)
+        return
+    print('%-50s %8s %10s %14s %14s' % ('Name', 'Type', 'Calls', 'Mean', 'Total'))
+    print('-'*100)
+    for r in rows:
+        print('%-50s %8s %10d %14.2f %14.2f' % (r[0][:50], r[1], r[2], r[3], r[4]))
+
+def main():
+    args = parseArgs()
+    header, names, intervals = readSnapshots(args.filename)
+    if args.list_intervals:
+        print('Rank', header['rank'], 'period', header['period'], 'us,',
+            len(intervals), 'intervals,', len(names), 'profiles')
+        for i, interval in enumerate(intervals):
+            print('%6d %14.6f s %8d changed' % (i, interval.timestamp * 1.0e-9,
+                len(interval.ids)))
+        return
+    if len(intervals) == 0:
+        print('No intervals in', args.filename)
+        return
+    last = args.interval if args.interval >= 0 else len(intervals) - 1
+    last = min(last, len(intervals) - 1)
+    profile, seen = rebuild(names, intervals, last, args.delta)
+    print('Interval', last, 'at', intervals[last].timestamp * 1.0e-9, 'seconds')
+    show(names, profile, seen, args)
+
+if __name__ == '__main__':
+    main()
@@ -5,6 +5,8 @@ import pandas as pd
 import numpy as np
 import argparse
 import os
+import glob
+import apex_columnar
 
 # The output header looks like this:
 #"rank","name","type","num samples/calls","minimum","mean","maximum","stddev","total","inclusive (ns)","num threads","total per thread"
@@ -12,7 +14,7 @@ import os
 def parseArgs():
     parser = argparse.ArgumentParser(description='Post-process APEX flat profiles.')
     parser.add_argument('--filename', type=str, required=False,
-        help='The filename to parse (default: ./apex_profiles.csv)', default='./apex_profiles.csv')
+        help='The filename to parse, or a pattern like "apex_profiles.*.bin" for binary output (default: ./apex_profiles.csv)', default='./apex_profiles.csv')
     parser.add_argument('--counters', dest='counters', action='store_true',
         help='Print the counter data (default: false)', default=False)
     parser.add_argument('--timers', dest='timers', action='store_true',
@@ -28,7 +30,7 @@ def parseArgs():
     parser.add_argument('--sort', dest='sort_by', type=str, default='tot/thr', required=False,
         metavar='C', help='Column to sort timers (default: tot/thr)')
     args = parser.parse_args()
-    if not os.path.isfile(args.filename):
+    if len(glob.glob(args.filename)) == 0:
         parser.print_usage()
         parser.exit()
     if (not args.tau) and (not args.timers) and (not args.counters):
@@ -145,7 +147,10 @@ def convertToTAU(counters, timers, args):
 def main():
     args = parseArgs()
     #print('Reading profiles...')
-    df = pd.read_csv(args.filename) #, index_col=[0,1])
+    if apex_columnar.isColumnar(args.filename):
+        df = apex_columnar.readDataFrame(args.filename)
+    else:
+        df = pd.read_csv(args.filename) #, index_col=[0,1])
     df = df.fillna(0)
     print()
     if (args.counters):
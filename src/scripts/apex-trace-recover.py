@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+
+# Rebuild Google Trace Event files from the memory-mapped trace buffers that
+# APEX writes with APEX_TRACE_EVENT=1 and APEX_TRACE_EVENT_MMAP=1.  At a
+# normal exit APEX merges the buffers into trace_events.<node>.json(.gz) and
+# removes them, so this is only needed after a crash or SIGKILL.  Every
+# buffer has the complete events up to its committed size; anything after
+# that (an event that was being written) is ignored.
+
+import argparse
+import glob
+import json
+import os
+import struct
+import sys
+
+# See mapped_trace_buffer.hpp
+header_format = '<8sIIQQQQ16x'
+header_size = struct.calcsize(header_format)
+magic = b'APEXTRC\0'
+version = 1
+
+def parseArgs():
+    parser = argparse.ArgumentParser(description='Recover APEX traces from memory-mapped trace buffers.')
+    parser.add_argument('buffers', type=str, nargs='*',
+        help='The trace_events.<node>.<thread>.mmap files (default: all of them in --directory)')
+    parser.add_argument('--directory', type=str, required=False, default='.',
+        help='Where to look for the buffers (default: .)')
+    parser.add_argument('--output', type=str, required=False, default='.',
+        help='Directory for the recovered trace_events.<node>.json files (default: .)')
+    parser.add_argument('--remove', action='store_true',
+        help='Remove the buffers once the trace is written')
+    return parser.parse_args()
+
+def readBuffer(filename):
+    with open(filename, 'rb') as f:
+        data = f.read()
+    if len(data) < header_size:
+        print(filename, ': too short for a trace buffer, skipping', file=sys.stderr)
+        return None
+    (m, v, state, node, thread, capacity, committed) = struct.unpack_from(header_format, data)
+    if m != magic or v != version:
+        print(filename, ': not an APEX trace buffer (version', version, '), skipping', file=sys.stderr)
+        return None
+    committed = min(committed, capacity, len(data) - header_size)
+    events = []
+    dropped = 0
+    text = data[header_size:header_size + committed].decode('utf-8', errors='replace')
+    # each event is one line, followed by a comma
+    for line in text.splitlines():
+        line = line.strip().rstrip(',')
+        if len(line) == 0:
+            continue
+        try:
+            events.append(json.loads(line))
+        except ValueError:
+            dropped = dropped + 1
+    print('%s: node %d, thread %d, %s, %d bytes, %d events, %d unreadable' % (filename,
+          node, thread, 'finalized' if state == 1 else 'not finalized', committed,
+          len(events), dropped), file=sys.stderr)
+    return (node, events)
+
+def main():
+    args = parseArgs()
+    buffers = args.buffers
+    if len(buffers) == 0:
+        buffers = sorted(glob.glob(os.path.join(args.directory, 'trace_events.*.mmap')))
+    if len(buffers) == 0:
+        print('No trace buffers found', file=sys.stderr)
+        sys.exit(1)
+    nodes = {}
+    recovered = []
+    for filename in buffers:
+        result = readBuffer(filename)
+        if result is None:
+            continue
+        (node, events) = result
+        nodes.setdefault(node, []).extend(events)
+        recovered.append(filename)
+    for node, events in sorted(nodes.items()):
+        last = max([e['ts'] for e in events if 'ts' in e], default=0)
+        events.append({'name': 'APEX Trace End', 'ph': 'R', 'pid': node, 'tid': 0, 'ts': last})
+        outfile = os.path.join(args.output, 'trace_events.%d.json' % node)
+        with open(outfile, 'w') as f:
+            json.dump({'displayTimeUnit': 'ms', 'traceEvents': events}, f)
+        print('Wrote', len(events), 'events to', outfile, file=sys.stderr)
+    if args.remove:
+        for filename in recovered:
+            os.remove(filename)
+
+if __name__ == '__main__':
+    main()
@@ -6,6 +6,8 @@ import argparse
 from argparse import RawTextHelpFormatter
 import math
 import os
+import glob
+import apex_columnar
 import re
 
 # "process rank","node index","parent index","depth","name","calls","threads","total time(s)","inclusive time(s)","minimum time(s)","mean time(s)","maximum time(s)","stddev time(s)","total Recv Bytes","minimum Recv Bytes","mean Recv Bytes","maximum Recv Bytes","stddev Recv Bytes","median Recv Bytes","mode Recv Bytes","total Send Bytes","minimum Send Bytes","mean Send Bytes","maximum Send Bytes","stddev Send Bytes","median Send Bytes","mode Send Bytes"
@@ -30,7 +32,7 @@ agghelp = 'Aggregation operation for timers and counters (default: mean)'\
 def parseArgs():
     parser = argparse.ArgumentParser(description='Post-process APEX flat profiles.', formatter_class=RawTextHelpFormatter)
     parser.add_argument('--filename', type=str, required=False,
-        help='The filename to parse (default: ./apex_tasktree.csv)', default='./apex_tasktree.csv')
+        help='The filename to parse, or a pattern like "apex_tasktree.*.bin" for binary output (default: ./apex_tasktree.csv)', default='./apex_tasktree.csv')
     parser.add_argument('--tau', dest='tau', action='store_true',
         help='Convert to TAU profiles (default: false)', default=False)
     parser.add_argument('--dot', dest='dot', action='store_true',
@@ -60,7 +62,7 @@ def parseArgs():
     parser.add_argument('--sort', dest='sort_by', type=str, default='tot/thr', required=False,
         metavar='C', help='Column to sort timers (default: tot/thr)')
     args = parser.parse_args()
-    if not os.path.isfile(args.filename):
+    if len(glob.glob(args.filename)) == 0:
         parser.print_usage()
         parser.exit()
     return args
@@ -335,7 +337,10 @@ def main():
 
     if args.verbose:
         print('Reading tasktree...')
-    df = pd.read_csv(args.filename) #, index_col=[0,1])
+    if apex_columnar.isColumnar(args.filename):
+        df = apex_columnar.readDataFrame(args.filename)
+    else:
+        df = pd.read_csv(args.filename) #, index_col=[0,1])
     df = df.fillna(0)
     if args.verbose:
         print('Read', len(df.index), 'rows')
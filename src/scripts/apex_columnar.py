@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+
+# Read the columnar binary profiles written with APEX_BINARY_OUTPUT=1
+# (apex_profiles.<rank>.bin, and apex_tasktree.<rank>.bin with
+# APEX_TASKTREE_OUTPUT=1).  See src/apex/columnar_table.hpp for the format.
+# The numeric columns are views of the memory-mapped file, nothing is
+# parsed.  The column names are the same as in the CSV files, so the
+# resulting DataFrames can be used in place of pd.read_csv().
+
+import numpy as np
+import pandas as pd
+import mmap
+import glob
+import struct
+
+MAGIC = b'APEXCOL1'
+HEADER = struct.Struct('<8sIIIIQQQQ')
+DIRECTORY = struct.Struct('<IIQ')
+FLOAT64 = 1
+UINT32 = 2
+STRING = 3
+KINDS = {1: 'flat profile', 2: 'task tree'}
+
+def isColumnar(filename):
+    """ True if the file (or glob pattern) names columnar binary files. """
+    return filename.endswith('.bin')
+
+def readStrings(mm, offset, count):
+    ends = np.frombuffer(mm, dtype='<u8', count=count, offset=offset)
+    data = offset + 8*count
+    strings = []
+    start = 0
+    for end in ends:
+        strings.append(mm[data+start:data+int(end)].decode('utf-8', 'replace'))
+        start = int(end)
+    return strings
+
+def readTable(filename):
+    """ Memory-map one file, and return the header and an ordered list of
+        (name, values) columns.  String columns are returned as pandas
+        Categoricals, whose codes are the indices in the file. """
+    f = open(filename, 'rb')
+    mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    magic, version, kind, rank, num_columns, rows, num_strings, \
+        strings_offset, _ = HEADER.unpack_from(mm, 0)
+    if magic != MAGIC:
+        raise ValueError(filename + ' is not an APEX columnar file')
+    header = {'version': version, 'kind': KINDS.get(kind, str(kind)),
+        'rank': rank, 'rows': rows}
+    strings = readStrings(mm, strings_offset, num_strings)
+    columns = []
+    for i in range(num_columns):
+        name, ctype, offset = DIRECTORY.unpack_from(mm, HEADER.size + i*DIRECTORY.size)
+        if ctype == FLOAT64:
+            values = np.frombuffer(mm, dtype='<f8', count=rows, offset=offset)
+        else:
+            values = np.frombuffer(mm, dtype='<u4', count=rows, offset=offset)
+            if ctype == STRING:
+                values = pd.Categorical.from_codes(values.astype('int32'), strings)
+        columns.append((strings[name], values))
+    return header, columns
+
+def readDataFrame(pattern):
+    """ Read one file, or all of the files matching a glob pattern (i.e.
+        one per rank), into a single DataFrame.  String columns are
+        converted to plain strings, so that grouping and sorting behave
+        exactly as with the CSV files. """
+    filenames = sorted(glob.glob(pattern))
+    if len(filenames) == 0:
+        raise FileNotFoundError(pattern)
+    frames = []
+    for filename in filenames:
+        header, columns = readTable(filename)
+        data = {}
+        for name, values in columns:
+            if isinstance(values, pd.Categorical):
+                # each name is decoded once, then the codes are mapped
+                values = np.asarray(values.categories, dtype=object)[values.codes]
+            data[name] = values
+        frames.append(pd.DataFrame(data, columns=[c[0] for c in columns]))
+    if len(frames) == 1:
+        return frames[0]
+    return pd.concat(frames, ignore_index=True)
+
+if __name__ == '__main__':
+    import sys
+    for filename in sys.argv[1:]:
+        header, columns = readTable(filename)
+        print(filename, header)
+        for name, values in columns:
+            print('  %-30s %s' % (name, values.dtype))
@@ -0,0 +1,86 @@
+#include "apex_api.hpp"
+#include "block_zstream.hpp"
+#include "gzstream.hpp"
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <unistd.h>
+
+using namespace apex;
+using namespace std;
+
+/* Write trace-like events through the block compressed stream, with and
+ * without compression threads, and check that the file reads back as one
+ * gzip stream with the same contents.  Then check that a failed write is
+ * reported. */
+
+string make_events(size_t count) {
+  stringstream ss;
+  for (size_t i = 0 ; i < count ; i++) {
+    ss << "{\"name\":\"task " << (i % 97) << "\",\"ph\":\"X\",\"pid\":0"
+       << ",\"tid\":" << (i % 8) << ",\"ts\":" << (i * 13)
+       << ".000,\"dur\":" << (i % 1000) << ".000},\n";
+  }
+  return ss.str();
+}
+
+int check(const string& filename, const string& expected, size_t threads) {
+  auto start = chrono::steady_clock::now();
+  {
+    io::block_zstreambuf buffer(filename.c_str(), threads,
+        io::block_codec::gzip, 1 << 16);
+    ostream out(&buffer);
+    // in pieces, with flushes, like the trace listener
+    size_t piece = expected.size() / 10;
+    for (size_t i = 0 ; i < expected.size() ; i += piece) {
+      out.write(expected.data() + i, min(piece, expected.size() - i));
+      out << flush;
+    }
+    buffer.close();
+  }
+  auto seconds = chrono::duration<double>(
+      chrono::steady_clock::now() - start).count();
+  cout << threads << " threads: " << seconds << " seconds" << endl;
+  io::gzifstream in(filename);
+  stringstream actual;
+  actual << in.rdbuf();
+  remove(filename.c_str());
+  if (actual.str() != expected) {
+    cerr << "Failed with " << threads << " threads: read "
+         << actual.str().size() << " of " << expected.size() << " bytes"
+         << endl;
+    return 1;
+  }
+  return 0;
+}
+
+/* A write that fails has to be reported when the stream is closed */
+int check_failure(const string& expected) {
+  // every write to /dev/full fails
+  if (access("/dev/full", W_OK) != 0) { return 0; }
+  io::block_zofstream out("/dev/full", 2, io::block_codec::gzip);
+  out.write(expected.data(), expected.size());
+  out.close();
+  if (!out.fail()) {
+    cerr << "Writing to /dev/full didn't fail" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  init("apex::io::block_zstreambuf unit test", 0, 1);
+  cout << "APEX Version : " << version() << endl;
+  string filename("apex_block_zstream_test." + to_string(getpid()) + ".gz");
+  string expected(make_events(200000));
+  int failed{0};
+  failed += check(filename, expected, 0);
+  failed += check(filename, expected, 1);
+  failed += check(filename, expected, 4);
+  failed += check_failure(expected);
+  finalize();
+  if (failed == 0) { cout << "Test passed." << endl; }
+  return failed;
+}
@@ -0,0 +1,89 @@
+#include "apex_api.hpp"
+#include <unistd.h>
+
+using namespace apex;
+using namespace std;
+
+/* Profiles are updated out-of-band, so wait until they have caught up. */
+bool wait_for_calls(const std::string &name, double calls) {
+  task_identifier id(name);
+  apex_profile snapshot;
+  for (int i = 0 ; i < 10000 ; i++) {
+    if (get_profile_snapshot(id, snapshot) && snapshot.calls >= calls) {
+      return true;
+    }
+    usleep(100);
+  }
+  return false;
+}
+
+bool contains(std::vector<std::pair<task_identifier, apex_profile> > &changed,
+  const std::string &name) {
+  for (auto& c : changed) {
+    if (c.first.get_name().compare(name) == 0) { return true; }
+  }
+  return false;
+}
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  init("apex::get_changed_profiles unit test", 0, 1);
+  profiler * main_profiler = start(__func__);
+  for(int i = 0; i < 30; ++i) {
+    profiler * p = start("foo");
+    stop(p);
+  }
+  if (!wait_for_calls("foo", 30)) {
+    std::cout << "Test failed, foo was not processed." << std::endl;
+    return 1;
+  }
+  std::vector<std::pair<task_identifier, apex_profile> > changed;
+  uint64_t epoch = get_changed_profiles(0, changed);
+  std::cout << "Initial profiles: " << changed.size() << std::endl;
+  if (!contains(changed, "foo")) {
+    std::cout << "Test failed, foo not reported." << std::endl;
+    return 1;
+  }
+  for(int i = 0; i < 40; ++i) {
+    profiler * p = start("bar");
+    stop(p);
+  }
+  if (!wait_for_calls("bar", 40)) {
+    std::cout << "Test failed, bar was not processed." << std::endl;
+    return 1;
+  }
+  changed.clear();
+  epoch = get_changed_profiles(epoch, changed);
+  std::cout << "Changed profiles: " << changed.size() << std::endl;
+  if (!contains(changed, "bar") || contains(changed, "foo")) {
+    std::cout << "Test failed, only bar should have changed." << std::endl;
+    return 1;
+  }
+  for (auto& c : changed) {
+    if (c.first.get_name().compare("bar") == 0) {
+      std::cout << "bar calls : " << c.second.calls << std::endl;
+    }
+  }
+  // update foo again, which moves it past bar in the changed list
+  for(int i = 0; i < 20; ++i) {
+    profiler * p = start("foo");
+    stop(p);
+  }
+  if (!wait_for_calls("foo", 50)) {
+    std::cout << "Test failed, foo was not processed again." << std::endl;
+    return 1;
+  }
+  changed.clear();
+  epoch = get_changed_profiles(epoch, changed);
+  std::cout << "Changed profiles: " << changed.size() << std::endl;
+  if (!contains(changed, "foo") || contains(changed, "bar")) {
+    std::cout << "Test failed, only foo should have changed." << std::endl;
+    return 1;
+  }
+  stop(main_profiler);
+  finalize();
+  std::cout << "Test passed." << std::endl;
+  return 0;
+}
+
@@ -0,0 +1,62 @@
+#include "apex_api.hpp"
+#include <chrono>
+#include <iostream>
+
+#define ITERATIONS 100000
+
+using namespace std;
+
+std::atomic<size_t> stops(0);
+
+int stop_policy(apex_context const& context) {
+    APEX_UNUSED(context);
+    stops++;
+    return APEX_NOERROR;
+}
+
+/* The cost of one start/stop pair, in nanoseconds */
+double time_pairs(void) {
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0 ; i < ITERATIONS ; i++) {
+        apex::profiler* p = apex::start("listener overhead");
+        apex::stop(p);
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - begin).count() / ITERATIONS;
+}
+
+/* Run with different APEX_* listener options (see CMakeLists.txt) to
+ * compare the combinations. */
+int main (int argc, char** argv) {
+    APEX_UNUSED(argc);
+    APEX_UNUSED(argv);
+    apex::init("apex listener overhead unit test", 0, 1);
+    apex::profiler* p = apex::start(__func__);
+    cout << "Listeners: profiler"
+         << (apex::apex_options::use_trace_event() ? " trace_event" : "")
+         << (apex::apex_options::use_concurrency() > 0 ? " concurrency" : "")
+         << (apex::apex_options::use_sampling() ? " sampling" : "")
+         << (apex::apex_options::use_policy() ? " policy" : "") << endl;
+    // warm up
+    time_pairs();
+    cout << "start/stop: " << time_pairs() << " ns" << endl;
+    /* A stop policy adds the policy handler to the stop events */
+    apex_policy_handle * handle =
+        apex::register_policy(APEX_STOP_EVENT, stop_policy);
+    cout << "start/stop with a stop policy: " << time_pairs() << " ns"
+         << endl;
+    apex::deregister_policy(handle);
+    size_t seen = stops;
+    cout << "start/stop after removing it: " << time_pairs() << " ns"
+         << endl;
+    apex::stop(p);
+    apex::finalize();
+    if (apex::apex_options::use_policy() &&
+        (seen < ITERATIONS || stops != seen)) {
+        cerr << "The stop policy saw " << seen << " events, then "
+             << stops - seen << " more after it was removed" << endl;
+        return 1;
+    }
+    return 0;
+}
+
@@ -0,0 +1,67 @@
+#include "apex_api.hpp"
+#include "perfstubs_api/tool.h"
+#include <chrono>
+#include <iostream>
+
+#define ITERATIONS 100000
+
+using namespace std;
+
+/* The cost of one start/stop pair, in nanoseconds */
+template <typename F> double time_pairs(F pair) {
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0 ; i < ITERATIONS ; i++) {
+        pair();
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - begin).count() / ITERATIONS;
+}
+
+int main (int argc, char** argv) {
+    APEX_UNUSED(argc);
+    APEX_UNUSED(argv);
+    ps_tool_initialize();
+    apex::profiler* p = apex::start(__func__);
+    void * outer = ps_tool_timer_create("perfstubs outer");
+    void * inner = ps_tool_timer_create("perfstubs inner");
+    if (ps_tool_timer_create("perfstubs inner") != inner) {
+        cerr << "Expected one handle per timer name" << endl;
+        return 1;
+    }
+    /* stop the outer timer first; the handle says which one to stop */
+    ps_tool_timer_start(outer);
+    ps_tool_timer_start(inner);
+    ps_tool_timer_stop(outer);
+    ps_tool_timer_stop(inner);
+    /* stopping a timer that isn't running does nothing */
+    ps_tool_timer_stop(outer);
+    /* compare the handle and the name based start/stop */
+    void * handle = ps_tool_timer_create("perfstubs handle");
+    double with_handle = time_pairs([handle]() {
+        ps_tool_timer_start(handle);
+        ps_tool_timer_stop(handle);
+    });
+    double with_name = time_pairs([]() {
+        apex::profiler* q = apex::start("perfstubs name");
+        apex::stop(q);
+    });
+    cout << "handle start/stop: " << with_handle << " ns" << endl;
+    cout << "name start/stop:   " << with_name << " ns" << endl;
+    apex::stop(p);
+    /* the profiles are complete once finalize has processed the queue */
+    apex::finalize();
+    apex_profile * profile = apex::get_profile("perfstubs outer");
+    if (profile == nullptr || profile->calls != 1) {
+        cerr << "Expected 1 call to the outer timer" << endl;
+        return 1;
+    }
+    profile = apex::get_profile("perfstubs handle");
+    if (profile == nullptr || profile->calls != ITERATIONS) {
+        cerr << "Expected " << ITERATIONS << " calls to the handle timer"
+             << endl;
+        return 1;
+    }
+    apex::cleanup();
+    return 0;
+}
+
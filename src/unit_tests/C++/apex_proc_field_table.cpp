@@ -0,0 +1,100 @@
+#include "apex_api.hpp"
+#include "event_listener.hpp"
+#include "proc_read.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+
+using namespace apex;
+using namespace std;
+
+/* Sample a fake /proc file with a proc_field_table, and check that only
+ * the selected fields are sampled, and only when their values change. */
+
+mutex counts_mutex;
+map<string, int> counts;
+
+int count_samples(apex_context const& context) {
+  sample_value_event_data * data = (sample_value_event_data*)context.data;
+  // the proc reader samples the real files at the same time
+  if (data->counter_name->find("test:") == 0) {
+    unique_lock<mutex> l(counts_mutex);
+    counts[*(data->counter_name)]++;
+  }
+  return APEX_NOERROR;
+}
+
+void write_file(const string& filename, const string& contents) {
+  ofstream out(filename);
+  out << contents;
+}
+
+int expect(const string& counter, int expected) {
+  unique_lock<mutex> l(counts_mutex);
+  int actual = counts.count(counter) > 0 ? counts[counter] : 0;
+  if (actual != expected) {
+    cerr << counter << ": expected " << expected << " samples, got "
+         << actual << endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  init("apex::proc_field_table unit test", 0, 1);
+  cout << "APEX Version : " << version() << endl;
+  register_policy(APEX_SAMPLE_VALUE, count_samples);
+  string filename("apex_proc_field_table." + to_string(getpid()));
+  // like /proc/self/status, with a number after some of the keys
+  proc_field_table table(filename.c_str(), 0, "Vm*, Threads",
+    [](const string& key, const char* values, vector<proc_field>& fields) {
+      char* end;
+      strtod(values, &end);
+      if (end == values) { return; } // not a number
+      fields.push_back(proc_field{0, key, "test:" + key, 0.0, false});
+    });
+  int failed = 0;
+  if (table.sample()) {
+    cerr << "Sampled a file that doesn't exist" << endl;
+    failed++;
+  }
+  write_file(filename, "Name:\ttest\nVmRSS:\t100 kB\n"
+    "Threads:\t4\nCpus_allowed:\t3\n");
+  table.sample();
+  failed += expect("test:VmRSS", 1);
+  failed += expect("test:Threads", 1);
+  // not selected
+  failed += expect("test:Cpus_allowed", 0);
+  failed += expect("test:Name", 0);
+  // nothing changed
+  table.sample();
+  failed += expect("test:VmRSS", 1);
+  failed += expect("test:Threads", 1);
+  // one value changed
+  write_file(filename, "Name:\ttest\nVmRSS:\t200 kB\n"
+    "Threads:\t4\nCpus_allowed:\t3\n");
+  table.sample();
+  failed += expect("test:VmRSS", 2);
+  failed += expect("test:Threads", 1);
+  // a new key, the unchanged values are still skipped
+  write_file(filename, "Name:\ttest\nVmRSS:\t200 kB\nVmSwap:\t0 kB\n"
+    "Threads:\t4\nCpus_allowed:\t3\n");
+  table.sample();
+  failed += expect("test:VmRSS", 2);
+  failed += expect("test:VmSwap", 1);
+  failed += expect("test:Threads", 1);
+  remove(filename.c_str());
+  finalize();
+  cleanup();
+  if (failed > 0) {
+    return 1;
+  }
+  cout << "Test passed." << endl;
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <apex_api.hpp>
+#include <task_identifier.hpp>
+
+#define NUM_THREADS 4
+#define ITERATIONS 1000
+
+std::atomic<size_t> batches(0);
+std::atomic<size_t> stop_events(0);
+std::atomic<size_t> sample_events(0);
+std::atomic<bool> out_of_order(false);
+
+int batch_policy(apex_context const& context) {
+    apex_event_batch * batch = (apex_event_batch*)(context.data);
+    batches++;
+    for (size_t i = 0 ; i < batch->count ; i++) {
+        if (batch->records[i].event_type != context.event_type) {
+            out_of_order = true;
+        }
+        if (i > 0 && batch->records[i].timestamp <
+            batch->records[i-1].timestamp) {
+            out_of_order = true;
+        }
+    }
+    if (context.event_type == APEX_STOP_EVENT) {
+        stop_events += batch->count;
+    } else if (context.event_type == APEX_SAMPLE_VALUE) {
+        for (size_t i = 0 ; i < batch->count ; i++) {
+            /* APEX samples its own counters too, only count ours */
+            apex::task_identifier * id =
+                (apex::task_identifier*)(batch->records[i].task_id);
+            if (id->get_name() == "worker value") {
+                sample_events++;
+            }
+        }
+    }
+    return APEX_NOERROR;
+}
+
+std::atomic<apex_policy_handle*> self_handle(nullptr);
+std::atomic<size_t> self_events(0);
+
+/* a batch policy that removes itself must not deadlock the delivery */
+int self_removing_policy(apex_context const& context) {
+    apex_event_batch * batch = (apex_event_batch*)(context.data);
+    self_events += batch->count;
+    apex_policy_handle * handle = self_handle.exchange(nullptr);
+    if (handle != nullptr) {
+        apex::deregister_policy(handle);
+    }
+    return APEX_NOERROR;
+}
+
+void worker(void) {
+    apex::register_thread("batch policy worker");
+    for (int i = 0 ; i < ITERATIONS ; i++) {
+        apex::profiler* p = apex::start("worker loop");
+        apex::stop(p);
+        apex::sample_value("worker value", i);
+    }
+    apex::exit_thread();
+}
+
+int main(int argc, char **argv)
+{
+    APEX_UNUSED(argc);
+    APEX_UNUSED(argv);
+    apex::init("apex_register_batch_policy unit test", 0, 1);
+    apex_policy_handle * on_stop =
+        apex::register_batch_policy(APEX_STOP_EVENT, 10000, batch_policy);
+    apex_policy_handle * on_sample =
+        apex::register_batch_policy(APEX_SAMPLE_VALUE, 0, batch_policy);
+    /* Not a supported event type for batching */
+    apex_policy_handle * on_startup =
+        apex::register_batch_policy(APEX_STARTUP, 0, batch_policy);
+    if (on_startup != nullptr) {
+        printf("Startup batch policy should have been rejected!\n");
+        return(1);
+    }
+    apex::deregister_policy(on_startup);
+    /* Removing a periodic policy with the same period must not stop the
+     * delivery of the batches */
+    apex_policy_handle * on_period = apex::register_periodic_policy(10000,
+        [](apex_context const&){ return APEX_NOERROR; });
+    apex::deregister_policy(on_period);
+    std::vector<std::thread> threads;
+    for (int i = 0 ; i < NUM_THREADS ; i++) {
+        threads.push_back(std::thread(worker));
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (int i = 0 ; i < 2000 && stop_events != NUM_THREADS * ITERATIONS ;
+         i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    bool delivered = (stop_events == NUM_THREADS * ITERATIONS);
+    /* deregistering delivers anything still buffered */
+    apex::deregister_policy(on_stop);
+    apex::deregister_policy(on_sample);
+    printf("Delivered %lu batches, %lu stop events, %lu samples.\n",
+        (unsigned long)batches, (unsigned long)stop_events,
+        (unsigned long)sample_events);
+    /* The last batch policy is gone, so the timer stopped. Registering
+     * a new one has to start it again. */
+    self_handle = apex::register_batch_policy(APEX_STOP_EVENT, 10000,
+        self_removing_policy);
+    for (int i = 0 ; i < ITERATIONS ; i++) {
+        apex::profiler* p = apex::start("main loop");
+        apex::stop(p);
+    }
+    for (int i = 0 ; i < 2000 && self_handle != nullptr ; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    bool restarted = (self_handle == nullptr && self_events > 0);
+    printf("Delivered %lu stop events after re-registering.\n",
+        (unsigned long)self_events);
+    apex::finalize();
+    if (!restarted) {
+        printf("Stop events were not delivered after re-registering!\n");
+        return(1);
+    }
+    if (!delivered) {
+        printf("Stop events were not delivered periodically!\n");
+        return(1);
+    }
+    if (out_of_order ||
+        stop_events != NUM_THREADS * ITERATIONS ||
+        sample_events != NUM_THREADS * ITERATIONS) {
+        printf("Test failed!\n");
+        return(1);
+    }
+    return(0);
+}
+
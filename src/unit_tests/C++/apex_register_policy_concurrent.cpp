@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <apex_api.hpp>
+
+#define NUM_THREADS 4
+#define ITERATIONS 10000
+#define REGISTRATIONS 200
+
+std::atomic<bool> done(false);
+std::atomic<size_t> policy_calls(0);
+
+int count_policy(apex_context const context) {
+    APEX_UNUSED(context);
+    policy_calls++;
+    return APEX_NOERROR;
+}
+
+void worker(void) {
+    apex::register_thread("concurrent policy worker");
+    int i = 0;
+    while (!done) {
+        for (i = 0 ; i < ITERATIONS ; i++) {
+            apex::profiler* p = apex::start("worker loop");
+            apex::stop(p);
+        }
+    }
+    apex::exit_thread();
+}
+
+int main(int argc, char **argv)
+{
+    APEX_UNUSED(argc);
+    APEX_UNUSED(argv);
+    apex::init("apex_register_policy_concurrent unit test", 0, 1);
+    apex::profiler* my_profiler = apex::start(__func__);
+    std::vector<std::thread> threads;
+    for (int i = 0 ; i < NUM_THREADS ; i++) {
+        threads.push_back(std::thread(worker));
+    }
+    /* register and deregister policies while the workers are
+     * generating start and stop events. */
+    for (int i = 0 ; i < REGISTRATIONS ; i++) {
+        apex_policy_handle * on_start =
+            apex::register_policy(APEX_START_EVENT, count_policy);
+        apex_policy_handle * on_stop =
+            apex::register_policy(APEX_STOP_EVENT, count_policy);
+        std::this_thread::yield();
+        apex::deregister_policy(on_start);
+        apex::deregister_policy(on_stop);
+    }
+    done = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    printf("Policies executed %lu times.\n", (unsigned long)policy_calls);
+    apex::stop(my_profiler);
+    apex::finalize();
+    return(0);
+}
+
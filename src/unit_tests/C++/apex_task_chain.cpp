@@ -0,0 +1,51 @@
+#include "apex_api.hpp"
+#include <sys/resource.h>
+#include <iostream>
+
+#define CHAIN_LENGTH 1000000
+#define WARMUP 100000
+/* in KB, much less than the chain would need if it were kept alive */
+#define MAX_GROWTH 32768
+
+using namespace std;
+
+long peak_rss(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/* A continuation style chain of tasks: each task is the parent of the next,
+ * and only the last one is referenced by the application. */
+std::shared_ptr<apex::task_wrapper> extend_chain(
+    std::shared_ptr<apex::task_wrapper> last, int length) {
+    for (int i = 0 ; i < length ; i++) {
+        auto next = apex::new_task("chain link", UINTMAX_MAX, last);
+        apex::start(next);
+        apex::stop(next);
+        last = next;
+    }
+    return last;
+}
+
+int main (int argc, char** argv) {
+    APEX_UNUSED(argc);
+    APEX_UNUSED(argv);
+    apex::init("apex task chain unit test", 0, 1);
+    apex::profiler* p = apex::start(__func__);
+    auto last = extend_chain(nullptr, WARMUP);
+    long before = peak_rss();
+    last = extend_chain(last, CHAIN_LENGTH);
+    long after = peak_rss();
+    cout << "Peak RSS after " << WARMUP << " tasks: " << before << " KB" << endl;
+    cout << "Peak RSS after " << WARMUP + CHAIN_LENGTH << " tasks: "
+         << after << " KB" << endl;
+    apex::stop(p);
+    apex::finalize();
+    if (after - before > MAX_GROWTH) {
+        cerr << "Memory grew by " << after - before << " KB" << endl;
+        return 1;
+    }
+    return 0;
+}
+
@@ -0,0 +1,146 @@
+#include "apex_api.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+
+using namespace apex;
+using namespace std;
+
+/* Run a child with APEX_TRACE_EVENT=1 and APEX_TRACE_EVENT_MMAP=1 that exits
+ * normally, and check that the merged trace is valid JSON with all of the
+ * events.  Then run one that is killed after writing its events, recover
+ * the trace from its buffers with apex-trace-recover.py, and check that.
+ * The arguments are the python interpreter and the recovery script (see
+ * CMakeLists.txt); the traces are read with python's json module. */
+
+#define NUM_THREADS 4
+#define ITERATIONS 250
+
+void some_work(void) {
+  register_thread("mmap worker");
+  for (int i = 0 ; i < ITERATIONS ; i++) {
+    profiler * p = start("mmap test");
+    stop(p);
+  }
+  exit_thread();
+}
+
+int child(bool kill_me) {
+  init("apex::trace_event_mmap unit test child", 0, 1);
+  profiler * main_profiler = start(__func__);
+  vector<thread> threads;
+  for (int i = 0 ; i < NUM_THREADS ; i++) {
+    threads.push_back(thread(some_work));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  if (kill_me) {
+    // no chance to merge the buffers
+    raise(SIGKILL);
+  }
+  stop(main_profiler);
+  finalize();
+  return 0;
+}
+
+int run(const string& command) {
+  cout << command << endl;
+  return system(command.c_str());
+}
+
+/* count the trace files in the directory that end with the suffix */
+int count_files(const string& dir, const string& suffix) {
+  int count = 0;
+  DIR * d = opendir(dir.c_str());
+  if (d == nullptr) { return 0; }
+  struct dirent * entry;
+  while ((entry = readdir(d)) != nullptr) {
+    string name(entry->d_name);
+    if (name.find("trace_events.") == 0 && name.size() > suffix.size() &&
+        name.compare(name.size() - suffix.size(), suffix.size(),
+            suffix) == 0) {
+      count++;
+    }
+  }
+  closedir(d);
+  return count;
+}
+
+/* Parse the trace, and check that it has every "mmap test" event */
+int check_trace(const string& python, const string& dir) {
+  stringstream ss;
+  ss << python << " -c '"
+     << "import glob, gzip, json, sys\n"
+     << "files = glob.glob(sys.argv[1] + \"/trace_events.0.json*\")\n"
+     << "f = files[0]\n"
+     << "trace = json.load(gzip.open(f, \"rt\") if f.endswith(\".gz\") "
+     << "else open(f))\n"
+     << "n = len([e for e in trace[\"traceEvents\"] "
+     << "if e.get(\"name\") == \"mmap test\" and e.get(\"ph\") == \"X\"])\n"
+     << "print(f, \":\", n, \"events\")\n"
+     << "sys.exit(0 if n == int(sys.argv[2]) else 1)\n"
+     << "' " << dir << " " << NUM_THREADS * ITERATIONS;
+  if (run(ss.str()) != 0) {
+    cerr << "The trace in " << dir << " is not valid, or is missing events"
+         << endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main (int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "child") == 0) {
+    return child(argc > 2 && strcmp(argv[2], "kill") == 0);
+  }
+  if (argc < 3) {
+    cerr << "Usage: " << argv[0] << " <python> <apex-trace-recover.py>"
+         << endl;
+    return 1;
+  }
+  string python(argv[1]);
+  string script(argv[2]);
+  init("apex::trace_event_mmap unit test", 0, 1);
+  cout << "APEX Version : " << version() << endl;
+  char tmpl[] = "apex_trace_event_mmap.XXXXXX";
+  string dir(mkdtemp(tmpl));
+  string env("APEX_TRACE_EVENT=1 APEX_TRACE_EVENT_MMAP=1 "
+      "APEX_SCREEN_OUTPUT=0 APEX_OUTPUT_FILE_PATH=" + dir + " ");
+  int failed = 0;
+  // a normal exit merges the buffers and removes them
+  run(env + argv[0] + " child");
+  if (count_files(dir, ".mmap") != 0) {
+    cerr << "The buffers in " << dir << " were not removed" << endl;
+    failed++;
+  }
+  failed += check_trace(python, dir);
+  run("rm -f " + dir + "/trace_events.*");
+  // a killed child leaves its buffers behind
+  run(env + argv[0] + " child kill");
+  if (count_files(dir, ".mmap") == 0) {
+    cerr << "The killed child left no buffers in " << dir << endl;
+    failed++;
+  } else {
+    if (run(python + " " + script + " --directory " + dir + " --output " +
+        dir + " --remove") != 0) {
+      cerr << "Recovering the trace failed" << endl;
+      failed++;
+    }
+    failed += check_trace(python, dir);
+  }
+  run("rm -rf " + dir);
+  finalize();
+  cleanup();
+  if (failed > 0) {
+    return 1;
+  }
+  cout << "Test passed." << endl;
+  return 0;
+}
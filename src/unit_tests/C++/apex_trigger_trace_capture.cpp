@@ -0,0 +1,157 @@
+#include "apex_api.hpp"
+#ifdef APEX_HAVE_ZLIB
+#include "gzstream.hpp"
+#else
+#include <fstream>
+#endif
+#include <cstdlib>
+#include <signal.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace apex;
+using namespace std;
+
+/* Run with APEX_TRACE_EVENT=1, APEX_TRACE_EVENT_FLIGHT_RECORDER=1 and
+ * APEX_TRACE_EVENT_FLIGHT_RECORDER_SECONDS=1 (see CMakeLists.txt) to write
+ * the recent events at each trigger.  Then read the trace back, and check
+ * that each capture wrote the events in its window, and only once. */
+
+int capture_policy(apex_context const& context) {
+  APEX_UNUSED(context);
+  return APEX_TRACE_CAPTURE;
+}
+
+void some_work(const char * name, int count) {
+  for(int i = 0; i < count; ++i) {
+    profiler * p = start(name);
+    stop(p);
+  }
+}
+
+/* the value of a field in an event line, or empty */
+string field(const string& line, const string& name) {
+  string key("\"" + name + "\":");
+  size_t pos = line.find(key);
+  if (pos == string::npos) { return string(); }
+  pos += key.size();
+  if (line[pos] == '"') {
+    return line.substr(pos + 1, line.find('"', pos + 1) - pos - 1);
+  }
+  return line.substr(pos, line.find_first_of(",}", pos) - pos);
+}
+
+struct capture {
+  string reason;
+  double ts;
+  int foo;
+};
+
+int check_trace(const string& filename, double window_us) {
+#ifdef APEX_HAVE_ZLIB
+  io::gzifstream in(filename + ".gz");
+#else
+  ifstream in(filename);
+#endif
+  vector<capture> captures;
+  int failed = 0;
+  string line;
+  while (getline(in, line)) {
+    string name = field(line, "name");
+    if (name == "APEX Trace Capture") {
+      captures.push_back(capture{field(line, "reason"),
+        atof(field(line, "ts").c_str()), 0});
+    } else if (name == "old") {
+      cerr << "An event from before the window was captured" << endl;
+      failed++;
+    } else if (name == "foo" && field(line, "ph") == "X") {
+      if (captures.empty()) {
+        cerr << "An event was written before the first capture" << endl;
+        failed++;
+        continue;
+      }
+      double ts = atof(field(line, "ts").c_str());
+      if (ts < captures.back().ts - window_us) {
+        cerr << "An event was older than the window of the "
+             << captures.back().reason << " capture" << endl;
+        failed++;
+      }
+      captures.back().foo++;
+    }
+  }
+  // main is also longer than the latency trigger, and is captured as
+  // APEX finalizes
+  const char * reasons[] = {"unit test", "policy", "slow took", "signal",
+    "main took"};
+  if (captures.size() != 5) {
+    cerr << "Expected 5 captures, found " << captures.size() << endl;
+    return failed + 1;
+  }
+  int total = 0;
+  for (size_t i = 0 ; i < captures.size() ; i++) {
+    cout << captures[i].reason << ": " << captures[i].foo << " events"
+         << endl;
+    if (captures[i].reason.find(reasons[i]) == string::npos) {
+      cerr << "Capture " << i << " was for '" << captures[i].reason
+           << "', expected '" << reasons[i] << "'" << endl;
+      failed++;
+    }
+    total += captures[i].foo;
+  }
+  // the API capture is synchronous, the others happen a little later
+  if (captures[0].foo != 1000 || captures[1].foo < 1000) {
+    cerr << "The API and policy captures are missing events" << endl;
+    failed++;
+  }
+  // each event is written once
+  if (total != 3000) {
+    cerr << "Captured " << total << " of 3000 events" << endl;
+    failed++;
+  }
+  return failed;
+}
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  init("apex::trigger_trace_capture unit test", 0, 1);
+  cout << "APEX Version : " << version() << endl;
+  double window_us =
+    apex_options::trace_event_flight_recorder_seconds() * 1.0e6;
+  profiler * main_profiler = start(__func__);
+  // these events are too old to be written
+  some_work("old", 1000);
+  usleep((useconds_t)(window_us * 1.5));
+  // the API trigger
+  some_work("foo", 1000);
+  trigger_trace_capture("unit test");
+  // a policy trigger
+  apex_event_type capture_event = register_custom_event("capture");
+  register_policy(capture_event, capture_policy);
+  some_work("foo", 1000);
+  custom_event(capture_event, nullptr);
+  // a latency trigger, with APEX_TRACE_EVENT_TRIGGER_LATENCY_US
+  profiler * p = start("slow");
+  usleep(100000);
+  stop(p);
+  some_work("foo", 1000);
+  usleep(100000);
+  // a signal trigger, with APEX_TRACE_EVENT_TRIGGER_SIGNAL
+  if (apex_options::trace_event_trigger_signal() > 0) {
+    raise(apex_options::trace_event_trigger_signal());
+  }
+  some_work("bar", 1000);
+  usleep(100000);
+  stop(main_profiler);
+  finalize();
+  string filename(apex_options::output_file_path());
+  filename += "/trace_events.0.json";
+  int failed = check_trace(filename, window_us);
+  cleanup();
+  if (failed > 0) {
+    return 1;
+  }
+  cout << "Test passed." << endl;
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "apex_api.hpp"
+#include "tuning_cache.hpp"
+#include <cmath>
+#include <cstdio>
+#include <unistd.h>
+
+using namespace apex;
+using namespace std;
+
+/* Save converged results from two "runs" to the same file, and check that
+ * they merge, and that a nearby context finds the nearest result. */
+
+tuning_cache::entry make_entry(const string& name, double size,
+    int64_t team, double cost) {
+  tuning_cache::entry e;
+  e.name = name;
+  tuning_cache::feature f;
+  f.id = tuning_cache::variable_id("size",
+      tuning_cache::setting_type::double_value);
+  f.numeric = true;
+  f.value = size;
+  f.label = 0;
+  e.features.push_back(f);
+  f.id = tuning_cache::variable_id("kernel",
+      tuning_cache::setting_type::string_value);
+  f.numeric = false;
+  f.value = 0.0;
+  f.label = tuning_cache::label("kernel");
+  e.features.push_back(f);
+  tuning_cache::setting s;
+  s.type = tuning_cache::setting_type::int_value;
+  s.id = tuning_cache::variable_id("team", s.type);
+  s.dvalue = 0.0;
+  s.lvalue = team;
+  e.settings.push_back(s);
+  e.cost = cost;
+  e.runs = 1;
+  return e;
+}
+
+int check(bool condition, const char * what) {
+  if (!condition) { cerr << "Failed: " << what << endl; }
+  return condition ? 0 : 1;
+}
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  init("apex::tuning_cache unit test", 0, 1);
+  cout << "APEX Version : " << version() << endl;
+  string filename("apex_tuning_cache_test." + to_string(getpid()));
+  int failed{0};
+
+  tuning_cache::cache first;
+  first.add(make_entry("context_0", 100, 32, 5.0));
+  first.add(make_entry("context_1", 1000000, 8, 50.0));
+  failed += check(first.save(filename), "first save");
+
+  // the same context with a better result, and a new one
+  tuning_cache::cache second;
+  second.add(make_entry("context_0", 100, 16, 4.0));
+  second.add(make_entry("context_0", 10000, 1, 7.0));
+  // the names aren't the same across runs, so this is context_1
+  second.add(make_entry("renamed_1", 1000000, 4, 40.0));
+  failed += check(second.save(filename), "second save");
+
+  tuning_cache::cache loaded;
+  failed += check(loaded.load(filename), "load");
+  failed += check(loaded.size() == 3, "merged size");
+  for (auto& e : loaded.get_entries()) {
+    if (e.name == "context_0" && e.features[0].value == 100) {
+      failed += check(e.settings[0].lvalue == 16, "lower cost kept");
+      failed += check(e.runs == 2, "runs counted");
+    }
+    if (e.features[0].value == 1000000) {
+      failed += check(e.settings[0].lvalue == 4 && e.runs == 2,
+          "merged by features");
+    }
+  }
+
+  vector<uint64_t> ids{tuning_cache::variable_id("team",
+      tuning_cache::setting_type::int_value)};
+  double distance;
+  const tuning_cache::entry * near = loaded.nearest(
+      make_entry("new", 1200000, 0, 0.0).features, ids, distance);
+  failed += check(near != nullptr && near->settings[0].lvalue == 4,
+      "nearest entry");
+  failed += check(distance < 1.0, "nearest distance");
+  // a different kernel is never near
+  tuning_cache::entry other = make_entry("other", 100, 0, 0.0);
+  other.features[1].label = tuning_cache::label("other kernel");
+  near = loaded.nearest(other.features, ids, distance);
+  failed += check(near == nullptr, "different kernel");
+  // nor is a tuning variable with the same name and another type
+  vector<uint64_t> string_ids{tuning_cache::variable_id("team",
+      tuning_cache::setting_type::string_value)};
+  near = loaded.nearest(make_entry("new", 100, 0, 0.0).features,
+      string_ids, distance);
+  failed += check(near == nullptr, "different setting type");
+
+  remove(filename.c_str());
+  remove((filename + ".lock").c_str());
+  finalize();
+  if (failed == 0) { cout << "Test passed." << endl; }
+  return failed;
+}